@@ -0,0 +1,873 @@
+/*
+	aes.c ~ RL
+
+	AES-128 block cipher with table-driven and AES-NI backends
+*/
+
+#include "aes.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define AES_NI_SUPPORTED
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AES_NI_TARGET
+#else
+#include <cpuid.h>
+#define AES_NI_TARGET __attribute__((target("aes,sse2")))
+#endif
+#endif
+
+/*	https://github.com/m3y54m/aes-in-c
+	https://en.wikipedia.org/wiki/Rijndael_MixColumns
+	https://en.wikipedia.org/wiki/Finite_field_arithmetic#Rijndael's_(AES)_finite_field */
+
+/* KEY_SIZE can be 16, 24, or 32. 16 is the only tested constant. */
+#define KEY_SIZE		AES_KEY_SIZE
+#define EXP_KEY_SIZE	AES_EXPANDED_KEY_SIZE
+#define STATE_SIZE		AES_BLOCK_SIZE /* state is a 4x4 matrix, row-major */
+/* from "The Design of Rjindael:" "For Rijndael versions with a longer key, the number of rounds was raised by one for every additional 32 bits in the cipher key." */
+#define ROUND_COUNT		(6 + (KEY_SIZE / 4))
+
+static uint8_t aes_sbox[] =
+{
+	0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+	0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+	0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+	0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+	0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+	0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+	0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+	0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+	0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+	0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+	0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+	0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+	0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+	0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+	0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+	0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+static uint8_t aes_sbox_invert[] =
+{
+	0x52, 0x09, 0x6A, 0xD5, 0x30, 0x36, 0xA5, 0x38, 0xBF, 0x40, 0xA3, 0x9E, 0x81, 0xF3, 0xD7, 0xFB,
+	0x7C, 0xE3, 0x39, 0x82, 0x9B, 0x2F, 0xFF, 0x87, 0x34, 0x8E, 0x43, 0x44, 0xC4, 0xDE, 0xE9, 0xCB,
+	0x54, 0x7B, 0x94, 0x32, 0xA6, 0xC2, 0x23, 0x3D, 0xEE, 0x4C, 0x95, 0x0B, 0x42, 0xFA, 0xC3, 0x4E,
+	0x08, 0x2E, 0xA1, 0x66, 0x28, 0xD9, 0x24, 0xB2, 0x76, 0x5B, 0xA2, 0x49, 0x6D, 0x8B, 0xD1, 0x25,
+	0x72, 0xF8, 0xF6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xD4, 0xA4, 0x5C, 0xCC, 0x5D, 0x65, 0xB6, 0x92,
+	0x6C, 0x70, 0x48, 0x50, 0xFD, 0xED, 0xB9, 0xDA, 0x5E, 0x15, 0x46, 0x57, 0xA7, 0x8D, 0x9D, 0x84,
+	0x90, 0xD8, 0xAB, 0x00, 0x8C, 0xBC, 0xD3, 0x0A, 0xF7, 0xE4, 0x58, 0x05, 0xB8, 0xB3, 0x45, 0x06,
+	0xD0, 0x2C, 0x1E, 0x8F, 0xCA, 0x3F, 0x0F, 0x02, 0xC1, 0xAF, 0xBD, 0x03, 0x01, 0x13, 0x8A, 0x6B,
+	0x3A, 0x91, 0x11, 0x41, 0x4F, 0x67, 0xDC, 0xEA, 0x97, 0xF2, 0xCF, 0xCE, 0xF0, 0xB4, 0xE6, 0x73,
+	0x96, 0xAC, 0x74, 0x22, 0xE7, 0xAD, 0x35, 0x85, 0xE2, 0xF9, 0x37, 0xE8, 0x1C, 0x75, 0xDF, 0x6E,
+	0x47, 0xF1, 0x1A, 0x71, 0x1D, 0x29, 0xC5, 0x89, 0x6F, 0xB7, 0x62, 0x0E, 0xAA, 0x18, 0xBE, 0x1B,
+	0xFC, 0x56, 0x3E, 0x4B, 0xC6, 0xD2, 0x79, 0x20, 0x9A, 0xDB, 0xC0, 0xFE, 0x78, 0xCD, 0x5A, 0xF4,
+	0x1F, 0xDD, 0xA8, 0x33, 0x88, 0x07, 0xC7, 0x31, 0xB1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xEC, 0x5F,
+	0x60, 0x51, 0x7F, 0xA9, 0x19, 0xB5, 0x4A, 0x0D, 0x2D, 0xE5, 0x7A, 0x9F, 0x93, 0xC9, 0x9C, 0xEF,
+	0xA0, 0xE0, 0x3B, 0x4D, 0xAE, 0x2A, 0xF5, 0xB0, 0xC8, 0xEB, 0xBB, 0x3C, 0x83, 0x53, 0x99, 0x61,
+	0x17, 0x2B, 0x04, 0x7E, 0xBA, 0x77, 0xD6, 0x26, 0xE1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0C, 0x7D
+};
+
+static uint8_t aes_rcon[] = 
+{ 
+	0x8D, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36, 0x6C, 0xD8, 0xAB, 0x4D, 0x9A,
+	0x2F, 0x5E, 0xBC, 0x63, 0xC6, 0x97, 0x35, 0x6A, 0xD4, 0xB3, 0x7D, 0xFA, 0xEF, 0xC5, 0x91, 0x39,
+	0x72, 0xE4, 0xD3, 0xBD, 0x61, 0xC2, 0x9F, 0x25, 0x4A, 0x94, 0x33, 0x66, 0xCC, 0x83, 0x1D, 0x3A,
+	0x74, 0xE8, 0xCB, 0x8D, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36, 0x6C, 0xD8,
+	0xAB, 0x4D, 0x9A, 0x2F, 0x5E, 0xBC, 0x63, 0xC6, 0x97, 0x35, 0x6A, 0xD4, 0xB3, 0x7D, 0xFA, 0xEF,
+	0xC5, 0x91, 0x39, 0x72, 0xE4, 0xD3, 0xBD, 0x61, 0xC2, 0x9F, 0x25, 0x4A, 0x94, 0x33, 0x66, 0xCC,
+	0x83, 0x1D, 0x3A, 0x74, 0xE8, 0xCB, 0x8D, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B,
+	0x36, 0x6C, 0xD8, 0xAB, 0x4D, 0x9A, 0x2F, 0x5E, 0xBC, 0x63, 0xC6, 0x97, 0x35, 0x6A, 0xD4, 0xB3,
+	0x7D, 0xFA, 0xEF, 0xC5, 0x91, 0x39, 0x72, 0xE4, 0xD3, 0xBD, 0x61, 0xC2, 0x9F, 0x25, 0x4A, 0x94,
+	0x33, 0x66, 0xCC, 0x83, 0x1D, 0x3A, 0x74, 0xE8, 0xCB, 0x8D, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+	0x40, 0x80, 0x1B, 0x36, 0x6C, 0xD8, 0xAB, 0x4D, 0x9A, 0x2F, 0x5E, 0xBC, 0x63, 0xC6, 0x97, 0x35,
+	0x6A, 0xD4, 0xB3, 0x7D, 0xFA, 0xEF, 0xC5, 0x91, 0x39, 0x72, 0xE4, 0xD3, 0xBD, 0x61, 0xC2, 0x9F,
+	0x25, 0x4A, 0x94, 0x33, 0x66, 0xCC, 0x83, 0x1D, 0x3A, 0x74, 0xE8, 0xCB, 0x8D, 0x01, 0x02, 0x04,
+	0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36, 0x6C, 0xD8, 0xAB, 0x4D, 0x9A, 0x2F, 0x5E, 0xBC, 0x63,
+	0xC6, 0x97, 0x35, 0x6A, 0xD4, 0xB3, 0x7D, 0xFA, 0xEF, 0xC5, 0x91, 0x39, 0x72, 0xE4, 0xD3, 0xBD,
+	0x61, 0xC2, 0x9F, 0x25, 0x4A, 0x94, 0x33, 0x66, 0xCC, 0x83, 0x1D, 0x3A, 0x74, 0xE8, 0xCB
+};
+
+static uint8_t aes_mix_vector[4] = { 2, 3, 1, 1 };
+static uint8_t aes_mix_inv_vector[4] = { 14, 11, 13, 9 };
+
+static inline void aes_rotate_left(uint8_t word[4])
+{
+	uint8_t temp = word[0];
+	for (int i = 0; i < 3; i++)
+		word[i] = word[i + 1];
+	word[3] = temp;
+}
+
+static inline void aes_rotate_right(uint8_t word[4])
+{
+	uint8_t temp = word[3];
+	for (int i = 3; i > 0; i--)
+		word[i] = word[i - 1];
+	word[0] = temp;
+}
+
+static void aes_expand_key(uint8_t key[KEY_SIZE], uint8_t expanded_key[EXP_KEY_SIZE])
+{
+	for (int i = 0; i < KEY_SIZE; i++)
+		expanded_key[i] = key[i];
+
+	int pos = KEY_SIZE,
+		rcon_i = 1;
+	while (pos < EXP_KEY_SIZE)
+	{
+		uint8_t temp[4];
+		for (int i = 0; i < 4; i++)
+			temp[i] = expanded_key[pos - 4 + i];
+
+		if (pos % KEY_SIZE == 0)
+		{
+			aes_rotate_left(temp);
+			for (int i = 0; i < 4; i++)
+				temp[i] = aes_sbox[temp[i]];
+			temp[0] ^= aes_rcon[rcon_i++];
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			expanded_key[pos] = expanded_key[pos - KEY_SIZE] ^ temp[i];
+			pos++;
+		}
+	}
+}
+
+static uint8_t aes_galois_multiply(uint8_t a, uint8_t b)
+{
+	uint8_t p = 0;
+	while (a != 0 && b != 0)
+	{
+		if (b & 0b00000001)
+			p ^= a;
+		b >>= 1;
+		bool carry = a & 0b10000000;
+		a <<= 1;
+		if (carry)
+			a ^= 0b00011011;
+	}
+	return p;
+}
+
+static inline void aes_substitute_bytes(uint8_t state[STATE_SIZE], uint8_t sbox[sizeof aes_sbox])
+{
+	for (int i = 0; i < STATE_SIZE; i++)
+		state[i] = sbox[state[i]];
+}
+
+static inline void aes_shift_rows_left(uint8_t state[STATE_SIZE])
+{
+	for (int i = 1; i < 4; i++) /* i = 1 because the first row is never shifted */
+	{
+		for (int j = 0; j < i; j++)
+			aes_rotate_left(state + i * 4);
+	}
+}
+
+static inline void aes_shift_rows_right(uint8_t state[STATE_SIZE])
+{
+	for (int i = 1; i < 4; i++) /* i = 1 because the first row is never shifted */
+	{
+		for (int j = 0; j < i; j++)
+			aes_rotate_right(state + i * 4);
+	}
+}
+
+static inline void aes_add_round_key(uint8_t state[STATE_SIZE], uint8_t round_key[STATE_SIZE])
+{
+	for (int i = 0; i < STATE_SIZE; i++)
+		state[i] ^= round_key[i];
+}
+
+/* 
+	the multiplication matrix for mixing columns is either:
+		2 3 1 1
+		1 2 3 1
+		1 1 2 3
+		3 1 1 2
+	or the inverse:
+		14 11 13 09
+		09 14 11 13
+		13 09 14 11
+		11 13 09 14
+	Since each row is the the one before it shifted right, 
+	we can just pass a vector in instead of the whole matrix
+*/
+static inline void aes_mix_columns(uint8_t state[STATE_SIZE], uint8_t vector[4])
+{
+	for (int i = 0; i < 4; i++)
+	{
+		uint8_t col_cpy[4];
+		for (int j = 0; j < 4; j++)
+			col_cpy[j] = state[j * 4 + i];
+		
+		for (int j = 0; j < 4; j++)
+		{
+			state[j * 4 + i] =
+				aes_galois_multiply(col_cpy[j], vector[0])
+				^ aes_galois_multiply(col_cpy[(j + 3) % 4], vector[3])
+				^ aes_galois_multiply(col_cpy[(j + 2) % 4], vector[2])
+				^ aes_galois_multiply(col_cpy[(j + 1) % 4], vector[1]);
+		}
+	}
+}
+
+static inline void aes_create_round_key(uint8_t exp_key_section[KEY_SIZE], uint8_t out_key[KEY_SIZE])
+{
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+			out_key[i + j * 4] = exp_key_section[i * 4 + j];
+	}
+}
+
+static void aes_encrypt_chunk(uint8_t input[STATE_SIZE], uint8_t output[STATE_SIZE], uint8_t key[KEY_SIZE])
+{
+	uint8_t exp_key[EXP_KEY_SIZE];
+	aes_expand_key(key, exp_key);
+
+	uint8_t state[STATE_SIZE];
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+			state[i + j * 4] = input[i * 4 + j];
+	}
+
+	uint8_t round_key[STATE_SIZE];
+	aes_create_round_key(exp_key, round_key);
+	aes_add_round_key(state, round_key);
+
+	for (int i = 1; i < 10; i++)
+	{
+		aes_create_round_key(exp_key + KEY_SIZE * i, round_key);
+
+		aes_substitute_bytes(state, aes_sbox);
+		aes_shift_rows_left(state);
+		aes_mix_columns(state, aes_mix_vector);
+		aes_add_round_key(state, round_key);
+	}
+
+	aes_create_round_key(exp_key + KEY_SIZE * ROUND_COUNT, round_key);
+
+	aes_substitute_bytes(state, aes_sbox);
+	aes_shift_rows_left(state);
+	aes_add_round_key(state, round_key);
+
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+			output[i * 4 + j] = state[i + j * 4];
+	}
+}
+
+static void aes_decrypt_chunk(uint8_t input[STATE_SIZE], uint8_t output[STATE_SIZE], uint8_t key[KEY_SIZE])
+{
+	uint8_t exp_key[EXP_KEY_SIZE];
+	aes_expand_key(key, exp_key);
+
+	uint8_t state[STATE_SIZE];
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+			state[i + j * 4] = input[i * 4 + j];
+	}
+
+	uint8_t round_key[STATE_SIZE];
+	aes_create_round_key(exp_key + ROUND_COUNT * KEY_SIZE, round_key);
+	aes_add_round_key(state, round_key);
+
+	for (int i = ROUND_COUNT - 1; i > 0; i--)
+	{
+		aes_create_round_key(exp_key + KEY_SIZE * i, round_key);
+
+		aes_shift_rows_right(state);
+		aes_substitute_bytes(state, aes_sbox_invert);
+		aes_add_round_key(state, round_key);
+		aes_mix_columns(state, aes_mix_inv_vector);
+	}
+
+	aes_create_round_key(exp_key, round_key);
+
+	aes_shift_rows_right(state);
+	aes_substitute_bytes(state, aes_sbox_invert);
+	aes_add_round_key(state, round_key);
+
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+			output[i * 4 + j] = state[i + j * 4];
+	}
+}
+
+/*
+	TABLE BACKEND
+
+	Each round of SubBytes, ShiftRows, and MixColumns collapses into four lookups per column.
+	Te0[x] is the column (2, 1, 1, 3) * S[x] and Td0[x] is the column (14, 9, 13, 11) * Si[x],
+	the other tables are the same columns rotated a byte at a time.
+	Decryption uses the equivalent inverse cipher, which moves InvMixColumns onto the round keys.
+	Lookups are indexed by secret data, so this backend is not constant-time.
+*/
+
+static uint32_t aes_te[4][256], aes_td[4][256];
+
+/* keys are expanded on worker threads too, so the tables are built exactly once by whichever gets there first */
+#ifdef _WIN32
+static INIT_ONCE aes_tables_once = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t aes_tables_once = PTHREAD_ONCE_INIT;
+#endif
+
+#define AES_ROTATE_WORD(w, n)	(((w) >> (n)) | ((w) << (32 - (n))))
+#define AES_BYTE(w, n)			(((w) >> (24 - 8 * (n))) & 0xFF)
+
+static void aes_fill_tables(void)
+{
+	for (int i = 0; i < 256; i++)
+	{
+		uint8_t s = aes_sbox[i], si = aes_sbox_invert[i];
+		uint32_t te = (uint32_t)aes_galois_multiply(s, 2) << 24 | (uint32_t)s << 16 | (uint32_t)s << 8 | aes_galois_multiply(s, 3);
+		uint32_t td = (uint32_t)aes_galois_multiply(si, 14) << 24 | (uint32_t)aes_galois_multiply(si, 9) << 16
+			| (uint32_t)aes_galois_multiply(si, 13) << 8 | aes_galois_multiply(si, 11);
+		for (int j = 0; j < 4; j++)
+		{
+			aes_te[j][i] = j ? AES_ROTATE_WORD(te, 8 * j) : te;
+			aes_td[j][i] = j ? AES_ROTATE_WORD(td, 8 * j) : td;
+		}
+	}
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK aes_fill_tables_once(INIT_ONCE* once, void* parameter, void** context)
+{
+	(void)once, (void)parameter, (void)context;
+	aes_fill_tables();
+	return TRUE;
+}
+#endif
+
+static void aes_create_tables(void)
+{
+#ifdef _WIN32
+	InitOnceExecuteOnce(&aes_tables_once, aes_fill_tables_once, NULL, NULL);
+#else
+	pthread_once(&aes_tables_once, aes_fill_tables);
+#endif
+}
+
+static inline uint32_t aes_load_word(const uint8_t* in)
+{
+	return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 | in[3];
+}
+
+static inline void aes_store_word(uint8_t* out, uint32_t w)
+{
+	out[0] = (uint8_t)(w >> 24);
+	out[1] = (uint8_t)(w >> 16);
+	out[2] = (uint8_t)(w >> 8);
+	out[3] = (uint8_t)w;
+}
+
+static void aes_table_expand_key(aes_context_t* ctx)
+{
+	aes_create_tables();
+	uint32_t* ek = ctx->encrypt_words, *dk = ctx->decrypt_words;
+	for (int i = 0; i < 4 * (AES_ROUND_COUNT + 1); i++)
+		ek[i] = aes_load_word(ctx->expanded_key + i * 4);
+
+	/* first and last round keys swap, the ones in between get InvMixColumns */
+	for (int i = 0; i <= AES_ROUND_COUNT; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			uint32_t w = ek[(AES_ROUND_COUNT - i) * 4 + j];
+			if (i != 0 && i != AES_ROUND_COUNT) /* Td contains Si, so substitute first to cancel it out */
+				w = aes_td[0][aes_sbox[AES_BYTE(w, 0)]] ^ aes_td[1][aes_sbox[AES_BYTE(w, 1)]] ^ aes_td[2][aes_sbox[AES_BYTE(w, 2)]] ^ aes_td[3][aes_sbox[AES_BYTE(w, 3)]];
+			dk[i * 4 + j] = w;
+		}
+	}
+}
+
+static void aes_table_encrypt(const aes_context_t* ctx, const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE])
+{
+	const uint32_t* rk = ctx->encrypt_words;
+	uint32_t s[4], t[4];
+	for (int i = 0; i < 4; i++)
+		s[i] = aes_load_word(in + i * 4) ^ rk[i];
+
+	for (int round = 1; round < AES_ROUND_COUNT; round++)
+	{
+		rk += 4;
+		for (int i = 0; i < 4; i++)
+		{
+			t[i] = aes_te[0][AES_BYTE(s[i], 0)] ^ aes_te[1][AES_BYTE(s[(i + 1) % 4], 1)]
+				^ aes_te[2][AES_BYTE(s[(i + 2) % 4], 2)] ^ aes_te[3][AES_BYTE(s[(i + 3) % 4], 3)] ^ rk[i];
+		}
+		memcpy(s, t, sizeof s);
+	}
+
+	rk += 4;
+	for (int i = 0; i < 4; i++)
+	{
+		uint32_t w = (uint32_t)aes_sbox[AES_BYTE(s[i], 0)] << 24 | (uint32_t)aes_sbox[AES_BYTE(s[(i + 1) % 4], 1)] << 16
+			| (uint32_t)aes_sbox[AES_BYTE(s[(i + 2) % 4], 2)] << 8 | aes_sbox[AES_BYTE(s[(i + 3) % 4], 3)];
+		aes_store_word(out + i * 4, w ^ rk[i]);
+	}
+}
+
+static void aes_table_decrypt(const aes_context_t* ctx, const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE])
+{
+	const uint32_t* rk = ctx->decrypt_words;
+	uint32_t s[4], t[4];
+	for (int i = 0; i < 4; i++)
+		s[i] = aes_load_word(in + i * 4) ^ rk[i];
+
+	for (int round = 1; round < AES_ROUND_COUNT; round++)
+	{
+		rk += 4;
+		for (int i = 0; i < 4; i++)
+		{
+			t[i] = aes_td[0][AES_BYTE(s[i], 0)] ^ aes_td[1][AES_BYTE(s[(i + 3) % 4], 1)]
+				^ aes_td[2][AES_BYTE(s[(i + 2) % 4], 2)] ^ aes_td[3][AES_BYTE(s[(i + 1) % 4], 3)] ^ rk[i];
+		}
+		memcpy(s, t, sizeof s);
+	}
+
+	rk += 4;
+	for (int i = 0; i < 4; i++)
+	{
+		uint32_t w = (uint32_t)aes_sbox_invert[AES_BYTE(s[i], 0)] << 24 | (uint32_t)aes_sbox_invert[AES_BYTE(s[(i + 3) % 4], 1)] << 16
+			| (uint32_t)aes_sbox_invert[AES_BYTE(s[(i + 2) % 4], 2)] << 8 | aes_sbox_invert[AES_BYTE(s[(i + 1) % 4], 3)];
+		aes_store_word(out + i * 4, w ^ rk[i]);
+	}
+}
+
+/*
+	AES-NI BACKEND
+
+	Uses the same expanded key as the reference backend. Blocks are interleaved four at a time
+	since AESENC has a latency of several cycles but can issue every cycle.
+*/
+
+#ifdef AES_NI_SUPPORTED
+static bool aes_ni_is_supported(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] >> 25) & 1;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (ecx >> 25) & 1;
+#endif
+}
+
+AES_NI_TARGET static void aes_ni_expand_key(aes_context_t* ctx)
+{
+	memcpy(ctx->decrypt_key, ctx->expanded_key + AES_ROUND_COUNT * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+	for (int i = 1; i < AES_ROUND_COUNT; i++)
+	{
+		__m128i rk = _mm_loadu_si128((const __m128i*)(ctx->expanded_key + (AES_ROUND_COUNT - i) * AES_BLOCK_SIZE));
+		_mm_storeu_si128((__m128i*)(ctx->decrypt_key + i * AES_BLOCK_SIZE), _mm_aesimc_si128(rk));
+	}
+	memcpy(ctx->decrypt_key + AES_ROUND_COUNT * AES_BLOCK_SIZE, ctx->expanded_key, AES_BLOCK_SIZE);
+}
+
+AES_NI_TARGET static void aes_ni_crypt_blocks(const uint8_t* keys, bool encrypt, const uint8_t* in, uint8_t* out, int count)
+{
+	__m128i rk[AES_ROUND_COUNT + 1];
+	for (int i = 0; i <= AES_ROUND_COUNT; i++)
+		rk[i] = _mm_loadu_si128((const __m128i*)(keys + i * AES_BLOCK_SIZE));
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i b[4];
+		for (int j = 0; j < 4; j++)
+			b[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + (i + j) * AES_BLOCK_SIZE)), rk[0]);
+		for (int round = 1; round < AES_ROUND_COUNT; round++)
+		{
+			for (int j = 0; j < 4; j++)
+				b[j] = encrypt ? _mm_aesenc_si128(b[j], rk[round]) : _mm_aesdec_si128(b[j], rk[round]);
+		}
+		for (int j = 0; j < 4; j++)
+		{
+			b[j] = encrypt ? _mm_aesenclast_si128(b[j], rk[AES_ROUND_COUNT]) : _mm_aesdeclast_si128(b[j], rk[AES_ROUND_COUNT]);
+			_mm_storeu_si128((__m128i*)(out + (i + j) * AES_BLOCK_SIZE), b[j]);
+		}
+	}
+	for (; i < count; i++)
+	{
+		__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i * AES_BLOCK_SIZE)), rk[0]);
+		for (int round = 1; round < AES_ROUND_COUNT; round++)
+			b = encrypt ? _mm_aesenc_si128(b, rk[round]) : _mm_aesdec_si128(b, rk[round]);
+		b = encrypt ? _mm_aesenclast_si128(b, rk[AES_ROUND_COUNT]) : _mm_aesdeclast_si128(b, rk[AES_ROUND_COUNT]);
+		_mm_storeu_si128((__m128i*)(out + i * AES_BLOCK_SIZE), b);
+	}
+}
+#endif
+
+static aes_backend_t aes_backend = (aes_backend_t)-1;
+
+/* fastest backend supported by this CPU */
+aes_backend_t aes_best_backend(void)
+{
+#ifdef AES_NI_SUPPORTED
+	if (aes_ni_is_supported())
+		return AES_BACKEND_NI;
+#endif
+	return AES_BACKEND_TABLE;
+}
+
+/* sets backend used by contexts initialized afterwards. Falls back to the table backend if unsupported */
+void aes_set_backend(aes_backend_t backend)
+{
+	if (backend == AES_BACKEND_NI && aes_best_backend() != AES_BACKEND_NI)
+	{
+		debug_format("AES-NI is not supported, using T-tables.\n");
+		backend = AES_BACKEND_TABLE;
+	}
+	aes_backend = backend;
+}
+
+/* expands key into context */
+void aes_init(aes_context_t* ctx, const uint8_t key[AES_KEY_SIZE])
+{
+	assert(ctx && key);
+	if (aes_backend == (aes_backend_t)-1)
+		aes_backend = aes_best_backend();
+
+	memset(ctx, 0, sizeof * ctx);
+	ctx->backend = aes_backend;
+	memcpy(ctx->key, key, AES_KEY_SIZE);
+	aes_expand_key(ctx->key, ctx->expanded_key);
+	switch (ctx->backend)
+	{
+	case AES_BACKEND_REFERENCE:
+		break;
+	case AES_BACKEND_TABLE:
+		aes_table_expand_key(ctx);
+		break;
+#ifdef AES_NI_SUPPORTED
+	case AES_BACKEND_NI:
+		aes_ni_expand_key(ctx);
+		break;
+#endif
+	}
+}
+
+/* encrypts count blocks of AES_BLOCK_SIZE bytes. in and out may be the same */
+void aes_encrypt_blocks(const aes_context_t* ctx, const uint8_t* in, uint8_t* out, int count)
+{
+	assert(ctx && in && out && count >= 0);
+	switch (ctx->backend)
+	{
+	case AES_BACKEND_REFERENCE:
+		for (int i = 0; i < count; i++)
+		{
+			uint8_t chunk[STATE_SIZE], key[KEY_SIZE];
+			memcpy(chunk, in + i * STATE_SIZE, STATE_SIZE);
+			memcpy(key, ctx->key, KEY_SIZE);
+			aes_encrypt_chunk(chunk, out + i * STATE_SIZE, key);
+		}
+		break;
+	case AES_BACKEND_TABLE:
+		for (int i = 0; i < count; i++)
+			aes_table_encrypt(ctx, in + i * STATE_SIZE, out + i * STATE_SIZE);
+		break;
+#ifdef AES_NI_SUPPORTED
+	case AES_BACKEND_NI:
+		aes_ni_crypt_blocks(ctx->expanded_key, true, in, out, count);
+		break;
+#endif
+	}
+}
+
+/* decrypts count blocks of AES_BLOCK_SIZE bytes. in and out may be the same */
+void aes_decrypt_blocks(const aes_context_t* ctx, const uint8_t* in, uint8_t* out, int count)
+{
+	assert(ctx && in && out && count >= 0);
+	switch (ctx->backend)
+	{
+	case AES_BACKEND_REFERENCE:
+		for (int i = 0; i < count; i++)
+		{
+			uint8_t chunk[STATE_SIZE], key[KEY_SIZE];
+			memcpy(chunk, in + i * STATE_SIZE, STATE_SIZE);
+			memcpy(key, ctx->key, KEY_SIZE);
+			aes_decrypt_chunk(chunk, out + i * STATE_SIZE, key);
+		}
+		break;
+	case AES_BACKEND_TABLE:
+		for (int i = 0; i < count; i++)
+			aes_table_decrypt(ctx, in + i * STATE_SIZE, out + i * STATE_SIZE);
+		break;
+#ifdef AES_NI_SUPPORTED
+	case AES_BACKEND_NI:
+		aes_ni_crypt_blocks(ctx->decrypt_key, false, in, out, count);
+		break;
+#endif
+	}
+}
+
+/*
+	GALOIS/COUNTER MODE
+
+	https://csrc.nist.gov/publications/detail/sp/800-38d/final
+	CTR keystream comes from encrypting batches of counter blocks so the backends can pipeline them.
+	GHASH multiplies by H four bits at a time using a table of the 16 multiples of H (Shoup's method).
+*/
+
+#define AES_GCM_BATCH	64 /* counter blocks encrypted at a time */
+
+static const uint64_t aes_gcm_last4[16] =
+{
+	0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+	0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0
+};
+
+static inline uint64_t aes_load_u64(const uint8_t* in)
+{
+	return (uint64_t)aes_load_word(in) << 32 | aes_load_word(in + 4);
+}
+
+static inline void aes_store_u64(uint8_t* out, uint64_t v)
+{
+	aes_store_word(out, (uint32_t)(v >> 32));
+	aes_store_word(out + 4, (uint32_t)v);
+}
+
+/* x = x * H */
+static void aes_gcm_multiply(const aes_gcm_t* gcm, uint8_t x[AES_BLOCK_SIZE])
+{
+	int lo = x[15] & 0xF;
+	uint64_t zh = gcm->hh[lo], zl = gcm->hl[lo];
+	for (int i = 15; i >= 0; i--)
+	{
+		lo = x[i] & 0xF;
+		int hi = (x[i] >> 4) & 0xF;
+		if (i != 15)
+		{
+			int rem = (int)(zl & 0xF);
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (aes_gcm_last4[rem] << 48);
+			zh ^= gcm->hh[lo];
+			zl ^= gcm->hl[lo];
+		}
+		int rem = (int)(zl & 0xF);
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (aes_gcm_last4[rem] << 48);
+		zh ^= gcm->hh[hi];
+		zl ^= gcm->hl[hi];
+	}
+	aes_store_u64(x, zh);
+	aes_store_u64(x + 8, zl);
+}
+
+/* absorbs data into the hash, zero padding the last block */
+static void aes_gcm_hash(const aes_gcm_t* gcm, uint8_t hash[AES_BLOCK_SIZE], const uint8_t* data, int size)
+{
+	for (int i = 0; i < size; i += AES_BLOCK_SIZE)
+	{
+		int count = min(AES_BLOCK_SIZE, size - i);
+		for (int j = 0; j < count; j++)
+			hash[j] ^= data[i + j];
+		aes_gcm_multiply(gcm, hash);
+	}
+}
+
+/* in and out may be the same. The first counter block is nonce || 2, nonce || 1 is saved for the tag */
+static void aes_gcm_ctr(const aes_gcm_t* gcm, const uint8_t nonce[AES_GCM_NONCE_SIZE], const uint8_t* in, uint8_t* out, int size)
+{
+	uint8_t stream[AES_GCM_BATCH * AES_BLOCK_SIZE];
+	uint32_t counter = 2;
+	for (int i = 0; i < size; i += sizeof stream)
+	{
+		int count = min((int)sizeof stream, size - i);
+		int blocks = (count + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+		for (int j = 0; j < blocks; j++)
+		{
+			memcpy(stream + j * AES_BLOCK_SIZE, nonce, AES_GCM_NONCE_SIZE);
+			aes_store_word(stream + j * AES_BLOCK_SIZE + AES_GCM_NONCE_SIZE, counter++);
+		}
+		aes_encrypt_blocks(&gcm->cipher, stream, stream, blocks);
+		for (int j = 0; j < count; j++)
+			out[i + j] = in[i + j] ^ stream[j];
+	}
+}
+
+static void aes_gcm_tag(const aes_gcm_t* gcm, const uint8_t nonce[AES_GCM_NONCE_SIZE], const uint8_t* aad, int aad_size, const uint8_t* cipher, int size, uint8_t tag[AES_GCM_TAG_SIZE])
+{
+	uint8_t hash[AES_BLOCK_SIZE] = { 0 }, lengths[AES_BLOCK_SIZE], first[AES_BLOCK_SIZE];
+	aes_gcm_hash(gcm, hash, aad, aad_size);
+	aes_gcm_hash(gcm, hash, cipher, size);
+	aes_store_u64(lengths, (uint64_t)aad_size * 8);
+	aes_store_u64(lengths + 8, (uint64_t)size * 8);
+	aes_gcm_hash(gcm, hash, lengths, AES_BLOCK_SIZE);
+
+	memcpy(first, nonce, AES_GCM_NONCE_SIZE);
+	aes_store_word(first + AES_GCM_NONCE_SIZE, 1);
+	aes_encrypt_blocks(&gcm->cipher, first, first, 1);
+	for (int i = 0; i < AES_GCM_TAG_SIZE; i++)
+		tag[i] = hash[i] ^ first[i];
+}
+
+/* expands key and creates the hash table */
+void aes_gcm_init(aes_gcm_t* gcm, const uint8_t key[AES_KEY_SIZE])
+{
+	assert(gcm && key);
+	aes_init(&gcm->cipher, key);
+
+	uint8_t h[AES_BLOCK_SIZE] = { 0 };
+	aes_encrypt_blocks(&gcm->cipher, h, h, 1);
+	uint64_t vh = aes_load_u64(h), vl = aes_load_u64(h + 8);
+
+	/* multiples of H by 8, 4, 2, and 1 in GCM's reflected bit order, the rest are sums of those */
+	gcm->hh[0] = gcm->hl[0] = 0;
+	gcm->hh[8] = vh;
+	gcm->hl[8] = vl;
+	for (int i = 4; i > 0; i >>= 1)
+	{
+		uint64_t carry = (vl & 1) * 0xE1000000;
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ (carry << 32);
+		gcm->hh[i] = vh;
+		gcm->hl[i] = vl;
+	}
+	for (int i = 2; i <= 8; i *= 2)
+	{
+		for (int j = 1; j < i; j++)
+		{
+			gcm->hh[i + j] = gcm->hh[i] ^ gcm->hh[j];
+			gcm->hl[i + j] = gcm->hl[i] ^ gcm->hl[j];
+		}
+	}
+}
+
+/* encrypts size bytes and writes the authentication tag of the ciphertext and aad. in and out may be the same */
+void aes_gcm_encrypt(const aes_gcm_t* gcm, const uint8_t nonce[AES_GCM_NONCE_SIZE], const uint8_t* aad, int aad_size,
+	const uint8_t* in, uint8_t* out, int size, uint8_t tag[AES_GCM_TAG_SIZE])
+{
+	assert(gcm && nonce && (aad || aad_size == 0) && ((in && out) || size == 0) && tag);
+	aes_gcm_ctr(gcm, nonce, in, out, size);
+	aes_gcm_tag(gcm, nonce, aad, aad_size, out, size, tag);
+}
+
+/* returns false and zeroes out if the tag does not match. in and out may be the same */
+bool aes_gcm_decrypt(const aes_gcm_t* gcm, const uint8_t nonce[AES_GCM_NONCE_SIZE], const uint8_t* aad, int aad_size,
+	const uint8_t* in, uint8_t* out, int size, const uint8_t tag[AES_GCM_TAG_SIZE])
+{
+	assert(gcm && nonce && (aad || aad_size == 0) && ((in && out) || size == 0) && tag);
+	uint8_t expected[AES_GCM_TAG_SIZE], difference = 0;
+	aes_gcm_tag(gcm, nonce, aad, aad_size, in, size, expected);
+	for (int i = 0; i < AES_GCM_TAG_SIZE; i++)
+		difference |= expected[i] ^ tag[i];
+	if (difference)
+	{
+		memset(out, 0, size);
+		return false;
+	}
+	aes_gcm_ctr(gcm, nonce, in, out, size);
+	return true;
+}
+
+#ifdef TEST
+#ifdef AES_TEST
+#include <stdio.h>
+#include <time.h>
+
+#define BLOCK_COUNT 0x40000
+
+int main()
+{
+	/* FIPS-197 appendix C.1 */
+	const uint8_t key[AES_KEY_SIZE] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+	const uint8_t plain[AES_BLOCK_SIZE] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+	const uint8_t cipher[AES_BLOCK_SIZE] = { 0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A };
+	static const char* names[] = { "Reference", "T-table", "AES-NI" };
+
+	uint8_t* buf = journal_malloc(BLOCK_COUNT * AES_BLOCK_SIZE);
+	srand((unsigned int)time(NULL));
+	for (int i = 0; i < BLOCK_COUNT * AES_BLOCK_SIZE; i++)
+		buf[i] = rand();
+
+	int failures = 0;
+	for (aes_backend_t backend = AES_BACKEND_REFERENCE; backend <= aes_best_backend(); backend++)
+	{
+		aes_context_t ctx;
+		aes_set_backend(backend);
+		aes_init(&ctx, key);
+
+		uint8_t block[AES_BLOCK_SIZE];
+		aes_encrypt_blocks(&ctx, plain, block, 1);
+		bool encrypted = memcmp(block, cipher, AES_BLOCK_SIZE) == 0;
+		aes_decrypt_blocks(&ctx, block, block, 1);
+		bool decrypted = memcmp(block, plain, AES_BLOCK_SIZE) == 0;
+		failures += !encrypted + !decrypted;
+
+		/* the reference backend is much slower, so it gets fewer blocks */
+		int count = backend == AES_BACKEND_REFERENCE ? BLOCK_COUNT / 16 : BLOCK_COUNT;
+		clock_t start = clock();
+		aes_encrypt_blocks(&ctx, buf, buf, count);
+		double encrypt_time = (clock() - start) / (double)CLOCKS_PER_SEC;
+		start = clock();
+		aes_decrypt_blocks(&ctx, buf, buf, count);
+		double decrypt_time = (clock() - start) / (double)CLOCKS_PER_SEC;
+
+		printf("%-10s known answer: %s, encrypt: %.1f MB/s, decrypt: %.1f MB/s\n", names[backend], encrypted && decrypted ? "pass" : "FAIL",
+			count * AES_BLOCK_SIZE / 1e6 / encrypt_time, count * AES_BLOCK_SIZE / 1e6 / decrypt_time);
+	}
+	/* GCM specification test case 4 */
+	const uint8_t gcm_key[AES_KEY_SIZE] = { 0xFE, 0xFF, 0xE9, 0x92, 0x86, 0x65, 0x73, 0x1C, 0x6D, 0x6A, 0x8F, 0x94, 0x67, 0x30, 0x83, 0x08 };
+	const uint8_t nonce[AES_GCM_NONCE_SIZE] = { 0xCA, 0xFE, 0xBA, 0xBE, 0xFA, 0xCE, 0xDB, 0xAD, 0xDE, 0xCA, 0xF8, 0x88 };
+	const uint8_t aad[20] = { 0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE, 0xEF, 0xAB, 0xAD, 0xDA, 0xD2 };
+	const uint8_t gcm_plain[60] =
+	{
+		0xD9, 0x31, 0x32, 0x25, 0xF8, 0x84, 0x06, 0xE5, 0xA5, 0x59, 0x09, 0xC5, 0xAF, 0xF5, 0x26, 0x9A,
+		0x86, 0xA7, 0xA9, 0x53, 0x15, 0x34, 0xF7, 0xDA, 0x2E, 0x4C, 0x30, 0x3D, 0x8A, 0x31, 0x8A, 0x72,
+		0x1C, 0x3C, 0x0C, 0x95, 0x95, 0x68, 0x09, 0x53, 0x2F, 0xCF, 0x0E, 0x24, 0x49, 0xA6, 0xB5, 0x25,
+		0xB1, 0x6A, 0xED, 0xF5, 0xAA, 0x0D, 0xE6, 0x57, 0xBA, 0x63, 0x7B, 0x39
+	};
+	const uint8_t gcm_cipher[60] =
+	{
+		0x42, 0x83, 0x1E, 0xC2, 0x21, 0x77, 0x74, 0x24, 0x4B, 0x72, 0x21, 0xB7, 0x84, 0xD0, 0xD4, 0x9C,
+		0xE3, 0xAA, 0x21, 0x2F, 0x2C, 0x02, 0xA4, 0xE0, 0x35, 0xC1, 0x7E, 0x23, 0x29, 0xAC, 0xA1, 0x2E,
+		0x21, 0xD5, 0x14, 0xB2, 0x54, 0x66, 0x93, 0x1C, 0x7D, 0x8F, 0x6A, 0x5A, 0xAC, 0x84, 0xAA, 0x05,
+		0x1B, 0xA3, 0x0B, 0x39, 0x6A, 0x0A, 0xAC, 0x97, 0x3D, 0x58, 0xE0, 0x91
+	};
+	const uint8_t gcm_tag[AES_GCM_TAG_SIZE] = { 0x5B, 0xC9, 0x4F, 0xBC, 0x32, 0x21, 0xA5, 0xDB, 0x94, 0xFA, 0xE9, 0x5A, 0xE7, 0x12, 0x1A, 0x47 };
+
+	aes_gcm_t gcm;
+	aes_gcm_init(&gcm, gcm_key);
+	uint8_t sealed[60], opened[60], tag[AES_GCM_TAG_SIZE];
+	aes_gcm_encrypt(&gcm, nonce, aad, sizeof aad, gcm_plain, sealed, sizeof sealed, tag);
+	bool gcm_passed = memcmp(sealed, gcm_cipher, sizeof sealed) == 0 && memcmp(tag, gcm_tag, sizeof tag) == 0
+		&& aes_gcm_decrypt(&gcm, nonce, aad, sizeof aad, sealed, opened, sizeof opened, tag) && memcmp(opened, gcm_plain, sizeof opened) == 0;
+	sealed[7] ^= 1;
+	gcm_passed &= !aes_gcm_decrypt(&gcm, nonce, aad, sizeof aad, sealed, opened, sizeof opened, tag);
+	printf("GCM known answer: %s\n", gcm_passed ? "pass" : "FAIL");
+	failures += !gcm_passed;
+
+	free(buf);
+	return failures;
+}
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+/*
+	aes.h ~ RL
+
+	AES-128 block cipher with table-driven and AES-NI backends
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AES_KEY_SIZE			16
+#define AES_BLOCK_SIZE			16
+#define AES_EXPANDED_KEY_SIZE	176
+#define AES_ROUND_COUNT			10
+#define AES_GCM_NONCE_SIZE		12
+#define AES_GCM_TAG_SIZE		16
+
+typedef enum aes_backend
+{
+	AES_BACKEND_REFERENCE,	/* byte-oriented implementation, re-expands the key every block */
+	AES_BACKEND_TABLE,		/* 32-bit T-tables */
+	AES_BACKEND_NI			/* AES-NI instructions, x86-64 only */
+} aes_backend_t;
+
+/* key schedule, expanded once and reused for every block */
+typedef struct aes_context
+{
+	aes_backend_t backend;
+	uint8_t key[AES_KEY_SIZE];
+	uint8_t expanded_key[AES_EXPANDED_KEY_SIZE];
+	uint8_t decrypt_key[AES_EXPANDED_KEY_SIZE];				/* AES-NI equivalent inverse cipher round keys */
+	uint32_t encrypt_words[4 * (AES_ROUND_COUNT + 1)];
+	uint32_t decrypt_words[4 * (AES_ROUND_COUNT + 1)];		/* T-table equivalent inverse cipher round keys */
+} aes_context_t;
+
+/* AES in Galois/Counter Mode, an authenticated stream cipher */
+typedef struct aes_gcm
+{
+	aes_context_t cipher;
+	uint64_t hh[16], hl[16];	/* multiples of the hash key */
+} aes_gcm_t;
+
+/* fastest backend supported by this CPU */
+aes_backend_t aes_best_backend(void);
+/* sets backend used by contexts initialized afterwards. Falls back to the table backend if unsupported */
+void aes_set_backend(aes_backend_t backend);
+
+/* expands key into context */
+void aes_init(aes_context_t* ctx, const uint8_t key[AES_KEY_SIZE]);
+/* encrypts count blocks of AES_BLOCK_SIZE bytes. in and out may be the same */
+void aes_encrypt_blocks(const aes_context_t* ctx, const uint8_t* in, uint8_t* out, int count);
+/* decrypts count blocks of AES_BLOCK_SIZE bytes. in and out may be the same */
+void aes_decrypt_blocks(const aes_context_t* ctx, const uint8_t* in, uint8_t* out, int count);
+
+/* expands key and creates the hash table */
+void aes_gcm_init(aes_gcm_t* gcm, const uint8_t key[AES_KEY_SIZE]);
+/* encrypts size bytes and writes the authentication tag of the ciphertext and aad. in and out may be the same */
+void aes_gcm_encrypt(const aes_gcm_t* gcm, const uint8_t nonce[AES_GCM_NONCE_SIZE], const uint8_t* aad, int aad_size,
+	const uint8_t* in, uint8_t* out, int size, uint8_t tag[AES_GCM_TAG_SIZE]);
+/* returns false and zeroes out if the tag does not match. in and out may be the same */
+bool aes_gcm_decrypt(const aes_gcm_t* gcm, const uint8_t nonce[AES_GCM_NONCE_SIZE], const uint8_t* aad, int aad_size,
+	const uint8_t* in, uint8_t* out, int size, const uint8_t tag[AES_GCM_TAG_SIZE]);
\ No newline at end of file
@@ -0,0 +1,1608 @@
+/*
+	console.c ~ RL
+
+	User interface - editing, the action buffers and drawing. The terminal itself is behind console_platform.h
+*/
+
+#include "console.h"
+#include "console_platform.h"
+#include <assert.h>
+#include <ctype.h>
+#include "file.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "regexp.h"
+#include "thread.h"
+#include "user.h"
+#include "wal.h"
+
+#define CONSOLE_INVERT_ATTRIBUTE(attrib)	(((attrib) >> 4) | (((attrib) << 4) & 0xF0))
+#define CONSOLE_DEFAULT_ATTRIBUTE			(1 << 9)
+#define CONSOLE_DEFAULT_CHAR				(1 << 17)
+#define CONSOLE_MAX_PROMPT_LEN				80
+#define CONSOLE_MAX_PATH					260
+#define CONSOLE_MAX_ACTION_RUN				4096 /* merged keystrokes are capped so prepending a backspace stays cheap */
+#define CONSOLE_RUN_GAP						4 /* unchanged cells between two changes that are rewritten rather than skipped */
+#define CONSOLE_FRAME_INTERVAL				16 /* shortest time between two frames, in milliseconds */
+
+typedef int attribute_t;
+static attribute_t user_attribute = CONSOLE_CREATE_ATTRIBUTE(COLOR_LIGHT_GRAY, COLOR_BLACK);
+static attribute_t footer_attribute = CONSOLE_CREATE_ATTRIBUTE(COLOR_WHITE, COLOR_DARK_GRAY);
+
+static bool created;
+static coords_t size;
+static console_cell_t* buffer;	/* frame being drawn */
+static console_cell_t* shown;	/* frame the terminal shows, only cells that differ from it are written */
+static bool shown_lost;			/* the terminal's contents are unknown, the whole frame is written */
+static coords_t cursor, camera;
+static rope_t lines;
+static const char* footer_message;
+
+static file_details_t current_file;
+static char dir_buf[CONSOLE_MAX_PATH];
+
+/*	undo and redo go between versions of the lines, which the rope keeps as a tree. Actions are only replayed into the
+	edit log, each version's are the ones that made it from its parent */
+static list_t actions; /* every action committed on any branch, in the order they were */
+static list_t action_groups; /* int, index in actions of the first action of each version of the lines */
+static list_t action_history; /* text of every action back to back, released all at once */
+static int action_version = -1; /* version the last action made, -1 once undo or redo leaves it */
+static action_break_t action_breaks = BREAK_DEFAULT;
+static int action_pause = ACTION_PAUSE_DEFAULT;
+static bool action_run_open; /* last action was a keystroke and nothing has broken the run since */
+static uint64_t action_run_time;
+
+static bool selecting;
+static coords_t selection_begin;
+
+/* totals of every line before each one, so the size of a selection doesn't depend on how much is selected.
+	Characters come from the editor's line index */
+struct line_totals
+{
+	long long words;
+};
+
+static list_t line_totals; /* struct line_totals, one past the last line */
+static int line_totals_valid; /* count of entries that are up to date */
+
+/* last pattern searched for. Matches include ones that overlap, only the first of those is used */
+static char search_pattern[CONSOLE_MAX_PROMPT_LEN + 1];
+static int search_size;
+static list_t search_matches; /* coords_t, in order */
+static bool search_valid; /* matches are up to date with the lines */
+static regexp_t search_regexp; /* set if the last search was for a regular expression, which is found as it's needed */
+static char search_message[CONSOLE_MAX_PROMPT_LEN];
+
+static int prompt_len;
+static prompt_callback_t callback;
+static prompt_callback_t prompt_typed; /* called with the response so far whenever it is typed in */
+static rope_t prev_lines;
+static coords_t prev_cursor;
+
+/* re-renders the screen */
+static bool console_invalidate(void);
+/* marks the lines' totals out of date from row on */
+static void console_lines_changed(int row);
+/* deletes the selection as an action */
+static void console_act_delete_selection(void);
+/* callbacks of the find and replace prompts */
+static void console_find_typed(const char* response);
+static void console_find_picked(const char* response);
+static void console_find_pattern_picked(const char* response);
+static void console_replace_picked(const char* response);
+
+/* pauses application to ask user with prompt, calls callback when done and frees string passed after. */
+void console_prompt_user(const char* prompt, prompt_callback_t _callback)
+{
+	assert(console_is_created());
+	prev_lines = lines;
+	line_totals_valid = 0;
+	lines = rope_create();
+	rope_insert(lines, 0, prompt, (int)strnlen(prompt, CONSOLE_MAX_PROMPT_LEN));
+
+	prompt_len = rope_line_length(lines, 0);
+	callback = _callback;
+	prev_cursor = cursor;
+
+	selecting = false;
+	console_move_cursor((coords_t) { .column = prompt_len });
+}
+
+/*	pauses application to ask user with prompt and series of possible choices.
+	prompt is a string delimited by a newline. First line is the question, other lines are choices. */
+void console_prompt_user_mc(const char* prompt, prompt_callback_t _callback)
+{
+	assert(console_is_created());
+	prev_lines = lines;
+	line_totals_valid = 0;
+	lines = rope_create();
+	coords_t temp = (coords_t){ 0 };
+	editor_add_raw(lines, prompt, &temp);
+
+	/* inline choices */
+	for (int i = 1; i < rope_line_count(lines); i++)
+	{
+		temp = (coords_t){ .column = 0, .row = i };
+		editor_add_tab(lines, &temp);
+	}
+
+	console_move_cursor((coords_t) { .row = 1, .column = TAB_SIZE });
+
+	prompt_len = rope_line_length(lines, 0);
+	callback = _callback;
+	prev_cursor = cursor;
+	selecting = false;
+}
+
+bool console_is_created(void)
+{
+	return created;
+}
+
+const file_details_t console_file(void)
+{
+	assert(console_is_created());
+	return current_file;
+}
+
+rope_t console_lines(void)
+{
+	assert(console_is_created());
+	return lines;
+}
+
+coords_t console_cursor(void)
+{
+	assert(console_is_created());
+	return cursor;
+}
+
+list_t console_actions(void)
+{
+	assert(console_is_created());
+	return actions;
+}
+
+/* text of an action. Only valid until the next action is committed */
+const char* console_action_text(const action_t* action)
+{
+	assert(console_is_created() && action && action->text_offset + action->text_length <= list_count(action_history));
+	return (const char*)list_element_array(action_history) + action->text_offset;
+}
+
+/* returns bitmask of console's colors. use CONSOLE_GET_****GROUND macros to extract what you need */
+int console_colors(void)
+{
+	assert(console_is_created());
+	return user_attribute;
+}
+
+static void console_set_title(const char* directory)
+{
+	char title_buf[128];
+	char file_buf[128];
+	file_get_name(directory, file_buf, sizeof file_buf);
+	snprintf(title_buf, sizeof title_buf, "Journal - %s", file_buf);
+	console_platform_set_title(title_buf);
+}
+
+/* starts the edit log of the current file, first replaying edits a crash left in it */
+static void console_start_log(void)
+{
+	if (current_file.type & TYPE_ENCRYPTED)
+	{
+		wal_close(); /* the log would keep the text unencrypted next to the file */
+		return;
+	}
+	int replayed = wal_open(current_file.directory, lines);
+	if (replayed > 0)
+	{
+		debug_format("Replayed %i edits from the log of \"%s\".\n", replayed, current_file.directory);
+		footer_message = "Recovered unsaved edits.";
+	}
+}
+
+/* set console's file details. The directory is copied on the console's end, the lines are taken and destroyed once replaced */
+void console_set_file_details(const file_details_t details)
+{
+	assert(details.directory && details.lines && !prev_lines);
+	if (details.lines != lines)
+		rope_destroy(lines);
+	lines = current_file.lines = details.lines;
+	console_move_cursor((coords_t) { 0, 0 });
+
+	console_set_title(details.directory);
+
+	strncpy(dir_buf, details.directory, sizeof dir_buf);
+	current_file.directory = dir_buf;
+	current_file.type = details.type;
+
+	selecting = false;
+	action_run_open = false;
+	line_totals_valid = 0;
+	search_valid = false;
+	console_start_log();
+	console_clear_buffer(); /* edits the log replayed are part of the file */
+}
+
+/* sets what splits typing into separate undo actions. pause_ms is only used with BREAK_ON_PAUSE */
+void console_set_action_breaks(action_break_t breaks, int pause_ms)
+{
+	assert(pause_ms >= 0);
+	action_breaks = breaks;
+	action_pause = pause_ms;
+	action_run_open = false;
+}
+
+/* set color and foreground of console */
+void console_set_color(color_t foreground, color_t background)
+{
+	assert(console_is_created());
+	user_attribute = CONSOLE_CREATE_ATTRIBUTE(foreground, background);
+	DEBUG_ON_FAILURE(console_invalidate());
+}
+
+static void console_destroy_physical(void)
+{
+	rope_destroy(lines);
+	if (prev_lines)
+		rope_destroy(prev_lines);
+	prev_lines = NULL;
+
+	list_destroy(actions);
+	list_destroy(action_groups);
+	list_destroy(action_history);
+	wal_close();
+
+	free(buffer);
+	free(shown);
+	buffer = shown = NULL;
+}
+
+/* destroys the console */
+void console_destroy(void)
+{
+	if (!console_is_created())
+		return;
+	console_platform_destroy();
+	console_destroy_physical();
+	created = false;
+}
+
+/* sizes both frames to the screen. What the terminal shows is lost with it */
+static void console_resize_frames(coords_t new_size)
+{
+	size_t frame_size = sizeof * buffer * new_size.column * new_size.row;
+	console_cell_t* temp_buffer = journal_malloc(frame_size), *temp_shown = journal_malloc(frame_size);
+	memset(temp_buffer, 0, frame_size);
+	free(buffer);
+	free(shown);
+	buffer = temp_buffer;
+	shown = temp_shown;
+	size = new_size;
+	shown_lost = true;
+}
+
+/* destroys the console if it is created then creates the console */
+bool console_create(void)
+{
+	if (console_is_created())
+		console_destroy();
+	coords_t temp_size;
+	if (!console_platform_create(&temp_size))
+		return false;
+	console_resize_frames(temp_size);
+	created = true;
+
+	lines = rope_create();
+	search_valid = false;
+	actions = list_create(sizeof(action_t));
+	action_groups = list_create(sizeof(int));
+	action_history = list_create(sizeof(char));
+	console_clear_buffer();
+
+	current_file.lines = lines;
+
+	DEBUG_ON_FAILURE(console_invalidate()); /* If it fails to draw, then it's not really an initialization problem like one might expect from a false return value */
+	return true;
+}
+
+static bool console_handle_potential_resize(void)
+{
+	coords_t new_size = size;
+	bool result = console_platform_resize(&new_size);
+	if (new_size.column != size.column || new_size.row != size.row)
+		console_resize_frames(new_size);
+	return result;
+}
+
+static bool console_paste_selection(void)
+{
+	list_t str = list_create(sizeof(char));
+	if (!console_clipboard(str))
+	{
+		list_destroy(str);
+		return false;
+	}
+
+	editor_add_raw(lines, list_element_array(str), &cursor);
+	console_move_cursor(editor_overflow_cursor(lines, (coords_t) { .column = cursor.column + 1, .row = cursor.row }));
+	list_destroy(str);
+	return true;
+}
+
+/* copies to clipboard -- has nothing to add to an action buffer */
+bool console_copy(void)
+{
+	assert(console_is_created());
+	if (!selecting)
+		return true;
+	list_t str = list_create(sizeof(char));
+	console_copy_selection_string(str);
+	return console_set_clipboard(list_element_array(str), list_count(str));
+}
+
+/* position of the character after ch, which is at position */
+static coords_t console_next_position(coords_t position, char ch)
+{
+	return ch == '\n' ? (coords_t) { 0, position.row + 1 } : (coords_t) { position.column + 1, position.row };
+}
+
+/* whether a run of text may go on from before to after */
+static bool console_continues_run(char before, char after)
+{
+	return !(action_breaks & BREAK_ON_WHITESPACE) || !isspace((unsigned char)before) || isspace((unsigned char)after);
+}
+
+/*	merges a keystroke into the last action if it carries on from it. Typing and the delete key add to the
+	end of the last action's text, backspace adds to the front. The last action's text must be at the end of the history */
+static bool console_merge_action(action_t action, const char* text, int size)
+{
+	action_t* last = list_get(actions, list_count(actions) - 1);
+	if (!last || last->did_remove != action.did_remove || action.coupled || size == 0
+		|| last->text_offset + last->text_length != list_count(action_history) || last->text_length + size > CONSOLE_MAX_ACTION_RUN)
+		return false;
+
+	char* history = list_element_array(action_history);
+	char first = history[last->text_offset], final = history[last->text_offset + last->text_length - 1];
+	coords_t after_last = console_next_position(last->end, final);
+	int start = list_count(action_history);
+	if (!action.did_remove && editor_compare_cursors(action.start, after_last) == 0 && console_continues_run(final, text[0]))
+		last->end = action.end;
+	else if (action.did_remove && editor_compare_cursors(action.start, last->start) == 0 && console_continues_run(final, text[0]))
+		last->end = after_last; /* delete key, the text closes up under the cursor */
+	else if (action.did_remove && editor_compare_cursors(console_next_position(action.end, text[size - 1]), last->start) == 0
+		&& console_continues_run(text[size - 1], first))
+	{
+		/* backspace */
+		list_resize(action_history, start + size);
+		history = list_element_array(action_history);
+		memmove(history + last->text_offset + size, history + last->text_offset, last->text_length);
+		memcpy(history + last->text_offset, text, size);
+		last->start = action.start;
+		last->text_length += size;
+		return true;
+	}
+	else
+		return false;
+
+	list_resize(action_history, start + size);
+	memcpy((char*)list_element_array(action_history) + start, text, size);
+	last->text_length += size;
+	return true;
+}
+
+/* logs an edit to the file. A prompt's lines aren't the file */
+static void console_log_edit(bool did_remove, coords_t start, coords_t end, const char* text, int size)
+{
+	console_lines_changed(start.row);
+	if (!prev_lines)
+	{
+		search_valid = false;
+		wal_append(did_remove, start, end, text, size);
+	}
+}
+
+/*	copies size bytes of text into the action's history, stopping early at a NUL, and commits the lines' new version.
+	Keystrokes are merged into the last action while the break policy allows it, they and coupled actions amend its version */
+static inline void console_commit_action(action_t action, const char* text, int size, bool keystroke)
+{
+	size = (int)strnlen(text, size);
+	console_log_edit(action.did_remove, action.start, action.end, text, size);
+	if (prev_lines)
+		return; /* a prompt's edits aren't undone */
+	uint64_t now = console_platform_ticks();
+	bool paused = (action_breaks & BREAK_ON_PAUSE) && now - action_run_time > (uint64_t)action_pause;
+	bool amends = action_version == rope_version(lines);
+	bool merged = keystroke && action_run_open && !paused && amends && console_merge_action(action, text, size);
+	action_run_open = keystroke;
+	action_run_time = now;
+	if (merged || (amends && action.coupled))
+		rope_amend(lines);
+	else
+	{
+		int parent = rope_version(lines);
+		if (rope_commit(lines) == parent)
+			return; /* nothing changed */
+		action_version = rope_version(lines);
+		int first = list_count(actions);
+		LIST_PUSH(action_groups, first);
+	}
+	if (merged)
+		return;
+
+	int start = list_count(action_history);
+	list_resize(action_history, start + size);
+	memcpy((char*)list_element_array(action_history) + start, text, size);
+	action.text_offset = start;
+	action.text_length = size;
+	LIST_PUSH(actions, action);
+}
+
+/* pastes from clipboard to current position */
+bool console_paste(void)
+{
+	assert(console_is_created());
+	bool was_selecting = selecting;
+	if (selecting)
+		console_act_delete_selection();
+	coords_t prev = cursor;
+	list_t str = list_create(sizeof(char));
+	if (!console_clipboard(str) || !console_paste_selection())
+	{
+		list_destroy(str);
+		return false;
+	}
+	console_commit_action((action_t) 
+	{
+		.coupled = was_selecting,
+		.cursor = prev,
+		.start = prev,
+		.end = editor_overflow_cursor(lines, (coords_t) { .column = cursor.column - 1, .row = cursor.row }),
+		.did_remove = false
+	}, list_element_array(str), list_count(str), false);
+	list_destroy(str);
+	return true;
+}
+
+/* swaps the lines for the version before or after the current one, then logs the edits between them */
+static void console_generic_do(bool direction, action_t* out)
+{
+	assert(console_is_created());
+	int from = rope_version(lines);
+	if (prev_lines || !(direction ? rope_redo(lines) : rope_undo(lines)))
+		return;
+
+	action_run_open = false;
+	action_version = -1;
+	/*	the later version's actions, undone from the last one back and redone from the first one on.
+		Every version but the first was made by at least one */
+	int version = direction ? rope_version(lines) : from;
+	int first = *LIST_GET(action_groups, version, int);
+	int end = version + 1 < list_count(action_groups) ? *LIST_GET(action_groups, version + 1, int) : list_count(actions);
+	action_vec_t buffer = action_vec_of(actions);
+	for (int i = 0; i < end - first; i++)
+	{
+		const action_t* curr = action_vec_at(buffer, direction ? first + i : end - 1 - i);
+		/* true for redo */
+		bool adjusted = direction ? curr->did_remove : !curr->did_remove;
+		console_log_edit(adjusted, curr->start, curr->end, console_action_text(curr), curr->text_length);
+		console_move_cursor(curr->cursor);
+	}
+	if (out)
+		*out = *action_vec_at(buffer, direction ? first : end - 1);
+}
+
+/* puts action to undo in out (IF NOT NULL) and then undoes it */
+void console_undo(action_t* out)
+{
+	assert(console_is_created());
+	console_generic_do(false, out);
+}
+
+/* redoes last undo and puts that action in out (IF NOT NULL) */
+void console_redo(action_t* out)
+{
+	assert(console_is_created());
+	console_generic_do(true, out);
+}
+
+/* redoes along the next branch off of the current version, so repeating undo then this cycles through all of them */
+void console_redo_branch(action_t* out)
+{
+	assert(console_is_created());
+	if (!prev_lines)
+		rope_next_branch(lines);
+	console_generic_do(true, out);
+}
+
+#define CONSOLE_COLOR_CHOICES "Black\nDark blue\nDark green\nDark cyan\nDark red\nDark purple\nDark yellow\nLight gray\nDark gray\nLight blue\nLight green\nLight cyan\nLight red\nLight purple\nLight yellow\nWhite"
+
+static color_t foreground;
+
+static inline color_t console_to_color(const char* color)
+{
+	/*	trailing new line because response_curr needs to be equal to 0; but if the user picks the last option, 
+		response_curr will advance past that NUL terminator since choice_curr ends in that too */
+	const char* choice_curr = CONSOLE_COLOR_CHOICES "\n";
+	int i;
+	for (i = 0; i < 16; i++)
+	{
+		const char* response_curr = color;
+		while (*choice_curr != '\n')
+		{
+			if (*choice_curr++ == *response_curr)
+				response_curr++;
+		}
+		choice_curr++;
+		if (*response_curr == '\0')
+			break;
+	}
+	assert(i < 16);
+	return (color_t)i;
+}
+
+static void console_handle_background(const char* response)
+{
+	user_t user = user_get_latest();
+	user.background = console_to_color(response);
+	user.foreground = foreground;
+	DEBUG_ON_FAILURE(user_save(user));
+	user_attribute = CONSOLE_CREATE_ATTRIBUTE(foreground, user.background);
+}
+
+static void console_handle_foreground(const char* response)
+{
+	foreground = console_to_color(response);
+	console_prompt_user_mc("Background color:\n" CONSOLE_COLOR_CHOICES, console_handle_background);
+}
+
+static void console_handle_font(const char* response)
+{
+	console_set_font(response);
+	user_t user = user_get_latest();
+	strncpy(user.font, response, sizeof user.font);
+	DEBUG_ON_FAILURE(user_save(user));
+}
+
+static void console_handle_workers(const char* response)
+{
+	char* end;
+	long count = strtol(response, &end, 10);
+	if (end == response || *end != '\0' || count < 0 || count > THREAD_MAX_WORKERS + 1)
+	{
+		footer_message = "Worker count isn't valid.";
+		return;
+	}
+	thread_set_worker_count((int)count);
+	user_t user = user_get_latest();
+	user.worker_count = (int)count;
+	DEBUG_ON_FAILURE(user_save(user));
+	footer_message = "Set worker count.";
+}
+
+static void console_open_picked(const char* directory)
+{
+	file_details_t details = file_open(directory);
+	if (IS_BAD_DETAILS(details))
+	{
+		footer_message = "Failed to open file.";
+		return;
+	}
+	console_set_file_details(details);
+
+	coords_t last_cursor = { 0 };
+	list_t saves = user_get_latest().file_saves;
+	for (int i = 0; i < list_count(saves); i++)
+	{
+		file_save_t* save = LIST_GET(saves, i, file_save_t);
+		if (strncmp(save->directory, directory, CONSOLE_MAX_PATH) == 0)
+			last_cursor = save->cursor;
+	}
+	if (editor_is_valid_cursor(lines, last_cursor))
+		console_move_cursor(last_cursor);
+	else
+		debug_format("Invalid cursor placement saved to user file.\n");
+	footer_message = "Opened file.";
+}
+
+static bool console_save(void)
+{
+	debug_format("Saving file \"%s\" with type %i.\n", current_file.directory, current_file.type);
+	bool result = DEBUG_ON_FAILURE(user_save_file((file_save_t) { .directory = current_file.directory, .cursor = cursor })) &&
+		DEBUG_ON_FAILURE(file_save(current_file));
+	if (result && !(current_file.type & TYPE_ENCRYPTED))
+		DEBUG_ON_FAILURE(wal_restart(current_file.directory));
+	else if (result)
+		wal_close();
+	footer_message = "Saved file.";
+	if (!result)
+		footer_message = "Failed to save file.";
+	return result;
+}
+
+static void console_save_picked(const char* directory)
+{
+	current_file.type = file_extension_to_type(directory);
+	strncpy(dir_buf, directory, CONSOLE_MAX_PATH - 1);
+	current_file.directory = dir_buf;
+	console_set_title(current_file.directory);
+	console_save();
+}
+
+static bool console_handle_control_event(int ch, bool shifting)
+{
+	switch (ch)
+	{
+	case 'C':
+		return console_copy();
+	case 'V':
+		return console_paste();
+	case 'Y':
+		console_redo(NULL);
+		break;
+	case 'B':
+		console_redo_branch(NULL);
+		break;
+	case 'Z':
+		console_undo(NULL);
+		break;
+	case 'P':
+		console_prompt_user("Enter password: ", file_set_password);
+		break;
+	case 'U':
+		console_prompt_user_mc("Text color:\n" CONSOLE_COLOR_CHOICES, console_handle_foreground);
+		break;
+	case 'G':
+		console_prompt_user("Font: ", console_handle_font);
+		break;
+	case 'T':
+		console_prompt_user("Worker threads, 0 for one per core: ", console_handle_workers);
+		break;
+
+	case 'F':
+		console_prompt_user("Find: ", console_find_picked);
+		prompt_typed = console_find_typed;
+		break;
+	case 'E':
+		console_prompt_user("Find pattern: ", console_find_pattern_picked);
+		break;
+	case 'N':
+		return console_find_next();
+	case 'R':
+		if (search_size == 0)
+		{
+			footer_message = "Find something to replace first.";
+			break;
+		}
+		console_prompt_user("Replace with: ", console_replace_picked);
+		break;
+
+	case 'A':
+		selecting = true;
+		selection_begin = (coords_t){ 0, 0 };
+		console_move_cursor((coords_t) { rope_line_length(lines, rope_line_count(lines) - 1), rope_line_count(lines) - 1 });
+		break;
+
+	case 'O':
+		console_platform_pick_file(true, current_file.directory, console_open_picked);
+		break;
+
+	case 'S':
+		if (!current_file.directory || shifting)
+		{
+			console_platform_pick_file(false, current_file.directory, console_save_picked);
+			break;
+		}
+		return console_save();
+	}
+	return true;
+}
+
+/* handles an arrow key action */
+void console_arrow_key(bool shifting, int dc, int dr)
+{
+	assert(console_is_created());
+	if (action_breaks & BREAK_ON_JUMP)
+		action_run_open = false;
+	coords_t new_cursor = cursor, begin, end;
+	if (shifting && !selecting)
+	{
+		selection_begin = cursor;
+		selecting = true;
+	}
+	else if (!shifting && console_get_selection_region(&begin, &end))
+	{
+		selecting = false;
+		if (dc < 0 || dr < 0)
+			new_cursor = begin;
+		else
+			new_cursor = end;
+	}
+	new_cursor = editor_overflow_cursor(lines, (coords_t) { .column = new_cursor.column + dc, .row = new_cursor.row });
+	/* increment after overflow, otherwise if the line is too short, it will overflow into another row */
+	new_cursor.row += dr;
+	console_move_cursor(new_cursor);
+}
+
+static void console_act_delete_selection(void)
+{
+	coords_t start, end, prev = cursor;
+	list_t str = list_create(sizeof(char));
+	console_get_selection_region(&start, &end);
+	console_copy_selection_string(str);
+	console_delete_selection();
+
+	action_t action = { .cursor = prev, .start = start, .end = end, .did_remove = true };
+	console_commit_action(action, list_element_array(str), list_count(str), false);
+	list_destroy(str);
+}
+
+static void console_act_delete_char(coords_t prev)
+{
+	char deleted;
+	rope_copy(lines, rope_coords_to_offset(lines, cursor), 1, &deleted); /* the newline, at the end of a line */
+
+	editor_delete_region(lines, cursor, cursor);
+
+	action_t action = { .cursor = prev, .start = cursor, .end = cursor, .did_remove = true };
+	console_commit_action(action, &deleted, 1, true);
+}
+
+/* handles a DEL key command */
+void console_delete(void)
+{
+	assert(console_is_created());
+	if (selecting)
+		console_act_delete_selection();
+	else if (cursor.column < rope_line_length(lines, cursor.row) || cursor.row + 1 < rope_line_count(lines))
+		console_act_delete_char(cursor);
+}
+
+/* handles a BKSPC key command */
+void console_backspace(void)
+{
+	assert(console_is_created());
+	coords_t start = cursor;
+	if (selecting)
+		console_act_delete_selection();
+	else if (cursor.column != 0 || cursor.row != 0)
+	{
+		cursor = editor_overflow_cursor(lines, (coords_t) { .column = cursor.column - 1, .row = cursor.row });
+		console_act_delete_char(start);
+	}
+}
+
+/* handles an enter/return key command */
+void console_return(void)
+{
+	assert(console_is_created());
+	if (selecting)
+		console_act_delete_selection();
+	else
+	{
+		coords_t end = (coords_t){ 0, cursor.row + 1 };
+		action_t action = { .cursor = cursor, .did_remove = false, .start = cursor, .end = cursor };
+		editor_add_newline(lines, cursor);
+		console_move_cursor(end);
+		console_commit_action(action, "\n", 1, true);
+	}
+}
+
+/* handles a tab key command */
+void console_tab(void)
+{
+	assert(console_is_created());
+	if (selecting)
+		console_act_delete_selection();
+	coords_t start = cursor, end = start;
+	int tabc = TAB_SIZE - cursor.column % TAB_SIZE;
+	char tab_str[TAB_SIZE + 1] = { 0 };
+	memset(tab_str, ' ', tabc);
+	editor_add_raw(lines, tab_str, &end);
+
+	console_move_cursor(end);
+	action_t action = { .cursor = start, .did_remove = false, .start = start, .end = end };
+	console_commit_action(action, tab_str, tabc, true);
+}
+
+/* handles adding a character */
+void console_character(int ch)
+{
+	assert(console_is_created());
+	bool was_selecting = selecting;
+	if (selecting)
+		console_act_delete_selection();
+	coords_t start = cursor;
+	if (ch == '\n')
+		editor_add_newline(lines, cursor);
+	editor_add_char(lines, (char)ch, cursor);
+	console_move_cursor((coords_t) { cursor.column + 1, cursor.row });
+	char str = (char)ch;
+	action_t action = { .cursor = start, .did_remove = false, .start = start, .end = start, .coupled = was_selecting };
+	console_commit_action(action, &str, 1, true);
+}
+
+static bool console_handle_key_event(console_event_t event)
+{
+	bool result = true;
+	bool shifting = event.modifiers & MODIFIER_SHIFT;
+	switch (event.key)
+	{
+	case KEY_UP:
+	case KEY_DOWN:
+		console_arrow_key(shifting, 0, event.key == KEY_DOWN ? 1 : -1);
+		break;
+	case KEY_LEFT:
+	case KEY_RIGHT:
+		console_arrow_key(shifting, event.key == KEY_RIGHT ? 1 : -1, 0);
+		break;
+	case KEY_DELETE:
+		console_delete();
+		break;
+	case KEY_BACKSPACE:
+		console_backspace();
+		break;
+	case KEY_RETURN:
+		console_return();
+		break;
+	case KEY_TAB:
+		console_tab();
+		break;
+
+	case KEY_CHARACTER:
+		if (event.modifiers & MODIFIER_CONTROL)
+			result = console_handle_control_event(event.ch, shifting);
+		else
+			console_character(event.ch);
+		break;
+	default: /* escape is handled by the loop */
+		break;
+	}
+
+	if (!(event.modifiers & (MODIFIER_SHIFT | MODIFIER_CONTROL)) && selecting)
+		selecting = false;
+	return result;
+}
+
+static void console_handle_mouse_event(console_event_t event)
+{ 
+	static bool mouse_state = false;
+	if (!event.moved) /* mouse down or up */
+	{
+		mouse_state = event.pressed;
+		if (mouse_state) /* mouse down event */
+		{
+			if (action_breaks & BREAK_ON_JUMP)
+				action_run_open = false;
+			console_move_cursor((coords_t) { event.mouse.column + camera.column, event.mouse.row + camera.row });
+			selection_begin = cursor;
+		}
+	}
+	if (mouse_state && event.moved)
+	{
+		selecting = true;
+		console_move_cursor((coords_t) { event.mouse.column + camera.column, event.mouse.row + camera.row });
+	}
+}
+
+static bool console_handle_mcq_prompt(console_event_t event)
+{
+	switch (event.type)
+	{
+	case EVENT_KEY:
+	{
+		if (event.key == KEY_UP || event.key == KEY_DOWN)
+			console_arrow_key(false, 0, event.key == KEY_DOWN ? 1 : -1);
+		else if (event.key == KEY_LEFT || event.key == KEY_RIGHT)
+			console_arrow_key(false, event.key == KEY_RIGHT ? 1 : -1, 0);
+		else if (event.key == KEY_RETURN && cursor.row != 0) /* row 0 = the question line */
+		{
+			/* delete choices beyond the one selected */
+			editor_delete_region(lines, (coords_t) 
+			{ 
+				.column = rope_line_length(lines, cursor.row), 
+				.row = cursor.row 
+			}, (coords_t) 
+			{ 
+				.column = rope_line_length(lines, rope_line_count(lines) - 1) - 1,
+				.row = rope_line_count(lines) - 1
+			});
+			/* delete choices before but keep the prompt */
+			editor_delete_region(lines, (coords_t) { .column = prompt_len, .row = 0 }, (coords_t) { .column = TAB_SIZE - 1, .row = cursor.row });
+			return true;
+		}
+		break;
+	}
+	case EVENT_MOUSE:
+		console_handle_mouse_event(event);
+		selecting = false;
+		break;
+	default: /* resizes are picked up when the next frame is drawn */
+		break;
+	}
+	return false;
+}
+
+static bool console_handle_response_prompt(console_event_t event)
+{
+	switch (event.type)
+	{
+	case EVENT_KEY:
+	{
+		DEBUG_ON_FAILURE(console_handle_key_event(event));
+		if (event.key == KEY_RETURN)
+		{
+			/* remove new line */
+			int start = rope_coords_to_offset(lines, (coords_t) { 0, cursor.row }) - 1;
+			rope_delete(lines, start, rope_line_length(lines, cursor.row) + 1);
+		}
+		else if (prompt_typed)
+		{
+			int count;
+			const char* string = rope_line(lines, 0, &count);
+			char response[CONSOLE_MAX_PROMPT_LEN + 1] = { 0 };
+			memcpy(response, string + prompt_len, min(count - prompt_len, CONSOLE_MAX_PROMPT_LEN));
+			prompt_typed(response);
+		}
+		break;
+	}
+	case EVENT_MOUSE:
+		console_handle_mouse_event(event);
+		break;
+	default:
+		break;
+	}
+
+	cursor.column = max(cursor.column, prompt_len);
+	selection_begin.column = max(selection_begin.column, prompt_len);
+	return cursor.row >= 1;
+}
+
+/* blocks until there's input, writing the edit log's pending group if typing stops first */
+static bool console_read_input(console_event_t* event)
+{
+	if (wal_has_pending() && !console_platform_poll(WAL_GROUP_DELAY))
+		DEBUG_ON_FAILURE(wal_flush());
+	return console_platform_read(event);
+}
+
+/* applies an event to the lines, or to the prompt if the user is being asked something */
+static void console_handle_event(console_event_t event)
+{
+	if (callback)
+	{
+		/* if prompting the user a multiple choice, list count will always be > 1 */
+		if (((rope_line_count(lines) <= 1 && console_handle_response_prompt(event))
+			|| (rope_line_count(lines) > 1 && console_handle_mcq_prompt(event))))
+		{
+			list_t str = list_create(sizeof(char));
+			editor_copy_all_lines(lines, str);
+			rope_destroy(lines);
+			lines = prev_lines;
+			line_totals_valid = 0;
+			console_move_cursor(prev_cursor);
+			prev_lines = NULL;
+			prompt_typed = NULL;
+
+			prompt_callback_t curr = callback;
+			curr((char*)list_element_array(str) + prompt_len);
+			list_destroy(str);
+
+			if (curr == callback)
+				callback = NULL;
+		}
+	}
+	else if (event.type == EVENT_KEY)
+		DEBUG_ON_FAILURE(console_handle_key_event(event));
+	else if (event.type == EVENT_MOUSE)
+		console_handle_mouse_event(event);
+}
+
+/*	whether the events since the last frame should be drawn now. Input that's already waiting is applied first,
+	so a paste or a drag is drawn once rather than per event. Frames are at most one interval apart, and
+	the first event after the last frame is drawn within an interval of being read */
+static bool console_is_frame_due(uint64_t batch_start, uint64_t last_frame)
+{
+	uint64_t now = console_platform_ticks();
+	if (now - batch_start >= CONSOLE_FRAME_INTERVAL)
+		return true;
+	int wait = now - last_frame >= CONSOLE_FRAME_INTERVAL ? 0 : (int)(CONSOLE_FRAME_INTERVAL - (now - last_frame));
+	return !console_platform_poll(wait);
+}
+
+/* returns once user escapes */
+void console_loop(void)
+{
+	console_event_t event = { 0 };
+	bool drawn = true;
+	uint64_t batch_start = 0, last_frame = 0;
+
+	for (;;)
+	{
+		if (!drawn && console_is_frame_due(batch_start, last_frame))
+		{
+			DEBUG_ON_FAILURE(console_handle_potential_resize());
+			console_invalidate();
+			last_frame = console_platform_ticks();
+			drawn = true;
+			continue;
+		}
+
+		if (!console_read_input(&event) || (event.type == EVENT_KEY && event.key == KEY_ESCAPE))
+			break;
+		if (drawn)
+			batch_start = console_platform_ticks();
+		drawn = false;
+		console_handle_event(event);
+	}
+}
+
+/* returns false if there is no selection, otherwise sets pointers to cursor positions */
+bool console_get_selection_region(coords_t* begin, coords_t* end)
+{
+	assert(console_is_created());
+	if (selection_begin.row > cursor.row || (selection_begin.row == cursor.row && selection_begin.column > cursor.column))
+	{
+		*begin = cursor;
+		*end = selection_begin;
+	}
+	else
+	{
+		*begin = selection_begin;
+		*end = cursor;
+	}
+	bool is_selecting = selection_begin.row != cursor.row || selection_begin.column != cursor.column;
+	*end = editor_overflow_cursor(lines, (coords_t) { .column = end->column - 1, .row = end->row });
+	return selecting && is_selecting;
+}
+
+/* sets contents of assumed empty list "str" to the contents of the selection */
+void console_copy_selection_string(list_t str)
+{
+	assert(console_is_created() && str != NULL && list_count(str) == 0);
+	coords_t begin_coords, end_coords;
+	if (!console_get_selection_region(&begin_coords, &end_coords))
+	{
+		list_push_primitive(str, 0);
+		return;
+	}
+	editor_copy_region(lines, str, begin_coords, end_coords);
+}
+
+/* deletes contents of selection */
+void console_delete_selection(void)
+{
+	assert(console_is_created());
+	coords_t begin, end;
+	if (!console_get_selection_region(&begin, &end))
+		return;
+
+	editor_delete_region(lines, begin, end);
+	console_lines_changed(begin.row);
+	selecting = false;
+	console_move_cursor(begin);
+}
+
+/* clears the undo history, the current text becomes where it starts */
+void console_clear_buffer(void)
+{
+	list_clear(actions);
+	list_clear(action_history);
+	list_clear(action_groups);
+	int first = 0;
+	LIST_PUSH(action_groups, first);
+	action_version = -1;
+	action_run_open = false;
+	rope_clear_versions(prev_lines ? prev_lines : lines);
+}
+
+/*
+	FIND AND REPLACE
+*/
+
+/* searches the file's lines for pattern, refining the last search's matches if pattern carries on from it */
+static void console_search(const char* pattern)
+{
+	rope_t file_lines = prev_lines ? prev_lines : lines;
+	int size = (int)strnlen(pattern, CONSOLE_MAX_PROMPT_LEN);
+	bool grows = search_valid && !search_regexp && search_size > 0 && size >= search_size && memcmp(pattern, search_pattern, search_size) == 0;
+	if (!search_matches)
+		search_matches = list_create(sizeof(coords_t));
+
+	/* case is ignored unless the pattern has a capital letter. Matches that ignore it still hold the ones that don't */
+	bool ignore_case = true;
+	for (int i = 0; i < size; i++)
+		ignore_case = ignore_case && !isupper((unsigned char)pattern[i]);
+	if (grows)
+		editor_refine_matches(file_lines, pattern, size, ignore_case, search_matches);
+	else
+	{
+		list_clear(search_matches);
+		if (size > 0)
+			editor_find_all(file_lines, pattern, size, ignore_case, search_matches);
+	}
+	memmove(search_pattern, pattern, size);
+	search_pattern[size] = '\0';
+	search_size = size;
+	search_valid = true;
+	regexp_destroy(search_regexp);
+	search_regexp = NULL;
+}
+
+/* index of the first match at or after position, the count of matches if there is none */
+static int console_match_at(coords_t position)
+{
+	const coords_t* matches = list_element_array(search_matches);
+	int low = 0, high = list_count(search_matches);
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (editor_compare_cursors(matches[middle], position) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/* index of the match after the one at index that doesn't overlap it */
+static int console_next_match(int index)
+{
+	coords_t match = *LIST_GET(search_matches, index, coords_t);
+	return console_match_at((coords_t) { .column = match.column + search_size, .row = match.row });
+}
+
+/* count of matches that don't overlap each other */
+static int console_count_matches(void)
+{
+	int count = 0;
+	for (int i = 0; i < list_count(search_matches); i = console_next_match(i))
+		count++;
+	return count;
+}
+
+static void console_find_typed(const char* response)
+{
+	console_search(response);
+	snprintf(search_message, sizeof search_message, "%i matches", console_count_matches());
+	footer_message = search_message;
+}
+
+static void console_find_picked(const char* response)
+{
+	console_search(response);
+	console_find_next();
+}
+
+static void console_find_pattern_picked(const char* response)
+{
+	console_find_pattern(response);
+}
+
+static void console_replace_picked(const char* response)
+{
+	console_replace_all(response);
+}
+
+/* searches for pattern and selects the first match after the cursor */
+void console_find(const char* pattern)
+{
+	assert(console_is_created() && pattern);
+	console_search(pattern);
+	console_find_next();
+}
+
+/* searches for pattern, a regular expression, and selects the first match after the cursor */
+bool console_find_pattern(const char* pattern)
+{
+	assert(console_is_created() && pattern);
+	int size = (int)strnlen(pattern, CONSOLE_MAX_PROMPT_LEN);
+	/* like plain text, case is ignored unless there's a capital letter. Escapes like \W aren't letters */
+	bool ignore_case = true;
+	for (int i = 0; i < size; i++)
+	{
+		if (pattern[i] == '\\')
+			i++;
+		else
+			ignore_case = ignore_case && !isupper((unsigned char)pattern[i]);
+	}
+	regexp_t compiled = regexp_compile(pattern, size, ignore_case);
+	if (!compiled)
+	{
+		footer_message = "Pattern isn't valid.";
+		return false;
+	}
+	regexp_destroy(search_regexp);
+	search_regexp = compiled;
+	memcpy(search_pattern, pattern, size);
+	search_pattern[size] = '\0';
+	search_size = size;
+	return console_find_next();
+}
+
+/* finds the next match of the last search's regular expression after the cursor */
+static bool console_find_next_pattern(regexp_match_t* match)
+{
+	if (!regexp_find_in_lines(search_regexp, lines, cursor, match))
+		return false;
+	/* an empty match at the cursor is the one found last, so the search goes on from the next position */
+	if (editor_compare_cursors(match->begin, cursor) != 0 || editor_compare_cursors(match->end, cursor) != 0)
+		return true;
+	coords_t next = editor_overflow_cursor(lines, (coords_t) { .column = cursor.column + 1, .row = cursor.row });
+	return editor_compare_cursors(next, cursor) != 0 && regexp_find_in_lines(search_regexp, lines, next, match);
+}
+
+/* every match of the last search that doesn't overlap another, as regexp_match_t */
+static list_t console_search_ranges(void)
+{
+	list_t result = list_create(sizeof(regexp_match_t));
+	if (search_regexp)
+	{
+		regexp_find_all(search_regexp, lines, result);
+		return result;
+	}
+	if (!search_valid)
+	{
+		search_size = 0; /* the lines changed, so nothing is refined */
+		console_search(search_pattern);
+	}
+	for (int i = 0; i < list_count(search_matches); i = console_next_match(i))
+	{
+		coords_t begin = *LIST_GET(search_matches, i, coords_t);
+		regexp_match_t range = { .begin = begin, .end = { .column = begin.column + search_size, .row = begin.row } };
+		LIST_PUSH(result, range);
+	}
+	return result;
+}
+
+/* selects the next match of the last search after the cursor, going back to the top after the last one */
+bool console_find_next(void)
+{
+	assert(console_is_created());
+	if (search_size == 0)
+		return false;
+
+	regexp_match_t match;
+	if (search_regexp)
+	{
+		bool found = console_find_next_pattern(&match);
+		if (!found && regexp_find_in_lines(search_regexp, lines, (coords_t) { 0 }, &match))
+		{
+			found = true;
+			footer_message = "Search wrapped.";
+		}
+		if (!found)
+		{
+			footer_message = "No matches.";
+			return true;
+		}
+	}
+	else
+	{
+		if (!search_valid)
+		{
+			search_size = 0; /* the lines changed, so nothing is refined */
+			console_search(search_pattern);
+		}
+		if (list_count(search_matches) == 0)
+		{
+			footer_message = "No matches.";
+			return true;
+		}
+		int index = console_match_at(cursor);
+		if (index == list_count(search_matches))
+		{
+			index = 0;
+			footer_message = "Search wrapped.";
+		}
+		match.begin = *LIST_GET(search_matches, index, coords_t);
+		match.end = (coords_t){ .column = match.begin.column + search_size, .row = match.begin.row };
+	}
+	selecting = true;
+	selection_begin = match.begin;
+	console_move_cursor(match.end);
+	return true;
+}
+
+/*	replaces every match of the last search with replacement. The text from the first match to the end of the last
+	is swapped for its replaced copy, so it's one removal and one addition to undo however many matches there are */
+bool console_replace_all(const char* replacement)
+{
+	assert(console_is_created() && replacement);
+	if (search_size == 0)
+		return false;
+	list_t ranges = console_search_ranges();
+	if (list_count(ranges) == 0)
+	{
+		list_destroy(ranges);
+		footer_message = "No matches.";
+		return true;
+	}
+
+	/* offsets are taken before anything changes. A regular expression's matches can be empty, so the span can be too */
+	const regexp_match_t* first = LIST_GET(ranges, 0, regexp_match_t), *last = LIST_GET(ranges, list_count(ranges) - 1, regexp_match_t);
+	coords_t begin = first->begin, prev = cursor;
+	int base = rope_coords_to_offset(lines, begin), span = rope_coords_to_offset(lines, last->end) - base;
+	coords_t end = rope_offset_to_coords(lines, base + span - 1);
+	list_t original = list_create(sizeof(char)), replaced = list_create(sizeof(char));
+	if (span > 0)
+		editor_copy_region(lines, original, begin, end);
+	const char* text = list_element_array(original);
+	int replacement_size = (int)strlen(replacement), copied = 0;
+	for (int i = 0; i < list_count(ranges); i++)
+	{
+		const regexp_match_t* range = LIST_GET(ranges, i, regexp_match_t);
+		int at = rope_coords_to_offset(lines, range->begin) - base, start = list_count(replaced);
+		list_resize(replaced, start + at - copied + replacement_size);
+		memcpy((char*)list_element_array(replaced) + start, text + copied, at - copied);
+		memcpy((char*)list_element_array(replaced) + start + at - copied, replacement, replacement_size);
+		copied = rope_coords_to_offset(lines, range->end) - base;
+	}
+
+	selecting = false;
+	if (span > 0)
+	{
+		editor_delete_region(lines, begin, end);
+		action_t removal = { .cursor = prev, .start = begin, .end = end, .did_remove = true };
+		console_commit_action(removal, text, span, false);
+	}
+	coords_t after = begin;
+	if (list_count(replaced) > 0)
+	{
+		editor_add_text(lines, list_element_array(replaced), list_count(replaced), &after);
+		action_t addition = { .cursor = span > 0 ? begin : prev, .start = begin, .end = after, .did_remove = false, .coupled = span > 0 };
+		console_commit_action(addition, list_element_array(replaced), list_count(replaced), false);
+		after = editor_overflow_cursor(lines, (coords_t) { .column = after.column + 1, .row = after.row });
+	}
+	console_move_cursor(after);
+	snprintf(search_message, sizeof search_message, "Replaced %i matches.", list_count(ranges));
+	footer_message = search_message;
+	list_destroy(original);
+	list_destroy(replaced);
+	list_destroy(ranges);
+	return true;
+}
+
+/*
+	SELECTION SIZE
+*/
+
+static void console_lines_changed(int row)
+{
+	line_totals_valid = min(line_totals_valid, row + 1);
+}
+
+/* count of words starting between columns start and end of a line length characters long */
+static int console_count_words(const char* str, int length, int start, int end)
+{
+	end = min(end, length);
+	int count = 0;
+	for (int i = start; i < end; i++)
+		count += !isspace((unsigned char)str[i]) && (i == start || isspace((unsigned char)str[i - 1]));
+	return count;
+}
+
+/* totals of every line before row, brought up to date first */
+static struct line_totals console_line_totals(int row)
+{
+	assert(row >= 0 && row <= rope_line_count(lines));
+	if (!line_totals)
+		line_totals = list_create(sizeof(struct line_totals));
+	list_resize(line_totals, rope_line_count(lines) + 1);
+	struct line_totals* totals = list_element_array(line_totals);
+	if (line_totals_valid == 0)
+		totals[line_totals_valid++] = (struct line_totals){ 0 };
+	for (; line_totals_valid <= row; line_totals_valid++)
+	{
+		int count;
+		const char* str = rope_line(lines, line_totals_valid - 1, &count);
+		totals[line_totals_valid].words = totals[line_totals_valid - 1].words + console_count_words(str, count, 0, count);
+	}
+	return totals[row];
+}
+
+/* characters, words and lines in the selection, the same characters console_copy_selection_string would copy */
+static bool console_selection_size(long long* chars, long long* words, int* line_count)
+{
+	coords_t begin, end;
+	if (!console_get_selection_region(&begin, &end))
+		return false;
+	*chars = (long long)rope_coords_to_offset(lines, end) + 1 - rope_coords_to_offset(lines, begin);
+	*line_count = end.row - begin.row + 1;
+	/* each line is counted before the rope is used again, which invalidates it */
+	int count;
+	const char* str = rope_line(lines, begin.row, &count);
+	if (begin.row == end.row)
+		*words = console_count_words(str, count, begin.column, end.column + 1);
+	else
+	{
+		*words = console_count_words(str, count, begin.column, count);
+		*words += console_line_totals(end.row).words - console_line_totals(begin.row + 1).words;
+		str = rope_line(lines, end.row, &count);
+		*words += console_count_words(str, count, 0, end.column + 1);
+	}
+	return true;
+}
+
+/*
+	RENDER
+*/
+
+static inline bool console_is_point_renderable(coords_t coords)
+{
+	return camera.column <= coords.column && camera.column + size.column > coords.column &&
+		camera.row <= coords.row && camera.row + size.row > coords.row;
+}
+
+static inline console_cell_t* console_get_cell(int row, int col)
+{
+	int tx = col - camera.column, ty = row - camera.row;
+	assert(tx + ty * size.column < (size.column * size.row));
+	return &buffer[tx + ty * size.column];
+}
+
+static inline void console_set_cell(int row, int col, attribute_t attrib, int ch)
+{
+	if (!console_is_point_renderable((coords_t) { col, row }))
+		return;
+	if (attrib != CONSOLE_DEFAULT_ATTRIBUTE)	console_get_cell(row, col)->attribute = (unsigned char)attrib;
+	if (ch != CONSOLE_DEFAULT_CHAR)				console_get_cell(row, col)->ch = (char)ch;
+}
+
+static inline void console_draw_line(int row, attribute_t attrib)
+{
+	if (row < 0 || row >= rope_line_count(lines))
+		return;
+	int count;
+	const char* string = rope_line(lines, row, &count);
+	for (int col = camera.column, end = min(camera.column + size.column, count); col < end; col++)
+		console_set_cell(row, col, attrib, string[col]);
+}
+
+static inline void console_fill_line(int row, attribute_t attrib, int ch)
+{
+	for (int col = camera.column; col < camera.column + size.column; col++)
+		console_set_cell(row, col, attrib, ch);
+}
+
+/* returns the column after the string */
+static int console_set_stringf(int row, int col, attribute_t attrib, const char* fmt, ...)
+{
+	static char temp[1024];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(temp, sizeof temp, fmt, args);
+	va_end(args);
+
+	char* str = temp;
+	for (; *str; str++, col++)
+		console_set_cell(row, col, attrib, *str);
+	return col;
+}
+
+static inline void console_draw_footer(void)
+{
+	console_fill_line(camera.row + size.row - 1, footer_attribute, ' ');
+	console_set_stringf(camera.row + size.row - 1, camera.column + 00, footer_attribute, "Cursor: (%i, %i)", cursor.column + 1, cursor.row + 1);
+	console_set_stringf(camera.row + size.row - 1, camera.column + 24, footer_attribute, "Camera: (%i, %i)", camera.column + 1, camera.row + 1);
+	int message_column = camera.column + 80;
+	long long chars = 0, words = 0;
+	int line_count = 0;
+	if (selecting)
+	{
+		console_selection_size(&chars, &words, &line_count);
+		int after = console_set_stringf(camera.row + size.row - 1, camera.column + 48, footer_attribute, "Selected: %lli chars, %lli words, %i lines", chars, words, line_count);
+		message_column = max(message_column, after + 2);
+	}
+	if (footer_message)
+	{
+		console_set_stringf(camera.row + size.row - 1, message_column, footer_attribute, "%s", footer_message);
+		footer_message = NULL;
+	}
+}
+
+static void console_draw_selection(attribute_t attrib)
+{
+	coords_t begin, end;
+	if (console_get_selection_region(&begin, &end))
+		attrib = CONSOLE_INVERT_ATTRIBUTE(attrib);
+	else
+		return;
+	int first_line_end;
+	if (begin.row != end.row)
+	{
+		first_line_end = rope_line_length(lines, begin.row);
+		for (int i = begin.row + 1; i < end.row; i++)
+		{
+			console_draw_line(i, attrib);
+			console_set_cell(i, rope_line_length(lines, i), attrib, CONSOLE_DEFAULT_CHAR);
+		}
+		for (int i = 0; i <= end.column; i++)
+			console_set_cell(end.row, i, attrib, CONSOLE_DEFAULT_CHAR);
+	}
+	else
+		first_line_end = end.column;
+
+	for (int i = begin.column; i <= first_line_end; i++)
+		console_set_cell(begin.row, i, attrib, CONSOLE_DEFAULT_CHAR);
+}
+
+static inline bool console_same_cell(console_cell_t a, console_cell_t b)
+{
+	return a.ch == b.ch && a.attribute == b.attribute;
+}
+
+/*	writes the cells of the frame that differ from what the terminal shows. Changes close together are written
+	as one run with the unchanged cells between them, one longer write costs less than moving to the next change */
+static bool console_write_buffer(void)
+{
+	bool result = true;
+	for (int row = 0; row < size.row; row++)
+	{
+		const console_cell_t* now = &buffer[row * size.column], *before = &shown[row * size.column];
+		if (shown_lost)
+		{
+			result &= console_platform_write(row, 0, now, size.column);
+			continue;
+		}
+		for (int col = 0; col < size.column;)
+		{
+			if (console_same_cell(now[col], before[col]))
+			{
+				col++;
+				continue;
+			}
+			int start = col, end = col + 1;
+			for (col = end; col < size.column && col - end < CONSOLE_RUN_GAP; col++)
+			{
+				if (!console_same_cell(now[col], before[col]))
+					end = col + 1;
+			}
+			result &= console_platform_write(row, start, now + start, end - start);
+		}
+	}
+	memcpy(shown, buffer, sizeof * buffer * size.column * size.row);
+	shown_lost = !result;
+	return console_platform_present(cursor.row - camera.row, cursor.column - camera.column) && result;
+}
+
+/* physically moves cursor */
+void console_move_cursor(coords_t coords)
+{
+	assert(console_is_created());
+	coords.row = min(max(0, coords.row), rope_line_count(lines) - 1);
+	coords.column = min(max(0, coords.column), rope_line_length(lines, coords.row));
+	if (!console_is_point_renderable(coords) || coords.row >= camera.row + size.row - 1) /* accounting for footer */
+	{
+		if (camera.column > coords.column)
+			camera.column = coords.column;
+		else if (camera.column + size.column <= coords.column)
+			camera.column = coords.column - size.column + 1;
+
+		if (camera.row > coords.row)
+			camera.row = coords.row;
+		else if (camera.row + size.row - 1 <= coords.row)
+			camera.row = coords.row - size.row + 2;
+	}
+	cursor = coords;
+}
+
+/* re-renders the screen */
+static bool console_invalidate(void)
+{
+	assert(console_is_created());
+	for (int row = camera.row; row < camera.row + size.row - 1; row++)
+	{
+		console_fill_line(row, user_attribute, ' ');
+		console_draw_line(row, user_attribute);
+	}
+
+	coords_t temp;
+	if (console_get_selection_region(&temp, &temp))
+		console_draw_selection(user_attribute);
+	console_draw_footer();
+
+	return console_write_buffer();
+}
\ No newline at end of file
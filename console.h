@@ -39,9 +39,22 @@ typedef struct action
 	coords_t start, end, cursor;
 	bool did_remove;
 	bool coupled; /* coupled with previous action in buffer */
-	char* str;
+	int text_offset, text_length; /* text removed or added, kept in the console's history. See console_action_text */
 } action_t;
 
+LIST_DEFINE_VEC(action_vec, action_t)
+
+/* what stops consecutive keystrokes from merging into one action */
+typedef enum action_break
+{
+	BREAK_ON_WHITESPACE =	0x01, /* a word after whitespace starts a new action */
+	BREAK_ON_PAUSE =		0x02, /* typing resumes after a pause */
+	BREAK_ON_JUMP =			0x04, /* cursor was moved with the arrow keys or mouse */
+	BREAK_DEFAULT =			BREAK_ON_WHITESPACE | BREAK_ON_PAUSE | BREAK_ON_JUMP
+} action_break_t;
+
+#define ACTION_PAUSE_DEFAULT	1000 /* milliseconds */
+
 typedef void (*prompt_callback_t)(const char*);
 
 /* pauses application to ask user with prompt, calls callback when done and frees string passed after. */
@@ -52,17 +65,19 @@ void console_prompt_user_mc(const char* prompt, prompt_callback_t callback);
 
 bool console_is_created(void);
 const file_details_t console_file(void);
+/* every action committed on any branch of the undo tree, in the order they were */
 list_t console_actions(void);
-list_t console_undid_actions(void);
+/* text of an action. Only valid until the next action is committed */
+const char* console_action_text(const action_t* action);
 bool console_clipboard(list_t str);
 /* returns bitmask of console's colors. use CONSOLE_GET_****GROUND macros to extract what you need */
 int console_colors(void);
 const char* console_font(void);
 
-list_t console_lines(void);
+rope_t console_lines(void);
 coords_t console_cursor(void);
 
-/* set console's file details. File details are copied on the console's end */
+/* set console's file details. The directory is copied on the console's end, the lines are taken and destroyed once replaced */
 void console_set_file_details(const file_details_t details);
 /* sets clipboard */
 bool console_set_clipboard(const char* str, size_t size);
@@ -70,6 +85,8 @@ bool console_set_clipboard(const char* str, size_t size);
 void console_set_color(color_t foreground, color_t background);
 /* copies font name in console */
 void console_set_font(const char* font);
+/* sets what splits typing into separate undo actions. pause_ms is only used with BREAK_ON_PAUSE */
+void console_set_action_breaks(action_break_t breaks, int pause_ms);
 
 /* destroys the console if it is created then creates the console */
 bool console_create(void);
@@ -86,7 +103,7 @@ void console_copy_selection_string(list_t str);
 /* deletes contents of selection */
 void console_delete_selection(void);
 
-/* clears action buffers entirely */
+/* clears the undo history, the current text becomes where it starts */
 void console_clear_buffer(void);
 
 /*
@@ -114,4 +131,15 @@ bool console_paste(void);
 /* puts action to undo in out (IF NOT NULL) and then undoes it */
 void console_undo(action_t* out);
 /* redoes last undo and puts that action in out (IF NOT NULL) */
-void console_redo(action_t* out);
\ No newline at end of file
+void console_redo(action_t* out);
+/* redoes along the next branch off of the current version, so repeating undo then this cycles through all of them */
+void console_redo_branch(action_t* out);
+/* searches for pattern and selects the first match after the cursor */
+void console_find(const char* pattern);
+/* searches for pattern, a regular expression, and selects the first match after the cursor */
+bool console_find_pattern(const char* pattern);
+/* selects the next match of the last search after the cursor, going back to the top after the last one */
+bool console_find_next(void);
+/*	replaces every match of the last search with replacement. The text from the first match to the end of the last
+	is swapped for its replaced copy, so it's one removal and one addition to undo however many matches there are */
+bool console_replace_all(const char* replacement);
\ No newline at end of file
@@ -0,0 +1,399 @@
+/*
+	console_headless.c ~ RL
+
+	User interface - terminal that only exists in memory, for tests and benchmarks
+*/
+
+#ifdef CONSOLE_HEADLESS
+
+#include "console_headless.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "thread.h"
+#include <time.h>
+
+#define HEADLESS_MAX_FONT		32
+
+static coords_t size = { .column = 80, .row = 25 }, next_size = { .column = 80, .row = 25 };
+static console_cell_t* screen;
+static coords_t cursor;
+static long long cells_written;
+static int frames;
+static bool unpresented;		/* an event was read that isn't presented yet */
+static uint64_t read_since;		/* when the first of those was read */
+static int worst_latency;
+
+static list_t events; /* console_event_t */
+static int next_event;
+
+static list_t clipboard;
+static char font[HEADLESS_MAX_FONT] = "Terminal";
+
+bool console_clipboard(list_t str)
+{
+	assert(str != NULL && list_element_size(str) == sizeof(char));
+	if (!clipboard || list_count(clipboard) == 0)
+		return false;
+	list_t temp = list_create_with_array(list_element_array(clipboard), sizeof(char), list_count(clipboard));
+	list_push_primitive(temp, 0);
+	editor_format_raw(temp);
+	list_concat(str, temp, 0);
+	list_destroy(temp);
+	return true;
+}
+
+/* sets clipboard */
+bool console_set_clipboard(const char* str, size_t size)
+{
+	assert(str && clipboard);
+	int count = (int)strnlen(str, size);
+	list_resize(clipboard, count);
+	memcpy(list_element_array(clipboard), str, count);
+	return true;
+}
+
+const char* console_font(void)
+{
+	assert(console_is_created());
+	return font;
+}
+
+/* copies font name in console */
+void console_set_font(const char* _font)
+{
+	assert(console_is_created() && _font);
+	strncpy(font, _font, sizeof font - 1);
+}
+
+/* sets the size of the screen, taking effect on the console's next frame */
+void console_headless_resize(coords_t _size)
+{
+	assert(_size.column > 0 && _size.row > 1);
+	next_size = _size;
+}
+
+/* queues an event for console_loop, which returns once every queued event is handled */
+void console_headless_push(console_event_t event)
+{
+	if (!events)
+		events = list_create(sizeof(console_event_t));
+	LIST_PUSH(events, event);
+}
+
+/* queues a key event for each character of text */
+void console_headless_type(const char* text)
+{
+	assert(text);
+	for (; *text; text++)
+	{
+		console_event_t event = { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = *text };
+		if (*text == '\n')
+			event.key = KEY_RETURN;
+		else if (*text == '\t')
+			event.key = KEY_TAB;
+		console_headless_push(event);
+	}
+}
+
+/* cell at row and column of the screen as it was last written */
+console_cell_t console_headless_cell(int row, int column)
+{
+	assert(screen && row >= 0 && row < size.row && column >= 0 && column < size.column);
+	return screen[row * size.column + column];
+}
+
+/* cursor as it was last presented */
+coords_t console_headless_cursor(void)
+{
+	return cursor;
+}
+
+/* count of cells written to the screen since the console was created */
+long long console_headless_cells_written(void)
+{
+	return cells_written;
+}
+
+/* count of frames presented since the console was created */
+int console_headless_frames(void)
+{
+	return frames;
+}
+
+/* most milliseconds between reading an event and presenting the frame that shows it */
+int console_headless_worst_latency(void)
+{
+	return worst_latency;
+}
+
+static void console_headless_allocate(void)
+{
+	free(screen);
+	screen = journal_malloc(sizeof * screen * size.column * size.row);
+	memset(screen, 0, sizeof * screen * size.column * size.row);
+}
+
+/* opens the terminal and sets size to its size in cells */
+bool console_platform_create(coords_t* out_size)
+{
+	size = next_size;
+	console_headless_allocate();
+	cursor = (coords_t){ 0 };
+	cells_written = 0;
+	frames = worst_latency = 0;
+	unpresented = false;
+	if (!clipboard)
+		clipboard = list_create(sizeof(char));
+	*out_size = size;
+	return true;
+}
+
+/* puts the terminal back the way it was found */
+void console_platform_destroy(void)
+{
+	free(screen);
+	screen = NULL;
+	if (events)
+		list_clear(events);
+	next_event = 0;
+}
+
+/* fits the screen to the window, setting size to the screen's size. Everything on screen is lost if it changes */
+bool console_platform_resize(coords_t* out_size)
+{
+	if (next_size.column == size.column && next_size.row == size.row)
+		return true;
+	size = next_size;
+	console_headless_allocate();
+	*out_size = size;
+	return true;
+}
+
+/* waits up to timeout milliseconds for input, returns whether there is some */
+bool console_platform_poll(int timeout)
+{
+	return events && next_event < list_count(events);
+}
+
+/* blocks until the next event, returns false if there is no more input */
+bool console_platform_read(console_event_t* event)
+{
+	if (!console_platform_poll(0))
+	{
+		if (events)
+			list_clear(events);
+		next_event = 0;
+		return false;
+	}
+	*event = *LIST_GET(events, next_event++, console_event_t);
+	if (!unpresented)
+		read_since = console_platform_ticks();
+	unpresented = true;
+	return true;
+}
+
+/* writes count cells starting at row and column of the screen. They might not show until presented */
+bool console_platform_write(int row, int column, const console_cell_t* cells, int count)
+{
+	assert(screen && column + count <= size.column && row < size.row);
+	memcpy(&screen[row * size.column + column], cells, sizeof * cells * count);
+	cells_written += count;
+	return true;
+}
+
+/* shows everything written and puts the cursor at row and column of the screen */
+bool console_platform_present(int row, int column)
+{
+	cursor = (coords_t){ .column = column, .row = row };
+	frames++;
+	if (unpresented)
+		worst_latency = max(worst_latency, (int)(console_platform_ticks() - read_since));
+	unpresented = false;
+	return true;
+}
+
+/* milliseconds since some point in the past. This is processor time, the only clock standard C has */
+uint64_t console_platform_ticks(void)
+{
+	return (uint64_t)clock() * 1000 / CLOCKS_PER_SEC;
+}
+
+void console_platform_set_title(const char* title)
+{
+}
+
+/* asks the user for a file, calling callback with its path if one is picked */
+void console_platform_pick_file(bool does_file_exist, const char* initial, prompt_callback_t callback)
+{
+	console_prompt_user(does_file_exist ? "Open file: " : "Save as: ", callback);
+}
+
+#ifdef TEST
+#ifdef HEADLESS_TEST
+#include <time.h>
+
+#define TEST_COUNT 20000
+
+static bool headless_test_row(int row, const char* expected)
+{
+	int i;
+	for (i = 0; expected[i]; i++)
+	{
+		if (console_headless_cell(row, i).ch != expected[i])
+			return false;
+	}
+	return i == size.column || console_headless_cell(row, i).ch == ' ';
+}
+
+int main()
+{
+	int wrong_count = 0;
+	console_headless_resize((coords_t) { .column = 100, .row = 25 });
+	if (!console_create())
+		return 1;
+
+	/* typed text shows up with the cursor after it. Keys that are all waiting are drawn together */
+	int frames_before = console_headless_frames();
+	console_headless_type("Hello, world!\nSecond line");
+	console_loop();
+	wrong_count += console_headless_frames() - frames_before > 2;
+	wrong_count += !headless_test_row(0, "Hello, world!") + !headless_test_row(1, "Second line");
+	wrong_count += console_headless_cursor().column != 11 || console_headless_cursor().row != 1;
+
+	/* a keystroke only rewrites the cells it changed, the character and the cursor's column in the footer */
+	long long before = console_headless_cells_written();
+	console_headless_type("!");
+	console_loop();
+	long long keystroke = console_headless_cells_written() - before;
+	wrong_count += keystroke == 0 || keystroke > 8 || !headless_test_row(1, "Second line!");
+
+	/* moving the cursor without changing text only touches the footer */
+	before = console_headless_cells_written();
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_UP });
+	console_loop();
+	wrong_count += console_headless_cells_written() - before > 8 || console_headless_cursor().row != 0;
+
+	/* undoing puts the screen back */
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Z', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	wrong_count += !headless_test_row(0, "Hello, world!") + !headless_test_row(1, "Second");
+
+	/* the footer counts what's selected */
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'A', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	char footer[40] = { 0 };
+	for (int i = 0; i < (int)sizeof footer - 1; i++)
+		footer[i] = console_headless_cell(size.row - 1, 48 + i).ch;
+	wrong_count += strncmp(footer, "Selected: 21 chars, 3 words, 2 lines", 36) != 0;
+
+	/* a capital letter makes finding match case, so nothing is found */
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'F', .modifiers = MODIFIER_CONTROL });
+	console_headless_type("O\n");
+	console_loop();
+	wrong_count += console_headless_cursor().column != 7 || console_headless_cursor().row != 1;
+
+	/* finding selects the match after the cursor, wrapping around to the top */
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'F', .modifiers = MODIFIER_CONTROL });
+	console_headless_type("o\n");
+	console_loop();
+	wrong_count += console_headless_cursor().column != 5 || console_headless_cursor().row != 0;
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'N', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	wrong_count += console_headless_cursor().column != 9 || console_headless_cursor().row != 0;
+
+	/* replacing every match is undone and redone in one step */
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'R', .modifiers = MODIFIER_CONTROL });
+	console_headless_type("0\n");
+	console_loop();
+	wrong_count += !headless_test_row(0, "Hell0, w0rld!") + !headless_test_row(1, "Sec0nd");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Z', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	wrong_count += !headless_test_row(0, "Hello, world!") + !headless_test_row(1, "Second");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Y', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	wrong_count += !headless_test_row(0, "Hell0, w0rld!") + !headless_test_row(1, "Sec0nd");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Z', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+
+	/* regular expressions are found after the cursor and replaced the same way */
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'E', .modifiers = MODIFIER_CONTROL });
+	console_headless_type("w\\w+|^s\n");
+	console_loop();
+	wrong_count += console_headless_cursor().column != 1 || console_headless_cursor().row != 1;
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'R', .modifiers = MODIFIER_CONTROL });
+	console_headless_type("X\n");
+	console_loop();
+	wrong_count += !headless_test_row(0, "Hello, X!") + !headless_test_row(1, "Xecond");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Z', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	wrong_count += !headless_test_row(0, "Hello, world!") + !headless_test_row(1, "Second");
+
+	/* an edit made after undoing starts a branch, control B redoes along the next older one and redo stays on it */
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'A', .modifiers = MODIFIER_CONTROL });
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_RIGHT });
+	console_headless_type("A");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Z', .modifiers = MODIFIER_CONTROL });
+	console_headless_type("B");
+	console_loop();
+	wrong_count += !headless_test_row(1, "Second B");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Z', .modifiers = MODIFIER_CONTROL });
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'B', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	wrong_count += !headless_test_row(1, "Second A");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Z', .modifiers = MODIFIER_CONTROL });
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Y', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	wrong_count += !headless_test_row(1, "Second A");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'Z', .modifiers = MODIFIER_CONTROL });
+	console_loop();
+	wrong_count += !headless_test_row(1, "Second");
+
+	/* a new size loses the screen, so all of it is written */
+	console_headless_resize((coords_t) { .column = 40, .row = 10 });
+	before = console_headless_cells_written();
+	console_headless_push((console_event_t) { .type = EVENT_RESIZE });
+	console_loop();
+	wrong_count += console_headless_cells_written() - before != 40 * 10 || !headless_test_row(0, "Hello, world!");
+
+	/* the worker count is set from a prompt, ignoring what isn't a count */
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'T', .modifiers = MODIFIER_CONTROL });
+	console_headless_type("2\n");
+	console_headless_push((console_event_t) { .type = EVENT_KEY, .key = KEY_CHARACTER, .ch = 'T', .modifiers = MODIFIER_CONTROL });
+	console_headless_type("two\n");
+	console_loop();
+	wrong_count += thread_worker_count() != 2 || !headless_test_row(0, "Hello, world!");
+	printf("Headless console test resulted in %i mismatches.\n", wrong_count);
+
+	/* benchmark, cells written and time taken typing lines of text past the bottom of the screen */
+	console_headless_resize((coords_t) { .column = 120, .row = 40 });
+	console_headless_push((console_event_t) { .type = EVENT_RESIZE });
+	console_loop();
+	for (int i = 0; i < TEST_COUNT; i++)
+		console_headless_push((console_event_t) { .type = EVENT_KEY, .key = i % 60 == 59 ? KEY_RETURN : KEY_CHARACTER, .ch = (char)('a' + i % 26) });
+	before = console_headless_cells_written();
+	frames_before = console_headless_frames();
+	clock_t start = clock();
+	console_loop();
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	long long written = console_headless_cells_written() - before;
+	int frames = console_headless_frames() - frames_before;
+	printf("Typed %i keys in %.3fs over %i frames, %.1f cells written per frame of %i, worst latency %ims.\n",
+		TEST_COUNT, seconds, frames, (double)written / max(frames, 1), 120 * 40, console_headless_worst_latency());
+
+	/* benchmark, searching what was typed and replacing every match */
+	start = clock();
+	console_find("klmno");
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	start = clock();
+	console_replace_all("KLMNO");
+	printf("Found in %.3fs, replaced every match in %.3fs.\n", seconds, (double)(clock() - start) / CLOCKS_PER_SEC);
+
+	console_destroy();
+	return wrong_count;
+}
+
+#endif
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+/*
+	console_headless.h ~ RL
+
+	Terminal that only exists in memory, for tests and benchmarks. Built instead of the real one when CONSOLE_HEADLESS is defined
+*/
+
+#pragma once
+
+#include "console_platform.h"
+#include <stdbool.h>
+#include "util.h"
+
+/* sets the size of the screen, taking effect on the console's next frame */
+void console_headless_resize(coords_t size);
+/* queues an event for console_loop, which returns once every queued event is handled */
+void console_headless_push(console_event_t event);
+/* queues a key event for each character of text */
+void console_headless_type(const char* text);
+
+/* cell at row and column of the screen as it was last written */
+console_cell_t console_headless_cell(int row, int column);
+/* cursor as it was last presented */
+coords_t console_headless_cursor(void);
+/* count of cells written to the screen since the console was created */
+long long console_headless_cells_written(void);
+/* count of frames presented since the console was created */
+int console_headless_frames(void);
+/* most milliseconds between reading an event and presenting the frame that shows it */
+int console_headless_worst_latency(void);
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+	console_platform.h ~ RL
+
+	What the user interface needs from the terminal it runs in. Each console_****.c implements this for one
+	kind of terminal, console.c does everything else
+*/
+
+#pragma once
+
+#include "console.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+
+#define CONSOLE_CREATE_ATTRIBUTE(fg, bg)	((fg) | (bg) << 4)
+
+/* one character of the screen and its colors, use CONSOLE_GET_****GROUND macros on the attribute */
+typedef struct console_cell
+{
+	char ch;
+	unsigned char attribute;
+} console_cell_t;
+
+typedef enum console_key
+{
+	KEY_CHARACTER,
+	KEY_UP,
+	KEY_DOWN,
+	KEY_LEFT,
+	KEY_RIGHT,
+	KEY_DELETE,
+	KEY_BACKSPACE,
+	KEY_RETURN,
+	KEY_TAB,
+	KEY_ESCAPE,
+} console_key_t;
+
+typedef enum console_event_type
+{
+	EVENT_KEY,
+	EVENT_MOUSE,
+	EVENT_RESIZE,
+} console_event_type_t;
+
+#define MODIFIER_SHIFT		0x01
+#define MODIFIER_CONTROL	0x02
+
+typedef struct console_event
+{
+	console_event_type_t type;
+	int modifiers;
+	console_key_t key;
+	char ch;		/* character typed with KEY_CHARACTER, or the uppercase letter if control is held */
+	coords_t mouse;	/* cell of the screen the mouse is over */
+	bool pressed;	/* a mouse button is held */
+	bool moved;		/* the mouse moved, otherwise a button went down or up */
+} console_event_t;
+
+/* opens the terminal and sets size to its size in cells */
+bool console_platform_create(coords_t* size);
+/* puts the terminal back the way it was found */
+void console_platform_destroy(void);
+/* fits the screen to the window, setting size to the screen's size. Everything on screen is lost if it changes */
+bool console_platform_resize(coords_t* size);
+
+/* waits up to timeout milliseconds for input, returns whether there is some */
+bool console_platform_poll(int timeout);
+/* blocks until the next event, returns false if there is no more input */
+bool console_platform_read(console_event_t* event);
+
+/* writes count cells starting at row and column of the screen. They might not show until presented */
+bool console_platform_write(int row, int column, const console_cell_t* cells, int count);
+/* shows everything written and puts the cursor at row and column of the screen */
+bool console_platform_present(int row, int column);
+
+/* milliseconds since some point in the past */
+uint64_t console_platform_ticks(void);
+void console_platform_set_title(const char* title);
+/* asks the user for a file, calling callback with its path if one is picked */
+void console_platform_pick_file(bool does_file_exist, const char* initial, prompt_callback_t callback);
\ No newline at end of file
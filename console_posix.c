@@ -0,0 +1,433 @@
+/*
+	console_posix.c ~ RL
+
+	User interface - terminal implemented with termios and VT escape sequences
+*/
+
+#if !defined(_WIN32) && !defined(CONSOLE_HEADLESS)
+
+#include "console_platform.h"
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONSOLE_ESCAPE_DELAY	25 /* milliseconds an escape waits for the rest of its sequence before it's the escape key */
+#define CONSOLE_MAX_PARAMS		4
+#define CONSOLE_MAX_FONT		32
+
+static struct termios original_termios;
+static struct sigaction original_winch;
+static volatile sig_atomic_t resized;
+static coords_t size;
+
+static list_t output;	/* bytes since the last present, sent with one write */
+static int pen;			/* attribute the terminal draws with, -1 if unknown */
+
+static unsigned char pending[256]; /* bytes read but not parsed yet, as many as are waiting are read at once */
+static int pending_start, pending_end;
+static console_event_t parsed; /* event parsed while polling, handed out by the next read */
+static bool has_parsed;
+
+static list_t clipboard;
+static char font[CONSOLE_MAX_FONT] = "Terminal";
+
+static void console_emit(const char* str, int count)
+{
+	int start = list_count(output);
+	list_resize(output, start + count);
+	memcpy((char*)list_element_array(output) + start, str, count);
+}
+
+static void console_emitf(const char* fmt, ...)
+{
+	char temp[256];
+	va_list args;
+	va_start(args, fmt);
+	int count = vsnprintf(temp, sizeof temp, fmt, args);
+	va_end(args);
+	console_emit(temp, min(max(count, 0), (int)sizeof temp - 1));
+}
+
+/* writes everything emitted */
+static bool console_flush(void)
+{
+	const char* bytes = list_element_array(output);
+	int count = list_count(output), done = 0;
+	while (done < count)
+	{
+		ssize_t written = write(STDOUT_FILENO, bytes + done, count - done);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			break;
+		done += (int)written;
+	}
+	list_clear(output);
+	return done == count;
+}
+
+static void console_emit_base64(const char* str, size_t count)
+{
+	static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	for (size_t i = 0; i < count; i += 3)
+	{
+		unsigned int group = (unsigned char)str[i] << 16
+			| (i + 1 < count ? (unsigned char)str[i + 1] << 8 : 0)
+			| (i + 2 < count ? (unsigned char)str[i + 2] : 0);
+		char quad[4] =
+		{
+			digits[group >> 18], digits[group >> 12 & 0x3F],
+			i + 1 < count ? digits[group >> 6 & 0x3F] : '=',
+			i + 2 < count ? digits[group & 0x3F] : '='
+		};
+		console_emit(quad, sizeof quad);
+	}
+}
+
+bool console_clipboard(list_t str)
+{
+	assert(str != NULL && list_element_size(str) == sizeof(char));
+	if (!clipboard || list_count(clipboard) == 0)
+		return false;
+	list_t temp = list_create_with_array(list_element_array(clipboard), sizeof(char), list_count(clipboard));
+	list_push_primitive(temp, 0);
+	editor_format_raw(temp);
+	list_concat(str, temp, 0);
+	list_destroy(temp);
+	return true;
+}
+
+/* sets clipboard. Terminals can't be read from, so it's kept here too for pasting */
+bool console_set_clipboard(const char* str, size_t size)
+{
+	assert(str && clipboard);
+	int count = (int)strnlen(str, size);
+	list_resize(clipboard, count);
+	memcpy(list_element_array(clipboard), str, count);
+	/* OSC 52 puts it on the system clipboard, terminals that don't know it ignore it */
+	console_emit("\x1b]52;c;", 7);
+	console_emit_base64(str, count);
+	console_emit("\x07", 1);
+	return true;
+}
+
+const char* console_font(void)
+{
+	assert(console_is_created());
+	return font;
+}
+
+/* copies font name in console. The terminal picks its own font, it's only kept for the user's settings */
+void console_set_font(const char* _font)
+{
+	assert(console_is_created() && _font);
+	strncpy(font, _font, sizeof font - 1);
+}
+
+static void console_handle_winch(int signal)
+{
+	resized = 1;
+}
+
+static bool console_query_size(coords_t* out_size)
+{
+	struct winsize window;
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window) != 0 || window.ws_col == 0 || window.ws_row == 0)
+		return false;
+	*out_size = (coords_t){ .column = window.ws_col, .row = window.ws_row };
+	return true;
+}
+
+/* opens the terminal and sets size to its size in cells */
+bool console_platform_create(coords_t* out_size)
+{
+	if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &original_termios) != 0)
+		return false;
+	/* raw mode, every key comes through as it's pressed. Control C, S, V and Z are editor commands here */
+	struct termios raw = original_termios;
+	raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+	raw.c_oflag &= ~OPOST;
+	raw.c_cflag |= CS8;
+	raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+		return false;
+
+	/* no SA_RESTART, so a resize interrupts the read waiting for input and gets drawn */
+	struct sigaction winch = { .sa_handler = console_handle_winch };
+	sigemptyset(&winch.sa_mask);
+	sigaction(SIGWINCH, &winch, &original_winch);
+
+	if (!console_query_size(&size))
+		size = (coords_t){ .column = 80, .row = 24 };
+	*out_size = size;
+	output = list_create(sizeof(char));
+	clipboard = list_create(sizeof(char));
+	pen = -1;
+	pending_start = pending_end = 0;
+	has_parsed = false;
+
+	/* alternate screen, no line wrapping, mouse presses and drags reported in SGR form */
+	console_emitf("\x1b[?1049h\x1b[?7l\x1b[?1002h\x1b[?1006h\x1b[2J");
+	return console_flush();
+}
+
+/* puts the terminal back the way it was found */
+void console_platform_destroy(void)
+{
+	console_emitf("\x1b[0m\x1b[?1006l\x1b[?1002l\x1b[?7h\x1b[?1049l");
+	console_flush();
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, &original_termios);
+	sigaction(SIGWINCH, &original_winch, NULL);
+	list_destroy(output);
+	list_destroy(clipboard);
+	output = clipboard = NULL;
+}
+
+/* fits the screen to the window, setting size to the screen's size. Everything on screen is lost if it changes */
+bool console_platform_resize(coords_t* out_size)
+{
+	if (!resized)
+		return true;
+	resized = 0;
+	coords_t temp;
+	if (!console_query_size(&temp))
+		return false;
+	if (temp.column != size.column || temp.row != size.row)
+	{
+		size = temp;
+		*out_size = size;
+		pen = -1;
+		console_emitf("\x1b[0m\x1b[2J");
+	}
+	return true;
+}
+
+/* next byte of input, waiting up to timeout milliseconds for it or forever if it's negative. -1 if none came */
+static int console_next_byte(int timeout)
+{
+	errno = 0;
+	if (pending_start == pending_end)
+	{
+		struct pollfd input = { .fd = STDIN_FILENO, .events = POLLIN };
+		if (timeout >= 0 && poll(&input, 1, timeout) <= 0)
+			return -1;
+		ssize_t count = read(STDIN_FILENO, pending, sizeof pending);
+		if (count <= 0)
+			return -1;
+		pending_start = 0;
+		pending_end = (int)count;
+	}
+	return pending[pending_start++];
+}
+
+/* SGR mouse report, button has 32 added while dragging and 64 for the wheel */
+static bool console_parse_mouse(const int* params, bool pressed, console_event_t* event)
+{
+	int button = params[0];
+	if (button & 64)
+		return false;
+	event->type = EVENT_MOUSE;
+	event->mouse = (coords_t){ .column = params[1] - 1, .row = params[2] - 1 };
+	event->moved = button & 32;
+	event->pressed = pressed && (button & 3) != 3;
+	return true;
+}
+
+/* the rest of a sequence after an escape. Alone, it's the escape key */
+static bool console_parse_escape(console_event_t* event)
+{
+	int ch = console_next_byte(CONSOLE_ESCAPE_DELAY);
+	if (ch < 0)
+	{
+		event->key = KEY_ESCAPE;
+		return true;
+	}
+	if (ch != '[' && ch != 'O')
+		return false; /* alt with a key */
+
+	/* parameters are numbers separated by semicolons, the sequence ends with a byte from '@' to '~' */
+	int params[CONSOLE_MAX_PARAMS] = { 0 }, count = 1, final;
+	bool mouse = false;
+	while ((final = console_next_byte(CONSOLE_ESCAPE_DELAY)) >= 0 && (final < '@' || final > '~'))
+	{
+		if (final == '<')
+			mouse = true;
+		else if (final == ';')
+			count++;
+		else if (isdigit(final) && count <= CONSOLE_MAX_PARAMS)
+			params[count - 1] = params[count - 1] * 10 + final - '0';
+	}
+	if (mouse)
+		return (final == 'M' || final == 'm') && console_parse_mouse(params, final == 'M', event);
+
+	/* the second parameter is 1 plus 1 for shift, 2 for alt and 4 for control */
+	int modifiers = max(params[1] - 1, 0);
+	event->modifiers = (modifiers & 1 ? MODIFIER_SHIFT : 0) | (modifiers & 4 ? MODIFIER_CONTROL : 0);
+	switch (final)
+	{
+	case 'A':	event->key = KEY_UP;	return true;
+	case 'B':	event->key = KEY_DOWN;	return true;
+	case 'C':	event->key = KEY_RIGHT;	return true;
+	case 'D':	event->key = KEY_LEFT;	return true;
+	case '~':
+		event->key = KEY_DELETE;
+		return params[0] == 3;
+	case 'u':
+		/* keyboard protocol that tells control shift S apart from control S */
+		switch (params[0])
+		{
+		case '\r':	event->key = KEY_RETURN;	return true;
+		case '\t':	event->key = KEY_TAB;		return true;
+		case 0x7F:	event->key = KEY_BACKSPACE;	return true;
+		case 0x1B:	event->key = KEY_ESCAPE;	return true;
+		}
+		if (params[0] < ' ' || params[0] > '~')
+			return false;
+		event->key = KEY_CHARACTER;
+		event->ch = (char)(event->modifiers & MODIFIER_CONTROL ? toupper(params[0]) : params[0]);
+		return true;
+	}
+	return false;
+}
+
+/* turns the input starting with ch into an event, false if it isn't one that's handled */
+static bool console_parse_input(int ch, console_event_t* event)
+{
+	event->type = EVENT_KEY;
+	switch (ch)
+	{
+	case 0x1B:
+		return console_parse_escape(event);
+	case '\r':
+	case '\n':
+		event->key = KEY_RETURN;
+		return true;
+	case '\t':
+		event->key = KEY_TAB;
+		return true;
+	case 0x7F:
+	case '\b':
+		event->key = KEY_BACKSPACE;
+		return true;
+	}
+
+	event->key = KEY_CHARACTER;
+	if (ch < ' ')
+	{
+		/* control and a letter sends the letter with its top bits cleared */
+		event->modifiers = MODIFIER_CONTROL;
+		event->ch = (char)(ch + '@');
+	}
+	else
+		event->ch = (char)ch;
+	return true;
+}
+
+/* waits up to timeout milliseconds for input, returns whether there is some */
+bool console_platform_poll(int timeout)
+{
+	uint64_t deadline = console_platform_ticks() + timeout;
+	/* sequences that aren't handled don't count as input, so the next event is parsed to be sure there is one */
+	while (!has_parsed)
+	{
+		int64_t remaining = (int64_t)(deadline - console_platform_ticks());
+		int ch = console_next_byte((int)max(remaining, 0));
+		if (ch < 0)
+			return false;
+		parsed = (console_event_t){ 0 };
+		has_parsed = console_parse_input(ch, &parsed);
+	}
+	return true;
+}
+
+/* blocks until the next event, returns false if there is no more input */
+bool console_platform_read(console_event_t* event)
+{
+	if (has_parsed)
+	{
+		*event = parsed;
+		has_parsed = false;
+		return true;
+	}
+	for (;;)
+	{
+		*event = (console_event_t){ 0 };
+		int ch = console_next_byte(-1);
+		if (ch < 0 && resized)
+		{
+			event->type = EVENT_RESIZE;
+			return true;
+		}
+		else if (ch < 0 && errno != EINTR)
+			return false;
+		else if (ch >= 0 && console_parse_input(ch, event))
+			return true;
+	}
+}
+
+/* console colors are blue, green, red from the low bit up. ANSI's are red, green, blue */
+static int console_ansi_color(int color, int base)
+{
+	int rgb = (color & 1) << 2 | (color & 2) | (color & 4) >> 2;
+	return rgb + (color & 8 ? base + 60 : base);
+}
+
+/* writes count cells starting at row and column of the screen. They might not show until presented */
+bool console_platform_write(int row, int column, const console_cell_t* cells, int count)
+{
+	assert(output && column + count <= size.column && row < size.row);
+	console_emitf("\x1b[%i;%iH", row + 1, column + 1);
+	for (int i = 0; i < count; i++)
+	{
+		if (cells[i].attribute != pen)
+		{
+			pen = cells[i].attribute;
+			console_emitf("\x1b[%i;%im", console_ansi_color(CONSOLE_GET_FOREGROUND(pen), 30), console_ansi_color(CONSOLE_GET_BACKGROUND(pen), 40));
+		}
+		/* control characters would move the terminal's cursor, and lone bytes above ASCII aren't UTF-8 */
+		char ch = cells[i].ch;
+		if (ch < ' ' || ch > '~')
+			ch = ch < 0 ? '?' : ' ';
+		console_emit(&ch, 1);
+	}
+	return true;
+}
+
+/* shows everything written and puts the cursor at row and column of the screen */
+bool console_platform_present(int row, int column)
+{
+	console_emitf("\x1b[%i;%iH", row + 1, column + 1);
+	return console_flush();
+}
+
+/* milliseconds since some point in the past */
+uint64_t console_platform_ticks(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void console_platform_set_title(const char* title)
+{
+	console_emitf("\x1b]0;%s\x07", title);
+}
+
+/* asks the user for a file, calling callback with its path if one is picked. Terminals have no dialog, the path is typed */
+void console_platform_pick_file(bool does_file_exist, const char* initial, prompt_callback_t callback)
+{
+	console_prompt_user(does_file_exist ? "Open file: " : "Save as: ", callback);
+}
+
+#endif
\ No newline at end of file
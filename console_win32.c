@@ -1,129 +1,29 @@
 /*
 	console_win32.c ~ RL
 
-	User interface - implemented using the Win32 Console API
+	User interface - terminal implemented using the Win32 Console API
 */
 
-#include "console.h"
+#if defined(_WIN32) && !defined(CONSOLE_HEADLESS)
+
+#include "console_platform.h"
 #include <assert.h>
-#include "file.h"
-#include "user.h"
 #include <stdio.h>
+#include <string.h>
 #include <Windows.h>
 
-#define CONSOLE_CREATE_ATTRIBUTE(fg, bg)	((fg) | (bg) << 4)
-#define CONSOLE_INVERT_ATTRIBUTE(attrib)	(((attrib) >> 4) | (((attrib) << 4) & 0xF0))
-#define CONSOLE_DEFAULT_ATTRIBUTE			(1 << 9)
-#define CONSOLE_DEFAULT_CHAR				(1 << 17)
-#define CONSOLE_MAX_PROMPT_LEN				80
-
-typedef int attribute_t;
-static attribute_t user_attribute = CONSOLE_CREATE_ATTRIBUTE(COLOR_LIGHT_GRAY, COLOR_BLACK);
-static attribute_t footer_attribute = CONSOLE_CREATE_ATTRIBUTE(COLOR_WHITE, COLOR_DARK_GRAY);
-
 static HANDLE input, output;
 static COORD size;
-static CHAR_INFO* buffer;
-static coords_t cursor, camera;
-static list_t lines;
-static const char* footer_message;
+static CHAR_INFO* run;	/* cells being written, converted for WriteConsoleOutputA */
+static int run_size;
 
-static file_details_t current_file;
-static char dir_buf[MAX_PATH];
+#define CONSOLE_INPUT_BATCH 128 /* records read at once */
 
-static list_t actions;
-static list_t undid_actions;
-
-static bool selecting;
-static coords_t selection_begin;
-
-static int prompt_len;
-static prompt_callback_t callback;
-static list_t prev_lines;
-static coords_t prev_cursor;
+static console_event_t events[CONSOLE_INPUT_BATCH]; /* converted from the last records read and not handled yet */
+static int event_next, event_count;
 
 static CONSOLE_FONT_INFOEX font_info = { .cbSize = sizeof font_info, .nFont = 0, .dwFontSize.X = 0, .dwFontSize.Y = 12, .FontFamily = FF_DONTCARE, .FontWeight = FW_NORMAL };
 
-/* re-renders the screen */
-static bool console_invalidate(void);
-
-/* pauses application to ask user with prompt, calls callback when done and frees string passed after. */
-void console_prompt_user(const char* prompt, prompt_callback_t _callback)
-{
-	assert(console_is_created());
-	prev_lines = lines;
-	lines = list_create(sizeof(line_t));
-	line_t line = { .string = list_create_with_array(prompt, sizeof(char), (int)strnlen(prompt, CONSOLE_MAX_PROMPT_LEN)) };
-	LIST_PUSH(lines, line);
-
-	prompt_len = list_count(line.string);
-	callback = _callback;
-	prev_cursor = cursor;
-
-	selecting = false;
-	console_move_cursor((coords_t) { .column = list_count(line.string) });
-}
-
-/*	pauses application to ask user with prompt and series of possible choices.
-	prompt is a string delimited by a newline. First line is the question, other lines are choices. */
-void console_prompt_user_mc(const char* prompt, prompt_callback_t _callback)
-{
-	assert(console_is_created());
-	prev_lines = lines;
-	lines = editor_create_lines();
-	coords_t temp = (coords_t){ 0 };
-	editor_add_raw(lines, prompt, &temp);
-
-	/* inline choices */
-	for (int i = 1; i < list_count(lines); i++)
-	{
-		temp = (coords_t){ .column = 0, .row = i };
-		editor_add_tab(lines, &temp);
-	}
-
-	console_move_cursor((coords_t) { .row = 1, .column = TAB_SIZE });
-
-	prompt_len = list_count(LIST_GET(lines, 0, line_t)->string);
-	callback = _callback;
-	prev_cursor = cursor;
-	selecting = false;
-}
-
-bool console_is_created(void)
-{
-	return !!output;
-}
-
-const file_details_t console_file(void)
-{
-	assert(console_is_created());
-	return current_file;
-}
-
-list_t console_lines(void)
-{
-	assert(console_is_created());
-	return lines;
-}
-
-coords_t console_cursor(void)
-{
-	assert(console_is_created());
-	return cursor;
-}
-
-list_t console_actions(void)
-{
-	assert(console_is_created());
-	return actions;
-}
-
-list_t console_undid_actions(void)
-{
-	assert(console_is_created());
-	return undid_actions;
-}
-
 bool console_clipboard(list_t str)
 {
 	assert(str != NULL && list_element_size(str) == sizeof(char));
@@ -145,60 +45,6 @@ bool console_clipboard(list_t str)
 	return true;
 }
 
-/* returns bitmask of console's colors. use CONSOLE_GET_****GROUND macros to extract what you need */
-int console_colors(void)
-{
-	assert(console_is_created());
-	return user_attribute;
-}
-
-const char* console_font(void)
-{
-	assert(console_is_created());
-	static char res[LF_FACESIZE];
-	assert(WideCharToMultiByte(CP_ACP, MB_ERR_INVALID_CHARS, font_info.FaceName, -1, res, 32, NULL, NULL) != 0);
-	return res;
-}
-
-/* copies font name in console */
-void console_set_font(const char* _font)
-{
-	assert(console_is_created() && _font);
-	if (!DEBUG_ON_FAILURE(MultiByteToWideChar(CP_ACP, MB_ERR_INVALID_CHARS, _font, -1, font_info.FaceName, 32) != 0))
-		return;
-	DEBUG_ON_FAILURE(SetCurrentConsoleFontEx(output, FALSE, &font_info));
-}
-
-static void console_set_title(const char* directory)
-{
-	char title_buf[128];
-	char file_buf[128];
-	file_get_name(directory, file_buf, sizeof file_buf);
-	snprintf(title_buf, sizeof title_buf, "Journal - %s", file_buf);
-	DEBUG_ON_FAILURE(SetConsoleTitleA(title_buf));
-}
-
-/* set console's file details. File details are copied on the console's end */
-void console_set_file_details(const file_details_t details)
-{
-	assert(details.directory && details.lines && list_element_size(details.lines) == sizeof(line_t));
-	for (int i = 0; i < list_count(details.lines); i++)
-		assert(LIST_GET(details.lines, i, line_t)->string && list_element_size(LIST_GET(details.lines, i, line_t)->string) == sizeof(char));
-
-	editor_destroy_lines(current_file.lines);
-	list_clear(current_file.lines);
-	list_concat(lines, details.lines, 0);
-	console_move_cursor((coords_t) { 0, 0 });
-
-	console_set_title(details.directory);
-
-	strncpy(dir_buf, details.directory, sizeof dir_buf);
-	current_file.directory = dir_buf;
-	current_file.type = details.type;
-
-	selecting = false;
-}
-
 /* sets clipboard */
 bool console_set_clipboard(const char* str, size_t size)
 {
@@ -219,42 +65,25 @@ bool console_set_clipboard(const char* str, size_t size)
 	return true;
 }
 
-/* set color and foreground of console */
-void console_set_color(color_t foreground, color_t background)
+const char* console_font(void)
 {
 	assert(console_is_created());
-	user_attribute = CONSOLE_CREATE_ATTRIBUTE(foreground, background);
-	DEBUG_ON_FAILURE(console_invalidate());
-}
-
-static void console_destroy_interface(void)
-{
-	input = NULL;
-	CloseHandle(output);
-	output = NULL;
-	FreeConsole();
-}
-
-static void console_destroy_physical(void)
-{
-	editor_destroy_lines(lines);
-	list_destroy(lines);
-
-	console_clear_buffer();
-	list_destroy(actions);
-	list_destroy(undid_actions);
+	static char res[LF_FACESIZE];
+	assert(WideCharToMultiByte(CP_ACP, MB_ERR_INVALID_CHARS, font_info.FaceName, -1, res, 32, NULL, NULL) != 0);
+	return res;
 }
 
-/* destroys the console */
-void console_destroy(void)
+/* copies font name in console */
+void console_set_font(const char* _font)
 {
-	if (!console_is_created())
+	assert(console_is_created() && _font);
+	if (!DEBUG_ON_FAILURE(MultiByteToWideChar(CP_ACP, MB_ERR_INVALID_CHARS, _font, -1, font_info.FaceName, 32) != 0))
 		return;
-	console_destroy_interface();
-	console_destroy_physical();
+	DEBUG_ON_FAILURE(SetCurrentConsoleFontEx(output, FALSE, &font_info));
 }
 
-static bool console_create_interface(void)
+/* opens the terminal and sets size to its size in cells */
+bool console_platform_create(coords_t* out_size)
 {
 	AllocConsole();
 	HANDLE temp_input = GetStdHandle(STD_INPUT_HANDLE);
@@ -288,37 +117,29 @@ static bool console_create_interface(void)
 		CloseHandle(temp_output);
 		return false;
 	}
-	COORD temp_size = csbi.dwSize;
-	int buffer_size = sizeof * buffer * temp_size.X * temp_size.Y;
-	CHAR_INFO* temp_buffer = journal_malloc(buffer_size);
-	memset(temp_buffer, 0, buffer_size);
 
 	input = temp_input;
 	output = temp_output;
-	buffer = temp_buffer;
-	size = temp_size;
+	size = csbi.dwSize;
+	*out_size = (coords_t){ .column = size.X, .row = size.Y };
 	return true;
 }
 
-/* destroys the console if it is created then creates the console */
-bool console_create(void)
+/* puts the terminal back the way it was found */
+void console_platform_destroy(void)
 {
-	if (console_is_created())
-		console_destroy();
-	if (!console_create_interface())
-		return false;
-
-	lines = editor_create_lines();
-	actions = list_create(sizeof(action_t));
-	undid_actions = list_create(sizeof(action_t));
-
-	current_file.lines = lines;
-
-	DEBUG_ON_FAILURE(console_invalidate()); /* If it fails to draw, then it's not really an initialization problem like one might expect from a false return value */
-	return true;
+	input = NULL;
+	CloseHandle(output);
+	output = NULL;
+	free(run);
+	run = NULL;
+	run_size = 0;
+	event_next = event_count = 0;
+	FreeConsole();
 }
 
-static bool console_handle_potential_resize(void)
+/* fits the screen to the window, setting size to the screen's size. Everything on screen is lost if it changes */
+bool console_platform_resize(coords_t* out_size)
 {
 	/* resize buffer to window */
 	CONSOLE_SCREEN_BUFFER_INFOEX csbi = { .cbSize = sizeof csbi };
@@ -329,11 +150,8 @@ static bool console_handle_potential_resize(void)
 	csbi.dwSize = (COORD){ csbi.srWindow.Right + 1, csbi.srWindow.Bottom + 1 };
 	if (!SetConsoleScreenBufferInfoEx(output, &csbi))
 		return false;
-	CHAR_INFO* temp = journal_malloc(sizeof * temp * csbi.dwSize.X * csbi.dwSize.Y);
-	memset(temp, 0, sizeof * temp * csbi.dwSize.X * csbi.dwSize.Y);
-	free(buffer);
-	buffer = temp;
 	size = csbi.dwSize;
+	*out_size = (coords_t){ .column = size.X, .row = size.Y };
 
 	/* remove scrollbar */
 	CONSOLE_FONT_INFO cfi;
@@ -344,771 +162,149 @@ static bool console_handle_potential_resize(void)
 	return DEBUG_ON_FAILURE(SetWindowPos(GetConsoleWindow(), NULL, 0, 0, fitted.right - fitted.left, fitted.bottom - fitted.top, SWP_NOMOVE));
 }
 
-static bool console_paste_selection(void)
-{
-	list_t str = list_create(sizeof(char));
-	if (!console_clipboard(str))
-	{
-		list_destroy(str);
-		return false;
-	}
-
-	editor_add_raw(lines, list_element_array(str), &cursor);
-	console_move_cursor(editor_overflow_cursor(lines, (coords_t) { .column = cursor.column + 1, .row = cursor.row }));
-	list_destroy(str);
-	return true;
-}
-
-static char* console_open_file_dialog(bool does_file_exist)
-{
-	static char buf[MAX_PATH];
-
-	OPENFILENAMEA settings =
-	{
-		/* OFN_DONTADDTORECENT ~ Plain text files can be opened by anyone, but compressed and encrypted can't. This wouldn't make sense for those files */
-		.Flags =			OFN_DONTADDTORECENT | (does_file_exist ? (OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST) : 0),
-		.lStructSize =		sizeof settings,
-		.lpstrFilter =		"Journal Text Files (.txt, .dmc, .aes)\0*.txt;*.dmc;*.aes\0\0",
-		.nFilterIndex =		1,
-		.lpstrInitialDir =	current_file.directory,
-		.lpstrFile =		buf,
-		.nMaxFile =			sizeof buf,
-	};
-	if (!GetOpenFileNameA(&settings))
-		return NULL;
-	return buf;
-}
-
-/* copies to clipboard -- has nothing to add to an action buffer */
-bool console_copy(void)
-{
-	assert(console_is_created());
-	if (!selecting)
-		return true;
-	list_t str = list_create(sizeof(char));
-	console_copy_selection_string(str);
-	return console_set_clipboard(list_element_array(str), list_count(str));
-}
-
-static inline void console_commit_action(action_t action)
-{
-	LIST_PUSH(actions, action);
-	list_clear(undid_actions);
-}
-
-/* pastes from clipboard to current position */
-bool console_paste(void)
-{
-	assert(console_is_created());
-	bool was_selecting = selecting;
-	if (selecting)
-		console_delete_selection();
-	coords_t prev = cursor;
-	list_t str = list_create(sizeof(char));
-	if (!console_clipboard(str) || !console_paste_selection())
-	{
-		list_destroy(str);
-		return false;
-	}
-	char* str_copy = journal_malloc(list_count(str));
-	strncpy(str_copy, list_element_array(str), list_count(str));
-	list_destroy(str);
-	console_commit_action((action_t) 
-	{
-		.coupled = was_selecting,
-		.cursor = prev,
-		.start = prev,
-		.end = editor_overflow_cursor(lines, (coords_t) { .column = cursor.column - 1, .row = cursor.row }),
-		.did_remove = false,
-		.str = str_copy
-	});
-	return true;
-}
-
-static void console_generic_do(bool direction, action_t* out)
-{
-	assert(console_is_created());
-	list_t buffer = direction ? undid_actions : actions, other = direction ? actions : undid_actions;
-	if (list_count(buffer) <= 0)
-		return;
-
-	int other_add = list_count(other);
-	action_t head, curr;
-	list_pop(buffer, &head);
-	curr = head;
-	do
-	{
-		/* true for redo */
-		bool adjusted = direction ? curr.did_remove : !curr.did_remove;
-		if (adjusted)
-			editor_delete_region(lines, curr.start, curr.end);
-		else
-		{
-			coords_t temp = curr.start;
-			editor_add_raw(lines, curr.str, &temp);
-		}
-		console_move_cursor(curr.cursor);
-		LIST_ADD(other, curr, other_add);
-	} while (curr.coupled && (list_pop(buffer, &curr), true));
-	if (out)
-		*out = head;
-}
-
-/* puts action to undo in out (IF NOT NULL) and then undoes it */
-void console_undo(action_t* out)
-{
-	assert(console_is_created());
-	console_generic_do(false, out);
-}
-
-/* redoes last undo and puts that action in out (IF NOT NULL) */
-void console_redo(action_t* out)
-{
-	assert(console_is_created());
-	console_generic_do(true, out);
-}
-
-#define CONSOLE_COLOR_CHOICES "Black\nDark blue\nDark green\nDark cyan\nDark red\nDark purple\nDark yellow\nLight gray\nDark gray\nLight blue\nLight green\nLight cyan\nLight red\nLight purple\nLight yellow\nWhite"
-
-static color_t foreground;
-
-static inline color_t console_to_color(const char* color)
-{
-	/*	trailing new line because response_curr needs to be equal to 0; but if the user picks the last option, 
-		response_curr will advance past that NUL terminator since choice_curr ends in that too */
-	const char* choice_curr = CONSOLE_COLOR_CHOICES "\n";
-	int i;
-	for (i = 0; i < 16; i++)
-	{
-		const char* response_curr = color;
-		while (*choice_curr != '\n')
-		{
-			if (*choice_curr++ == *response_curr)
-				response_curr++;
-		}
-		choice_curr++;
-		if (*response_curr == '\0')
-			break;
-	}
-	assert(i < 16);
-	return (color_t)i;
-}
-
-static void console_handle_background(const char* response)
-{
-	user_t user = user_get_latest();
-	user.background = console_to_color(response);
-	user.foreground = foreground;
-	DEBUG_ON_FAILURE(user_save(user));
-	user_attribute = CONSOLE_CREATE_ATTRIBUTE(foreground, user.background);
-}
-
-static void console_handle_foreground(const char* response)
-{
-	foreground = console_to_color(response);
-	console_prompt_user_mc("Background color:\n" CONSOLE_COLOR_CHOICES, console_handle_background);
-}
-
-static void console_handle_font(const char* response)
-{
-	console_set_font(response);
-	user_t user = user_get_latest();
-	strncpy(user.font, response, sizeof user.font);
-	DEBUG_ON_FAILURE(user_save(user));
-}
-
-static bool console_handle_control_event(int ch, bool shifting)
-{
-	switch (ch)
-	{
-	case 'C':
-		return console_copy();
-	case 'V':
-		return console_paste();
-	case 'Y':
-		console_redo(NULL);
-		break;
-	case 'Z':
-		console_undo(NULL);
-		break;
-	case 'P':
-		console_prompt_user("Enter password: ", file_set_password);
-		break;
-	case 'U':
-		console_prompt_user_mc("Text color:\n" CONSOLE_COLOR_CHOICES, console_handle_foreground);
-		break;
-	case 'G':
-		console_prompt_user("Font: ", console_handle_font);
-		break;
-
-	case 'A':
-		selecting = true;
-		selection_begin = (coords_t){ 0, 0 };
-		console_move_cursor((coords_t) { list_count(LIST_GET(lines, list_count(lines) - 1, line_t)->string), list_count(lines) - 1 });
-		break;
-
-	case 'O':
-		char* buf = console_open_file_dialog(true);
-		if (!buf)
-			return true;
-		file_details_t details = file_open(buf);
-		if (IS_BAD_DETAILS(details))
-		{
-			footer_message = "Failed to open file.";
-			return false;
-		}
-		console_set_file_details(details);
-		
-		coords_t last_cursor = { 0 };
-		list_t saves = user_get_latest().file_saves;
-		for (int i = 0; i < list_count(saves); i++)
-		{
-			file_save_t* save = LIST_GET(saves, i, file_save_t);
-			if (strncmp(save->directory, buf, MAX_PATH) == 0)
-				last_cursor = save->cursor;
-		}
-		if (editor_is_valid_cursor(lines, last_cursor))
-			console_move_cursor(last_cursor);
-		else
-			debug_format("Invalid cursor placement saved to user file.\n");
-		footer_message = "Opened file.";
-		return true;
-
-	case 'S':
-		if (!current_file.directory || shifting)
-		{
-			const char* dir = console_open_file_dialog(false);
-			if (!dir)
-				return true;
-			current_file.type = file_extension_to_type(dir);
-			strncpy(dir_buf, dir, MAX_PATH);
-			current_file.directory = dir_buf;
-			console_set_title(current_file.directory);
-		}
-		debug_format("Saving file \"%s\" with type %i.\n", current_file.directory, current_file.type);
-		bool result = DEBUG_ON_FAILURE(user_save_file((file_save_t) { .directory = current_file.directory, .cursor = cursor })) &&
-			DEBUG_ON_FAILURE(file_save(current_file));
-		footer_message = "Saved file.";
-		if (!result)
-			footer_message = "Failed to save file.";
-		return result;
-	}
-	return true;
-}
-
-/* handles an arrow key action */
-void console_arrow_key(bool shifting, int dc, int dr)
-{
-	assert(console_is_created());
-	coords_t new_cursor = cursor, begin, end;
-	if (shifting && !selecting)
-	{
-		selection_begin = cursor;
-		selecting = true;
-	}
-	else if (!shifting && console_get_selection_region(&begin, &end))
-	{
-		selecting = false;
-		if (dc < 0 || dr < 0)
-			new_cursor = begin;
-		else
-			new_cursor = end;
-	}
-	new_cursor = editor_overflow_cursor(lines, (coords_t) { .column = new_cursor.column + dc, .row = new_cursor.row });
-	/* increment after overflow, otherwise if the line is too short, it will overflow into another row */
-	new_cursor.row += dr;
-	console_move_cursor(new_cursor);
-}
-
-static void console_act_delete_selection(void)
-{
-	coords_t start, end, prev = cursor;
-	list_t str = list_create(sizeof(char));
-	console_get_selection_region(&start, &end);
-	console_copy_selection_string(str);
-	console_delete_selection();
-
-	char* str_copy = journal_malloc(list_count(str));
-	strncpy(str_copy, (char*)list_element_array(str), list_count(str));
-	list_destroy(str);
-	action_t action = { .cursor = prev, .start = start, .end = end, .did_remove = true, .str = str_copy };
-	console_commit_action(action);
-}
-
-static void console_act_delete_char(coords_t prev)
-{
-	char newline = '\n';
-	char* deleted = LIST_GET(LIST_GET(lines, cursor.row, line_t)->string, cursor.column, char);
-	if (!deleted)
-		deleted = &newline;
-
-	line_t* line = LIST_GET(lines, cursor.row, line_t);
-	if (cursor.column == list_count(line->string) && cursor.row + 1 < list_count(lines))
-	{
-		list_concat(line->string, LIST_GET(lines, cursor.row + 1, line_t)->string, list_count(line->string));
-		list_remove(lines, cursor.row + 1);
-	}
-	else
-		list_remove(((line_t*)LIST_GET(lines, cursor.row, line_t))->string, cursor.column);
-
-	char* deleted_copy = journal_malloc(sizeof(char) * 2);
-	deleted_copy[0] = *deleted;
-	deleted_copy[1] = '\0';
-	action_t action = { .cursor = prev, .start = cursor, .end = cursor, .did_remove = true, .str = deleted_copy };
-	console_commit_action(action);
-}
-
-/* handles a DEL key command */
-void console_delete(void)
-{
-	assert(console_is_created());
-	if (selecting)
-		console_act_delete_selection();
-	else if (cursor.column < list_count(LIST_GET(lines, cursor.row, line_t)->string) || cursor.row + 1 < list_count(lines))
-		console_act_delete_char(cursor);
-}
-
-/* handles a BKSPC key command */
-void console_backspace(void)
-{
-	assert(console_is_created());
-	coords_t start = cursor;
-	if (selecting)
-		console_act_delete_selection();
-	else if (cursor.column != 0 || cursor.row != 0)
-	{
-		cursor = editor_overflow_cursor(lines, (coords_t) { .column = cursor.column - 1, .row = cursor.row });
-		console_act_delete_char(start);
-	}
-}
-
-/* handles an enter/return key command */
-void console_return(void)
-{
-	assert(console_is_created());
-	if (selecting)
-		console_act_delete_selection();
-	else
-	{
-		char* newline = journal_malloc(sizeof(char) * 2);
-		newline[0] = '\n';
-		newline[1] = '\0';
-		coords_t end = (coords_t){ 0, cursor.row + 1 };
-		action_t action = { .cursor = cursor, .did_remove = false, .start = cursor, .end = cursor, .str = newline };
-		editor_add_newline(lines, cursor);
-		console_move_cursor(end);
-		console_commit_action(action);
-	}
-}
-
-/* handles a tab key command */
-void console_tab(void)
-{
-	assert(console_is_created());
-	if (selecting)
-		console_act_delete_selection();
-	coords_t start = cursor, end = start;
-	int tabc = TAB_SIZE - cursor.column % TAB_SIZE;
-	char* tab_str = journal_malloc(tabc + 1);
-	memset(tab_str, ' ', tabc);
-	tab_str[tabc] = '\0';
-	editor_add_raw(lines, tab_str, &end);
-
-	console_move_cursor(end);
-	action_t action = { .cursor = start, .did_remove = false, .start = start, .end = end, .str = tab_str };
-	console_commit_action(action);
-}
-
-/* handles adding a character */
-void console_character(int ch)
-{
-	assert(console_is_created());
-	bool was_selecting = selecting;
-	if (selecting)
-		console_act_delete_selection();
-	coords_t start = cursor;
-	if (ch == '\n')
-		editor_add_newline(lines, cursor);
-	LIST_ADD(LIST_GET(lines, cursor.row, line_t)->string, (char)ch, cursor.column);
-	console_move_cursor((coords_t) { cursor.column + 1, cursor.row });
-	char* str = journal_malloc(sizeof(char) * 2);
-	str[0] = (char)ch;
-	str[1] = '\0';
-	action_t action = { .cursor = start, .did_remove = false, .start = start, .end = start, .str = str, .coupled = was_selecting };
-	console_commit_action(action);
-}
-
-static bool console_handle_key_event(KEY_EVENT_RECORD ker)
+static bool console_convert_key(KEY_EVENT_RECORD ker, console_event_t* event)
 {
 	if (!ker.bKeyDown)
-		return true;
-
-	bool result = true;
+		return false;
+	event->type = EVENT_KEY;
+	event->modifiers = (ker.dwControlKeyState & SHIFT_PRESSED ? MODIFIER_SHIFT : 0)
+		| (ker.dwControlKeyState & (LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED) ? MODIFIER_CONTROL : 0);
 	switch (ker.wVirtualKeyCode)
 	{
-	case VK_LCONTROL:
-	case VK_RCONTROL:
-	case VK_CONTROL:
-		result = true;
-		break;
-
-	case VK_DOWN:
-	case VK_UP:
-		console_arrow_key(ker.dwControlKeyState & SHIFT_PRESSED, 0, ker.wVirtualKeyCode - 0x27);
-		break;
-	case VK_RIGHT:
-	case VK_LEFT:
-		console_arrow_key(ker.dwControlKeyState & SHIFT_PRESSED, ker.wVirtualKeyCode - 0x26, 0);
-		break;
-	case VK_DELETE:
-		console_delete();
-		break;
-	case VK_BACK:
-		console_backspace();
-		break;
-	case VK_RETURN:
-		console_return();
-		break;
-	case VK_TAB:
-		console_tab();
-		break;
+	case VK_UP:		event->key = KEY_UP;		break;
+	case VK_DOWN:	event->key = KEY_DOWN;		break;
+	case VK_LEFT:	event->key = KEY_LEFT;		break;
+	case VK_RIGHT:	event->key = KEY_RIGHT;		break;
+	case VK_DELETE:	event->key = KEY_DELETE;	break;
+	case VK_BACK:	event->key = KEY_BACKSPACE;	break;
+	case VK_RETURN:	event->key = KEY_RETURN;	break;
+	case VK_TAB:	event->key = KEY_TAB;		break;
+	case VK_ESCAPE:	event->key = KEY_ESCAPE;	break;
 
 	default:
 		if (!ker.uChar.AsciiChar)
-			break; /* a virtual key code we don't handle */
-		if (ker.dwControlKeyState & (LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED))
-			result = console_handle_control_event(ker.wVirtualKeyCode, ker.dwControlKeyState & SHIFT_PRESSED);
-		else
-			console_character(ker.uChar.AsciiChar);
-		break;
-	}
-
-	if (!(ker.dwControlKeyState & (SHIFT_PRESSED | LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED)) && selecting)
-		selecting = false;
-	return result;
-}
-
-static void console_handle_mouse_event(MOUSE_EVENT_RECORD mer)
-{ 
-	static bool mouse_state = false;
-	if (mer.dwEventFlags == 0) /* mouse down or up */
-	{
-		mouse_state = mer.dwButtonState != 0;
-		if (mouse_state) /* mouse down event */
-		{
-			console_move_cursor((coords_t) { mer.dwMousePosition.X + camera.column, mer.dwMousePosition.Y + camera.row });
-			selection_begin = cursor;
-		}
-	}
-	if (mouse_state && mer.dwEventFlags == MOUSE_MOVED)
-	{
-		selecting = true;
-		console_move_cursor((coords_t) { mer.dwMousePosition.X + camera.column, mer.dwMousePosition.Y + camera.row });
-	}
-}
-
-static bool console_handle_mcq_prompt(INPUT_RECORD record)
-{
-	switch (record.EventType)
-	{
-	case KEY_EVENT:
-	{
-		if (!record.Event.KeyEvent.bKeyDown)
-			break;
-
-		int vk = record.Event.KeyEvent.wVirtualKeyCode;
-		if (vk == VK_UP || vk == VK_DOWN)
-			console_arrow_key(false, 0, vk - 0x27);
-		else if (vk == VK_LEFT || vk == VK_RIGHT)
-			console_arrow_key(false, vk - 0x26, 0);
-		else if (vk == VK_RETURN && cursor.row != 0) /* row 0 = the question line */
-		{
-			/* delete choices beyond the one selected */
-			editor_delete_region(lines, (coords_t) 
-			{ 
-				.column = list_count(LIST_GET(lines, cursor.row, line_t)->string), 
-				.row = cursor.row 
-			}, (coords_t) 
-			{ 
-				.column = list_count(LIST_GET(lines, list_count(lines) - 1, line_t)->string) - 1,
-				.row = list_count(lines) - 1
-			});
-			/* delete choices before but keep the prompt */
-			editor_delete_region(lines, (coords_t) { .column = prompt_len, .row = 0 }, (coords_t) { .column = TAB_SIZE - 1, .row = cursor.row });
-			return true;
-		}
-		break;
-	}
-	case MOUSE_EVENT:
-		console_handle_mouse_event(record.Event.MouseEvent);
-		selecting = false;
+			return false; /* a virtual key code we don't handle */
+		event->key = KEY_CHARACTER;
+		/* with control held, the character is a control code. The virtual key code is the letter */
+		event->ch = event->modifiers & MODIFIER_CONTROL ? (char)ker.wVirtualKeyCode : ker.uChar.AsciiChar;
 		break;
 	}
-	return false;
+	return true;
 }
 
-static bool console_handle_response_prompt(INPUT_RECORD record)
+static bool console_convert_mouse(MOUSE_EVENT_RECORD mer, console_event_t* event)
 {
-	switch (record.EventType)
-	{
-	case KEY_EVENT:
-	{
-		DEBUG_ON_FAILURE(console_handle_key_event(record.Event.KeyEvent));
-		if (record.Event.KeyEvent.wVirtualKeyCode == VK_RETURN)
-			list_remove(lines, cursor.row); /* remove new line */
-		break;
-	}
-	case MOUSE_EVENT:
-		console_handle_mouse_event(record.Event.MouseEvent);
-		break;
-	}
-
-	cursor.column = max(cursor.column, prompt_len);
-	selection_begin.column = max(selection_begin.column, prompt_len);
-	return cursor.row >= 1;
+	if (mer.dwEventFlags != 0 && mer.dwEventFlags != MOUSE_MOVED)
+		return false; /* double clicks and the wheel */
+	event->type = EVENT_MOUSE;
+	event->mouse = (coords_t){ .column = mer.dwMousePosition.X, .row = mer.dwMousePosition.Y };
+	event->pressed = mer.dwButtonState != 0;
+	event->moved = mer.dwEventFlags == MOUSE_MOVED;
+	return true;
 }
 
-/* returns once user escapes */
-void console_loop(void)
+/* reads every record waiting, or blocks for the next one if there are none, and keeps the ones that are events */
+static bool console_read_records(void)
 {
-	INPUT_RECORD record = { 0 };
+	INPUT_RECORD records[CONSOLE_INPUT_BATCH];
 	DWORD read;
-
-	while (ReadConsoleInputA(input, &record, 1, &read)
-		&& (record.EventType != KEY_EVENT || record.Event.KeyEvent.wVirtualKeyCode != VK_ESCAPE))
-	{
-		assert(read == 1);
-		DEBUG_ON_FAILURE(console_handle_potential_resize());
-
-		if (callback)
+	if (!ReadConsoleInputA(input, records, CONSOLE_INPUT_BATCH, &read))
+		return false;
+	event_next = event_count = 0;
+	for (DWORD i = 0; i < read; i++)
+	{
+		console_event_t* event = &events[event_count];
+		*event = (console_event_t){ 0 };
+		if ((records[i].EventType == KEY_EVENT && console_convert_key(records[i].Event.KeyEvent, event))
+			|| (records[i].EventType == MOUSE_EVENT && console_convert_mouse(records[i].Event.MouseEvent, event)))
+			event_count++;
+		else if (records[i].EventType == WINDOW_BUFFER_SIZE_EVENT)
 		{
-			/* if prompting the user a multiple choice, list count will always be > 1 */
-			if (((list_count(lines) <= 1 && console_handle_response_prompt(record))
-				|| (list_count(lines) > 1 && console_handle_mcq_prompt(record))))
-			{
-				list_t str = list_create(sizeof(char));
-				editor_copy_all_lines(lines, str);
-				editor_destroy_lines(lines);
-				list_destroy(lines);
-				lines = prev_lines;
-				console_move_cursor(prev_cursor);
-				prev_lines = NULL;
-
-				prompt_callback_t curr = callback;
-				curr((char*)list_element_array(str) + prompt_len);
-				list_destroy(str);
-
-				if (curr == callback)
-					callback = NULL;
-			}
+			event->type = EVENT_RESIZE;
+			event_count++;
 		}
-		else if (record.EventType == KEY_EVENT)
-			DEBUG_ON_FAILURE(console_handle_key_event(record.Event.KeyEvent));
-		else if (record.EventType == MOUSE_EVENT)
-			console_handle_mouse_event(record.Event.MouseEvent);
-
-		console_invalidate();
 	}
+	return true;
 }
 
-/* returns false if there is no selection, otherwise sets pointers to cursor positions */
-bool console_get_selection_region(coords_t* begin, coords_t* end)
+/* waits up to timeout milliseconds for input, returns whether there is some */
+bool console_platform_poll(int timeout)
 {
-	assert(console_is_created());
-	if (selection_begin.row > cursor.row || (selection_begin.row == cursor.row && selection_begin.column > cursor.column))
-	{
-		*begin = cursor;
-		*end = selection_begin;
-	}
-	else
+	ULONGLONG deadline = GetTickCount64() + timeout;
+	/* key releases and the like signal the handle too, but they aren't events */
+	while (event_next == event_count)
 	{
-		*begin = selection_begin;
-		*end = cursor;
+		ULONGLONG now = GetTickCount64();
+		if (WaitForSingleObject(input, now < deadline ? (DWORD)(deadline - now) : 0) != WAIT_OBJECT_0 || !console_read_records())
+			return false;
 	}
-	bool is_selecting = selection_begin.row != cursor.row || selection_begin.column != cursor.column;
-	*end = editor_overflow_cursor(lines, (coords_t) { .column = end->column - 1, .row = end->row });
-	return selecting && is_selecting;
+	return true;
 }
 
-/* sets contents of assumed empty list "str" to the contents of the selection */
-void console_copy_selection_string(list_t str)
+/* blocks until the next event, returns false if there is no more input */
+bool console_platform_read(console_event_t* event)
 {
-	assert(console_is_created() && str != NULL && list_count(str) == 0);
-	coords_t begin_coords, end_coords;
-	if (!console_get_selection_region(&begin_coords, &end_coords))
+	while (event_next == event_count)
 	{
-		list_push_primitive(str, 0);
-		return;
+		if (!console_read_records())
+			return false;
 	}
-	editor_copy_region(lines, str, begin_coords, end_coords);
-}
-
-/* deletes contents of selection */
-void console_delete_selection(void)
-{
-	assert(console_is_created());
-	coords_t begin, end;
-	if (!console_get_selection_region(&begin, &end))
-		return;
-
-	editor_delete_region(lines, begin, end);
-	selecting = false;
-	console_move_cursor(begin);
-}
-
-/* clears action buffer entirely */
-void console_clear_buffer(void)
-{
-	for (int i = 0; i < list_count(actions); i++)
-		free(LIST_GET(actions, i, action_t)->str);
-	for (int i = 0; i < list_count(undid_actions); i++)
-		free(LIST_GET(undid_actions, i, action_t)->str);
-	list_clear(actions);
-	list_clear(undid_actions);
-}
-
-/*
-	RENDER
-*/
-
-static inline bool console_is_point_renderable(coords_t coords)
-{
-	return camera.column <= coords.column && camera.column + size.X > coords.column &&
-		camera.row <= coords.row && camera.row + size.Y > coords.row;
-}
-
-static inline CHAR_INFO* console_get_cell(int row, int col)
-{
-	SHORT tx = (SHORT)(col - camera.column), ty = (SHORT)(row - camera.row);
-	assert(tx + ty * size.X < (size.X * size.Y));
-	return &buffer[tx + ty * size.X];
-}
-
-static inline void console_set_cell(int row, int col, attribute_t attrib, int ch)
-{
-	if (!console_is_point_renderable((coords_t) { col, row }))
-		return;
-	if (attrib != CONSOLE_DEFAULT_ATTRIBUTE)	console_get_cell(row, col)->Attributes = attrib;
-	if (ch != CONSOLE_DEFAULT_CHAR)				console_get_cell(row, col)->Char.AsciiChar = ch;
-}
-
-static inline void console_draw_line(int row, attribute_t attrib)
-{
-	const line_t* line = (line_t*)list_get(lines, row);
-	if (!line)
-		return;
-	for (int col = camera.column; col < min(camera.column + size.X, list_count(line->string)); col++)
-		console_set_cell(row, col, attrib, *LIST_GET(line->string, col, char));
-}
-
-static inline void console_fill_line(int row, attribute_t attrib, int ch)
-{
-	for (int col = camera.column; col < camera.column + size.X; col++)
-		console_set_cell(row, col, attrib, ch);
-}
-
-static void console_set_stringf(int row, int col, attribute_t attrib, const char* fmt, ...)
-{
-	static char temp[1024];
-	va_list args;
-	va_start(args, fmt);
-	vsnprintf(temp, sizeof temp, fmt, args);
-	va_end(args);
-
-	char* str = temp;
-	for (; *str; str++, col++)
-		console_set_cell(row, col, attrib, *str);
+	*event = events[event_next++];
+	return true;
 }
 
-static inline void console_draw_footer(void)
+/* writes count cells starting at row and column of the screen. They might not show until presented */
+bool console_platform_write(int row, int column, const console_cell_t* cells, int count)
 {
-	console_fill_line(camera.row + size.Y - 1, footer_attribute, ' ');
-	console_set_stringf(camera.row + size.Y - 1, camera.column + 00, footer_attribute, "Cursor: (%i, %i)", cursor.column + 1, cursor.row + 1);
-	console_set_stringf(camera.row + size.Y - 1, camera.column + 24, footer_attribute, "Camera: (%i, %i)", camera.column + 1, camera.row + 1);
-	if (selecting)
+	assert(column + count <= size.X && row < size.Y);
+	if (count > run_size)
 	{
-		static list_t buf;
-		if (!buf)
-			buf = list_create(sizeof(char));
-		list_clear(buf);
-		console_copy_selection_string(buf);
-		console_set_stringf(camera.row + size.Y - 1, camera.column + 48, footer_attribute, "Characters selected: %i", list_count(buf) - 1); /* -1 for NUL character */
-	}
-	if (footer_message)
-	{
-		console_set_stringf(camera.row + size.Y - 1, camera.column + 80, footer_attribute, "%s", footer_message);
-		footer_message = NULL;
+		CHAR_INFO* temp = journal_malloc(sizeof * temp * size.X);
+		free(run);
+		run = temp;
+		run_size = size.X;
 	}
+	for (int i = 0; i < count; i++)
+		run[i] = (CHAR_INFO){ .Char.AsciiChar = cells[i].ch, .Attributes = cells[i].attribute };
+	SMALL_RECT region = (SMALL_RECT){ (SHORT)column, (SHORT)row, (SHORT)(column + count - 1), (SHORT)row };
+	return WriteConsoleOutputA(output, run, (COORD) { (SHORT)count, 1 }, (COORD) { 0, 0 }, &region);
 }
 
-static void console_draw_selection(attribute_t attrib)
+/* shows everything written and puts the cursor at row and column of the screen */
+bool console_platform_present(int row, int column)
 {
-	coords_t begin, end;
-	if (console_get_selection_region(&begin, &end))
-		attrib = CONSOLE_INVERT_ATTRIBUTE(attrib);
-	else
-		return;
-	int first_line_end;
-	if (begin.row != end.row)
-	{
-		first_line_end = list_count(LIST_GET(lines, begin.row, line_t)->string);
-		for (int i = begin.row + 1; i < end.row; i++)
-		{
-			console_draw_line(i, attrib);
-			console_set_cell(i, list_count(LIST_GET(lines, i, line_t)->string), attrib, CONSOLE_DEFAULT_CHAR);
-		}
-		for (int i = 0; i <= end.column; i++)
-			console_set_cell(end.row, i, attrib, CONSOLE_DEFAULT_CHAR);
-	}
-	else
-		first_line_end = end.column;
-
-	for (int i = begin.column; i <= first_line_end; i++)
-		console_set_cell(begin.row, i, attrib, CONSOLE_DEFAULT_CHAR);
+	return SetConsoleCursorPosition(output, (COORD) { (SHORT)column, (SHORT)row });
 }
 
-static inline bool console_write_buffer(void)
+/* milliseconds since some point in the past */
+uint64_t console_platform_ticks(void)
 {
-	SMALL_RECT region = (SMALL_RECT){ 0, 0, size.X - 1, size.Y - 1 };
-	return WriteConsoleOutputA(output, buffer, size, (COORD) { 0, 0 }, &region) 
-		&& SetConsoleCursorPosition(output, (COORD) { (SHORT)(cursor.column - camera.column), (SHORT)(cursor.row - camera.row) });
+	return GetTickCount64();
 }
 
-/* physically moves cursor */
-void console_move_cursor(coords_t coords)
+void console_platform_set_title(const char* title)
 {
-	assert(console_is_created());
-	coords.row = min(max(0, coords.row), list_count(lines) - 1);
-	coords.column = min(max(0, coords.column), list_count(LIST_GET(lines, coords.row, line_t)->string));
-	if (!console_is_point_renderable(coords) || coords.row >= camera.row + size.Y - 1) /* accounting for footer */
-	{
-		if (camera.column > coords.column)
-			camera.column = coords.column;
-		else if (camera.column + size.X <= coords.column)
-			camera.column = coords.column - size.X + 1;
-
-		if (camera.row > coords.row)
-			camera.row = coords.row;
-		else if (camera.row + size.Y - 1 <= coords.row)
-			camera.row = coords.row - size.Y + 2;
-	}
-	cursor = coords;
+	DEBUG_ON_FAILURE(SetConsoleTitleA(title));
 }
 
-/* re-renders the screen */
-static bool console_invalidate(void)
+/* asks the user for a file, calling callback with its path if one is picked */
+void console_platform_pick_file(bool does_file_exist, const char* initial, prompt_callback_t callback)
 {
-	assert(console_is_created());
-	for (int row = camera.row; row < camera.row + size.Y - 1; row++)
-	{
-		console_fill_line(row, user_attribute, ' ');
-		console_draw_line(row, user_attribute);
-	}
+	static char buf[MAX_PATH];
 
-	coords_t temp;
-	if (console_get_selection_region(&temp, &temp))
-		console_draw_selection(user_attribute);
-	console_draw_footer();
+	OPENFILENAMEA settings =
+	{
+		/* OFN_DONTADDTORECENT ~ Plain text files can be opened by anyone, but compressed and encrypted can't. This wouldn't make sense for those files */
+		.Flags =			OFN_DONTADDTORECENT | (does_file_exist ? (OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST) : 0),
+		.lStructSize =		sizeof settings,
+		.lpstrFilter =		"Journal Text Files (.txt, .dmc, .aes)\0*.txt;*.dmc;*.aes\0\0",
+		.nFilterIndex =		1,
+		.lpstrInitialDir =	initial,
+		.lpstrFile =		buf,
+		.nMaxFile =			sizeof buf,
+	};
+	if (GetOpenFileNameA(&settings))
+		callback(buf);
+}
 
-	return console_write_buffer();
-}
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,684 @@
+/*
+	dmc.c ~ RL
+
+	Dynamic Markov Compression with a compact, index-linked model
+*/
+
+#include "dmc.h"
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+#include "stream.h"
+#include "thread.h"
+
+/*	https://webhome.cs.uvic.ca/~nigelh/Publications/DMC.pd
+	https://web.archive.org/web/20070630111546/http://plg.uwaterloo.ca/~ftp/dmc/dmc.c */
+
+#define BIT_COUNT		CHAR_BIT
+#define STRANDS			(1 << BIT_COUNT)
+#define BRAID_COUNT		(STRANDS * STRANDS)
+#define MIN_CNT1		2 /* Minimum "number of observed transitions from the current state to the candidate state" in order to clone */
+#define MIN_CNT2		2 /* Minimum "number of observed transitions from all states other than the current state to the candidate state" in order to clone */
+#define CLONE_COUNT		0x80000
+#define CLONE_LIMIT		(CLONE_COUNT - 20) /* model is flushed once this many clones are made, matching the original encoder */
+
+static const char dmc_header[3] = { 0xDD, 0x17, 0xCC };
+static const char dmc_blocks_header[3] = { 0xDD, 0x17, 0xCB };
+
+/*	The block format is laid out as:
+		header[3], version[1], block size[4]
+		then for every block: original size[4], compressed size[4], stream[compressed size]
+		and a last block with both sizes 0
+	Each block is coded with a freshly braided model, so blocks can be compressed
+	and decompressed independently on the worker threads, a batch at a time. */
+
+#define DMC_BLOCKS_VERSION		2
+#define DMC_BLOCKS_OFFSET		(sizeof dmc_blocks_header + CHAR_SIZE + INT_SIZE)
+#define DMC_FRAME_SIZE			(INT_SIZE * 2)
+#define DMC_MAX_STREAM(length)	((length) + (length) / 4 + 16) /* compressed size no valid block gets near */
+
+/*	Nodes live in one arena and link to each other by index, so a node is 16 bytes instead of 24
+	and the braid and the clones share one allocation. Counts stay floats: the coder's interval
+	splits depend on their exact rounding, and the stream has to match files already on disk. */
+struct dmc_node
+{
+	float count[2];		/* how many transistions occured out of this state */
+	uint32_t next[2];	/* arena index of next node(s) in tree */
+};
+
+struct dmc_state
+{
+	uint32_t curr, clone_count;
+	struct dmc_node* nodes; /* BRAID_COUNT braid nodes, strand by strand, followed by CLONE_COUNT clones */
+};
+
+/*	As described in the paper, the "braid" structure is best suited
+	for byte-oriented data as it better remembers details between bytes.
+	So, it's best to use it for a word processor. */
+static void dmc_predictor_braid(struct dmc_state* state)
+{
+	for (uint32_t j = 0; j < STRANDS; j++)
+	{
+		struct dmc_node* strand = state->nodes + j * STRANDS;
+
+		/* 1-7th bit */
+		for (uint32_t i = 0; i < STRANDS / 2 - 1; i++)
+		{
+			strand[i].count[0] = 0.2F;
+			strand[i].count[1] = 0.2F;
+			strand[i].next[0] = j * STRANDS + 2 * i + 1;
+			strand[i].next[1] = j * STRANDS + 2 * i + 2;
+		}
+
+		/* 8th bit */
+		for (uint32_t i = STRANDS / 2 - 1; i < STRANDS - 1; i++)
+		{
+			strand[i].count[0] = 0.2F;
+			strand[i].count[1] = 0.2F;
+			strand[i].next[0] = (i + 1) * STRANDS;
+			strand[i].next[1] = (i - (STRANDS / 2 - 1)) * STRANDS;
+		}
+	}
+	state->clone_count = 0;
+	state->curr = 0;
+}
+
+static void dmc_predictor_init(struct dmc_state* state)
+{
+	state->nodes = journal_malloc(sizeof * state->nodes * (BRAID_COUNT + CLONE_COUNT));
+	dmc_predictor_braid(state);
+}
+
+static void dmc_predictor_destroy(struct dmc_state* state)
+{
+	free(state->nodes);
+	state->nodes = NULL;
+}
+
+/* returns chance for interval */
+static float dmc_predictor(const struct dmc_state* state)
+{
+	const struct dmc_node* p = &state->nodes[state->curr];
+	return p->count[0] / (p->count[0] + p->count[1]);
+}
+
+static void dmc_predictor_update(struct dmc_state* state, bool bit)
+{
+	int i = (int)!!bit;
+	struct dmc_node* p = &state->nodes[state->curr];
+	struct dmc_node* next = &state->nodes[p->next[i]];
+	if (p->count[i] >= MIN_CNT1
+		&& next->count[0] + next->count[1] >= MIN_CNT2 + p->count[i])
+	{
+		uint32_t index = BRAID_COUNT + state->clone_count++;
+		struct dmc_node* new = &state->nodes[index];
+		float r = p->count[i] / (next->count[1] + next->count[0]);
+		new->count[0] = next->count[0] * r;
+		new->count[1] = next->count[1] * r;
+		next->count[0] -= new->count[0];
+		next->count[1] -= new->count[1];
+		new->next[0] = next->next[0];
+		new->next[1] = next->next[1];
+		p->next[i] = index;
+	}
+	p->count[i]++;
+	state->curr = p->next[i];
+	if (state->clone_count > CLONE_LIMIT)
+	{
+		debug_format("Ran out of predictor memory, flushing...\n");
+		dmc_predictor_braid(state);
+	}
+}
+
+#undef max
+#undef min
+
+/* codes size bytes and appends the stream, without a header, to out. Returns compressed size */
+static int dmc_encode(const char* buf, int size, list_t out)
+{
+	struct dmc_state state;
+	dmc_predictor_init(&state);
+
+	/* interval variables */
+	int max = 0x1000000,
+		min = 0,
+		mid;
+
+	int in_bytes = 0,
+		out_bytes = 0,
+		pout = out_bytes; /* output position when the last 256 bytes were checked for a poorly fitting model */
+
+	for (int i = 0; i < size; i++)
+	{
+		for (int j = 0; j < BIT_COUNT; j++)
+		{
+			bool bit = ((int)buf[i] << j) & 0x80;
+			mid = (int)(min + (max - min - 1) * dmc_predictor(&state));
+			dmc_predictor_update(&state, bit);
+			if (mid == min)
+				mid++;
+			if (mid == (max - 1))
+				mid--;
+			if (bit)
+				min = mid;
+			else
+				max = mid;
+
+			while ((max - min) < 0x100)
+			{
+				if (bit)
+					max--;
+				LIST_PUSH_PRIMITIVE(out, min >> 16);
+				out_bytes++;
+				min = (min << 8) & 0xFFFF00;
+				max = (max << 8) & 0xFFFF00;
+				if (min >= max)
+					max = 0x1000000;
+			}
+		}
+
+		if (!(++in_bytes & 0xFF))
+		{
+			if (out_bytes - pout > 0x100)
+				dmc_predictor_braid(&state);
+			pout = out_bytes;
+		}
+	}
+
+	min = max - 1;
+	LIST_PUSH_PRIMITIVE(out, min >> 16);
+	LIST_PUSH_PRIMITIVE(out, (min >> 8) & 0xFF);
+	LIST_PUSH_PRIMITIVE(out, min & 0xFF);
+
+	dmc_predictor_destroy(&state);
+	return out_bytes + 3;
+}
+
+/*	decodes a stream without a header and appends it to out. count is the original size,
+	or -1 to decode until the stream runs out, which is all the single stream format can do */
+static bool dmc_decode(const uint8_t* buf, int size, int count, list_t out)
+{
+	if (size < 3)
+		return false;
+
+	struct dmc_state state;
+	dmc_predictor_init(&state);
+
+	int max = 0x1000000,
+		min = 0,
+		mid;
+
+	int in_bytes = 0,
+		out_bytes = 0,
+		pin = in_bytes; /* input position when the last 256 bytes were checked for a poorly fitting model */
+
+	int val = (buf[0] << 16) + (buf[1] << 8) + buf[2];
+	for (int i = 3; count < 0 ? i < size : out_bytes < count; )
+	{
+		int ch = 0;
+		for (int j = 0; j < BIT_COUNT; j++)
+		{
+			mid = (int)(min + (max - min - 1) * dmc_predictor(&state));
+			if (mid == min)
+				mid++;
+			if (mid == (max - 1))
+				mid--;
+			bool bit = false;
+			if (val >= mid)
+			{
+				bit = true;
+				min = mid;
+			}
+			else
+				max = mid;
+			dmc_predictor_update(&state, bit);
+			ch = (ch << 1) + bit;
+			while ((max - min) < 0x100)
+			{
+				if (bit)
+					max--;
+				in_bytes++;
+				int nxt = i < size ? buf[i] : 0;
+				i++;
+				val = ((val << 8) & 0xFFFF00) | nxt;
+				min = (min << 8) & 0xFFFF00;
+				max = (max << 8) & 0xFFFF00;
+				if (min >= max)
+					max = 0x1000000;
+			}
+		}
+		char c = (char)ch;
+		LIST_PUSH(out, c);
+		if (!(++out_bytes & 0xFF))
+		{
+			if (in_bytes - pin > 0x100)
+				dmc_predictor_braid(&state);
+			pin = in_bytes;
+		}
+	}
+
+	dmc_predictor_destroy(&state);
+	return true;
+}
+
+/* a batch of blocks, compressed or decompressed together on the worker threads */
+struct dmc_blocks
+{
+	int count, capacity;
+	const char* in;		/* input when compressing, blocks back to back */
+	int block_size;
+	int* lengths;		/* original size of every block */
+	int* sizes;			/* compressed size of every block */
+	list_t* inputs;		/* compressed input of every block when decompressing */
+	list_t* results;	/* output of every block */
+};
+
+static void dmc_compress_block(void* ctx, int index)
+{
+	struct dmc_blocks* blocks = ctx;
+	list_clear(blocks->results[index]);
+	const char* in = blocks->in + (long)index * blocks->block_size;
+	blocks->sizes[index] = dmc_encode(in, blocks->lengths[index], blocks->results[index]);
+}
+
+static void dmc_decompress_block(void* ctx, int index)
+{
+	struct dmc_blocks* blocks = ctx;
+	list_t input = blocks->inputs[index];
+	list_clear(blocks->results[index]);
+	if (!dmc_decode(list_element_array(input), list_count(input), blocks->lengths[index], blocks->results[index]))
+		list_clear(blocks->results[index]);
+}
+
+static void dmc_blocks_create(struct dmc_blocks* blocks, int capacity, int block_size)
+{
+	*blocks = (struct dmc_blocks){ .capacity = capacity, .block_size = block_size };
+	blocks->lengths = journal_malloc(sizeof * blocks->lengths * capacity);
+	blocks->sizes = journal_malloc(sizeof * blocks->sizes * capacity);
+	blocks->inputs = journal_malloc(sizeof * blocks->inputs * capacity);
+	blocks->results = journal_malloc(sizeof * blocks->results * capacity);
+	for (int i = 0; i < capacity; i++)
+	{
+		blocks->inputs[i] = list_create(sizeof(char));
+		blocks->results[i] = list_create(sizeof(char));
+	}
+}
+
+static void dmc_blocks_destroy(struct dmc_blocks* blocks)
+{
+	for (int i = 0; i < blocks->capacity; i++)
+	{
+		list_destroy(blocks->inputs[i]);
+		list_destroy(blocks->results[i]);
+	}
+	free(blocks->lengths);
+	free(blocks->sizes);
+	free(blocks->inputs);
+	free(blocks->results);
+}
+
+struct dmc_reader
+{
+	int version;		/* 0 until the header is read, -1 for the single stream format */
+	bool ended;			/* no blocks left in source */
+	int block_size;
+	struct dmc_blocks batch;
+	int block, pos;		/* block of the batch being read out and position in it */
+};
+
+static void dmc_reader_free(void* state)
+{
+	struct dmc_reader* reader = state;
+	if (reader->version != 0)
+		dmc_blocks_destroy(&reader->batch);
+	free(reader);
+}
+
+/* the single stream format has no sizes, so it's read and decoded whole */
+static bool dmc_read_single_stream(struct dmc_reader* reader, reader_t source)
+{
+	list_t input = reader->batch.inputs[0];
+	char buf[STREAM_BUFFER_SIZE];
+	int count;
+	while ((count = reader_read(source, buf, sizeof buf)) > 0)
+	{
+		int start = list_count(input);
+		list_resize(input, start + count);
+		memcpy((char*)list_element_array(input) + start, buf, count);
+	}
+	reader->ended = true;
+	reader->batch.count = 1;
+	return count == 0 && dmc_decode(list_element_array(input), list_count(input), -1, reader->batch.results[0]);
+}
+
+static bool dmc_read_header(struct dmc_reader* reader, reader_t source)
+{
+	char header[DMC_BLOCKS_OFFSET];
+	if (reader_read_full(source, header, sizeof dmc_header) != sizeof dmc_header)
+		return false;
+	if (memcmp(header, dmc_header, sizeof dmc_header) == 0)
+	{
+		reader->version = -1;
+		dmc_blocks_create(&reader->batch, 1, 0);
+		return dmc_read_single_stream(reader, source);
+	}
+	if (memcmp(header, dmc_blocks_header, sizeof dmc_blocks_header) != 0
+		|| reader_read_full(source, header + sizeof dmc_header, DMC_BLOCKS_OFFSET - sizeof dmc_header) != DMC_BLOCKS_OFFSET - sizeof dmc_header)
+		return false;
+
+	read_int(header, sizeof dmc_blocks_header + CHAR_SIZE, sizeof header, &reader->block_size);
+	if (header[sizeof dmc_blocks_header] != DMC_BLOCKS_VERSION || reader->block_size < DMC_MIN_BLOCK_SIZE)
+		return false;
+	reader->version = DMC_BLOCKS_VERSION;
+	dmc_blocks_create(&reader->batch, thread_worker_count(), reader->block_size);
+	return true;
+}
+
+/* reads the next batch of blocks and decompresses them */
+static bool dmc_read_batch(struct dmc_reader* reader, reader_t source)
+{
+	struct dmc_blocks* batch = &reader->batch;
+	batch->count = 0;
+	reader->block = 0;
+	reader->pos = 0;
+	while (batch->count < batch->capacity)
+	{
+		int length, size;
+		char frame[DMC_FRAME_SIZE];
+		if (reader_read_full(source, frame, sizeof frame) != sizeof frame)
+			return false;
+		read_int(frame, 0, sizeof frame, &length);
+		read_int(frame, INT_SIZE, sizeof frame, &size);
+		if (length == 0 && size == 0)
+		{
+			reader->ended = true;
+			break;
+		}
+		if (length <= 0 || length > reader->block_size || size < 3 || size > DMC_MAX_STREAM(reader->block_size))
+			return false;
+
+		list_t input = batch->inputs[batch->count];
+		list_resize(input, size);
+		if (reader_read_full(source, list_element_array(input), size) != size)
+			return false;
+		batch->lengths[batch->count++] = length;
+	}
+	if (batch->count < batch->capacity)
+		reader->ended = true;
+
+	thread_run_jobs(dmc_decompress_block, batch, batch->count);
+	for (int i = 0; i < batch->count; i++)
+	{
+		if (list_count(batch->results[i]) != batch->lengths[i])
+			return false;
+	}
+	return true;
+}
+
+static int dmc_reader_read(void* state, reader_t source, char* buf, int size)
+{
+	struct dmc_reader* reader = state;
+	if (reader->version == 0 && !dmc_read_header(reader, source))
+		return -1;
+	for (;;)
+	{
+		if (reader->block < reader->batch.count)
+		{
+			list_t result = reader->batch.results[reader->block];
+			int remaining = list_count(result) - reader->pos;
+			int count = remaining < size ? remaining : size;
+			if (count > 0)
+			{
+				memcpy(buf, (char*)list_element_array(result) + reader->pos, count);
+				reader->pos += count;
+				return count;
+			}
+			reader->block++;
+			reader->pos = 0;
+			continue;
+		}
+		if (reader->ended)
+			return 0;
+		if (!dmc_read_batch(reader, source))
+			return -1;
+	}
+}
+
+/* creates reader that decompresses either format as source is read */
+reader_t dmc_reader_create(reader_t source)
+{
+	assert(source);
+	struct dmc_reader* reader = journal_malloc(sizeof * reader);
+	*reader = (struct dmc_reader){ 0 };
+	return reader_create(dmc_reader_read, dmc_reader_free, reader, source);
+}
+
+struct dmc_writer
+{
+	bool header_written;
+	list_t input;		/* bytes waiting to be compressed, at most one batch */
+	struct dmc_blocks batch;
+};
+
+static void dmc_writer_free(void* state)
+{
+	struct dmc_writer* writer = state;
+	list_destroy(writer->input);
+	dmc_blocks_destroy(&writer->batch);
+	free(writer);
+}
+
+/* compresses everything waiting and writes it out as blocks */
+static bool dmc_write_batch(struct dmc_writer* writer, writer_t sink)
+{
+	struct dmc_blocks* batch = &writer->batch;
+	if (!writer->header_written)
+	{
+		char header[DMC_BLOCKS_OFFSET];
+		memcpy(header, dmc_blocks_header, sizeof dmc_blocks_header);
+		header[sizeof dmc_blocks_header] = DMC_BLOCKS_VERSION;
+		store_int(header, sizeof dmc_blocks_header + CHAR_SIZE, sizeof header, batch->block_size);
+		writer->header_written = true;
+		if (!writer_write(sink, header, sizeof header))
+			return false;
+	}
+
+	int size = list_count(writer->input);
+	batch->in = list_element_array(writer->input);
+	batch->count = (size + batch->block_size - 1) / batch->block_size;
+	for (int i = 0; i < batch->count; i++)
+	{
+		int remaining = size - i * batch->block_size;
+		batch->lengths[i] = remaining < batch->block_size ? remaining : batch->block_size;
+	}
+	thread_run_jobs(dmc_compress_block, batch, batch->count);
+
+	for (int i = 0; i < batch->count; i++)
+	{
+		char frame[DMC_FRAME_SIZE];
+		store_int(frame, 0, sizeof frame, batch->lengths[i]);
+		store_int(frame, INT_SIZE, sizeof frame, batch->sizes[i]);
+		if (!writer_write(sink, frame, sizeof frame)
+			|| !writer_write(sink, list_element_array(batch->results[i]), batch->sizes[i]))
+			return false;
+	}
+	list_clear(writer->input);
+	return true;
+}
+
+static bool dmc_writer_write(void* state, writer_t sink, const char* buf, int size)
+{
+	struct dmc_writer* writer = state;
+	int capacity = writer->batch.capacity * writer->batch.block_size;
+	while (size > 0)
+	{
+		if (list_count(writer->input) == capacity && !dmc_write_batch(writer, sink))
+			return false;
+		int start = list_count(writer->input);
+		int count = capacity - start < size ? capacity - start : size;
+		list_resize(writer->input, start + count);
+		memcpy((char*)list_element_array(writer->input) + start, buf, count);
+		buf += count;
+		size -= count;
+	}
+	return true;
+}
+
+static bool dmc_writer_close(void* state, writer_t sink)
+{
+	struct dmc_writer* writer = state;
+	if (!dmc_write_batch(writer, sink))
+		return false;
+	char frame[DMC_FRAME_SIZE] = { 0 };
+	return writer_write(sink, frame, sizeof frame);
+}
+
+/* creates writer that compresses blocks of block_size bytes, a batch at a time on the worker threads */
+writer_t dmc_writer_create(writer_t sink, int block_size)
+{
+	assert(sink && block_size >= DMC_MIN_BLOCK_SIZE);
+	struct dmc_writer* writer = journal_malloc(sizeof * writer);
+	*writer = (struct dmc_writer){ .input = list_create(sizeof(char)) };
+	dmc_blocks_create(&writer->batch, thread_worker_count(), block_size);
+	return writer_create(dmc_writer_write, dmc_writer_close, dmc_writer_free, writer, sink);
+}
+
+/* whether buf starts with the compressed header */
+bool dmc_is_compressed(const char* buf, int size)
+{
+	return size >= sizeof dmc_header
+		&& (memcmp(buf, dmc_header, sizeof dmc_header) == 0 || memcmp(buf, dmc_blocks_header, sizeof dmc_blocks_header) == 0);
+}
+
+/* decompresses a stream written by any of the compress functions, appending the original bytes to out */
+bool dmc_decompress(const char* buf, int size, list_t out)
+{
+	assert(buf && out && list_element_size(out) == sizeof(char));
+	reader_t reader = dmc_reader_create(reader_create_memory(buf, size));
+	int start = list_count(out), count;
+	do
+	{
+		int end = list_count(out);
+		list_resize(out, end + STREAM_BUFFER_SIZE);
+		count = reader_read(reader, (char*)list_element_array(out) + end, STREAM_BUFFER_SIZE);
+		list_resize(out, end + (count > 0 ? count : 0));
+	} while (count > 0);
+	reader_destroy(reader);
+
+	if (count < 0)
+	{
+		list_resize(out, start);
+		return false;
+	}
+	debug_format("Opened file compressed with Dynamic Markov Compression, in: %i, out: %i\n", size, list_count(out) - start);
+	return true;
+}
+
+/* compresses size bytes as a single stream, appending header and compressed stream to out */
+bool dmc_compress(const char* buf, int size, list_t out)
+{
+	assert((buf || size == 0) && out && list_element_size(out) == sizeof(char));
+
+	LIST_PUSH(out, dmc_header[0]);
+	LIST_PUSH(out, dmc_header[1]);
+	LIST_PUSH(out, dmc_header[2]);
+	int out_bytes = dmc_encode(buf, size, out) + sizeof dmc_header;
+
+	debug_format("Compressed file with Dynamic Markov Compression, in: %i, out: %i\n", size, out_bytes);
+	return true;
+}
+
+/* compresses size bytes in independent blocks of block_size bytes, spread across the worker threads */
+bool dmc_compress_blocks(const char* buf, int size, int block_size, list_t out)
+{
+	assert((buf || size == 0) && out && list_element_size(out) == sizeof(char));
+	int start = list_count(out);
+	writer_t writer = dmc_writer_create(writer_create_list(out), block_size);
+	bool result = writer_write(writer, buf, size) && writer_close(writer);
+	writer_destroy(writer);
+	debug_format("Compressed file with Dynamic Markov Compression, in: %i, out: %i\n", size, list_count(out) - start);
+	return result;
+}
+
+#ifdef TEST
+#ifdef DMC_TEST
+#include <stdio.h>
+#include <time.h>
+
+/* wall clock, clock() would add up the time of every worker thread */
+static double dmc_seconds(void)
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* benchmarks compression ratio and speed against block size, using the file at argv[1] or generated text */
+int main(int argc, char** argv)
+{
+	long size = 0;
+	char* buf = NULL;
+	if (argc > 1)
+	{
+		FILE* file = fopen(argv[1], "rb");
+		if (!file || !(buf = read_all_file(file, &size)))
+			return 1;
+		fclose(file);
+	}
+	else
+	{
+		static const char* words[] = { "the", "journal", "of", "a", "day", "and", "it", "was", "quiet", "rain", "morning", "wrote", "to", "in", "we" };
+		size = 0x800000;
+		buf = journal_malloc(size);
+		srand(1);
+		for (long i = 0; i < size; )
+		{
+			const char* word = words[rand() % (sizeof words / sizeof * words)];
+			while (*word && i < size)
+				buf[i++] = *word++;
+			if (i < size)
+				buf[i++] = rand() % 12 ? ' ' : '\n';
+		}
+	}
+
+	int failures = 0;
+	printf("%i bytes, %i threads\n", (int)size, thread_worker_count());
+	int block_sizes[] = { 0, 0x400000, 0x100000, 0x40000, 0x10000 };
+	for (int i = 0; i < sizeof block_sizes / sizeof * block_sizes; i++)
+	{
+		list_t compressed = list_create(sizeof(char)), decompressed = list_create(sizeof(char));
+		double start = dmc_seconds();
+		if (block_sizes[i])
+			dmc_compress_blocks(buf, size, block_sizes[i], compressed);
+		else
+			dmc_compress(buf, size, compressed);
+		double compress_time = dmc_seconds() - start;
+		start = dmc_seconds();
+		dmc_decompress(list_element_array(compressed), list_count(compressed), decompressed);
+		double decompress_time = dmc_seconds() - start;
+
+		/* the single stream format stores no length, so its decoder stops when the stream runs out
+			and can lose the last few bytes. Only the blocks have to come back whole */
+		int count = list_count(decompressed);
+		bool passed = (block_sizes[i] ? count == size : count <= size)
+			&& memcmp(list_element_array(decompressed), buf, count) == 0;
+		failures += !passed;
+		if (block_sizes[i])
+			printf("%8i byte blocks", block_sizes[i]);
+		else
+			printf("   single stream  ");
+		printf(": ratio %.4f, compress %.2f s, decompress %.2f s, %s", (double)list_count(compressed) / size,
+			compress_time, decompress_time, passed ? "pass" : "FAIL");
+		if (count != size)
+			printf(", lost %i trailing bytes", (int)size - count);
+		printf("\n");
+		list_destroy(compressed);
+		list_destroy(decompressed);
+	}
+
+	thread_destroy_pool();
+	free(buf);
+	return failures;
+}
+#endif
+#endif
\ No newline at end of file
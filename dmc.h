@@ -0,0 +1,27 @@
+/*
+	dmc.h ~ RL
+
+	Dynamic Markov Compression with a compact, index-linked model
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include "stream.h"
+#include "util.h"
+
+#define DMC_MIN_BLOCK_SIZE		0x1000
+
+/* whether buf starts with the compressed header */
+bool dmc_is_compressed(const char* buf, int size);
+/* compresses size bytes as a single stream, appending header and compressed stream to out */
+bool dmc_compress(const char* buf, int size, list_t out);
+/* compresses size bytes in independent blocks of block_size bytes, spread across the worker threads */
+bool dmc_compress_blocks(const char* buf, int size, int block_size, list_t out);
+/* decompresses a stream written by any of the compress functions, appending the original bytes to out */
+bool dmc_decompress(const char* buf, int size, list_t out);
+
+/* creates reader that decompresses either format as source is read */
+reader_t dmc_reader_create(reader_t source);
+/* creates writer that compresses blocks of block_size bytes, a batch at a time on the worker threads */
+writer_t dmc_writer_create(writer_t sink, int block_size);
\ No newline at end of file
@@ -7,40 +7,28 @@
 
 #include "editor.h"
 #include <assert.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define IS_LIST_VALID(lines)		(lines && list_element_size(lines) == sizeof(line_t))
-
-/* creates valid list of lines */
-list_t editor_create_lines(void)
-{
-	list_t result = list_create(sizeof(line_t));
-	line_t elem = (line_t){ .string = list_create(sizeof(char)) };
-	LIST_PUSH(result, elem);
-	return result;
-}
-
-/* frees lines' strings */
-void editor_destroy_lines(list_t lines)
-{
-	if (!lines)
-		return;
-	assert(IS_LIST_VALID(lines));
-	for (int i = 0; i < list_count(lines); i++)
-	{
-		line_t* li = LIST_GET(lines, i, line_t);
-		if (li->string)
-			list_destroy(li->string);
-	}
-	list_clear(lines);
-}
+#if defined(_M_X64) || defined(__x86_64__)
+#define EDITOR_SIMD_SUPPORTED
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define EDITOR_AVX2_TARGET
+#else
+#define EDITOR_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
 
 /* returns whether or not a cursor position is valid */
-bool editor_is_valid_cursor(list_t lines, coords_t coords)
+bool editor_is_valid_cursor(rope_t lines, coords_t coords)
 {
-	assert(IS_LIST_VALID(lines));
-	return coords.column >= 0 && coords.row >= 0 && coords.row < list_count(lines) && coords.column <= list_count(LIST_GET(lines, coords.row, line_t)->string);
+	assert(lines);
+	return coords.column >= 0 && coords.row >= 0 && coords.row < rope_line_count(lines) && coords.column <= rope_line_length(lines, coords.row);
 }
 
 /* -1 if a < b, 0 if a == b, 1 if a > b */
@@ -52,59 +40,187 @@ int editor_compare_cursors(coords_t a, coords_t b)
 		return 1;
 	else if (a.column < b.column) /* rows are the same */
 		return -1;
-	else if (b.column > a.column)
+	else if (a.column > b.column)
 		return 1;
 	else /* row and column are the same */
 		return 0;
 }
 
 /* adds new line character at position, splitting the line at position in two */
-void editor_add_newline(list_t lines, coords_t position)
+void editor_add_newline(rope_t lines, coords_t position)
+{
+	assert(editor_is_valid_cursor(lines, position));
+	rope_insert(lines, rope_coords_to_offset(lines, position), "\n", 1);
+}
+
+/* adds character at position, which isn't moved */
+void editor_add_char(rope_t lines, char ch, coords_t position)
+{
+	assert(editor_is_valid_cursor(lines, position));
+	rope_insert(lines, rope_coords_to_offset(lines, position), &ch, 1);
+}
+
+static const char* editor_find_break_scalar(const char* str, const char* end)
+{
+	while (str < end && *str != '\n' && *str != '\t' && *str != '\0')
+		str++;
+	return str;
+}
+
+#ifdef EDITOR_SIMD_SUPPORTED
+static int editor_first_bit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static bool editor_avx2_is_supported(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	if (!((info[2] >> 27) & 1) || (_xgetbv(0) & 6) != 6) /* OS saves the YMM registers */
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] >> 5) & 1;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool editor_use_avx2(void)
+{
+	static int avx2 = -1;
+	if (avx2 == -1)
+		avx2 = editor_avx2_is_supported();
+	return avx2;
+}
+
+/*	Blocks are loaded aligned, so a load never crosses into a page the string doesn't touch.
+	Bytes before str in the first block are masked off, and a match at or past end is ignored. */
+
+static const char* editor_find_break_sse2(const char* str, const char* end)
 {
-	assert(IS_LIST_VALID(lines) && editor_is_valid_cursor(lines, position));
-	list_t string = LIST_GET(lines, position.row, line_t)->string, new_string;
-	if (position.column < list_count(string))
+	const __m128i newline = _mm_set1_epi8('\n'), tab = _mm_set1_epi8('\t'), zero = _mm_setzero_si128();
+	const char* block = (const char*)((uintptr_t)str & ~(uintptr_t)15);
+	unsigned int skip = (unsigned int)(str - block);
+	for (; block < end; block += 16, skip = 0)
 	{
-		new_string = list_get_range(string, position.column, list_count(string) - 1);
-		list_splice(string, position.column, list_count(string) - 1);
+		__m128i bytes = _mm_load_si128((const __m128i*)block);
+		__m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, newline), _mm_cmpeq_epi8(bytes, tab)), _mm_cmpeq_epi8(bytes, zero));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(found) >> skip << skip;
+		if (mask)
+		{
+			const char* result = block + editor_first_bit(mask);
+			return result < end ? result : end;
+		}
 	}
-	else
-		new_string = list_create(sizeof(char));
-	line_t new_line = { .string = new_string };
-	LIST_ADD(lines, new_line, position.row + 1);
+	return end;
 }
 
-/* copies raw string at position, incrementing position coords accordingly. Formats tabs */
-void editor_add_raw(list_t lines, const char* raw, coords_t* position)
+EDITOR_AVX2_TARGET static const char* editor_find_break_avx2(const char* str, const char* end)
 {
-	assert(IS_LIST_VALID(lines) && raw && editor_is_valid_cursor(lines, *position));
-	int ch;
-	while (ch = *raw++)
+	const __m256i newline = _mm256_set1_epi8('\n'), tab = _mm256_set1_epi8('\t'), zero = _mm256_setzero_si256();
+	const char* block = (const char*)((uintptr_t)str & ~(uintptr_t)31);
+	unsigned int skip = (unsigned int)(str - block);
+	for (; block < end; block += 32, skip = 0)
 	{
-		if (CHECK_FOR_NEWLINE(ch))
+		__m256i bytes = _mm256_load_si256((const __m256i*)block);
+		__m256i found = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, newline), _mm256_cmpeq_epi8(bytes, tab)), _mm256_cmpeq_epi8(bytes, zero));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(found) >> skip << skip;
+		if (mask)
 		{
-			editor_add_newline(lines, *position);
-			*position = (coords_t){ 0, position->row + 1 };
+			const char* result = block + editor_first_bit(mask);
+			return result < end ? result : end;
 		}
-		else if (ch == '\t')
+	}
+	return end;
+}
+#endif
+
+/* finds the first newline, tab, or NUL before end, returns end if there isn't one */
+const char* editor_find_break(const char* str, const char* end)
+{
+	assert(str && end >= str);
+	/* short runs, like a single keystroke, aren't worth a vector */
+	if (end - str < 16)
+		return editor_find_break_scalar(str, end);
+#ifdef EDITOR_SIMD_SUPPORTED
+	return editor_use_avx2() ? editor_find_break_avx2(str, end) : editor_find_break_sse2(str, end);
+#else
+	return editor_find_break_scalar(str, end);
+#endif
+}
+
+/* appends one line of raw text to out, expanding tabs from column. Returns the newline or NUL that ended it, or end */
+static const char* editor_expand_line(const char* raw, const char* end, int column, list_t out)
+{
+	for (;;)
+	{
+		const char* found = editor_find_break(raw, end);
+		int count = (int)(found - raw), start = list_count(out);
+		if (count > 0)
 		{
-			editor_add_tab(lines, position);
-			position->column++;
+			list_resize(out, start + count);
+			memcpy((char*)list_element_array(out) + start, raw, count);
+			column += count;
 		}
-		else
-			LIST_ADD(LIST_GET(lines, position->row, line_t)->string, (char)ch, position->column++);
+		if (found == end || *found != '\t')
+			return found;
+
+		int tabc = TAB_SIZE - column % TAB_SIZE;
+		start = list_count(out);
+		list_resize(out, start + tabc);
+		memset((char*)list_element_array(out) + start, ' ', tabc);
+		column += tabc;
+		raw = found + 1;
+	}
+}
+
+/* copies size bytes of raw text at position, incrementing position coords accordingly. Formats tabs, a NUL ends the text */
+void editor_add_text(rope_t lines, const char* raw, int size, coords_t* position)
+{
+	assert((raw || size == 0) && size >= 0 && editor_is_valid_cursor(lines, *position));
+	list_t scratch = list_create(sizeof(char));
+	int offset = rope_coords_to_offset(lines, *position);
+	const char* end = raw + size, *pos = raw;
+
+	/* the text is formatted a line at a time and inserted in one go */
+	int line_start = 0, column = position->column;
+	for (;;)
+	{
+		pos = editor_expand_line(pos, end, column, scratch);
+		if (pos == end || *pos != '\n')
+			break;
+		list_push_primitive(scratch, (void*)'\n');
+		line_start = list_count(scratch);
+		column = 0;
+		position->row++;
+		pos++;
 	}
-	position->column--;
+	position->column = column + list_count(scratch) - line_start - 1;
+	rope_insert(lines, offset, list_element_array(scratch), list_count(scratch));
+	list_destroy(scratch);
+}
+
+/* copies raw string at position, incrementing position coords accordingly. Formats tabs */
+void editor_add_raw(rope_t lines, const char* raw, coords_t* position)
+{
+	assert(raw);
+	editor_add_text(lines, raw, (int)strlen(raw), position);
 }
 
 /* adds tab at position in line list, incrementing position coords accordingly */
-bool editor_add_tab(list_t lines, coords_t* position)
+bool editor_add_tab(rope_t lines, coords_t* position)
 {
-	assert(IS_LIST_VALID(lines) && editor_is_valid_cursor(lines, *position));
-	list_t str = LIST_GET(lines, position->row, line_t)->string;
+	assert(editor_is_valid_cursor(lines, *position));
 	int tabc = TAB_SIZE - position->column % TAB_SIZE;
-	for (int i = 0; i < tabc; i++)
-		list_add_primitive(str, (void*)' ', i + position->column);
+	rope_insert(lines, rope_coords_to_offset(lines, *position), "        ", tabc);
 	position->column += tabc - 1;
 	return true;
 }
@@ -130,107 +246,190 @@ bool editor_format_raw(list_t str)
 }
 
 /* formats and copies all lines to string */
-int editor_copy_all_lines(const list_t lines, list_t str)
+int editor_copy_all_lines(const rope_t lines, list_t str)
 {
-	assert(IS_LIST_VALID(lines) && str && list_count(str) == 0 && list_element_size(str) == sizeof(char));
-	int result = 0;
-	for (int i = 0; i < list_count(lines); i++)
-	{
-		list_t curr = LIST_GET(lines, i, line_t)->string;
-		list_concat(str, curr, result);
-		list_push_primitive(str, (void*)'\n');
-		result += list_count(curr) + 1;
-	}
-	list_pop(str, NULL);
-	list_push_primitive(str, '\0');
-	return result;
+	assert(lines && str && list_count(str) == 0 && list_element_size(str) == sizeof(char));
+	int size = rope_length(lines);
+	list_resize(str, size + 1);
+	rope_copy(lines, 0, size, list_element_array(str));
+	*LIST_GET(str, size, char) = '\0';
+	return size + 1;
+}
+
+/* converts an inclusive region to a range of characters. A region ending on a newline takes that newline */
+static void editor_region_to_range(const rope_t lines, coords_t begin, coords_t end, int* start, int* size)
+{
+	assert(editor_is_valid_cursor(lines, begin) && editor_is_valid_cursor(lines, end) && editor_compare_cursors(begin, end) <= 0);
+	int last = rope_coords_to_offset(lines, end);
+	*start = rope_coords_to_offset(lines, begin);
+	*size = max(0, min(last, rope_length(lines) - 1) - *start + 1);
 }
 
 /* writes to the out list as a string */
-void editor_copy_region(const list_t lines, list_t out, coords_t begin_coords, coords_t end_coords)
-{
-	assert(
-		IS_LIST_VALID(lines) 
-		&& list_count(out) == 0 
-		&& list_element_size(out) == sizeof(char) 
-		&& editor_is_valid_cursor(lines, begin_coords) 
-		&& editor_is_valid_cursor(lines, end_coords)
-		&& editor_compare_cursors(begin_coords, end_coords) <= 0);
-
-	const line_t* start = LIST_GET(lines, begin_coords.row, line_t), *end = LIST_GET(lines, end_coords.row, line_t);
-	list_concat(out, start->string, 0);
-	if (start != end)
+void editor_copy_region(const rope_t lines, list_t out, coords_t begin_coords, coords_t end_coords)
+{
+	assert(list_count(out) == 0 && list_element_size(out) == sizeof(char));
+	int start, size;
+	editor_region_to_range(lines, begin_coords, end_coords, &start, &size);
+	list_resize(out, size + 1);
+	rope_copy(lines, start, size, list_element_array(out));
+	*LIST_GET(out, size, char) = '\0';
+}
+
+/* deletes region of lines */
+void editor_delete_region(rope_t lines, coords_t begin, coords_t end)
+{
+	/* the region can only take the end row's newline if there's a row after it */
+	assert(editor_is_valid_cursor(lines, end) && (end.column < rope_line_length(lines, end.row) || end.row + 1 < rope_line_count(lines)));
+	int start, size;
+	editor_region_to_range(lines, begin, end, &start, &size);
+	rope_delete(lines, start, size);
+}
+
+/* adds character position to cursor */
+coords_t editor_overflow_cursor(rope_t lines, coords_t cursor)
+{
+	assert(lines);
+	cursor.row = min(max(0, cursor.row), rope_line_count(lines) - 1);
+	if (cursor.column >= 0 && cursor.column <= rope_line_length(lines, cursor.row))
+		return cursor;
+
+	int offset = rope_coords_to_offset(lines, (coords_t) { .column = 0, .row = cursor.row }) + cursor.column;
+	if (offset < 0) /* the column is left negative on the first row */
+		return (coords_t) { .column = offset, .row = 0 };
+	return rope_offset_to_coords(lines, offset);
+}
+
+/*
+	FIND. A PATTERN IS PART OF A SINGLE LINE. CANDIDATES ARE WHERE BOTH THE FIRST AND LAST CHARACTERS OF
+	THE PATTERN ARE FOUND, A BLOCK AT A TIME WITH VECTORS, AND ONLY THOSE ARE COMPARED IN FULL
+*/
+
+static char editor_other_case(char ch)
+{
+	return (char)(isupper((unsigned char)ch) ? tolower((unsigned char)ch) : toupper((unsigned char)ch));
+}
+
+/* whether size bytes of str and pattern are the same. Letters match either case if ignore_case is set */
+static bool editor_is_same(const char* str, const char* pattern, int size, bool ignore_case)
+{
+	if (!ignore_case)
+		return memcmp(str, pattern, size) == 0;
+	for (int i = 0; i < size; i++)
 	{
-		list_splice_count(out, 0, begin_coords.column);
-		list_push_primitive(out, (void*)'\n');
-		for (int i = begin_coords.row + 1; i < end_coords.row; i++)
-		{
-			list_concat(out, LIST_GET(lines, i, line_t)->string, list_count(out));
-			list_push_primitive(out, (void*)'\n');
-		}
-		int pos = list_count(out);
-		list_concat(out, end->string, pos);
-		list_splice_count(out, pos + end_coords.column + 1, list_count(end->string) - end_coords.column - 1);
+		if (tolower((unsigned char)str[i]) != tolower((unsigned char)pattern[i]))
+			return false;
 	}
-	else
+	return true;
+}
+
+/* first match starting from column to last, -1 if there is none */
+static int editor_find_scalar(const char* str, int column, int last, const char* pattern, int size, bool ignore_case)
+{
+	for (int i = column; i <= last; i++)
 	{
-		list_splice_count(out, end_coords.column + 1, list_count(out) - end_coords.column - 1);
-		list_splice_count(out, 0, begin_coords.column);
-		if (end_coords.column == list_count(out))
-			list_push_primitive(out, (void*)'\n');
+		if (editor_is_same(str + i, pattern, size, ignore_case))
+			return i;
 	}
-
-	list_push_primitive(out, (void*)'\0');
+	return -1;
 }
 
-/* deletes region of lines */
-void editor_delete_region(list_t lines, coords_t begin, coords_t end)
+#ifdef EDITOR_SIMD_SUPPORTED
+/*	Loads are unaligned but stay inside the string, the last block ending with its final character.
+	What's left after the last full block is searched one character at a time. */
+
+static int editor_find_sse2(const char* str, int column, int last, const char* pattern, int size, bool ignore_case)
 {
-	assert(IS_LIST_VALID(lines) && editor_is_valid_cursor(lines, begin) && editor_is_valid_cursor(lines, end) && editor_compare_cursors(begin, end) <= 0);
-	list_t begin_string = LIST_GET(lines, begin.row, line_t)->string;
-	int first_row_end;
-	if (begin.row != end.row)
+	char first = pattern[0], final = pattern[size - 1];
+	const __m128i first_case = _mm_set1_epi8(first), first_other = _mm_set1_epi8(ignore_case ? editor_other_case(first) : first);
+	const __m128i final_case = _mm_set1_epi8(final), final_other = _mm_set1_epi8(ignore_case ? editor_other_case(final) : final);
+	int i = column;
+	for (; i + 15 <= last; i += 16)
 	{
-		first_row_end = list_count(begin_string) - 1;
-		list_splice_count(LIST_GET(lines, end.row, line_t)->string, 0, end.column + 1);
-		list_concat(begin_string, LIST_GET(lines, end.row, line_t)->string, list_count(begin_string));
-		for (int i = begin.row + 1; i < end.row; i++)
-			list_destroy(LIST_GET(lines, i, line_t)->string);
-		list_splice(lines, begin.row + 1, end.row);
+		__m128i at_first = _mm_loadu_si128((const __m128i*)(str + i)), at_final = _mm_loadu_si128((const __m128i*)(str + i + size - 1));
+		__m128i found = _mm_and_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(at_first, first_case), _mm_cmpeq_epi8(at_first, first_other)),
+			_mm_or_si128(_mm_cmpeq_epi8(at_final, final_case), _mm_cmpeq_epi8(at_final, final_other)));
+		for (unsigned int mask = (unsigned int)_mm_movemask_epi8(found); mask; mask &= mask - 1)
+		{
+			int candidate = i + editor_first_bit(mask);
+			if (editor_is_same(str + candidate, pattern, size, ignore_case))
+				return candidate;
+		}
 	}
-	else
+	return editor_find_scalar(str, i, last, pattern, size, ignore_case);
+}
+
+EDITOR_AVX2_TARGET static int editor_find_avx2(const char* str, int column, int last, const char* pattern, int size, bool ignore_case)
+{
+	char first = pattern[0], final = pattern[size - 1];
+	const __m256i first_case = _mm256_set1_epi8(first), first_other = _mm256_set1_epi8(ignore_case ? editor_other_case(first) : first);
+	const __m256i final_case = _mm256_set1_epi8(final), final_other = _mm256_set1_epi8(ignore_case ? editor_other_case(final) : final);
+	int i = column;
+	for (; i + 31 <= last; i += 32)
 	{
-		first_row_end = end.column;
-		if (first_row_end == list_count(begin_string))
+		__m256i at_first = _mm256_loadu_si256((const __m256i*)(str + i)), at_final = _mm256_loadu_si256((const __m256i*)(str + i + size - 1));
+		__m256i found = _mm256_and_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(at_first, first_case), _mm256_cmpeq_epi8(at_first, first_other)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(at_final, final_case), _mm256_cmpeq_epi8(at_final, final_other)));
+		for (unsigned int mask = (unsigned int)_mm256_movemask_epi8(found); mask; mask &= mask - 1)
 		{
-			assert(end.row + 1 < list_count(lines));
-			list_t next_string = LIST_GET(lines, begin.row + 1, line_t)->string;
-			list_concat(begin_string, next_string, list_count(begin_string));
-			list_destroy(next_string);
-			list_remove(lines, begin.row + 1);
-			/* we removed the newline so we move our cursor back */
-			first_row_end--;
+			int candidate = i + editor_first_bit(mask);
+			if (editor_is_same(str + candidate, pattern, size, ignore_case))
+				return candidate;
 		}
 	}
+	return editor_find_sse2(str, i, last, pattern, size, ignore_case);
+}
+#endif
 
-	if (first_row_end >= begin.column)
-		list_splice(begin_string, begin.column, first_row_end);
+/* finds the first match of size bytes of pattern in string at or after column, returns -1 if there is none */
+int editor_find_in_string(const char* str, int count, int column, const char* pattern, int size, bool ignore_case)
+{
+	assert((str || count == 0) && pattern && size > 0 && column >= 0);
+	int last = count - size;
+	if (column > last)
+		return -1;
+	/* too few candidates to fill a vector */
+	if (last - column < 16)
+		return editor_find_scalar(str, column, last, pattern, size, ignore_case);
+#ifdef EDITOR_SIMD_SUPPORTED
+	return editor_use_avx2() ? editor_find_avx2(str, column, last, pattern, size, ignore_case) : editor_find_sse2(str, column, last, pattern, size, ignore_case);
+#else
+	return editor_find_scalar(str, column, last, pattern, size, ignore_case);
+#endif
 }
 
-/* adds character position to cursor */
-coords_t editor_overflow_cursor(list_t lines, coords_t cursor)
+/* adds the position of every match of pattern to matches in order, including ones that overlap */
+void editor_find_all(rope_t lines, const char* pattern, int size, bool ignore_case, list_t matches)
 {
-	cursor.row = min(max(0, cursor.row), list_count(lines) - 1);
-	while (cursor.row > 0 && cursor.column < 0)
+	assert(lines && matches && list_element_size(matches) == sizeof(coords_t));
+	for (int row = 0; row < rope_line_count(lines); row++)
 	{
-		cursor.row--;
-		cursor.column += list_count(LIST_GET(lines, cursor.row, line_t)->string) + 1;
+		int count;
+		const char* str = rope_line(lines, row, &count);
+		int column = editor_find_in_string(str, count, 0, pattern, size, ignore_case);
+		for (; column != -1; column = editor_find_in_string(str, count, column + 1, pattern, size, ignore_case))
+		{
+			coords_t match = { .column = column, .row = row };
+			LIST_PUSH(matches, match);
+		}
 	}
-	while (cursor.row < list_count(lines) - 1 && cursor.column > list_count(LIST_GET(lines, cursor.row, line_t)->string))
+}
+
+/*	removes the matches pattern isn't found at. Every match of a pattern is also a match of the start of it,
+	so matches found for the start of pattern can be refined instead of searching again */
+void editor_refine_matches(rope_t lines, const char* pattern, int size, bool ignore_case, list_t matches)
+{
+	assert(lines && pattern && size > 0 && matches && list_element_size(matches) == sizeof(coords_t));
+	coords_t* arr = list_element_array(matches);
+	int count = 0;
+	for (int i = 0; i < list_count(matches); i++)
 	{
-		cursor.column -= list_count(LIST_GET(lines, cursor.row, line_t)->string) + 1;
-		cursor.row++;
+		int length;
+		const char* str = rope_line(lines, arr[i].row, &length);
+		if (arr[i].column + size <= length && editor_is_same(str + arr[i].column, pattern, size, ignore_case))
+			arr[count++] = arr[i];
 	}
-	cursor.column = min(cursor.column, list_count(LIST_GET(lines, cursor.row, line_t)->string));
-	return cursor;
+	list_resize(matches, count);
 }
\ No newline at end of file
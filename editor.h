@@ -7,47 +7,46 @@
 
 #pragma once
 
+#include "rope.h"
 #include "util.h"
 
 #define CHECK_FOR_NEWLINE(ch)		((ch) == '\n')
 #define TAB_SIZE					4
 
-typedef struct coords
-{
-	int column;
-	int row;
-} coords_t;
-
-typedef struct line
-{
-	list_t string;
-} line_t;
-
-/* creates valid list of lines */
-list_t editor_create_lines(void);
-/* frees lines' strings */
-void editor_destroy_lines(list_t lines);
-
 /* returns whether or not a cursor position is valid */
-bool editor_is_valid_cursor(list_t lines, coords_t coords);
+bool editor_is_valid_cursor(rope_t lines, coords_t coords);
 /* -1 if a < b, 0 if a == b, 1 if a > b */
 int editor_compare_cursors(coords_t a, coords_t b);
 
 /* adds new line character at position, splitting the line at position in two */
-void editor_add_newline(list_t lines, coords_t position);
+void editor_add_newline(rope_t lines, coords_t position);
+/* adds character at position, which isn't moved */
+void editor_add_char(rope_t lines, char ch, coords_t position);
 /* copies raw string at position, incrementing position coords accordingly. Formats tabs */
-void editor_add_raw(list_t lines, const char* raw, coords_t* position);
+void editor_add_raw(rope_t lines, const char* raw, coords_t* position);
+/* copies size bytes of raw text at position, incrementing position coords accordingly. Formats tabs, a NUL ends the text */
+void editor_add_text(rope_t lines, const char* raw, int size, coords_t* position);
+/* finds the first newline, tab, or NUL before end, returns end if there isn't one */
+const char* editor_find_break(const char* str, const char* end);
 /* adds tab at position in line list, incrementing position coords accordingly */
-bool editor_add_tab(list_t lines, coords_t* position);
+bool editor_add_tab(rope_t lines, coords_t* position);
 /* formats text (ex. "\\r\\n" -> "\\n") */
 bool editor_format_raw(list_t str);
 
 /* formats and copies all lines to string */
-int editor_copy_all_lines(const list_t lines, list_t str);
+int editor_copy_all_lines(const rope_t lines, list_t str);
 /* writes to the out list as a string */
-void editor_copy_region(const list_t lines, list_t out, coords_t begin, coords_t end);
+void editor_copy_region(const rope_t lines, list_t out, coords_t begin, coords_t end);
 /* deletes region of lines */
-void editor_delete_region(list_t lines, coords_t begin, coords_t end);
+void editor_delete_region(rope_t lines, coords_t begin, coords_t end);
 
 /* adds character position to cursor */
-coords_t editor_overflow_cursor(list_t lines, coords_t cursor);
\ No newline at end of file
+coords_t editor_overflow_cursor(rope_t lines, coords_t cursor);
+
+/* finds the first match of size bytes of pattern in count characters of str at or after column, returns -1 if there is none */
+int editor_find_in_string(const char* str, int count, int column, const char* pattern, int size, bool ignore_case);
+/* adds the position of every match of pattern to matches in order, including ones that overlap */
+void editor_find_all(rope_t lines, const char* pattern, int size, bool ignore_case, list_t matches);
+/*	removes the matches pattern isn't found at. Every match of a pattern is also a match of the start of it,
+	so matches found for the start of pattern can be refined instead of searching again */
+void editor_refine_matches(rope_t lines, const char* pattern, int size, bool ignore_case, list_t matches);
\ No newline at end of file
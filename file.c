@@ -5,27 +5,42 @@
 */
 
 #include "file.h"
+#include "aes.h"
 #include <assert.h>
 #include "console.h"
+#include "dmc.h"
 #include "editor.h"
+#include "hash.h"
+#include "kdf.h"
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "stream.h"
+#include "thread.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define AES_EXTENSION			".aes"
 #define DMC_EXTENSION			".dmc"
 #define PLAIN_EXTENSION			".txt"
 #define EXTENSION_LEN			4
+#define MAP_MIN_SIZE			0x10000 /* smaller plain files are cheaper to read than to map */
+#define MAP_EDIT_SPACING		0x1000 /* mapped files needing more than one formatting edit per this many bytes are read instead */
 
-static bool aes_open(const list_t in, list_t out);
-static bool aes_save(const list_t in, list_t out);
-static bool dmc_open(const list_t in, list_t out);
-static bool dmc_save(const list_t in, list_t out);
+static reader_t aes_reader_create(reader_t source);
 
 static char aes_header[3] = { 0xAA, 0xEE, 0x17 };
-static char dmc_header[3] = { 0xDD, 0x17, 0xCC };
+static char indexed_header[3] = { 0x1D, 0xE5, 0xC4 };
 static char user_password[64] = { 0 };
 
 /* sets password with a max len of 64 */
@@ -54,477 +69,1063 @@ bool file_exists(const char* directory)
 bool file_get_name(const char* directory, char* buf, int size)
 {
 	assert(directory != NULL && buf != NULL && size > 0);
-	const char* file_name = strrchr(directory, '\\');
+	const char* file_name = strrchr(directory, PATH_SEPARATOR[0]);
 	if (file_name)
-		file_name++; /* strrchr returns ptr to last "\\", so we have to increment to get to the file name */
+		file_name++; /* strrchr returns ptr to the last separator, so we have to increment to get to the file name */
 	else
 		file_name = directory;
 	strncpy(buf, file_name, size);
 	return true;
 }
 
-static file_type_t file_read_header(const list_t buffer)
+/*	Compressed and encrypted files are saved in the indexed format, laid out as:
+		header[3], version[1], type[1], key derivation iterations[4], salt[16]
+		then chunks, each compressed and encrypted on its own. Encrypted chunks are nonce[12], cipher text, tag[16]
+		then the index: plain size[4], chunk count[4], then for every chunk: offset[4], stored size[4], plain size[4], line count[4], hash[8]
+		then the footer: index offset[4], index size[4], header[3], version[1]
+	A chunk is a run of whole lines with a "\n" between each, and chunks are joined by a "\n" when read. A chunk ends
+	on a line whose hash has its low bits clear, so an edit only moves the ends of the chunks around it. Saving keeps
+	every chunk the index already has, appends the rest with a new index and footer, and the footer at the end of the
+	file is the one that's read. A footer is only written once what it points to is on the disk, so a save cut off
+	part way leaves the file ending without one and the last footer that fits is read instead. Once the chunks out
+	of date take 1 / INDEXED_DEAD_DIVISOR of the space of the ones in use, or INDEXED_MAX_DEAD bytes, or every chunk
+	changed, the file is written again from the start to a temporary file that replaces it.
+	The index starts with the plain size of the whole text, which has to match its chunks.
+	The index is encrypted the same way as the chunks. A chunk authenticates the header and its hash and plain size,
+	and the index authenticates the header and its offset, so nothing can be swapped or moved between files. */
+
+#define INDEXED_VERSION			1
+#define INDEXED_PREFIX			(sizeof indexed_header + CHAR_SIZE * 2)
+#define INDEXED_HEADER_SIZE		(INDEXED_PREFIX + INT_SIZE + KDF_SALT_SIZE)
+#define INDEXED_HASH_SIZE		(INT_SIZE * 2)
+#define INDEXED_ENTRY_SIZE		(INT_SIZE * 4 + INDEXED_HASH_SIZE)
+#define INDEXED_INDEX_PREFIX	(INT_SIZE * 2)
+#define INDEXED_FOOTER_SIZE		(INT_SIZE * 2 + sizeof indexed_header + CHAR_SIZE)
+#define INDEXED_AAD_SIZE		(INDEXED_HEADER_SIZE + INT_SIZE + INDEXED_HASH_SIZE)
+#define INDEXED_MIN_CHUNK		0x4000	/* bytes a chunk holds before a line can end it */
+#define INDEXED_MAX_CHUNK		0x40000	/* bytes a chunk holds before the next line ends it whatever its hash */
+#define INDEXED_BOUNDARY_MASK	0x1F	/* low bits of the hash of the line that ends a chunk */
+#define INDEXED_MAX_DEAD		0x400000	/* bytes out of date a file keeps before it's written again */
+#define INDEXED_DEAD_DIVISOR	4	/* a file is written again once its bytes out of date are this fraction of the ones in use */
+#define INDEXED_SEARCH_SIZE		0x10000	/* bytes read at a time looking back for a footer */
+#define INDEXED_TEMP_EXTENSION	".tmp"
+
+struct indexed_chunk
 {
-	file_type_t type = TYPE_PLAIN;
-	if (list_count(buffer) >= 3)
-	{
-		if (memcmp(list_element_array(buffer), dmc_header, sizeof dmc_header) == 0)
-			type |= TYPE_COMPRESSED;
-		else if (memcmp(list_element_array(buffer), aes_header, sizeof aes_header) == 0)
-			type |= TYPE_ENCRYPTED;
-	}
-	return type;
+	int offset, stored_size;	/* where the chunk is in the file, offset is -1 until it's written */
+	int plain_size, line_count;
+	uint64_t hash;				/* of the hashes of its lines */
+	int start;					/* offset of its text, only known while saving */
+	list_t data;				/* chunk as it's stored, NULL if it's already in the file */
+};
+
+struct indexed_file
+{
+	uint8_t header[INDEXED_HEADER_SIZE];
+	file_type_t type;
+	aes_gcm_t gcm;
+	int size, index_offset;
+	int plain_size;				/* of the whole text, the chunks with a "\n" between each */
+	list_t chunks;				/* struct indexed_chunk */
+};
+
+static void indexed_free(struct indexed_file* file)
+{
+	if (!file->chunks)
+		return;
+	for (int i = 0; i < list_count(file->chunks); i++)
+		list_destroy(LIST_GET(file->chunks, i, struct indexed_chunk)->data);
+	list_destroy(file->chunks);
+	file->chunks = NULL;
 }
 
-/* determines type of file and then delegates open function to the appropriate function */
-file_details_t file_open(const char* directory)
+/* reads the type from header, which must hold INDEXED_HEADER_SIZE bytes, and derives the key if it's encrypted */
+static bool indexed_read_header(struct indexed_file* file, const uint8_t* header)
 {
-	assert(directory != NULL);
-	FILE* file = fopen(directory, "rb");
-	if (!file)
-		return FAILED_FILE_DETAILS;
-	long size;
-	char* buf = read_all_file(file, &size);
-	fclose(file);
-	if (!buf)
-		return FAILED_FILE_DETAILS;
+	if (memcmp(header, indexed_header, sizeof indexed_header) != 0 || header[sizeof indexed_header] != INDEXED_VERSION)
+		return false;
+	memcpy(file->header, header, INDEXED_HEADER_SIZE);
+	file->type = header[sizeof indexed_header + CHAR_SIZE];
+	if (file->type & ~(TYPE_COMPRESSED | TYPE_ENCRYPTED))
+		return false;
+	if (!(file->type & TYPE_ENCRYPTED))
+		return true;
 
-	list_t current = list_create_with_array(buf, sizeof(char), size);
-	free(buf);
+	int iterations;
+	uint8_t key[AES_KEY_SIZE];
+	read_int((const char*)header, INDEXED_PREFIX, INDEXED_HEADER_SIZE, &iterations);
+	if (!kdf_derive(user_password, header + INDEXED_PREFIX + INT_SIZE, iterations, key, AES_KEY_SIZE))
+		return false;
+	aes_gcm_init(&file->gcm, key);
+	return true;
+}
 
-	file_type_t type = file_read_header(current);
+/*	header the file is saved with given user's current settings. An encrypted file keeps salt, the salt of the file it's
+	saved over, so the key is already cached. A new one gets its own when salt is NULL */
+static bool indexed_create_header(struct indexed_file* file, file_type_t type, const uint8_t* salt)
+{
+	uint8_t header[INDEXED_HEADER_SIZE] = { 0 };
+	memcpy(header, indexed_header, sizeof indexed_header);
+	header[sizeof indexed_header] = INDEXED_VERSION;
+	header[sizeof indexed_header + CHAR_SIZE] = type;
 	if (type & TYPE_ENCRYPTED)
 	{
-		list_t next = list_create(sizeof(char));
-		if (!aes_open(current, next))
-		{
-			list_destroy(next);
-			list_destroy(current);
-			return FAILED_FILE_DETAILS;
-		}
-		list_destroy(current);
-		current = next;
+		store_int((char*)header, INDEXED_PREFIX, INDEXED_HEADER_SIZE, kdf_iterations());
+		if (salt)
+			memcpy(header + INDEXED_PREFIX + INT_SIZE, salt, KDF_SALT_SIZE);
+		else if (!random_bytes(header + INDEXED_PREFIX + INT_SIZE, KDF_SALT_SIZE))
+			return false;
 	}
+	return indexed_read_header(file, header);
+}
 
-	type |= file_read_header(current);
-	if (type & TYPE_COMPRESSED)
+static void indexed_store_hash(char* buf, int pos, int size, uint64_t hash)
+{
+	store_int(buf, pos, size, (int)(uint32_t)hash);
+	store_int(buf, pos + INT_SIZE, size, (int)(uint32_t)(hash >> 32));
+}
+
+static uint64_t indexed_read_hash(const char* buf, int pos, int size)
+{
+	int low, high;
+	read_int(buf, pos, size, &low);
+	read_int(buf, pos + INT_SIZE, size, &high);
+	return (uint32_t)low | (uint64_t)(uint32_t)high << 32;
+}
+
+/* additional data of a chunk or the index is the file header followed by fields, returns size */
+static int indexed_aad(const struct indexed_file* file, int field, uint64_t hash, bool has_hash, uint8_t aad[INDEXED_AAD_SIZE])
+{
+	memcpy(aad, file->header, INDEXED_HEADER_SIZE);
+	store_int((char*)aad, INDEXED_HEADER_SIZE, INDEXED_AAD_SIZE, field);
+	if (!has_hash)
+		return INDEXED_HEADER_SIZE + INT_SIZE;
+	indexed_store_hash((char*)aad, INDEXED_HEADER_SIZE + INT_SIZE, INDEXED_AAD_SIZE, hash);
+	return INDEXED_AAD_SIZE;
+}
+
+/* encrypts size bytes of plain into out in place of what it holds, nonce first and tag last. Nonce is random */
+static bool indexed_encrypt(const struct indexed_file* file, const uint8_t* aad, int aad_size, const char* plain, int size, list_t out)
+{
+	list_resize(out, size + AES_GCM_NONCE_SIZE + AES_GCM_TAG_SIZE);
+	uint8_t* raw = list_element_array(out);
+	if (!random_bytes(raw, AES_GCM_NONCE_SIZE))
+		return false;
+	aes_gcm_encrypt(&file->gcm, raw, aad, aad_size, (const uint8_t*)plain, raw + AES_GCM_NONCE_SIZE, size, raw + AES_GCM_NONCE_SIZE + size);
+	return true;
+}
+
+/* decrypts size bytes of raw, written by indexed_encrypt, into out in place of what it holds */
+static bool indexed_decrypt(const struct indexed_file* file, const uint8_t* aad, int aad_size, const char* raw, int size, list_t out)
+{
+	int plain_size = size - AES_GCM_NONCE_SIZE - AES_GCM_TAG_SIZE;
+	if (plain_size < 0)
+		return false;
+	list_resize(out, plain_size);
+	const uint8_t* nonce = (const uint8_t*)raw;
+	return aes_gcm_decrypt(&file->gcm, nonce, aad, aad_size, nonce + AES_GCM_NONCE_SIZE, list_element_array(out), plain_size, nonce + AES_GCM_NONCE_SIZE + plain_size);
+}
+
+static bool indexed_read_at(FILE* file, long offset, void* buf, int size)
+{
+	return fseek(file, offset, SEEK_SET) == 0 && fread(buf, 1, size, file) == (size_t)size;
+}
+
+/* whether footer, which ends at end, belongs to header and has the index right before it */
+static bool indexed_footer_fits(const char* footer, const uint8_t* header, long end)
+{
+	int index_offset, index_size;
+	read_int(footer, 0, INDEXED_FOOTER_SIZE, &index_offset);
+	read_int(footer, INT_SIZE, INDEXED_FOOTER_SIZE, &index_size);
+	return memcmp(footer + INT_SIZE * 2, header, sizeof indexed_header + CHAR_SIZE) == 0 && index_offset >= (int)INDEXED_HEADER_SIZE
+		&& index_size >= INDEXED_INDEX_PREFIX && (long long)index_offset + index_size == end - INDEXED_FOOTER_SIZE;
+}
+
+/* finds where the last footer that fits ends, looking back from size. Returns -1 if there's none */
+static long indexed_find_end(FILE* stream, const uint8_t* header, long size)
+{
+	char* window = journal_malloc(INDEXED_SEARCH_SIZE + INDEXED_FOOTER_SIZE);
+	long result = -1;
+	for (long high = size; high >= (long)(INDEXED_HEADER_SIZE + INDEXED_FOOTER_SIZE) && result < 0; high -= INDEXED_SEARCH_SIZE)
 	{
-		list_t next = list_create(sizeof(char));
-		if (!dmc_open(current, next))
+		/* window holds every footer ending in the INDEXED_SEARCH_SIZE bytes before high */
+		long low = max(high - INDEXED_SEARCH_SIZE - (long)INDEXED_FOOTER_SIZE, (long)INDEXED_HEADER_SIZE);
+		if (!indexed_read_at(stream, low, window, (int)(high - low)))
+			break;
+		for (long end = high; end > high - INDEXED_SEARCH_SIZE && end - (long)INDEXED_FOOTER_SIZE >= low && result < 0; end--)
 		{
-			list_destroy(next);
-			list_destroy(current);
-			return FAILED_FILE_DETAILS;
+			if (indexed_footer_fits(window + (end - INDEXED_FOOTER_SIZE - low), header, end))
+				result = end;
 		}
-		list_destroy(current);
-		current = next;
 	}
+	free(window);
+	return result;
+}
 
-	list_t lines = editor_create_lines();
-	if (!lines)
+/*	reads the header, footer, and index of an indexed file, rejecting anything that doesn't fit inside it.
+	A file that doesn't end in a footer was cut off while saving, so the save before it is read */
+static bool indexed_read_index(FILE* stream, struct indexed_file* file)
+{
+	uint8_t header[INDEXED_HEADER_SIZE];
+	char footer[INDEXED_FOOTER_SIZE];
+	long size = fseek(stream, 0, SEEK_END) == 0 ? ftell(stream) : -1;
+	if (size < (long)(INDEXED_HEADER_SIZE + INDEXED_FOOTER_SIZE) || size > INT_MAX
+		|| !indexed_read_at(stream, 0, header, sizeof header) || !indexed_read_header(file, header))
+		return false;
+	long end = indexed_read_at(stream, size - sizeof footer, footer, sizeof footer) && indexed_footer_fits(footer, header, size)
+		? size : indexed_find_end(stream, header, size);
+	if (end < 0 || !indexed_read_at(stream, end - sizeof footer, footer, sizeof footer))
+		return false;
+	if (end < size)
+		debug_format("Indexed file was cut off while saving, reading the save before it.\n");
+
+	int index_size;
+	file->size = (int)end;
+	read_int(footer, 0, sizeof footer, &file->index_offset);
+	read_int(footer, INT_SIZE, sizeof footer, &index_size);
+
+	list_t raw = list_create(sizeof(char)), index = list_create(sizeof(char));
+	list_resize(raw, index_size);
+	bool result = indexed_read_at(stream, file->index_offset, list_element_array(raw), index_size);
+	if (result && (file->type & TYPE_ENCRYPTED))
 	{
-		list_destroy(current);
-		return FAILED_FILE_DETAILS;
+		uint8_t aad[INDEXED_AAD_SIZE];
+		int aad_size = indexed_aad(file, file->index_offset, 0, false, aad);
+		result = indexed_decrypt(file, aad, aad_size, list_element_array(raw), index_size, index);
+		if (!result)
+			debug_format("Password is not valid or file is corrupt.\n");
 	}
-
-	coords_t temp = { 0 };
-	bool result = editor_format_raw(current);
-	list_push_primitive(current, (void*)'\0');
-	editor_add_raw(lines, list_element_array(current), &temp);
-
-	list_destroy(current);
-	if (!result)
+	else if (result)
+		list_concat(index, raw, 0);
+	list_destroy(raw);
+
+	int count = 0;
+	const char* fields = list_element_array(index);
+	result = result && read_int(fields, 0, list_count(index), &file->plain_size) && read_int(fields, INT_SIZE, list_count(index), &count)
+		&& count >= 1 && (long long)count * INDEXED_ENTRY_SIZE + INDEXED_INDEX_PREFIX == list_count(index);
+	file->chunks = list_create(sizeof(struct indexed_chunk));
+	long long plain_size = count - 1;
+	for (int i = 0; i < count && result; i++)
 	{
-		editor_destroy_lines(lines);
-		return FAILED_FILE_DETAILS;
+		struct indexed_chunk chunk = { .start = -1 };
+		int pos = INDEXED_INDEX_PREFIX + i * INDEXED_ENTRY_SIZE;
+		read_int(fields, pos, list_count(index), &chunk.offset);
+		read_int(fields, pos + INT_SIZE, list_count(index), &chunk.stored_size);
+		read_int(fields, pos + INT_SIZE * 2, list_count(index), &chunk.plain_size);
+		read_int(fields, pos + INT_SIZE * 3, list_count(index), &chunk.line_count);
+		chunk.hash = indexed_read_hash(fields, pos + INT_SIZE * 4, list_count(index));
+		result = chunk.offset >= (int)INDEXED_HEADER_SIZE && chunk.stored_size > 0 && (long long)chunk.offset + chunk.stored_size <= file->index_offset
+			&& chunk.plain_size >= 0 && chunk.line_count >= 1 && chunk.line_count - 1 <= chunk.plain_size;
+		plain_size += chunk.plain_size;
+		LIST_PUSH(file->chunks, chunk);
 	}
-	return (file_details_t) { .directory = directory, .lines = lines, .type = type };
+	result = result && plain_size == file->plain_size;
+	list_destroy(index);
+	if (!result)
+		debug_format("Indexed file is truncated or corrupt.\n");
+	return result;
 }
 
-/* saves console's file given user's current settings */
-bool file_save(const file_details_t details)
+/* chunks encoded or decoded together on the worker threads */
+struct indexed_batch
 {
-	assert(details.directory != NULL);
-	FILE* file = fopen(details.directory, "wb");
-	if (!file)
-		return false;
+	const struct indexed_file* file;
+	rope_t lines;
+	struct indexed_chunk** chunks;
+	bool* results;
+};
 
-	list_t current = list_create(sizeof(char));
-	if (!editor_copy_all_lines(details.lines, current))
+/* copies the chunk's text, then compresses and encrypts it into its data */
+static void indexed_encode_chunk(void* ctx, int index)
+{
+	const struct indexed_batch* batch = ctx;
+	struct indexed_chunk* chunk = batch->chunks[index];
+	list_t text = list_create(sizeof(char)), compressed = NULL;
+	list_resize(text, chunk->plain_size);
+	rope_copy(batch->lines, chunk->start, chunk->plain_size, list_element_array(text));
+
+	/* chunks are already spread across the worker threads, so each is compressed as a single block */
+	bool result = true;
+	if (batch->file->type & TYPE_COMPRESSED)
 	{
-		list_destroy(current);
-		fclose(file);
-		return false;
+		compressed = list_create(sizeof(char));
+		result = dmc_compress_blocks(list_element_array(text), chunk->plain_size, max(chunk->plain_size, DMC_MIN_BLOCK_SIZE), compressed);
+		list_destroy(text);
+		text = compressed;
 	}
+	if (result && (batch->file->type & TYPE_ENCRYPTED))
+	{
+		uint8_t aad[INDEXED_AAD_SIZE];
+		int aad_size = indexed_aad(batch->file, chunk->plain_size, chunk->hash, true, aad);
+		chunk->data = list_create(sizeof(char));
+		result = indexed_encrypt(batch->file, aad, aad_size, list_element_array(text), list_count(text), chunk->data);
+		list_destroy(text);
+	}
+	else
+		chunk->data = text;
+	chunk->stored_size = list_count(chunk->data);
+	batch->results[index] = result;
+}
 
-	list_pop(current, NULL);
-
-	if (details.type & TYPE_COMPRESSED)
+/* decrypts and decompresses the chunk's data in place, checking it holds what the index says */
+static void indexed_decode_chunk(void* ctx, int index)
+{
+	const struct indexed_batch* batch = ctx;
+	struct indexed_chunk* chunk = batch->chunks[index];
+	bool result = true;
+	if (batch->file->type & TYPE_ENCRYPTED)
 	{
-		list_t next = list_create(sizeof(char));
-		if (!dmc_save(current, next))
-		{
-			list_destroy(current);
-			fclose(file);
-			clear_file(details.directory);
-			return false;
-		}
-		current = next;
+		uint8_t aad[INDEXED_AAD_SIZE];
+		int aad_size = indexed_aad(batch->file, chunk->plain_size, chunk->hash, true, aad);
+		list_t plain = list_create(sizeof(char));
+		result = indexed_decrypt(batch->file, aad, aad_size, list_element_array(chunk->data), list_count(chunk->data), plain);
+		list_destroy(chunk->data);
+		chunk->data = plain;
 	}
-	if (details.type & TYPE_ENCRYPTED)
+	if (result && (batch->file->type & TYPE_COMPRESSED))
 	{
-		list_t next = list_create(sizeof(char));
-		if (!aes_save(current, next))
-		{
-			list_destroy(current);
-			fclose(file);
-			clear_file(details.directory);
-			return false;
-		}
-		current = next;
+		list_t text = list_create(sizeof(char));
+		result = dmc_decompress(list_element_array(chunk->data), list_count(chunk->data), text);
+		list_destroy(chunk->data);
+		chunk->data = text;
 	}
+	batch->results[index] = result && list_count(chunk->data) == chunk->plain_size;
+}
 
-	fwrite(list_element_array(current), 1, list_count(current), file);
-
-	fclose(file);
-	list_destroy(current);
+/* appends a decoded chunk to text, after a "\n" unless it's the first. False if it doesn't have the lines the index says */
+static bool indexed_add_text(list_t text, const struct indexed_chunk* chunk, bool first)
+{
+	const char* data = list_element_array(chunk->data), *end = data + chunk->plain_size;
+	int newlines = 0;
+	for (const char* pos = data; pos < end && (pos = memchr(pos, '\n', end - pos)); pos++)
+		newlines++;
+	if (newlines != chunk->line_count - 1)
+		return false;
+	int start = list_count(text) + !first;
+	list_resize(text, start + chunk->plain_size);
+	if (!first)
+		*LIST_GET(text, start - 1, char) = '\n';
+	memcpy((char*)list_element_array(text) + start, data, chunk->plain_size);
 	return true;
 }
 
-/* get file's extension given file type */
-const char* file_type_to_extension(file_type_t type)
+/* opens an indexed file, decoding a batch of chunks at a time on the worker threads */
+static rope_t indexed_open(FILE* stream)
 {
-	switch (type)
+	struct indexed_file file = { 0 };
+	bool indexed = indexed_read_index(stream, &file), result = indexed;
+
+	int capacity = thread_worker_count(), count = result ? list_count(file.chunks) : 0;
+	struct indexed_chunk** chunks = journal_malloc(sizeof * chunks * capacity);
+	bool* results = journal_malloc(sizeof * results * capacity);
+	struct indexed_batch batch = { .file = &file, .chunks = chunks, .results = results };
+	list_t text = list_create(sizeof(char));
+	for (int first = 0; first < count && result; first += capacity)
 	{
-	case TYPE_COMPRESSED:
-		return DMC_EXTENSION;
-	case TYPE_ENCRYPTED:
-		return AES_EXTENSION;
-	case TYPE_COMPRESSED | TYPE_ENCRYPTED:
-		return DMC_EXTENSION AES_EXTENSION;
+		int batch_count = min(capacity, count - first);
+		for (int i = 0; i < batch_count && result; i++)
+		{
+			chunks[i] = LIST_GET(file.chunks, first + i, struct indexed_chunk);
+			chunks[i]->data = list_create(sizeof(char));
+			list_resize(chunks[i]->data, chunks[i]->stored_size);
+			result = indexed_read_at(stream, chunks[i]->offset, list_element_array(chunks[i]->data), chunks[i]->stored_size);
+		}
+		if (result)
+			thread_run_jobs(indexed_decode_chunk, &batch, batch_count);
+		for (int i = 0; i < batch_count && result; i++)
+		{
+			result = results[i] && indexed_add_text(text, chunks[i], first + i == 0);
+			list_destroy(chunks[i]->data);
+			chunks[i]->data = NULL;
+		}
 	}
-	return PLAIN_EXTENSION;
+	if (indexed && !result)
+		debug_format("Chunk of indexed file is not valid, file is corrupt.\n");
+	free(chunks);
+	free(results);
+	indexed_free(&file);
+	rope_t lines = result ? rope_create_with_text(list_element_array(text), list_count(text)) : NULL;
+	list_destroy(text);
+	return lines;
 }
 
-/* returns type from extension. You can also pass a file directory in */
-file_type_t file_extension_to_type(const char* ext)
+/* splits lines into chunks, ending them on lines whose hash has its low bits clear */
+static list_t indexed_split(rope_t lines)
 {
-	const char* prev_last = NULL, *last = ext;
-	while (*ext++)
+	list_t chunks = list_create(sizeof(struct indexed_chunk));
+	struct indexed_chunk chunk = { .offset = -1 };
+	hash_state_t state;
+	hash_begin(&state, 0);
+	for (int i = 0, count = rope_line_count(lines); i < count; i++)
 	{
-		if (*ext == '.')
+		uint64_t hash = rope_line_hash(lines, i);
+		hash_update(&state, &hash, sizeof hash);
+		chunk.plain_size += rope_line_length(lines, i) + (chunk.line_count > 0);
+		chunk.line_count++;
+		if (i == count - 1 || chunk.plain_size >= INDEXED_MAX_CHUNK
+			|| (chunk.plain_size >= INDEXED_MIN_CHUNK && (hash & INDEXED_BOUNDARY_MASK) == 0))
 		{
-			prev_last = last;
-			last = ext;
+			chunk.hash = hash_end(&state);
+			LIST_PUSH(chunks, chunk);
+			chunk = (struct indexed_chunk){ .offset = -1, .start = chunk.start + chunk.plain_size + 1 };
+			hash_begin(&state, 0);
 		}
 	}
+	return chunks;
+}
 
-	file_type_t res = TYPE_PLAIN;
-
-	if (memcmp(last, DMC_EXTENSION, EXTENSION_LEN) == 0)
-		res |= TYPE_COMPRESSED;
-	else if (memcmp(last, AES_EXTENSION, EXTENSION_LEN) == 0)
-		res |= TYPE_ENCRYPTED;
-	
-	if (!prev_last)
-		return res;
-
-	if (memcmp(prev_last, DMC_EXTENSION, EXTENSION_LEN) == 0)
-		res |= TYPE_COMPRESSED;
-	else if (memcmp(prev_last, AES_EXTENSION, EXTENSION_LEN) == 0)
-		res |= TYPE_ENCRYPTED;
+/* open addressed table of the index of each of previous's chunks by hash, -1 for an empty slot. Its size is a power of two */
+static list_t indexed_map_chunks(const struct indexed_file* previous)
+{
+	int count = previous->chunks ? list_count(previous->chunks) : 0;
+	list_t map = list_create(sizeof(int));
+	list_resize(map, round_to_power_of_two(count * 2 + 1));
+	int* slots = list_element_array(map), mask = list_count(map) - 1;
+	memset(slots, -1, sizeof * slots * list_count(map));
+	for (int i = 0; i < count; i++)
+	{
+		int slot = (int)(LIST_GET(previous->chunks, i, struct indexed_chunk)->hash & mask);
+		while (slots[slot] >= 0)
+			slot = (slot + 1) & mask;
+		slots[slot] = i;
+	}
+	return map;
+}
 
-	return res;
+/* finds a chunk of previous with the same text through the table indexed_map_chunks made of them */
+static const struct indexed_chunk* indexed_find(const struct indexed_file* previous, list_t map, const struct indexed_chunk* chunk)
+{
+	const int* slots = list_element_array(map);
+	int mask = list_count(map) - 1;
+	for (int slot = (int)(chunk->hash & mask); slots[slot] >= 0; slot = (slot + 1) & mask)
+	{
+		const struct indexed_chunk* other = LIST_GET(previous->chunks, slots[slot], struct indexed_chunk);
+		if (other->hash == chunk->hash && other->plain_size == chunk->plain_size && other->line_count == chunk->line_count)
+			return other;
+	}
+	return NULL;
 }
 
-/*	https://github.com/m3y54m/aes-in-c
-	https://en.wikipedia.org/wiki/Rijndael_MixColumns
-	https://en.wikipedia.org/wiki/Finite_field_arithmetic#Rijndael's_(AES)_finite_field */
-
-/* KEY_SIZE can be 16, 24, or 32. 16 is the only tested constant. */
-#define KEY_SIZE		16
-#define EXP_KEY_SIZE	176
-#define STATE_SIZE		16 /* state is a 4x4 matrix, row-major */
-/* from "The Design of Rjindael:" "For Rijndael versions with a longer key, the number of rounds was raised by one for every additional 32 bits in the cipher key." */
-#define ROUND_COUNT		(6 + (KEY_SIZE / 4))
-#define AES_FILE_OFFSET	(sizeof aes_header + 16)
-
-static uint8_t aes_sbox[] =
-{
-	0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
-	0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
-	0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
-	0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
-	0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
-	0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
-	0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
-	0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
-	0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
-	0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
-	0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
-	0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
-	0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
-	0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
-	0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
-	0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
-};
+/* waits for everything written to reach the disk */
+static bool indexed_sync(FILE* stream)
+{
+	if (fflush(stream) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(stream)) == 0;
+#else
+	return fsync(fileno(stream)) == 0;
+#endif
+}
 
-static uint8_t aes_sbox_invert[] =
-{
-	0x52, 0x09, 0x6A, 0xD5, 0x30, 0x36, 0xA5, 0x38, 0xBF, 0x40, 0xA3, 0x9E, 0x81, 0xF3, 0xD7, 0xFB,
-	0x7C, 0xE3, 0x39, 0x82, 0x9B, 0x2F, 0xFF, 0x87, 0x34, 0x8E, 0x43, 0x44, 0xC4, 0xDE, 0xE9, 0xCB,
-	0x54, 0x7B, 0x94, 0x32, 0xA6, 0xC2, 0x23, 0x3D, 0xEE, 0x4C, 0x95, 0x0B, 0x42, 0xFA, 0xC3, 0x4E,
-	0x08, 0x2E, 0xA1, 0x66, 0x28, 0xD9, 0x24, 0xB2, 0x76, 0x5B, 0xA2, 0x49, 0x6D, 0x8B, 0xD1, 0x25,
-	0x72, 0xF8, 0xF6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xD4, 0xA4, 0x5C, 0xCC, 0x5D, 0x65, 0xB6, 0x92,
-	0x6C, 0x70, 0x48, 0x50, 0xFD, 0xED, 0xB9, 0xDA, 0x5E, 0x15, 0x46, 0x57, 0xA7, 0x8D, 0x9D, 0x84,
-	0x90, 0xD8, 0xAB, 0x00, 0x8C, 0xBC, 0xD3, 0x0A, 0xF7, 0xE4, 0x58, 0x05, 0xB8, 0xB3, 0x45, 0x06,
-	0xD0, 0x2C, 0x1E, 0x8F, 0xCA, 0x3F, 0x0F, 0x02, 0xC1, 0xAF, 0xBD, 0x03, 0x01, 0x13, 0x8A, 0x6B,
-	0x3A, 0x91, 0x11, 0x41, 0x4F, 0x67, 0xDC, 0xEA, 0x97, 0xF2, 0xCF, 0xCE, 0xF0, 0xB4, 0xE6, 0x73,
-	0x96, 0xAC, 0x74, 0x22, 0xE7, 0xAD, 0x35, 0x85, 0xE2, 0xF9, 0x37, 0xE8, 0x1C, 0x75, 0xDF, 0x6E,
-	0x47, 0xF1, 0x1A, 0x71, 0x1D, 0x29, 0xC5, 0x89, 0x6F, 0xB7, 0x62, 0x0E, 0xAA, 0x18, 0xBE, 0x1B,
-	0xFC, 0x56, 0x3E, 0x4B, 0xC6, 0xD2, 0x79, 0x20, 0x9A, 0xDB, 0xC0, 0xFE, 0x78, 0xCD, 0x5A, 0xF4,
-	0x1F, 0xDD, 0xA8, 0x33, 0x88, 0x07, 0xC7, 0x31, 0xB1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xEC, 0x5F,
-	0x60, 0x51, 0x7F, 0xA9, 0x19, 0xB5, 0x4A, 0x0D, 0x2D, 0xE5, 0x7A, 0x9F, 0x93, 0xC9, 0x9C, 0xEF,
-	0xA0, 0xE0, 0x3B, 0x4D, 0xAE, 0x2A, 0xF5, 0xB0, 0xC8, 0xEB, 0xBB, 0x3C, 0x83, 0x53, 0x99, 0x61,
-	0x17, 0x2B, 0x04, 0x7E, 0xBA, 0x77, 0xD6, 0x26, 0xE1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0C, 0x7D
-};
+/* cuts the file back to size bytes */
+static bool indexed_truncate(FILE* stream, int size)
+{
+#ifdef _WIN32
+	return _chsize_s(_fileno(stream), size) == 0;
+#else
+	return ftruncate(fileno(stream), size) == 0;
+#endif
+}
 
-static uint8_t aes_rcon[] = 
-{ 
-	0x8D, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36, 0x6C, 0xD8, 0xAB, 0x4D, 0x9A,
-	0x2F, 0x5E, 0xBC, 0x63, 0xC6, 0x97, 0x35, 0x6A, 0xD4, 0xB3, 0x7D, 0xFA, 0xEF, 0xC5, 0x91, 0x39,
-	0x72, 0xE4, 0xD3, 0xBD, 0x61, 0xC2, 0x9F, 0x25, 0x4A, 0x94, 0x33, 0x66, 0xCC, 0x83, 0x1D, 0x3A,
-	0x74, 0xE8, 0xCB, 0x8D, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36, 0x6C, 0xD8,
-	0xAB, 0x4D, 0x9A, 0x2F, 0x5E, 0xBC, 0x63, 0xC6, 0x97, 0x35, 0x6A, 0xD4, 0xB3, 0x7D, 0xFA, 0xEF,
-	0xC5, 0x91, 0x39, 0x72, 0xE4, 0xD3, 0xBD, 0x61, 0xC2, 0x9F, 0x25, 0x4A, 0x94, 0x33, 0x66, 0xCC,
-	0x83, 0x1D, 0x3A, 0x74, 0xE8, 0xCB, 0x8D, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B,
-	0x36, 0x6C, 0xD8, 0xAB, 0x4D, 0x9A, 0x2F, 0x5E, 0xBC, 0x63, 0xC6, 0x97, 0x35, 0x6A, 0xD4, 0xB3,
-	0x7D, 0xFA, 0xEF, 0xC5, 0x91, 0x39, 0x72, 0xE4, 0xD3, 0xBD, 0x61, 0xC2, 0x9F, 0x25, 0x4A, 0x94,
-	0x33, 0x66, 0xCC, 0x83, 0x1D, 0x3A, 0x74, 0xE8, 0xCB, 0x8D, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
-	0x40, 0x80, 0x1B, 0x36, 0x6C, 0xD8, 0xAB, 0x4D, 0x9A, 0x2F, 0x5E, 0xBC, 0x63, 0xC6, 0x97, 0x35,
-	0x6A, 0xD4, 0xB3, 0x7D, 0xFA, 0xEF, 0xC5, 0x91, 0x39, 0x72, 0xE4, 0xD3, 0xBD, 0x61, 0xC2, 0x9F,
-	0x25, 0x4A, 0x94, 0x33, 0x66, 0xCC, 0x83, 0x1D, 0x3A, 0x74, 0xE8, 0xCB, 0x8D, 0x01, 0x02, 0x04,
-	0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36, 0x6C, 0xD8, 0xAB, 0x4D, 0x9A, 0x2F, 0x5E, 0xBC, 0x63,
-	0xC6, 0x97, 0x35, 0x6A, 0xD4, 0xB3, 0x7D, 0xFA, 0xEF, 0xC5, 0x91, 0x39, 0x72, 0xE4, 0xD3, 0xBD,
-	0x61, 0xC2, 0x9F, 0x25, 0x4A, 0x94, 0x33, 0x66, 0xCC, 0x83, 0x1D, 0x3A, 0x74, 0xE8, 0xCB
-};
+/* writes the chunks that aren't in the file yet at the stream's position, offset, then the index, and once they're on the disk the footer */
+static bool indexed_write(FILE* stream, const struct indexed_file* file, list_t chunks, int offset)
+{
+	bool result = true;
+	for (int i = 0; i < list_count(chunks) && result; i++)
+	{
+		struct indexed_chunk* chunk = LIST_GET(chunks, i, struct indexed_chunk);
+		if (chunk->offset >= 0)
+			continue;
+		chunk->offset = offset;
+		result = (long long)offset + chunk->stored_size <= INT_MAX && fwrite(list_element_array(chunk->data), 1, chunk->stored_size, stream) == (size_t)chunk->stored_size;
+		offset += chunk->stored_size;
+	}
 
-static uint8_t aes_mix_vector[4] = { 2, 3, 1, 1 };
-static uint8_t aes_mix_inv_vector[4] = { 14, 11, 13, 9 };
+	list_t index = list_create(sizeof(char)), raw = list_create(sizeof(char));
+	list_resize(index, INDEXED_INDEX_PREFIX + list_count(chunks) * INDEXED_ENTRY_SIZE);
+	char* fields = list_element_array(index);
+	long long plain_size = list_count(chunks) - 1;
+	for (int i = 0; i < list_count(chunks); i++)
+	{
+		const struct indexed_chunk* chunk = LIST_GET(chunks, i, struct indexed_chunk);
+		int pos = INDEXED_INDEX_PREFIX + i * INDEXED_ENTRY_SIZE;
+		plain_size += chunk->plain_size;
+		store_int(fields, pos, list_count(index), chunk->offset);
+		store_int(fields, pos + INT_SIZE, list_count(index), chunk->stored_size);
+		store_int(fields, pos + INT_SIZE * 2, list_count(index), chunk->plain_size);
+		store_int(fields, pos + INT_SIZE * 3, list_count(index), chunk->line_count);
+		indexed_store_hash(fields, pos + INT_SIZE * 4, list_count(index), chunk->hash);
+	}
+	store_int(fields, 0, list_count(index), (int)plain_size);
+	store_int(fields, INT_SIZE, list_count(index), list_count(chunks));
+	result = result && plain_size <= INT_MAX;
+	if (file->type & TYPE_ENCRYPTED)
+	{
+		uint8_t aad[INDEXED_AAD_SIZE];
+		int aad_size = indexed_aad(file, offset, 0, false, aad);
+		result = result && indexed_encrypt(file, aad, aad_size, list_element_array(index), list_count(index), raw);
+	}
+	else
+		list_concat(raw, index, 0);
+
+	char footer[INDEXED_FOOTER_SIZE];
+	store_int(footer, 0, sizeof footer, offset);
+	store_int(footer, INT_SIZE, sizeof footer, list_count(raw));
+	memcpy(footer + INT_SIZE * 2, file->header, sizeof indexed_header + CHAR_SIZE);
+	result = result && (long long)offset + list_count(raw) + sizeof footer <= INT_MAX
+		&& fwrite(list_element_array(raw), 1, list_count(raw), stream) == (size_t)list_count(raw)
+		&& indexed_sync(stream) && fwrite(footer, 1, sizeof footer, stream) == sizeof footer;
+	list_destroy(index);
+	list_destroy(raw);
+	return indexed_sync(stream) && result;
+}
 
-static inline void aes_rotate_left(uint8_t word[4])
+/* writes the whole file to a temporary file next to it, which then replaces it */
+static bool indexed_rewrite(const char* directory, const struct indexed_file* file)
 {
-	uint8_t temp = word[0];
-	for (int i = 0; i < 3; i++)
-		word[i] = word[i + 1];
-	word[3] = temp;
+	char* temp = journal_malloc(strlen(directory) + sizeof INDEXED_TEMP_EXTENSION);
+	strcpy(temp, directory);
+	strcat(temp, INDEXED_TEMP_EXTENSION);
+	FILE* stream = fopen(temp, "wb");
+	bool result = stream && fwrite(file->header, 1, INDEXED_HEADER_SIZE, stream) == INDEXED_HEADER_SIZE
+		&& indexed_write(stream, file, file->chunks, INDEXED_HEADER_SIZE);
+	if (stream)
+		result = fclose(stream) == 0 && result;
+#ifdef _WIN32
+	result = result && MoveFileExA(temp, directory, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+	result = result && rename(temp, directory) == 0;
+#endif
+	if (stream && !result)
+		remove(temp);
+	free(temp);
+	return result;
 }
 
-static inline void aes_rotate_right(uint8_t word[4])
+/* salt of the file stream reads if it's an encrypted indexed file, false if it isn't one */
+static bool indexed_read_salt(FILE* stream, uint8_t salt[KDF_SALT_SIZE])
 {
-	uint8_t temp = word[3];
-	for (int i = 3; i > 0; i--)
-		word[i] = word[i - 1];
-	word[0] = temp;
+	uint8_t header[INDEXED_HEADER_SIZE];
+	if (!stream || !indexed_read_at(stream, 0, header, sizeof header) || memcmp(header, indexed_header, sizeof indexed_header) != 0
+		|| !(header[sizeof indexed_header + CHAR_SIZE] & TYPE_ENCRYPTED))
+		return false;
+	memcpy(salt, header + INDEXED_PREFIX + INT_SIZE, KDF_SALT_SIZE);
+	return true;
 }
 
-static void aes_expand_key(uint8_t key[KEY_SIZE], uint8_t expanded_key[EXP_KEY_SIZE])
+/*	saves lines in the indexed format. Chunks the file already has are kept where they are and the rest are
+	encoded on the worker threads and appended. Returns false without changing the file if anything fails */
+static bool indexed_save(const char* directory, rope_t lines, file_type_t type)
 {
-	for (int i = 0; i < KEY_SIZE; i++)
-		expanded_key[i] = key[i];
-
-	int pos = KEY_SIZE,
-		rcon_i = 1;
-	while (pos < EXP_KEY_SIZE)
+	struct indexed_file file = { 0 }, previous = { 0 };
+	FILE* stream = fopen(directory, "rb");
+	uint8_t salt[KDF_SALT_SIZE];
+	if (!indexed_create_header(&file, type, indexed_read_salt(stream, salt) ? salt : NULL))
 	{
-		uint8_t temp[4];
-		for (int i = 0; i < 4; i++)
-			temp[i] = expanded_key[pos - 4 + i];
-
-		if (pos % KEY_SIZE == 0)
+		if (stream)
+			fclose(stream);
+		return false;
+	}
+	bool reuse = stream && indexed_read_index(stream, &previous) && memcmp(previous.header, file.header, INDEXED_HEADER_SIZE) == 0;
+	if (!reuse)
+		indexed_free(&previous);
+
+	/* every chunk previous has is kept, the others are encoded */
+	file.chunks = indexed_split(lines);
+	int count = list_count(file.chunks), encoded = 0;
+	long long live = INDEXED_HEADER_SIZE, added = 0;
+	struct indexed_chunk** chunks = journal_malloc(sizeof * chunks * count);
+	list_t map = indexed_map_chunks(&previous);
+	for (int i = 0; i < count; i++)
+	{
+		struct indexed_chunk* chunk = LIST_GET(file.chunks, i, struct indexed_chunk);
+		const struct indexed_chunk* kept = indexed_find(&previous, map, chunk);
+		if (kept)
 		{
-			aes_rotate_left(temp);
-			for (int i = 0; i < 4; i++)
-				temp[i] = aes_sbox[temp[i]];
-			temp[0] ^= aes_rcon[rcon_i++];
+			chunk->offset = kept->offset;
+			chunk->stored_size = kept->stored_size;
 		}
+		else
+			chunks[encoded++] = chunk;
+	}
+	list_destroy(map);
+	bool* results = journal_malloc(sizeof * results * count);
+	struct indexed_batch batch = { .file = &file, .lines = lines, .chunks = chunks, .results = results };
+	thread_run_jobs(indexed_encode_chunk, &batch, encoded);
+	bool result = true;
+	for (int i = 0; i < encoded; i++)
+	{
+		result = result && results[i];
+		added += chunks[i]->stored_size;
+	}
+	for (int i = 0; i < count; i++)
+		live += LIST_GET(file.chunks, i, struct indexed_chunk)->stored_size;
+	free(chunks);
+	free(results);
+
+	bool unchanged = reuse && encoded == 0 && count == list_count(previous.chunks);
+	for (int i = 0; unchanged && i < count; i++)
+		unchanged = LIST_GET(file.chunks, i, struct indexed_chunk)->offset == LIST_GET(previous.chunks, i, struct indexed_chunk)->offset;
+
+	/* once what's out of date would take a share of what's in use, the chunks kept are read back and it's written again from the start */
+	long long dead = previous.size + added - live;
+	bool compact = reuse && !unchanged && (encoded == count || dead * INDEXED_DEAD_DIVISOR >= live || dead > INDEXED_MAX_DEAD);
+	for (int i = 0; i < count && compact && result; i++)
+	{
+		struct indexed_chunk* chunk = LIST_GET(file.chunks, i, struct indexed_chunk);
+		if (chunk->data)
+			continue;
+		chunk->data = list_create(sizeof(char));
+		list_resize(chunk->data, chunk->stored_size);
+		result = indexed_read_at(stream, chunk->offset, list_element_array(chunk->data), chunk->stored_size);
+		chunk->offset = -1;
+	}
+	if (stream)
+		fclose(stream);
 
-		for (int i = 0; i < 4; i++)
-		{
-			expanded_key[pos] = expanded_key[pos - KEY_SIZE] ^ temp[i];
-			pos++;
-		}
+	/* whatever a save cut off part way left after the last footer is cut off first */
+	if (result && !unchanged && reuse && !compact)
+	{
+		stream = fopen(directory, "r+b");
+		result = stream && indexed_truncate(stream, previous.size) && fseek(stream, previous.size, SEEK_SET) == 0
+			&& indexed_write(stream, &file, file.chunks, previous.size);
+		if (stream && !result)
+			indexed_truncate(stream, previous.size);
+		if (stream)
+			fclose(stream);
 	}
+	else if (result && !unchanged)
+		result = indexed_rewrite(directory, &file);
+#if _DEBUG
+	debug_format("Saved indexed file, %i of %i chunks encoded, %lli bytes added.\n", encoded, count, added);
+#endif
+	indexed_free(&file);
+	indexed_free(&previous);
+	return result;
 }
 
-static uint8_t aes_galois_multiply(uint8_t a, uint8_t b)
+static file_type_t file_read_header(const char* buf, int size)
 {
-	uint8_t p = 0;
-	while (a != 0 && b != 0)
+	file_type_t type = TYPE_PLAIN;
+	if (size >= 3)
 	{
-		if (b & 0b00000001)
-			p ^= a;
-		b >>= 1;
-		bool carry = a & 0b10000000;
-		a <<= 1;
-		if (carry)
-			a ^= 0b00011011;
+		if (dmc_is_compressed(buf, size))
+			type |= TYPE_COMPRESSED;
+		else if (memcmp(buf, aes_header, sizeof aes_header) == 0)
+			type |= TYPE_ENCRYPTED;
+		else if (size >= INDEXED_PREFIX && memcmp(buf, indexed_header, sizeof indexed_header) == 0)
+			type |= buf[INDEXED_PREFIX - CHAR_SIZE] & (TYPE_COMPRESSED | TYPE_ENCRYPTED);
 	}
-	return p;
+	return type;
 }
 
-static inline void aes_substitute_bytes(uint8_t state[STATE_SIZE], uint8_t sbox[sizeof aes_sbox])
+/* splits the stream into lines as it's read, "\r\n" is read as "\n" */
+static bool file_read_lines(reader_t reader, rope_t lines)
 {
-	for (int i = 0; i < STATE_SIZE; i++)
-		state[i] = sbox[state[i]];
+	char* buf = journal_malloc(STREAM_BUFFER_SIZE + 1);
+	coords_t position = { 0 };
+	bool held_return = false; /* "\r" at the end of the last read, dropped if a "\n" follows */
+	int size;
+	while ((size = reader_read(reader, buf + 1, STREAM_BUFFER_SIZE)) > 0)
+	{
+		char* start = buf + 1, *end = buf + 1 + size;
+		if (held_return && start[0] != '\n')
+			*--start = '\r';
+		held_return = end[-1] == '\r';
+		end -= held_return;
+
+		/* drop every "\r" that comes before a "\n" in place */
+		char* out = start;
+		for (char* in = start; in < end; in++)
+		{
+			if (*in != '\r' || in + 1 >= end || in[1] != '\n')
+				*out++ = *in;
+		}
+		editor_add_text(lines, start, (int)(out - start), &position);
+		position.column++; /* editor_add_text leaves position on the last character */
+	}
+	if (held_return)
+		editor_add_raw(lines, "\r", &position);
+	free(buf);
+	return size == 0;
 }
 
-static inline void aes_shift_rows_left(uint8_t state[STATE_SIZE])
+/* which file a path names, so every path to a file finds its mapping */
+typedef struct file_identity
 {
-	for (int i = 1; i < 4; i++) /* i = 1 because the first row is never shifted */
-	{
-		for (int j = 0; j < i; j++)
-			aes_rotate_left(state + i * 4);
-	}
+#ifdef _WIN32
+	DWORD volume, index_high, index_low;
+#else
+	dev_t device;
+	ino_t inode;
+#endif
+} file_identity_t;
+
+static bool file_same_identity(file_identity_t a, file_identity_t b)
+{
+#ifdef _WIN32
+	return a.volume == b.volume && a.index_high == b.index_high && a.index_low == b.index_low;
+#else
+	return a.device == b.device && a.inode == b.inode;
+#endif
 }
 
-static inline void aes_shift_rows_right(uint8_t state[STATE_SIZE])
+/* plain files are mapped read only, and their text is read straight from the mapping until it's saved over */
+struct file_mapping
 {
-	for (int i = 1; i < 4; i++) /* i = 1 because the first row is never shifted */
+	list_backing_t backing;
+	file_identity_t identity;
+	const char* view;
+	size_t size;
+#ifdef _WIN32
+	HANDLE handle;
+#endif
+	struct file_mapping* next;
+};
+
+static struct file_mapping* file_mappings = NULL;
+
+#ifdef _WIN32
+static file_identity_t file_identity_of(const BY_HANDLE_FILE_INFORMATION* info)
+{
+	return (file_identity_t) { info->dwVolumeSerialNumber, info->nFileIndexHigh, info->nFileIndexLow };
+}
+#else
+static file_identity_t file_identity_of(const struct stat* info)
+{
+	return (file_identity_t) { info->st_dev, info->st_ino };
+}
+#endif
+
+static struct file_mapping* file_find_mapping(const char* directory)
+{
+	file_identity_t identity;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(directory, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	BY_HANDLE_FILE_INFORMATION info;
+	bool found = file != INVALID_HANDLE_VALUE && GetFileInformationByHandle(file, &info);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	if (!found)
+		return NULL;
+#else
+	struct stat info;
+	if (stat(directory, &info) != 0)
+		return NULL;
+#endif
+	identity = file_identity_of(&info);
+	struct file_mapping* mapping = file_mappings;
+	while (mapping && !file_same_identity(mapping->identity, identity))
+		mapping = mapping->next;
+	return mapping;
+}
+
+/* called once the last rope reading from the mapping owns its text or is destroyed */
+static void file_unmap(list_backing_t* backing)
+{
+	struct file_mapping* mapping = (struct file_mapping*)backing;
+	struct file_mapping** link = &file_mappings;
+	while (*link != mapping)
+		link = &(*link)->next;
+	*link = mapping->next;
+#ifdef _WIN32
+	UnmapViewOfFile(mapping->view);
+	CloseHandle(mapping->handle);
+#else
+	munmap((void*)mapping->view, mapping->size);
+#endif
+	free(mapping);
+}
+
+/* maps the whole file, NULL if it's too small or can't be mapped */
+static struct file_mapping* file_map(const char* directory)
+{
+	struct file_mapping* mapping = journal_malloc(sizeof * mapping);
+	*mapping = (struct file_mapping){ .backing = { .release = file_unmap } };
+#ifdef _WIN32
+	HANDLE file = CreateFileA(directory, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	BY_HANDLE_FILE_INFORMATION info;
+	if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &size) && size.QuadPart >= MAP_MIN_SIZE && size.QuadPart <= INT_MAX
+		&& GetFileInformationByHandle(file, &info))
+	{
+		mapping->identity = file_identity_of(&info);
+		mapping->handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		mapping->view = mapping->handle ? MapViewOfFile(mapping->handle, FILE_MAP_READ, 0, 0, 0) : NULL;
+		mapping->size = (size_t)size.QuadPart;
+		if (mapping->handle && !mapping->view)
+			CloseHandle(mapping->handle);
+	}
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file); /* the mapping keeps the file open */
+#else
+	int file = open(directory, O_RDONLY);
+	struct stat info;
+	if (file >= 0 && fstat(file, &info) == 0 && info.st_size >= MAP_MIN_SIZE && info.st_size <= INT_MAX)
+	{
+		mapping->identity = file_identity_of(&info);
+		void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		mapping->view = view == MAP_FAILED ? NULL : view;
+		mapping->size = (size_t)info.st_size;
+	}
+	if (file >= 0)
+		close(file); /* the mapping keeps the file open */
+#endif
+	if (!mapping->view)
 	{
-		for (int j = 0; j < i; j++)
-			aes_rotate_right(state + i * 4);
+		free(mapping);
+		return NULL;
 	}
+	mapping->next = file_mappings;
+	file_mappings = mapping;
+	return mapping;
 }
 
-static inline void aes_add_round_key(uint8_t state[STATE_SIZE], uint8_t round_key[STATE_SIZE])
+/* formatting a mapped file needs, replacing removed characters at an offset of the mapping with spaces */
+struct map_edit
 {
-	for (int i = 0; i < STATE_SIZE; i++)
-		state[i] ^= round_key[i];
-}
+	int at;
+	int removed, spaces;
+};
 
-/* 
-	the multiplication matrix for mixing columns is either:
-		2 3 1 1
-		1 2 3 1
-		1 1 2 3
-		3 1 1 2
-	or the inverse:
-		14 11 13 09
-		09 14 11 13
-		13 09 14 11
-		11 13 09 14
-	Since each row is the the one before it shifted right, 
-	we can just pass a vector in instead of the whole matrix
-*/
-static inline void aes_mix_columns(uint8_t state[STATE_SIZE], uint8_t vector[4])
+/*	creates lines over a mapped plain file without copying it. Tabs are expanded, "\r\n" is read as "\n" and a NUL ends the
+	file the same as editor_add_raw, each by editing the lines so the rest is still read from the mapping. Every edit splits
+	a piece off, so NULL if the file needs more than one per MAP_EDIT_SPACING bytes and is cheaper to read in one go */
+static rope_t file_map_lines(struct file_mapping* mapping)
 {
-	for (int i = 0; i < 4; i++)
+	static const char spaces[TAB_SIZE] = "    ";
+	list_t edits = list_create(sizeof(struct map_edit));
+	int max_edits = (int)(mapping->size / MAP_EDIT_SPACING);
+	const char* pos = mapping->view, *end = mapping->view + mapping->size;
+	int column = 0; /* column pos is at once the edits before it are made */
+	while (list_count(edits) <= max_edits)
 	{
-		uint8_t col_cpy[4];
-		for (int j = 0; j < 4; j++)
-			col_cpy[j] = state[j * 4 + i];
-		
-		for (int j = 0; j < 4; j++)
+		const char* found = editor_find_break(pos, end);
+		column += (int)(found - pos);
+		if (found == end)
+			break;
+		struct map_edit edit = { .at = (int)(found - mapping->view) };
+		if (*found == '\0')
 		{
-			state[j * 4 + i] =
-				aes_galois_multiply(col_cpy[j], vector[0])
-				^ aes_galois_multiply(col_cpy[(j + 3) % 4], vector[3])
-				^ aes_galois_multiply(col_cpy[(j + 2) % 4], vector[2])
-				^ aes_galois_multiply(col_cpy[(j + 1) % 4], vector[1]);
+			edit.removed = (int)(end - found);
+			LIST_PUSH(edits, edit);
+			break;
 		}
+		if (*found == '\n')
+		{
+			column = 0;
+			if (found > mapping->view && found[-1] == '\r')
+			{
+				edit.at--;
+				edit.removed = 1;
+				LIST_PUSH(edits, edit);
+			}
+		}
+		else
+		{
+			edit.removed = 1;
+			edit.spaces = TAB_SIZE - column % TAB_SIZE;
+			column += edit.spaces;
+			LIST_PUSH(edits, edit);
+		}
+		pos = found + 1;
+	}
+	if (list_count(edits) > max_edits)
+	{
+		list_destroy(edits);
+		return NULL;
+	}
+
+	rope_t lines = rope_create_borrowed(mapping->view, (int)mapping->size, &mapping->backing);
+	int shift = 0; /* characters the edits so far added, less the ones they removed */
+	for (int i = 0; i < list_count(edits); i++)
+	{
+		const struct map_edit* edit = LIST_GET(edits, i, struct map_edit);
+		rope_delete(lines, edit->at + shift, edit->removed);
+		rope_insert(lines, edit->at + shift, spaces, edit->spaces);
+		shift += edit->spaces - edit->removed;
 	}
+	list_destroy(edits);
+	return lines;
 }
 
-static inline void aes_create_round_key(uint8_t exp_key_section[KEY_SIZE], uint8_t out_key[KEY_SIZE])
+/* copies lines out of any mapping of directory, false if the mapping is still held elsewhere and the file can't be written */
+static bool file_release_mapping(const char* directory, rope_t lines)
 {
-	for (int i = 0; i < 4; i++)
+	if (!file_find_mapping(directory))
+		return true;
+	rope_own(lines);
+	if (file_find_mapping(directory))
 	{
-		for (int j = 0; j < 4; j++)
-			out_key[i + j * 4] = exp_key_section[i * 4 + j];
+		debug_format("\"%s\" is still mapped by other lines, not saving over it.\n", directory);
+		return false;
 	}
+	return true;
 }
 
-static void aes_encrypt_chunk(uint8_t input[STATE_SIZE], uint8_t output[STATE_SIZE], uint8_t key[KEY_SIZE])
+/* determines type of file and then opens it through the matching readers, a buffer at a time. Large plain files are mapped instead */
+file_details_t file_open(const char* directory)
 {
-	uint8_t exp_key[EXP_KEY_SIZE];
-	aes_expand_key(key, exp_key);
-
-	uint8_t state[STATE_SIZE];
-	for (int i = 0; i < 4; i++)
+	assert(directory != NULL);
+	struct file_mapping* mapping = file_map(directory);
+	if (mapping)
 	{
-		for (int j = 0; j < 4; j++)
-			state[i + j * 4] = input[i * 4 + j];
+		rope_t lines = file_read_header(mapping->view, (int)min(mapping->size, (size_t)STREAM_PEEK_SIZE)) == TYPE_PLAIN
+			? file_map_lines(mapping) : NULL;
+		if (lines)
+			return (file_details_t) { .directory = directory, .lines = lines, .type = TYPE_PLAIN };
+		file_unmap(&mapping->backing);
 	}
 
-	uint8_t round_key[STATE_SIZE];
-	aes_create_round_key(exp_key, round_key);
-	aes_add_round_key(state, round_key);
+	FILE* file = fopen(directory, "rb");
+	if (!file)
+		return FAILED_FILE_DETAILS;
 
-	for (int i = 1; i < 10; i++)
+	char header[INDEXED_PREFIX];
+	reader_t reader = reader_create_file(file);
+	int header_size = reader_peek(reader, header, sizeof header);
+	file_type_t type = file_read_header(header, header_size);
+	if (header_size >= (int)sizeof indexed_header && memcmp(header, indexed_header, sizeof indexed_header) == 0)
 	{
-		aes_create_round_key(exp_key + KEY_SIZE * i, round_key);
+		reader_destroy(reader);
+		rope_t lines = indexed_open(file);
+		fclose(file);
+		return lines ? (file_details_t) { .directory = directory, .lines = lines, .type = type } : FAILED_FILE_DETAILS;
+	}
+	if (type & TYPE_ENCRYPTED)
+	{
+		reader = aes_reader_create(reader);
+		type |= file_read_header(header, reader_peek(reader, header, sizeof header));
+	}
+	if (type & TYPE_COMPRESSED)
+		reader = dmc_reader_create(reader);
 
-		aes_substitute_bytes(state, aes_sbox);
-		aes_shift_rows_left(state);
-		aes_mix_columns(state, aes_mix_vector);
-		aes_add_round_key(state, round_key);
+	rope_t lines = rope_create();
+	bool result = file_read_lines(reader, lines);
+	reader_destroy(reader);
+	fclose(file);
+	if (!result)
+	{
+		rope_destroy(lines);
+		return FAILED_FILE_DETAILS;
 	}
+	return (file_details_t) { .directory = directory, .lines = lines, .type = type };
+}
 
-	aes_create_round_key(exp_key + KEY_SIZE * ROUND_COUNT, round_key);
+/* writes lines a piece of their text at a time */
+static bool file_write_lines(writer_t writer, const rope_t lines)
+{
+	for (int offset = 0, size; offset < rope_length(lines); offset += size)
+	{
+		const char* text = rope_text(lines, offset, &size);
+		if (!writer_write(writer, text, size))
+			return false;
+	}
+	return true;
+}
 
-	aes_substitute_bytes(state, aes_sbox);
-	aes_shift_rows_left(state);
-	aes_add_round_key(state, round_key);
+/* saves console's file given user's current settings. Compressed and encrypted files only encode the chunks that changed */
+bool file_save(const file_details_t details)
+{
+	assert(details.directory != NULL);
+	if (!file_release_mapping(details.directory, details.lines))
+		return false;
+	if (details.type != TYPE_PLAIN)
+		return indexed_save(details.directory, details.lines, details.type);
+	FILE* file = fopen(details.directory, "wb");
+	if (!file)
+		return false;
 
-	for (int i = 0; i < 4; i++)
+	writer_t writer = writer_create_file(file);
+	bool result = file_write_lines(writer, details.lines);
+	result = writer_close(writer) && result;
+	writer_destroy(writer);
+	fclose(file);
+	if (!result)
+		clear_file(details.directory);
+	return result;
+}
+
+/* get file's extension given file type */
+const char* file_type_to_extension(file_type_t type)
+{
+	switch (type)
 	{
-		for (int j = 0; j < 4; j++)
-			output[i * 4 + j] = state[i + j * 4];
+	case TYPE_COMPRESSED:
+		return DMC_EXTENSION;
+	case TYPE_ENCRYPTED:
+		return AES_EXTENSION;
+	case TYPE_COMPRESSED | TYPE_ENCRYPTED:
+		return DMC_EXTENSION AES_EXTENSION;
 	}
+	return PLAIN_EXTENSION;
 }
 
-static void aes_decrypt_chunk(uint8_t input[STATE_SIZE], uint8_t output[STATE_SIZE], uint8_t key[KEY_SIZE])
+/* returns type from extension. You can also pass a file directory in */
+file_type_t file_extension_to_type(const char* ext)
 {
-	uint8_t exp_key[EXP_KEY_SIZE];
-	aes_expand_key(key, exp_key);
-
-	uint8_t state[STATE_SIZE];
-	for (int i = 0; i < 4; i++)
+	const char* prev_last = NULL, *last = ext;
+	while (*ext++)
 	{
-		for (int j = 0; j < 4; j++)
-			state[i + j * 4] = input[i * 4 + j];
+		if (*ext == '.')
+		{
+			prev_last = last;
+			last = ext;
+		}
 	}
 
-	uint8_t round_key[STATE_SIZE];
-	aes_create_round_key(exp_key + ROUND_COUNT * KEY_SIZE, round_key);
-	aes_add_round_key(state, round_key);
+	file_type_t res = TYPE_PLAIN;
 
-	for (int i = ROUND_COUNT - 1; i > 0; i--)
-	{
-		aes_create_round_key(exp_key + KEY_SIZE * i, round_key);
+	if (memcmp(last, DMC_EXTENSION, EXTENSION_LEN) == 0)
+		res |= TYPE_COMPRESSED;
+	else if (memcmp(last, AES_EXTENSION, EXTENSION_LEN) == 0)
+		res |= TYPE_ENCRYPTED;
+	
+	if (!prev_last)
+		return res;
 
-		aes_shift_rows_right(state);
-		aes_substitute_bytes(state, aes_sbox_invert);
-		aes_add_round_key(state, round_key);
-		aes_mix_columns(state, aes_mix_inv_vector);
-	}
+	if (memcmp(prev_last, DMC_EXTENSION, EXTENSION_LEN) == 0)
+		res |= TYPE_COMPRESSED;
+	else if (memcmp(prev_last, AES_EXTENSION, EXTENSION_LEN) == 0)
+		res |= TYPE_ENCRYPTED;
 
-	aes_create_round_key(exp_key, round_key);
+	return res;
+}
 
-	aes_shift_rows_right(state);
-	aes_substitute_bytes(state, aes_sbox_invert);
-	aes_add_round_key(state, round_key);
+#define AES_STRIPE_SIZE	0x10000 /* bytes each worker thread encrypts or decrypts at a time */
 
-	for (int i = 0; i < 4; i++)
-	{
-		for (int j = 0; j < 4; j++)
-			output[i * 4 + j] = state[i + j * 4];
-	}
+struct aes_stripes
+{
+	const aes_context_t* ctx;
+	const uint8_t* in;
+	uint8_t* out;
+	int block_count;
+	bool encrypt;
+};
+
+static void aes_crypt_stripe(void* ctx, int index)
+{
+	const struct aes_stripes* stripes = ctx;
+	int first = index * (AES_STRIPE_SIZE / AES_BLOCK_SIZE);
+	int count = min(AES_STRIPE_SIZE / AES_BLOCK_SIZE, stripes->block_count - first);
+	const uint8_t* in = stripes->in + first * AES_BLOCK_SIZE;
+	uint8_t* out = stripes->out + first * AES_BLOCK_SIZE;
+	if (stripes->encrypt)
+		aes_encrypt_blocks(stripes->ctx, in, out, count);
+	else
+		aes_decrypt_blocks(stripes->ctx, in, out, count);
 }
 
-/* TO DO: use PBKDF2-SHA256, the plain text user input seed has awful entropy */
+/* blocks are independent, so they are split into stripes across the worker threads */
+static void aes_crypt_parallel(const aes_context_t* ctx, const uint8_t* in, uint8_t* out, int block_count, bool encrypt)
+{
+	struct aes_stripes stripes = { .ctx = ctx, .in = in, .out = out, .block_count = block_count, .encrypt = encrypt };
+	int stripe_blocks = AES_STRIPE_SIZE / AES_BLOCK_SIZE;
+	thread_run_jobs(aes_crypt_stripe, &stripes, (block_count + stripe_blocks - 1) / stripe_blocks);
+}
 
+/* only used to derive keys of files saved before the switch to PBKDF2 */
 struct isaac_state
 {
 	uint32_t mm[256], seed[256];
@@ -605,94 +1206,102 @@ static struct isaac_state* isaac_init(const char* seed)
 #undef ISAAC_MIX
 }
 
-static bool aes_open(const list_t in, list_t out)
+/* derives the key of older files from the user's password, the check bytes are written after the header of the old format */
+static bool aes_password_key(uint8_t key[AES_KEY_SIZE], uint8_t check[16])
 {
-	assert(in && list_element_size(in) == sizeof(char) && out && list_element_size(out) == sizeof(char));
-	int size = list_count(in);
-	uint8_t* buf = list_element_array(in);
-	if (size < AES_FILE_OFFSET)
-		return false;
-
-	if (memcmp(buf, aes_header, sizeof aes_header) != 0)
-		return false;
-
-	uint8_t key[KEY_SIZE];
 	struct isaac_state* rng = isaac_init(user_password);
 	if (!rng)
 		return false;
-	for (int i = 0; i < KEY_SIZE; i++)
+	for (int i = 0; i < AES_KEY_SIZE; i++)
 		key[i] = rng->seed[rng->pos++] % 0x100;
-	for (int i = sizeof aes_header; i < AES_FILE_OFFSET; i++)
-	{
-		if (buf[i] != rng->seed[rng->pos++] % 0x100)
-		{
-			debug_format("Password is not valid.\n");
-			return false;
-		}
-	}
+	for (int i = 0; i < 16; i++)
+		check[i] = rng->seed[rng->pos++] % 0x100;
 	free(rng);
+	return true;
+}
+
+/* reads files saved before the indexed format, whose blocks are encrypted on their own */
+struct aes_reader
+{
+	bool started, ended;
+	aes_context_t cipher;
+	uint8_t* raw;					/* encrypted blocks of the last buffer read */
+	uint8_t* plain;					/* decrypted output of the last buffer read */
+	int plain_size, plain_pos;
+};
 
-	buf += AES_FILE_OFFSET;
-	size -= AES_FILE_OFFSET;
+static void aes_reader_free(void* state)
+{
+	struct aes_reader* reader = state;
+	free(reader->raw);
+	free(reader->plain);
+	free(reader);
+}
 
-	int chunk_count = size / STATE_SIZE;
-	for (int i = 0; i < chunk_count * STATE_SIZE; i += STATE_SIZE)
+static bool aes_reader_start(struct aes_reader* reader, reader_t source)
+{
+	/* the check bytes start right after the header */
+	uint8_t header[sizeof aes_header], key[AES_KEY_SIZE], check[16], stored[16];
+	if (reader_read_full(source, header, sizeof header) != sizeof header || memcmp(header, aes_header, sizeof aes_header) != 0
+		|| reader_read_full(source, stored, sizeof stored) != sizeof stored || !aes_password_key(key, check))
+		return false;
+	if (memcmp(stored, check, sizeof check) != 0)
 	{
-		uint8_t chunk[16] = { 0 }, output[16];
-		memcpy(chunk, buf + i, STATE_SIZE);
-		aes_decrypt_chunk(chunk, output, key);
-		for (int j = 0; j < STATE_SIZE; j++)
-			LIST_PUSH(out, output[j]);
+		debug_format("Password is not valid.\n");
+		return false;
 	}
-#if _DEBUG
-	debug_format("Opened file with AES using password \"%s\"\n", user_password);
-#endif
+	aes_init(&reader->cipher, key);
+	reader->raw = journal_malloc(STREAM_BUFFER_SIZE);
+	reader->plain = journal_malloc(STREAM_BUFFER_SIZE);
 	return true;
 }
 
-static bool aes_save(const list_t in, list_t out)
+static bool aes_read_buffer(struct aes_reader* reader, reader_t source)
 {
-	assert(in && list_element_size(in) == sizeof(char) && out && list_element_size(out) == sizeof(char));
-
-	LIST_PUSH(out, aes_header[0]);
-	LIST_PUSH(out, aes_header[1]);
-	LIST_PUSH(out, aes_header[2]);
-
-	uint8_t key[KEY_SIZE];
-	struct isaac_state* rng = isaac_init(user_password);
-	if (!rng)
+	int size = reader_read_full(source, reader->raw, STREAM_BUFFER_SIZE);
+	if (size < 0)
 		return false;
-	for (int i = 0; i < KEY_SIZE; i++)
-		key[i] = rng->seed[rng->pos++] % 0x100;
-	for (int i = 0; i < 16; i++)
-		LIST_PUSH_PRIMITIVE(out, rng->seed[rng->pos++] % 0x100);
-	free(rng);
-
-	int size = list_count(in);
-	uint8_t* buf = list_element_array(in);
+	reader->ended = size < STREAM_BUFFER_SIZE;
+	aes_crypt_parallel(&reader->cipher, reader->raw, reader->plain, size / AES_BLOCK_SIZE, false);
+	reader->plain_size = size / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
+	reader->plain_pos = 0;
+	return true;
+}
 
-	int chunk_count = size / STATE_SIZE + 1;
-	for (int i = 0; i < chunk_count * STATE_SIZE; i += STATE_SIZE)
+static int aes_reader_read(void* state, reader_t source, char* buf, int size)
+{
+	struct aes_reader* reader = state;
+	if (!reader->started)
 	{
-		int curr_chunk_size = min(STATE_SIZE, size - i);
-		if (curr_chunk_size <= 0)
-			break;
-
-		uint8_t chunk[16] = { 0 }, output[16];
-		memcpy(chunk, buf + i, curr_chunk_size);
-		aes_encrypt_chunk(chunk, output, key);
-		for (int j = 0; j < STATE_SIZE; j++)
-			LIST_PUSH(out, output[j]);
+		reader->started = true;
+		if (!aes_reader_start(reader, source))
+			return -1;
+	}
+	for (;;)
+	{
+		if (reader->plain_pos < reader->plain_size)
+		{
+			int count = min(size, reader->plain_size - reader->plain_pos);
+			memcpy(buf, reader->plain + reader->plain_pos, count);
+			reader->plain_pos += count;
+			return count;
+		}
+		if (reader->ended)
+			return 0;
+		if (!aes_read_buffer(reader, source))
+			return -1;
 	}
+}
 
-#if _DEBUG
-	debug_format("Saved file using AES with password \"%s\"\n", user_password);
-#endif
-	return true;
+/* creates reader that decrypts files saved before the indexed format as source is read */
+static reader_t aes_reader_create(reader_t source)
+{
+	struct aes_reader* reader = journal_malloc(sizeof * reader);
+	*reader = (struct aes_reader){ 0 };
+	return reader_create(aes_reader_read, aes_reader_free, reader, source);
 }
 
 #ifdef TEST
-#define FILE_TEST
 #ifdef FILE_TEST
 #include <time.h>
 
@@ -709,300 +1318,228 @@ int main()
 	rand_str(password, sizeof password);
 	file_set_password(password);
 
-	file_details_t test = { .directory = "aes_test_start.txt", .lines = list_create(sizeof(line_t)) };
+	file_details_t test = { .directory = "aes_test_start.txt", .type = TYPE_PLAIN, .lines = rope_create() };
+	coords_t position = { 0 };
 	for (int i = 0; i < 128; i++)
 	{
-		char buf[32];
-		rand_str(buf, sizeof buf);
-		line_t line = { .string = list_create_with_array(buf, sizeof(char), sizeof buf - 1) /* exclude NUL terminator */ };
-		LIST_PUSH(test.lines, line);
+		char buf[33] = { 0 };
+		rand_str(buf, sizeof buf - 1);
+		buf[sizeof buf - 2] = '\n';
+		editor_add_text(test.lines, buf, sizeof buf - 1 /* exclude NUL terminator */, &position);
+		position.column++;
 	}
 
-	assert(file_save(test, TYPE_PLAIN));
+	assert(file_save(test));
 	test.directory = "aes_test_start.aes";
-	assert(file_save(test, TYPE_ENCRYPTED));
-	file_details_t read = file_open(test.directory, TYPE_ENCRYPTED);
-	assert(!IS_BAD_DETAILS(read));
-	for (int i = 0; i < list_count(read.lines); i++)
+	test.type = TYPE_ENCRYPTED;
+	assert(file_save(test));
+	file_details_t read = file_open(test.directory);
+	assert(!IS_BAD_DETAILS(read) && read.type == TYPE_ENCRYPTED);
+	assert(rope_line_count(read.lines) == rope_line_count(test.lines));
+	for (int i = 0; i < rope_line_count(read.lines); i++)
 	{
-		list_t str = LIST_GET(read.lines, i, line_t)->string;
-		for (int j = 0; j < list_count(str); j++)
-			assert(*LIST_GET(str, j, char) == *LIST_GET(LIST_GET(test.lines, i, line_t)->string, j, char));
+		int count, test_count;
+		char str[33];
+		const char* line = rope_line(read.lines, i, &count);
+		assert(count <= (int)sizeof str);
+		memcpy(str, line, count); /* the next rope_line call can replace the copy line points to */
+		assert(memcmp(str, rope_line(test.lines, i, &test_count), count) == 0 && count == test_count);
 	}
 	read.directory = "aes_test.end.txt";
-	assert(file_save(read, TYPE_PLAIN));
-}
-#else
-#include <Windows.h>
-
-/* each completed in ~1 second */
-
-#define ENCRYPT_COUNT 0x20000
-#define DECRYPT_COUNT 0x18000
-
-int main()
-{
-	LARGE_INTEGER freq, start, end;
-	QueryPerformanceFrequency(&freq);
-
-	QueryPerformanceCounter(&start);
-	srand(start.QuadPart);
-
-	uint8_t input[16], output[16], decrypt[16], key[16];
-	for (int i = 0; i < 16; i++)
+	read.type = TYPE_PLAIN;
+	assert(file_save(read));
+	rope_destroy(read.lines);
+	rope_destroy(test.lines);
+
+	/* large files are mapped, unless they need too much formatting and are read in one go instead */
+	static const char* newlines[] = { "\n", "\r\n" };
+	for (int i = 0; i < 2; i++)
 	{
-		input[i] = rand();
-		key[i] = rand();
+		FILE* file = fopen("aes_test_map.txt", "wb");
+		assert(file);
+		for (int row = 0; row < 400000; row++)
+			fprintf(file, "line %i of the log%s", row, newlines[i]);
+		fclose(file);
+		clock_t start = clock();
+		file_details_t mapped = file_open("aes_test_map.txt");
+		double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+		assert(!IS_BAD_DETAILS(mapped) && rope_line_count(mapped.lines) == 400001);
+		int count;
+		const char* line = rope_line(mapped.lines, 399999, &count);
+		assert(count == 22 && memcmp(line, "line 399999 of the log", 22) == 0);
+		printf("Opened %i lines ending in %s in %.3fs.\n", rope_line_count(mapped.lines), i ? "\"\\r\\n\"" : "\"\\n\"", seconds);
+		rope_destroy(mapped.lines);
 	}
-
-	QueryPerformanceCounter(&start);
-	for (int i = 0; i < ENCRYPT_COUNT; i++)
-		aes_encrypt_chunk(input, output, key);
-	QueryPerformanceCounter(&end);
-	printf("Encrypted %i chunks in %fs.\n", ENCRYPT_COUNT, (end.QuadPart - start.QuadPart) / (double)freq.QuadPart);
-
-	QueryPerformanceCounter(&start);
-	for (int i = 0; i < DECRYPT_COUNT; i++)
-		aes_decrypt_chunk(output, decrypt, key);
-	QueryPerformanceCounter(&end);
-	bool success = memcmp(input, decrypt, STATE_SIZE) == 0;
-	printf("%s %i chunks in %fs.\n", success ? "Successfully decrypted" : "Failed to decrypt", DECRYPT_COUNT, (end.QuadPart - start.QuadPart) / (double)freq.QuadPart);
+	return 0;
 }
 #endif
-#endif
-
-/*	https://webhome.cs.uvic.ca/~nigelh/Publications/DMC.pd
-	https://web.archive.org/web/20070630111546/http://plg.uwaterloo.ca/~ftp/dmc/dmc.c */
-
-#define BIT_COUNT		CHAR_BIT
-#define STRANDS			(1 << BIT_COUNT)
-#define MIN_CNT1		2 /* Minimum "number of observed transitions from the current state to the candidate state" in order to clone */
-#define MIN_CNT2		2 /* Minimum "number of observed transitions from all states other than the current state to the candidate state" in order to clone */
-#define CLONE_COUNT		0x80000 /* sizeof(struct node) * CLONE_COUNT = 16mB */
+#ifdef SAVE_TEST
+#include <time.h>
 
-struct node
-{
-	float count[2];			/* how many transistions occured out of this state */
-	struct node* next[2];	/* next node(s) in tree */
-};
+#define TEST_LINES		60000
+#define TEST_DIRECTORY	"save_test.dmc.aes"
 
-struct dmc_state
+static bool save_test_same(rope_t a, rope_t b)
 {
-	struct node* curr;
-	struct node* clone_buf, *max_cb, *curr_cb; /* cb ~ Clone Buffer */
-	struct node nodes[256][256];
-};
-
-/*	As described in the paper, the "braid" structure is best suited
-	for byte-oriented data as it better remembers details between bytes.
-	So, it's best to use it for a word processor. */
-static void dmc_predictor_braid(struct dmc_state* state)
-{
-	/* TO DO: Adapt to BIT_COUNT and STRANDS macros */
-	for (int j = 0; j < 256; j++)
-	{
-		/* 1-7th bit */
-		for (int i = 0; i < 127; i++)
-		{
-			state->nodes[j][i].count[0] = 0.2F;
-			state->nodes[j][i].count[1] = 0.2F;
-			state->nodes[j][i].next[0] = &state->nodes[j][2 * i + 1];
-			state->nodes[j][i].next[1] = &state->nodes[j][2 * i + 2];
-		}
-
-		/* 8th bit */
-		for (int i = 127; i < 255; i++)
-		{
-			state->nodes[j][i].count[0] = 0.2F;
-			state->nodes[j][i].count[1] = 0.2F;
-			state->nodes[j][i].next[0] = &state->nodes[i + 1][0];
-			state->nodes[j][i].next[1] = &state->nodes[i - 127][0];
-		}
-	}
-	state->curr_cb = state->clone_buf;
-	state->curr = &state->nodes[0][0];
+	list_t x = list_create(sizeof(char)), y = list_create(sizeof(char));
+	editor_copy_all_lines(a, x);
+	editor_copy_all_lines(b, y);
+	bool result = list_count(x) == list_count(y) && memcmp(list_element_array(x), list_element_array(y), list_count(x)) == 0;
+	list_destroy(x);
+	list_destroy(y);
+	return result;
 }
 
-/* Initializes clone buffer */
-static void dmc_predictor_init(struct dmc_state* state)
+/* saves lines and opens them again, returns seconds the save took or -1 if what's read back is different */
+static double save_test_round_trip(file_details_t details, long* size)
 {
-	state->clone_buf = journal_malloc(sizeof * state->clone_buf * CLONE_COUNT);
-	state->max_cb = state->clone_buf + CLONE_COUNT - 20; /* TO DO: why -20? */
-	dmc_predictor_braid(state);
+	clock_t start = clock();
+	bool result = file_save(details);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	file_details_t read = file_open(details.directory);
+	result = result && !IS_BAD_DETAILS(read) && read.type == details.type && save_test_same(details.lines, read.lines);
+	if (!IS_BAD_DETAILS(read))
+		rope_destroy(read.lines);
+	FILE* file = fopen(details.directory, "rb");
+	*size = file && fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+	if (file)
+		fclose(file);
+	return result ? seconds : -1;
 }
 
-/* returns chance for interval */
-static float dmc_predictor(struct dmc_state* state)
+/* changes count rows spread evenly through lines */
+static void save_test_edit(rope_t lines, int count)
 {
-	return state->curr->count[0] / (state->curr->count[0] + state->curr->count[1]);
+	for (int i = 0; i < count; i++)
+		editor_add_char(lines, '#', (coords_t) { .row = (int)((long long)rope_line_count(lines) * i / count + 7) % rope_line_count(lines) });
 }
 
-static void dmc_predictor_update(struct dmc_state* state, bool bit)
+int main()
 {
-	int i = (int)!!bit;
-	struct node* p = state->curr;
-	if (p->count[i] >= MIN_CNT1
-		&& p->next[i]->count[0] + p->next[i]->count[1] >= MIN_CNT2 + p->count[i])
+	int wrong_count = 0;
+	srand(1);
+	file_set_password("password");
+	kdf_set_iterations(1000);
+	remove(TEST_DIRECTORY);
+
+	/* a journal of sentences made of made up words */
+	file_details_t details = { .directory = TEST_DIRECTORY, .type = TYPE_COMPRESSED | TYPE_ENCRYPTED, .lines = rope_create() };
+	coords_t position = { 0 };
+	for (int i = 0; i < TEST_LINES; i++)
 	{
-		struct node* new = state->curr_cb++;
-		float r = p->count[i] / (p->next[i]->count[1] + p->next[i]->count[0]);
-		new->count[0] = p->next[i]->count[0] * r;
-		new->count[1] = p->next[i]->count[1] * r;
-		p->next[i]->count[0] -= new->count[0];
-		p->next[i]->count[1] -= new->count[1];
-		new->next[0] = p->next[i]->next[0];
-		new->next[1] = p->next[i]->next[1];
-		p->next[i] = new;
+		char line[128];
+		int size = 0, words = rand() % 16;
+		for (int j = 0; j < words; j++)
+		{
+			for (int length = 2 + rand() % 7; length > 0; length--)
+				line[size++] = "etaoinshrdlucmfw"[rand() % 16];
+			line[size++] = j == words - 1 ? '.' : ' ';
+		}
+		line[size++] = '\n';
+		editor_add_text(details.lines, line, size, &position);
+		position.column++;
 	}
-	p->count[i]++;
-	state->curr = p->next[i];
-	if (state->curr_cb > state->max_cb)
+
+	/* every other type is written and read back the same */
+	const file_type_t types[] = { TYPE_COMPRESSED, TYPE_ENCRYPTED };
+	for (int i = 0; i < sizeof types / sizeof * types; i++)
 	{
-		debug_format("Ran out of predictor memory, flushing...\n");
-		dmc_predictor_braid(state);
+		long size;
+		file_details_t other = { .directory = i ? "save_test.aes" : "save_test.dmc", .type = types[i], .lines = details.lines };
+		remove(other.directory);
+		wrong_count += save_test_round_trip(other, &size) < 0;
+		save_test_edit(details.lines, 10);
+		wrong_count += save_test_round_trip(other, &size) < 0;
+		remove(other.directory);
 	}
-}
-
-#undef max
-#undef min
 
-static bool dmc_open(const list_t in, list_t out)
-{
-	assert(in && list_element_size(in) == sizeof(char) && out && list_element_size(out) == sizeof(char));
-	
-	int size = list_count(in);
-	const char* buf = list_element_array(in);
-	if (size < 6)
-		return false;
-
-	if (memcmp(buf, dmc_header, sizeof dmc_header) != 0)
-		return false;
-	
-	struct dmc_state* state = journal_malloc(sizeof * state);
-	dmc_predictor_init(state);
-
-	int max = 0x1000000,
-		min = 0,
-		mid;
-
-	int in_bytes = 3,
-		out_bytes = 0,
-		pin = in_bytes; /* TO DO: what does pin represent? */
-
-	int val = (buf[3] << 16) + (buf[4] << 8) + buf[5];
-	for (int i = 6; i < size; )
+	/* a mapped plain file is copied out of its mapping before it's saved over, whichever path it's saved through */
+	long size;
+	file_details_t plain = { .directory = "save_test.txt", .type = TYPE_PLAIN, .lines = details.lines };
+	remove(plain.directory);
+	wrong_count += save_test_round_trip(plain, &size) < 0;
+	file_details_t mapped = file_open("." PATH_SEPARATOR "save_test.txt");
+	wrong_count += IS_BAD_DETAILS(mapped);
+	if (!IS_BAD_DETAILS(mapped))
 	{
-		int ch = 0;
-		for (int j = 0; j < 8; j++)
-		{
-			mid = (int)(min + (max - min - 1) * dmc_predictor(state));
-			if (mid == min)
-				mid++;
-			if (mid == (max - 1))
-				mid--;
-			bool bit = false;
-			if (val >= mid)
-			{
-				bit = true;
-				min = mid;
-			}
-			else
-				max = mid;
-			dmc_predictor_update(state, bit);
-			ch = (ch << 1) + bit;
-			while ((max - min) < 0x100)
-			{
-				if (bit)
-					max--;
-				in_bytes++;
-				char nxt;
-				read_char(buf, i++, size, &nxt);
-				val = (val << 8) & 0xFFFF00 | (nxt & 0xFF);
-				min = (min << 8) & 0xFFFF00;
-				max = (max << 8) & 0xFFFF00;
-				if (min >= max)
-					max = 0x1000000;
-			}
-		}
-		LIST_PUSH(out, (char)ch);
-		if (!(++out_bytes & 0xFF))
-		{
-			if (in_bytes - pin > 0x100)
-				dmc_predictor_braid(state);
-			pin = in_bytes;
-		}
+		mapped.directory = plain.directory;
+		editor_add_char(mapped.lines, '#', (coords_t) { 0 });
+		wrong_count += save_test_round_trip(mapped, &size) < 0;
+		rope_destroy(mapped.lines);
 	}
-
-	debug_format("Opened file compressed with Dynamic Markov Compression, in: %i, out: %i\n", in_bytes, out_bytes);
-	return true;
-}
-
-static bool dmc_save(const list_t in, list_t out)
-{
-	assert(in && list_element_size(in) == sizeof(char) && out && list_element_size(out) == sizeof(char));
-
-	int size = list_count(in);
-	const char* buf = list_element_array(in);
-
-	LIST_PUSH(out, dmc_header[0]);
-	LIST_PUSH(out, dmc_header[1]);
-	LIST_PUSH(out, dmc_header[2]);
-	
-	struct dmc_state* state = journal_malloc(sizeof * state);
-	dmc_predictor_init(state);
-	
-	/* interval variables */
-	int max = 0x1000000,
-		min = 0,
-		mid;
-
-	int in_bytes = 0, 
-		out_bytes = 3, 
-		pout = out_bytes; /* TO DO: what does pout represent? */
-
-	for (int i = 0; i < size; i++)
+	remove(plain.directory);
+
+	/* benchmark, time taken saving against how much was edited since the last save */
+	double seconds = save_test_round_trip(details, &size);
+	wrong_count += seconds < 0;
+	long whole = size; /* size written from the start, what chunks kept after an edit add to */
+	printf("Saved %i lines in %.3fs, %li bytes.\n", rope_line_count(details.lines), seconds, size);
+	const int edits[] = { 0, 1, 10, 100, 1000, TEST_LINES / 10 };
+	for (int i = 0; i < sizeof edits / sizeof * edits; i++)
 	{
-		for (int j = 0; j < BIT_COUNT; j++)
-		{
-			bool bit = ((int)buf[i] << j) & 0x80;
-			mid = (int)(min + (max - min - 1) * dmc_predictor(state));
-			dmc_predictor_update(state, bit);
-			if (mid == min)
-				mid++;
-			if (mid == (max - 1))
-				mid--;
-			if (bit)
-				min = mid;
-			else
-				max = mid;
-
-			while ((max - min) < 0x100)
-			{
-				if (bit)
-					max--;
-				LIST_PUSH_PRIMITIVE(out, min >> 16);
-				out_bytes++;
-				min = (min << 8) & 0xFFFF00;
-				max = (max << 8) & 0xFFFF00;
-				if (min >= max)
-					max = 0x1000000;
-			}
-		}
-
-		if (!(++in_bytes & 0xFF))
-		{
-			if (out_bytes - pout > 0x100)
-				dmc_predictor_braid(state);
-			pout = out_bytes;
-		}
+		save_test_edit(details.lines, edits[i]);
+		seconds = save_test_round_trip(details, &size);
+		wrong_count += seconds < 0;
+		printf("Saved after editing %i lines in %.3fs, %li bytes (%+.1f%% over a whole save).\n", edits[i], seconds, size, 100.0 * (size - whole) / whole);
 	}
 
-	min = max - 1;
-	LIST_PUSH_PRIMITIVE(out, min >> 16);
-	LIST_PUSH_PRIMITIVE(out, (min >> 8) & 0xFF);
-	LIST_PUSH_PRIMITIVE(out, min & 0xFF);
+	/* a new file gets a salt of its own, not the one of the file saved before it */
+	file_details_t copy = { .directory = "save_test.aes", .type = TYPE_ENCRYPTED, .lines = details.lines };
+	remove(copy.directory);
+	wrong_count += save_test_round_trip(copy, &size) < 0;
+	uint8_t salt[KDF_SALT_SIZE], copy_salt[KDF_SALT_SIZE];
+	FILE* original = fopen(TEST_DIRECTORY, "rb"), *copied = fopen(copy.directory, "rb");
+	wrong_count += !indexed_read_salt(original, salt) || !indexed_read_salt(copied, copy_salt) || memcmp(salt, copy_salt, sizeof salt) == 0;
+	if (original)
+		fclose(original);
+	if (copied)
+		fclose(copied);
+	remove(copy.directory);
+
+	/* lines added and removed in the middle only change the chunks around them */
+	position = (coords_t){ .row = rope_line_count(details.lines) / 2 };
+	editor_add_raw(details.lines, "A new line.\nAnd another.\n", &position);
+	editor_delete_region(details.lines, (coords_t) { .row = 100 }, (coords_t) { .row = 103 });
+	seconds = save_test_round_trip(details, &size);
+	wrong_count += seconds < 0;
+	printf("Saved after adding and removing lines in %.3fs, %li bytes.\n", seconds, size);
+
+	/* a save cut off part way leaves the file opening as the save before it, and the next save writes over what it left */
+	long saved = size, cut_size;
+	save_test_edit(details.lines, 1);
+	wrong_count += save_test_round_trip(details, &cut_size) < 0;
+	editor_delete_region(details.lines, (coords_t) { .row = 7 }, (coords_t) { .row = 7 });
+	const long cuts[] = { cut_size - 1, saved + (cut_size - saved) / 2 };
+	for (int i = 0; i < sizeof cuts / sizeof * cuts; i++)
+	{
+		FILE* file = fopen(TEST_DIRECTORY, "r+b");
+		wrong_count += !file || !indexed_truncate(file, cuts[i]);
+		if (file)
+			fclose(file);
+		file_details_t recovered = file_open(TEST_DIRECTORY);
+		wrong_count += IS_BAD_DETAILS(recovered) || !save_test_same(details.lines, recovered.lines);
+		if (!IS_BAD_DETAILS(recovered))
+			rope_destroy(recovered.lines);
+	}
+	save_test_edit(details.lines, 1);
+	seconds = save_test_round_trip(details, &size);
+	wrong_count += seconds < 0;
+	printf("Saved over a save cut off part way in %.3fs, %li bytes.\n", seconds, size);
+
+	/* a file whose index doesn't authenticate isn't opened */
+	FILE* file = fopen(TEST_DIRECTORY, "r+b");
+	fseek(file, size - INDEXED_FOOTER_SIZE - 1, SEEK_SET);
+	int ch = fgetc(file);
+	fseek(file, size - INDEXED_FOOTER_SIZE - 1, SEEK_SET);
+	fputc(~ch, file);
+	fclose(file);
+	file_details_t tampered = file_open(TEST_DIRECTORY);
+	wrong_count += !IS_BAD_DETAILS(tampered);
+	remove(TEST_DIRECTORY);
 
-	free(state);
-	debug_format("Compressed file with Dynamic Markov Compression, in: %i, out: %i\n", in_bytes, out_bytes);
-	return true;
-}
\ No newline at end of file
+	printf("Save test resulted in %i mismatches.\n", wrong_count);
+	rope_destroy(details.lines);
+	return wrong_count;
+}
+#endif
+#endif
\ No newline at end of file
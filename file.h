@@ -24,7 +24,7 @@ typedef struct file_details
 {
 	const char* directory;
 	file_type_t type;
-	list_t lines;
+	rope_t lines;
 } file_details_t;
 
 /* sets password with a max len of 64 */
@@ -0,0 +1,351 @@
+/*
+	hash.c ~ RL
+
+	Fast 64-bit non-cryptographic hashing, in one go or a piece at a time
+*/
+
+#include "hash.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include "util.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define HASH_SSE2_SUPPORTED
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+/*	https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+	https://github.com/wangyi-fudan/wyhash
+
+	Input of a stripe or less is hashed the way wyhash does, with a few 128-bit multiplies. Longer input is read a
+	stripe at a time into eight accumulators the way XXH3 does, which SSE2 runs two lanes at a time, and scrambled
+	every block of stripes. The last bytes are always left to the short hash, so the result doesn't depend on how
+	the input was split up. Reads are little-endian. */
+
+#define HASH_BLOCK_STRIPES		16
+
+static const uint64_t hash_secret[16] =
+{
+	0xE220A8397B1DCDAF, 0x6E789E6AA1B965F4, 0x06C45D188009454F, 0xF88BB8A8724C81EC,
+	0x1B39896A51A8749B, 0x53CB9F0C747EA2EA, 0x2C829ABE1F4532E1, 0xC584133AC916AB3C,
+	0x3EE5789041C98AC3, 0xF3B8488C368CB0A6, 0x657EECDD3CB13D09, 0xC2D326E0055BDEF6,
+	0x8621A03FE0BBDB7B, 0x8E1F7555983AA92F, 0xB54E0F1600CC4D19, 0x84BB3F97971D80AB,
+};
+
+static inline uint64_t hash_read64(const uint8_t* p)
+{
+	uint64_t result;
+	memcpy(&result, p, sizeof result);
+	return result;
+}
+
+static inline uint64_t hash_read32(const uint8_t* p)
+{
+	uint32_t result;
+	memcpy(&result, p, sizeof result);
+	return result;
+}
+
+/* 128-bit product of a and b, low half in a and high half in b */
+static inline void hash_multiply(uint64_t* a, uint64_t* b)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 product = (unsigned __int128)*a * *b;
+	*a = (uint64_t)product;
+	*b = (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	*a = _umul128(*a, *b, b);
+#else
+	uint64_t high_a = *a >> 32, low_a = (uint32_t)*a, high_b = *b >> 32, low_b = (uint32_t)*b;
+	uint64_t high = high_a * high_b, middle_a = high_a * low_b, middle_b = high_b * low_a, low = low_a * low_b;
+	uint64_t sum = low + (middle_a << 32), carry = sum < low;
+	uint64_t result = sum + (middle_b << 32);
+	carry += result < sum;
+	*a = result;
+	*b = high + (middle_a >> 32) + (middle_b >> 32) + carry;
+#endif
+}
+
+/* folds the 128-bit product of a and b into 64 bits */
+static inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+	hash_multiply(&a, &b);
+	return a ^ b;
+}
+
+/* hash of a stripe or less */
+static uint64_t hash_short(const uint8_t* p, size_t size, uint64_t seed)
+{
+	assert(size <= HASH_STRIPE_SIZE);
+	seed ^= hash_mix(seed ^ hash_secret[12], hash_secret[13]);
+	uint64_t a, b;
+	if (size <= 16)
+	{
+		if (size >= 4)
+		{
+			/* two overlapping reads from each end cover every byte */
+			size_t middle = (size >> 3) << 2;
+			a = (hash_read32(p) << 32) | hash_read32(p + middle);
+			b = (hash_read32(p + size - 4) << 32) | hash_read32(p + size - 4 - middle);
+		}
+		else if (size > 0)
+		{
+			a = ((uint64_t)p[0] << 16) | ((uint64_t)p[size >> 1] << 8) | p[size - 1];
+			b = 0;
+		}
+		else
+			a = b = 0;
+	}
+	else
+	{
+		size_t remaining = size;
+		for (; remaining > 16; remaining -= 16, p += 16)
+			seed = hash_mix(hash_read64(p) ^ hash_secret[13], hash_read64(p + 8) ^ seed);
+		/* the last 16 bytes, overlapping ones already read */
+		a = hash_read64(p + remaining - 16);
+		b = hash_read64(p + remaining - 8);
+	}
+	a ^= hash_secret[13];
+	b ^= seed;
+	hash_multiply(&a, &b);
+	return hash_mix(a ^ hash_secret[14] ^ size, b ^ hash_secret[15]);
+}
+
+/* adds count stripes at p to the accumulators. SSE2 builds only keep it to check against */
+#if !defined(HASH_SSE2_SUPPORTED) || defined(HASH_TEST)
+static void hash_stripes_scalar(uint64_t* accumulators, const uint8_t* p, int count)
+{
+	for (; count > 0; count--, p += HASH_STRIPE_SIZE)
+	{
+		for (int lane = 0; lane < 8; lane++)
+		{
+			uint64_t value = hash_read64(p + lane * 8), key = value ^ hash_secret[lane];
+			accumulators[lane ^ 1] += value;
+			accumulators[lane] += (key & 0xFFFFFFFF) * (key >> 32);
+		}
+	}
+}
+#endif
+
+#ifdef HASH_SSE2_SUPPORTED
+static void hash_stripes_sse2(uint64_t* accumulators, const uint8_t* p, int count)
+{
+	__m128i sums[4], keys[4];
+	for (int i = 0; i < 4; i++)
+	{
+		sums[i] = _mm_loadu_si128((const __m128i*)accumulators + i);
+		keys[i] = _mm_loadu_si128((const __m128i*)hash_secret + i);
+	}
+	for (; count > 0; count--, p += HASH_STRIPE_SIZE)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			__m128i value = _mm_loadu_si128((const __m128i*)p + i);
+			__m128i key = _mm_xor_si128(value, keys[i]);
+			/* high half of each lane's key moved down, so one multiply does low * high for both lanes */
+			__m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+			__m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+			sums[i] = _mm_add_epi64(sums[i], _mm_add_epi64(swapped, product));
+		}
+	}
+	for (int i = 0; i < 4; i++)
+		_mm_storeu_si128((__m128i*)accumulators + i, sums[i]);
+}
+#endif
+
+static void hash_stripes(uint64_t* accumulators, const uint8_t* p, int count)
+{
+#ifdef HASH_SSE2_SUPPORTED
+	hash_stripes_sse2(accumulators, p, count);
+#else
+	hash_stripes_scalar(accumulators, p, count);
+#endif
+}
+
+/* spreads the accumulators' high bits back down at the end of each block, before sums wrap around */
+static void hash_scramble(uint64_t* accumulators)
+{
+	for (int lane = 0; lane < 8; lane++)
+	{
+		uint64_t value = accumulators[lane];
+		value ^= value >> 47;
+		value ^= hash_secret[8 + lane];
+		accumulators[lane] = value * 0x9E3779B1;
+	}
+}
+
+/* hashes count stripes at p into state, scrambling at the end of every block */
+static void hash_consume(hash_state_t* state, const uint8_t* p, size_t count)
+{
+	while (count > 0)
+	{
+		int run = (int)min(count, (size_t)(HASH_BLOCK_STRIPES - state->block_stripes));
+		hash_stripes(state->accumulators, p, run);
+		p += (size_t)run * HASH_STRIPE_SIZE;
+		count -= run;
+		state->block_stripes += run;
+		if (state->block_stripes == HASH_BLOCK_STRIPES)
+		{
+			hash_scramble(state->accumulators);
+			state->block_stripes = 0;
+		}
+	}
+}
+
+/* starts a hash that bytes are added to with hash_update */
+void hash_begin(hash_state_t* state, uint64_t seed)
+{
+	assert(state);
+	*state = (hash_state_t){ .seed = seed };
+	for (int lane = 0; lane < 8; lane++)
+		state->accumulators[lane] = hash_secret[lane] + seed;
+}
+
+/* adds size bytes of data to the hash */
+void hash_update(hash_state_t* state, const void* data, size_t size)
+{
+	assert(state && (data || size == 0));
+	const uint8_t* p = data;
+	state->size += size;
+	if (state->buffered + size <= HASH_STRIPE_SIZE)
+	{
+		if (size > 0)
+			memcpy(state->buffer + state->buffered, p, size);
+		state->buffered += (int)size;
+		return;
+	}
+
+	/* more follows the buffer, so it's a whole stripe that can be hashed */
+	if (state->buffered > 0)
+	{
+		size_t fill = HASH_STRIPE_SIZE - state->buffered;
+		memcpy(state->buffer + state->buffered, p, fill);
+		p += fill;
+		size -= fill;
+		hash_consume(state, state->buffer, 1);
+	}
+	/* the last stripe or less is kept for hash_end, even if it's whole */
+	size_t stripes = (size - 1) / HASH_STRIPE_SIZE;
+	hash_consume(state, p, stripes);
+	p += stripes * HASH_STRIPE_SIZE;
+	size -= stripes * HASH_STRIPE_SIZE;
+	memcpy(state->buffer, p, size);
+	state->buffered = (int)size;
+}
+
+/* hash of every byte added so far. More can still be added after */
+uint64_t hash_end(const hash_state_t* state)
+{
+	assert(state);
+	if (state->size <= HASH_STRIPE_SIZE)
+		return hash_short(state->buffer, state->buffered, state->seed);
+
+	uint64_t result = (uint64_t)state->size * hash_secret[0] ^ state->seed;
+	for (int lane = 0; lane < 8; lane += 2)
+		result += hash_mix(state->accumulators[lane] ^ hash_secret[8 + lane], state->accumulators[lane + 1] ^ hash_secret[9 + lane]);
+	result ^= result >> 37;
+	result *= 0x165667919E3779F9;
+	result ^= result >> 32;
+	return hash_mix(result ^ hash_secret[1], hash_short(state->buffer, state->buffered, state->seed) ^ hash_secret[2]);
+}
+
+/* hashes size bytes of data, a different seed gives an unrelated hash */
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+	assert(data || size == 0);
+	/* lines are mostly this short, so they skip the accumulators */
+	if (size <= HASH_STRIPE_SIZE)
+		return hash_short(data, size, seed);
+	hash_state_t state;
+	hash_begin(&state, seed);
+	hash_update(&state, data, size);
+	return hash_end(&state);
+}
+
+#ifdef TEST
+#ifdef HASH_TEST
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TEST_MAX_SIZE		1200
+#define TEST_BENCH_SIZE		(64 * 1024 * 1024)
+#define TEST_LINE_SIZE		40
+
+/* the byte-at-a-time hash list_hash used to be, which stops at a NUL */
+static uint64_t hash_test_djb2(const char* str)
+{
+	uint64_t hash = 5381;
+	int c;
+	while (c = *str++)
+		hash = ((hash << 5) + hash) ^ c;
+	return hash;
+}
+
+int main()
+{
+	int wrong_count = 0;
+	srand(3);
+	uint8_t* buf = malloc(TEST_BENCH_SIZE + 1);
+	for (int i = 0; i < TEST_BENCH_SIZE; i++)
+		buf[i] = (uint8_t)(1 + rand() % 255);
+	buf[TEST_BENCH_SIZE] = '\0';
+
+	/* every way of splitting input gives the hash of the whole */
+	for (int size = 0; size <= TEST_MAX_SIZE; size++)
+	{
+		uint64_t expected = hash_bytes(buf, size, size);
+		hash_state_t state;
+		hash_begin(&state, size);
+		for (int pos = 0, piece; pos < size; pos += piece)
+		{
+			piece = rand() % 150;
+			piece = min(piece, size - pos);
+			hash_update(&state, buf + pos, piece);
+		}
+		wrong_count += hash_end(&state) != expected;
+		wrong_count += size > 0 && hash_bytes(buf, size, size + 1) == expected;
+	}
+
+#ifdef HASH_SSE2_SUPPORTED
+	uint64_t scalar[8] = { 1, 2, 3, 4, 5, 6, 7, 8 }, sse2[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	hash_stripes_scalar(scalar, buf, 1000);
+	hash_stripes_sse2(sse2, buf, 1000);
+	wrong_count += memcmp(scalar, sse2, sizeof scalar) != 0;
+#endif
+
+	/* every bit is hashed, including ones past a NUL */
+	uint8_t message[100] = { 0 };
+	uint64_t hashes[sizeof message * 8 + 1];
+	hashes[0] = hash_bytes(message, sizeof message, 0);
+	for (int bit = 0; bit < sizeof message * 8; bit++)
+	{
+		message[bit / 8] ^= 1 << bit % 8;
+		hashes[bit + 1] = hash_bytes(message, sizeof message, 0);
+		message[bit / 8] ^= 1 << bit % 8;
+		for (int i = 0; i <= bit; i++)
+			wrong_count += hashes[i] == hashes[bit + 1];
+	}
+	printf("Hash test resulted in %i mismatches.\n", wrong_count);
+
+	clock_t start = clock();
+	uint64_t sink = hash_bytes(buf, TEST_BENCH_SIZE, 0);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	start = clock();
+	sink ^= hash_test_djb2((const char*)buf);
+	double djb2_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	start = clock();
+	for (int i = 0; i + TEST_LINE_SIZE <= TEST_BENCH_SIZE; i += TEST_LINE_SIZE)
+		sink ^= hash_bytes(buf + i, TEST_LINE_SIZE, 0);
+	double line_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("Hashed %i MB in %.3fs, %.3fs with djb2. %i-byte lines took %.3fs (%llx).\n",
+		TEST_BENCH_SIZE >> 20, seconds, djb2_seconds, TEST_LINE_SIZE, line_seconds, (unsigned long long)sink & 0xF);
+	free(buf);
+	return 0;
+}
+#endif
+#endif
\ No newline at end of file
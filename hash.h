@@ -0,0 +1,33 @@
+/*
+	hash.h ~ RL
+
+	Fast 64-bit non-cryptographic hashing, in one go or a piece at a time
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_STRIPE_SIZE		64
+
+/* hash being built from pieces. Every way of splitting the same bytes ends with the same hash as hash_bytes */
+typedef struct hash_state
+{
+	uint64_t accumulators[8];
+	uint64_t seed;
+	long long size;		/* bytes passed so far */
+	int block_stripes;	/* stripes hashed since the accumulators were last scrambled */
+	int buffered;		/* bytes of buffer waiting to be hashed, only a whole stripe is hashed once more follow it */
+	uint8_t buffer[HASH_STRIPE_SIZE];
+} hash_state_t;
+
+/* hashes size bytes of data, a different seed gives an unrelated hash */
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed);
+
+/* starts a hash that bytes are added to with hash_update */
+void hash_begin(hash_state_t* state, uint64_t seed);
+/* adds size bytes of data to the hash */
+void hash_update(hash_state_t* state, const void* data, size_t size);
+/* hash of every byte added so far. More can still be added after */
+uint64_t hash_end(const hash_state_t* state);
\ No newline at end of file
@@ -0,0 +1,343 @@
+/*
+	kdf.c ~ RL
+
+	Password based key derivation (PBKDF2-SHA256) with a cache of derived keys
+*/
+
+#include "kdf.h"
+#include <assert.h>
+#include <string.h>
+#include "util.h"
+
+/*	https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.180-4.pdf
+	https://www.rfc-editor.org/rfc/rfc8018#section-5.2 */
+
+#define ROTR(x, n)		(((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t sha256_k[64] =
+{
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static void sha256_compress(uint32_t state[8], const uint8_t block[SHA256_BLOCK_SIZE])
+{
+	uint32_t w[64];
+	for (int i = 0; i < 16; i++)
+		w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+	for (int i = 16; i < 64; i++)
+	{
+		uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+	for (int i = 0; i < 64; i++)
+	{
+		uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+/* starts a new hash */
+void sha256_init(sha256_t* sha)
+{
+	static const uint32_t initial[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+	memcpy(sha->state, initial, sizeof initial);
+	sha->length = 0;
+	sha->block_size = 0;
+}
+
+/* hashes size more bytes */
+void sha256_update(sha256_t* sha, const void* data, size_t size)
+{
+	assert(sha && (data || size == 0));
+	const uint8_t* bytes = data;
+	sha->length += size;
+	while (size > 0)
+	{
+		if (sha->block_size == 0 && size >= SHA256_BLOCK_SIZE)
+		{
+			sha256_compress(sha->state, bytes);
+			bytes += SHA256_BLOCK_SIZE;
+			size -= SHA256_BLOCK_SIZE;
+			continue;
+		}
+		size_t count = min(size, (size_t)(SHA256_BLOCK_SIZE - sha->block_size));
+		memcpy(sha->block + sha->block_size, bytes, count);
+		sha->block_size += (int)count;
+		bytes += count;
+		size -= count;
+		if (sha->block_size == SHA256_BLOCK_SIZE)
+		{
+			sha256_compress(sha->state, sha->block);
+			sha->block_size = 0;
+		}
+	}
+}
+
+/* pads and writes the digest */
+void sha256_final(sha256_t* sha, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	uint64_t bits = sha->length * 8;
+	sha->block[sha->block_size++] = 0x80;
+	if (sha->block_size > SHA256_BLOCK_SIZE - 8)
+	{
+		memset(sha->block + sha->block_size, 0, SHA256_BLOCK_SIZE - sha->block_size);
+		sha256_compress(sha->state, sha->block);
+		sha->block_size = 0;
+	}
+	memset(sha->block + sha->block_size, 0, SHA256_BLOCK_SIZE - 8 - sha->block_size);
+	for (int i = 0; i < 8; i++)
+		sha->block[SHA256_BLOCK_SIZE - 1 - i] = (uint8_t)(bits >> (8 * i));
+	sha256_compress(sha->state, sha->block);
+	for (int i = 0; i < 8; i++)
+	{
+		digest[i * 4] = (uint8_t)(sha->state[i] >> 24);
+		digest[i * 4 + 1] = (uint8_t)(sha->state[i] >> 16);
+		digest[i * 4 + 2] = (uint8_t)(sha->state[i] >> 8);
+		digest[i * 4 + 3] = (uint8_t)sha->state[i];
+	}
+}
+
+/* inner and outer hashes with the padded key already absorbed */
+struct hmac_keys
+{
+	sha256_t inner, outer;
+};
+
+static void hmac_sha256_init(struct hmac_keys* keys, const void* key, size_t key_size)
+{
+	uint8_t block[SHA256_BLOCK_SIZE] = { 0 };
+	if (key_size > SHA256_BLOCK_SIZE)
+	{
+		sha256_t sha;
+		sha256_init(&sha);
+		sha256_update(&sha, key, key_size);
+		sha256_final(&sha, block);
+	}
+	else if (key_size > 0)
+		memcpy(block, key, key_size);
+
+	uint8_t pad[SHA256_BLOCK_SIZE];
+	for (int i = 0; i < SHA256_BLOCK_SIZE; i++)
+		pad[i] = block[i] ^ 0x36;
+	sha256_init(&keys->inner);
+	sha256_update(&keys->inner, pad, sizeof pad);
+	for (int i = 0; i < SHA256_BLOCK_SIZE; i++)
+		pad[i] = block[i] ^ 0x5C;
+	sha256_init(&keys->outer);
+	sha256_update(&keys->outer, pad, sizeof pad);
+	memset(block, 0, sizeof block);
+	memset(pad, 0, sizeof pad);
+}
+
+static void hmac_sha256_finish(const struct hmac_keys* keys, sha256_t* inner, uint8_t mac[SHA256_DIGEST_SIZE])
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	sha256_final(inner, digest);
+	sha256_t outer = keys->outer;
+	sha256_update(&outer, digest, sizeof digest);
+	sha256_final(&outer, mac);
+}
+
+/* writes HMAC-SHA256 of data */
+void hmac_sha256(const void* key, size_t key_size, const void* data, size_t size, uint8_t mac[SHA256_DIGEST_SIZE])
+{
+	struct hmac_keys keys;
+	hmac_sha256_init(&keys, key, key_size);
+	sha256_t inner = keys.inner;
+	sha256_update(&inner, data, size);
+	hmac_sha256_finish(&keys, &inner, mac);
+}
+
+/* derives out_size bytes with PBKDF2-HMAC-SHA256 */
+void pbkdf2_sha256(const void* password, size_t password_size, const void* salt, size_t salt_size, int iterations, uint8_t* out, size_t out_size)
+{
+	assert(iterations > 0 && out);
+	/* the padded password is hashed once, every iteration after that is two compressions */
+	struct hmac_keys keys;
+	hmac_sha256_init(&keys, password, password_size);
+
+	for (uint32_t block = 1; out_size > 0; block++)
+	{
+		uint8_t index[4] = { (uint8_t)(block >> 24), (uint8_t)(block >> 16), (uint8_t)(block >> 8), (uint8_t)block };
+		uint8_t u[SHA256_DIGEST_SIZE], t[SHA256_DIGEST_SIZE];
+		sha256_t inner = keys.inner;
+		sha256_update(&inner, salt, salt_size);
+		sha256_update(&inner, index, sizeof index);
+		hmac_sha256_finish(&keys, &inner, u);
+		memcpy(t, u, sizeof t);
+
+		for (int i = 1; i < iterations; i++)
+		{
+			inner = keys.inner;
+			sha256_update(&inner, u, sizeof u);
+			hmac_sha256_finish(&keys, &inner, u);
+			for (int j = 0; j < SHA256_DIGEST_SIZE; j++)
+				t[j] ^= u[j];
+		}
+
+		size_t count = min(out_size, sizeof t);
+		memcpy(out, t, count);
+		out += count;
+		out_size -= count;
+		memset(u, 0, sizeof u);
+		memset(t, 0, sizeof t);
+	}
+	memset(&keys, 0, sizeof keys);
+}
+
+/* the password itself is never kept, entries are matched on its hash */
+static struct kdf_cache_entry
+{
+	bool used;
+	uint64_t last_use;
+	uint8_t password_hash[SHA256_DIGEST_SIZE];
+	uint8_t salt[KDF_SALT_SIZE];
+	int iterations, key_size;
+	uint8_t key[KDF_MAX_KEY_SIZE];
+} kdf_cache[KDF_CACHE_SIZE];
+static uint64_t kdf_clock = 0;
+static int kdf_cost = KDF_DEFAULT_ITERATIONS;
+
+/* sets cost of new keys, existing files keep the cost they were saved with */
+void kdf_set_iterations(int iterations)
+{
+	assert(iterations > 0 && iterations <= KDF_MAX_ITERATIONS);
+	kdf_cost = iterations;
+}
+
+/* cost new keys are derived with */
+int kdf_iterations(void)
+{
+	return kdf_cost;
+}
+
+/* derives key from password and salt, reusing the key if the same password, salt, and cost were derived recently */
+bool kdf_derive(const char* password, const uint8_t salt[KDF_SALT_SIZE], int iterations, uint8_t* key, int key_size)
+{
+	assert(password && salt && key && key_size > 0 && key_size <= KDF_MAX_KEY_SIZE);
+	if (iterations <= 0 || iterations > KDF_MAX_ITERATIONS)
+	{
+		debug_format("Key derivation cost %i is out of range.\n", iterations);
+		return false;
+	}
+
+	uint8_t password_hash[SHA256_DIGEST_SIZE];
+	sha256_t sha;
+	sha256_init(&sha);
+	sha256_update(&sha, password, strlen(password));
+	sha256_final(&sha, password_hash);
+
+	struct kdf_cache_entry* oldest = &kdf_cache[0];
+	for (int i = 0; i < KDF_CACHE_SIZE; i++)
+	{
+		struct kdf_cache_entry* entry = &kdf_cache[i];
+		if (entry->used && entry->iterations == iterations && entry->key_size == key_size
+			&& memcmp(entry->salt, salt, KDF_SALT_SIZE) == 0 && memcmp(entry->password_hash, password_hash, SHA256_DIGEST_SIZE) == 0)
+		{
+			entry->last_use = ++kdf_clock;
+			memcpy(key, entry->key, key_size);
+			return true;
+		}
+		if (!entry->used || (oldest->used && entry->last_use < oldest->last_use))
+			oldest = entry;
+	}
+
+	pbkdf2_sha256(password, strlen(password), salt, KDF_SALT_SIZE, iterations, key, key_size);
+
+	oldest->used = true;
+	oldest->last_use = ++kdf_clock;
+	memcpy(oldest->password_hash, password_hash, SHA256_DIGEST_SIZE);
+	memcpy(oldest->salt, salt, KDF_SALT_SIZE);
+	oldest->iterations = iterations;
+	oldest->key_size = key_size;
+	memcpy(oldest->key, key, key_size);
+	return true;
+}
+
+/* zeroes all cached keys */
+void kdf_clear_cache(void)
+{
+	memset(kdf_cache, 0, sizeof kdf_cache);
+}
+
+#ifdef TEST
+#ifdef KDF_TEST
+#include <stdio.h>
+#include <time.h>
+
+int main()
+{
+	int failures = 0;
+
+	/* FIPS 180-2 appendix B.1 */
+	const uint8_t abc_digest[SHA256_DIGEST_SIZE] =
+	{
+		0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+		0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD
+	};
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	sha256_t sha;
+	sha256_init(&sha);
+	sha256_update(&sha, "abc", 3);
+	sha256_final(&sha, digest);
+	bool passed = memcmp(digest, abc_digest, sizeof digest) == 0;
+	printf("SHA-256 known answer: %s\n", passed ? "pass" : "FAIL");
+	failures += !passed;
+
+	/* RFC 7914 section 11 */
+	const uint8_t pbkdf2_key[64] =
+	{
+		0x55, 0xAC, 0x04, 0x6E, 0x56, 0xE3, 0x08, 0x9F, 0xEC, 0x16, 0x91, 0xC2, 0x25, 0x44, 0xB6, 0x05,
+		0xF9, 0x41, 0x85, 0x21, 0x6D, 0xDE, 0x04, 0x65, 0xE6, 0x8B, 0x9D, 0x57, 0xC2, 0x0D, 0xAC, 0xBC,
+		0x49, 0xCA, 0x9C, 0xCC, 0xF1, 0x79, 0xB6, 0x45, 0x99, 0x16, 0x64, 0xB3, 0x9D, 0x77, 0xEF, 0x31,
+		0x7C, 0x71, 0xB8, 0x45, 0xB1, 0xE3, 0x0B, 0xD5, 0x09, 0x11, 0x20, 0x41, 0xD3, 0xA1, 0x97, 0x83
+	};
+	uint8_t key[64];
+	pbkdf2_sha256("passwd", 6, "salt", 4, 1, key, sizeof key);
+	passed = memcmp(key, pbkdf2_key, sizeof key) == 0;
+	printf("PBKDF2-SHA256 known answer: %s\n", passed ? "pass" : "FAIL");
+	failures += !passed;
+
+	/* the second derivation should come straight out of the cache */
+	uint8_t salt[KDF_SALT_SIZE] = { 0 }, first[16], second[16];
+	clock_t start = clock();
+	kdf_derive("password", salt, KDF_DEFAULT_ITERATIONS, first, sizeof first);
+	double derive_time = (clock() - start) / (double)CLOCKS_PER_SEC;
+	start = clock();
+	kdf_derive("password", salt, KDF_DEFAULT_ITERATIONS, second, sizeof second);
+	double cached_time = (clock() - start) / (double)CLOCKS_PER_SEC;
+	passed = memcmp(first, second, sizeof first) == 0;
+	printf("%i iterations: %.3f s, cached: %.6f s, %s\n", KDF_DEFAULT_ITERATIONS, derive_time, cached_time, passed ? "pass" : "FAIL");
+	failures += !passed;
+
+	kdf_clear_cache();
+	return failures;
+}
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+/*
+	kdf.h ~ RL
+
+	Password based key derivation (PBKDF2-SHA256) with a cache of derived keys
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BLOCK_SIZE			64
+#define SHA256_DIGEST_SIZE			32
+#define KDF_SALT_SIZE				16
+#define KDF_MAX_KEY_SIZE			32
+#define KDF_DEFAULT_ITERATIONS		200000
+#define KDF_MAX_ITERATIONS			10000000	/* files asking for more are rejected rather than stalling the editor */
+#define KDF_CACHE_SIZE				8
+
+typedef struct sha256
+{
+	uint32_t state[8];
+	uint64_t length;
+	uint8_t block[SHA256_BLOCK_SIZE];
+	int block_size;
+} sha256_t;
+
+/* starts a new hash */
+void sha256_init(sha256_t* sha);
+/* hashes size more bytes */
+void sha256_update(sha256_t* sha, const void* data, size_t size);
+/* pads and writes the digest */
+void sha256_final(sha256_t* sha, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/* writes HMAC-SHA256 of data */
+void hmac_sha256(const void* key, size_t key_size, const void* data, size_t size, uint8_t mac[SHA256_DIGEST_SIZE]);
+/* derives out_size bytes with PBKDF2-HMAC-SHA256 */
+void pbkdf2_sha256(const void* password, size_t password_size, const void* salt, size_t salt_size, int iterations, uint8_t* out, size_t out_size);
+
+/* sets cost of new keys, existing files keep the cost they were saved with */
+void kdf_set_iterations(int iterations);
+/* cost new keys are derived with */
+int kdf_iterations(void);
+/* derives key from password and salt, reusing the key if the same password, salt, and cost were derived recently */
+bool kdf_derive(const char* password, const uint8_t salt[KDF_SALT_SIZE], int iterations, uint8_t* key, int key_size);
+/* zeroes all cached keys */
+void kdf_clear_cache(void);
\ No newline at end of file
@@ -4,11 +4,14 @@
 
 #include "console.h"
 #include "file.h"
+#include "kdf.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include "thread.h"
 #include "user.h"
 #include "util.h"
+#include "wal.h"
 
 #ifndef TEST
 
@@ -27,9 +30,15 @@ static void journal_panic(void)
 
 	user_t user = user_get_latest();
 	user_unload(&user);
-	const file_details_t details = console_file();
-	console_destroy();
-	bool saved_file = file_save(details); /* free memory before trying to save, file_save allocates memory. */
+	/* the edits since the last save are already on disk but for the last group. Writing it allocates nothing */
+	if (wal_is_open())
+	{
+		bool flushed = wal_flush();
+		debug_format("Ran out of memory, %s edit log. It is replayed when the file is next opened.\n", flushed ? "flushed" : "failed to flush");
+		return;
+	}
+	/* files without a log, like encrypted ones, are saved whole. The console's lines have to outlive the save */
+	bool saved_file = file_save(console_file());
 	debug_format("Ran out of memory, %s current file.\n", saved_file ? "successfully saved" : "failed to save");
 }
 
@@ -39,7 +48,7 @@ static bool load_config(void)
 	if (!user_get_user_directory(directory))
 		return false;
 	static char buf[260];
-	snprintf(buf, 260, "%s\\Plain.txt", directory);
+	snprintf(buf, 260, "%s" PATH_SEPARATOR "Plain.txt", directory);
 	if (!file_exists(buf))
 	{
 		FILE* temp = fopen(buf, "w");
@@ -52,6 +61,7 @@ static bool load_config(void)
 		return false;
 	console_set_color(user.foreground, user.background);
 	console_set_font(user.font);
+	thread_set_worker_count(user.worker_count);
 	for (int i = 0; i < list_count(user.file_saves); i++)
 	{
 		file_save_t* save = LIST_GET(user.file_saves, 0, file_save_t);
@@ -86,6 +96,8 @@ int main(int argc, char** argv)
 
 	console_loop();
 	console_destroy();
+	thread_destroy_pool();
+	kdf_clear_cache();
 	user_t user = user_get_latest();
 	user_unload(&user);
 
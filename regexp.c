@@ -0,0 +1,682 @@
+/*
+	regexp.c ~ RL
+
+	Regular expressions over the editor's lines, run with a lazily built DFA so a search never backtracks
+*/
+
+#include "regexp.h"
+#include <assert.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*	The pattern is compiled twice into Thompson NFAs, once as written and once reversed. DFA states are
+	sets of NFA states, built the first time a character leads to them and cached until there are too many.
+	Scanning a line backward with the reversed pattern marks every column a match starts at, then scanning
+	forward from the leftmost of those finds where the longest match ends. Each scan reads a character
+	at most once, so a search is linear in the line's length whatever the pattern is.
+
+	^ and $ are edges of the line. As NFA states they're named by which way the scan faces them, so
+	reversing the pattern only swaps which state each one compiles to. */
+
+#define REGEXP_SET_WORDS		(256 / 32)
+
+typedef enum regexp_state_type
+{
+	STATE_SET,			/* reads a character in set */
+	STATE_EMPTY,		/* goes on to out without reading anything */
+	STATE_SPLIT,		/* goes on to out and alternate */
+	STATE_EDGE_BEHIND,	/* goes on to out if the scan began at an edge of the line and hasn't read anything */
+	STATE_EDGE_AHEAD,	/* goes on to out if the scan has reached the other edge of the line */
+	STATE_MATCH,
+} regexp_state_type_t;
+
+struct regexp_state
+{
+	regexp_state_type_t type;
+	int out, alternate;
+	uint32_t set[REGEXP_SET_WORDS];
+};
+
+/* piece of the NFA being built, entered at start and left through exit, which is empty */
+struct regexp_fragment
+{
+	int start, exit;
+};
+
+struct regexp_dfa_state
+{
+	int set_offset, set_count; /* NFA states that make it up, in the automaton's sets */
+	uint64_t hash;
+	bool accepting;			/* a match ends here */
+	bool accepting_at_edge;	/* a match ends here if this is the edge of the line */
+	int next[256];			/* state after reading each character, -1 if it hasn't been built */
+};
+
+struct regexp_automaton
+{
+	list_t nfa;			/* struct regexp_state */
+	int start;
+	bool unanchored;	/* the start is added back after every character, so a match can begin anywhere */
+
+	list_t states;		/* struct regexp_dfa_state */
+	list_t sets;		/* int, sorted NFA states of every DFA state back to back */
+	int initial[2];		/* DFA state a scan begins in, indexed by whether it begins at an edge. -1 if not built */
+	int flushes;		/* times the DFA states were thrown out */
+
+	list_t next_set;	/* int, NFA states of the DFA state being built */
+	list_t marks;		/* char, NFA states already in next_set */
+	list_t stack;		/* int */
+};
+
+struct regexp
+{
+	struct regexp_automaton forward;		/* anchored, finds where a match that starts at a column ends */
+	struct regexp_automaton backward;	/* the pattern reversed and unanchored, finds the columns matches start at */
+	list_t starts;	/* char, whether a match starts at each column of the last line scanned backward */
+};
+
+struct regexp_parser
+{
+	const char* pattern, *end;
+	bool ignore_case, reverse, failed;
+	list_t nfa;
+};
+
+/*
+	PARSING
+*/
+
+static struct regexp_state* regexp_get_state(list_t nfa, int index)
+{
+	return LIST_GET(nfa, index, struct regexp_state);
+}
+
+static int regexp_add_state(struct regexp_parser* parser, regexp_state_type_t type, int out, int alternate)
+{
+	struct regexp_state state = { .type = type, .out = out, .alternate = alternate };
+	LIST_PUSH(parser->nfa, state);
+	return list_count(parser->nfa) - 1;
+}
+
+/* fragment of one state of type, the caller fills in its set */
+static struct regexp_fragment regexp_single(struct regexp_parser* parser, regexp_state_type_t type)
+{
+	int exit = regexp_add_state(parser, STATE_EMPTY, -1, -1);
+	return (struct regexp_fragment) { .start = regexp_add_state(parser, type, exit, -1), .exit = exit };
+}
+
+static void regexp_link(struct regexp_parser* parser, int exit, int to)
+{
+	regexp_get_state(parser->nfa, exit)->out = to;
+}
+
+static bool regexp_is_next(const struct regexp_parser* parser, char ch)
+{
+	return parser->pattern < parser->end && *parser->pattern == ch;
+}
+
+/* adds characters low to high to set, along with their other case if case is ignored */
+static void regexp_set_add(const struct regexp_parser* parser, uint32_t* set, int low, int high)
+{
+	for (int ch = low; ch <= high; ch++)
+	{
+		set[ch >> 5] |= 1u << (ch & 31);
+		if (parser->ignore_case && isalpha(ch))
+		{
+			int other = islower(ch) ? toupper(ch) : tolower(ch);
+			set[other >> 5] |= 1u << (other & 31);
+		}
+	}
+}
+
+/* adds the class an escaped letter stands for to set, like digits for \d. Returns false if it doesn't stand for one */
+static bool regexp_set_add_class(uint32_t* set, char escaped)
+{
+	int lower = tolower((unsigned char)escaped);
+	if (lower != 'd' && lower != 'w' && lower != 's')
+		return false;
+	bool negated = isupper((unsigned char)escaped);
+	for (int ch = 0; ch < 256; ch++)
+	{
+		bool in = lower == 'd' ? isdigit(ch) : lower == 'w' ? isalnum(ch) || ch == '_' : isspace(ch);
+		if (in != negated)
+			set[ch >> 5] |= 1u << (ch & 31);
+	}
+	return true;
+}
+
+/* parses a bracketed class after its [ into set */
+static void regexp_parse_class(struct regexp_parser* parser, uint32_t* set)
+{
+	uint32_t class[REGEXP_SET_WORDS] = { 0 };
+	bool negated = regexp_is_next(parser, '^');
+	if (negated)
+		parser->pattern++;
+	/* a ] first in the class is part of it */
+	for (bool first = true; parser->pattern < parser->end && (first || *parser->pattern != ']'); first = false)
+	{
+		int low = (unsigned char)*parser->pattern++;
+		if (low == '\\' && parser->pattern < parser->end)
+		{
+			char escaped = *parser->pattern++;
+			if (regexp_set_add_class(class, escaped))
+				continue;
+			low = (unsigned char)escaped;
+		}
+		int high = low;
+		if (parser->pattern + 1 < parser->end && parser->pattern[0] == '-' && parser->pattern[1] != ']')
+		{
+			high = (unsigned char)parser->pattern[1];
+			parser->pattern += 2;
+			if (high == '\\' && parser->pattern < parser->end)
+				high = (unsigned char)*parser->pattern++;
+		}
+		if (high < low)
+			parser->failed = true;
+		regexp_set_add(parser, class, low, high);
+	}
+	if (!regexp_is_next(parser, ']'))
+	{
+		parser->failed = true;
+		return;
+	}
+	parser->pattern++;
+	for (int i = 0; i < REGEXP_SET_WORDS; i++)
+		set[i] = negated ? ~class[i] : class[i];
+}
+
+static struct regexp_fragment regexp_parse_alternation(struct regexp_parser* parser);
+
+static struct regexp_fragment regexp_parse_atom(struct regexp_parser* parser)
+{
+	char ch = *parser->pattern++;
+	struct regexp_fragment result;
+	switch (ch)
+	{
+	case '(':
+		result = regexp_parse_alternation(parser);
+		if (regexp_is_next(parser, ')'))
+			parser->pattern++;
+		else
+			parser->failed = true;
+		return result;
+	case '^':
+		return regexp_single(parser, parser->reverse ? STATE_EDGE_AHEAD : STATE_EDGE_BEHIND);
+	case '$':
+		return regexp_single(parser, parser->reverse ? STATE_EDGE_BEHIND : STATE_EDGE_AHEAD);
+	case '*':
+	case '+':
+	case '?':
+		parser->failed = true; /* nothing to repeat */
+		break;
+	}
+
+	result = regexp_single(parser, STATE_SET);
+	uint32_t* set = regexp_get_state(parser->nfa, result.start)->set;
+	if (ch == '.')
+		memset(set, 0xFF, sizeof * set * REGEXP_SET_WORDS);
+	else if (ch == '[')
+		regexp_parse_class(parser, set);
+	else if (ch == '\\')
+	{
+		if (parser->pattern == parser->end)
+			parser->failed = true;
+		else if (!regexp_set_add_class(set, *parser->pattern++))
+			regexp_set_add(parser, set, (unsigned char)parser->pattern[-1], (unsigned char)parser->pattern[-1]);
+	}
+	else
+		regexp_set_add(parser, set, (unsigned char)ch, (unsigned char)ch);
+	return result;
+}
+
+static struct regexp_fragment regexp_parse_repetition(struct regexp_parser* parser)
+{
+	struct regexp_fragment result = regexp_parse_atom(parser);
+	while (!parser->failed && (regexp_is_next(parser, '*') || regexp_is_next(parser, '+') || regexp_is_next(parser, '?')))
+	{
+		char op = *parser->pattern++;
+		int exit = regexp_add_state(parser, STATE_EMPTY, -1, -1);
+		int split = regexp_add_state(parser, STATE_SPLIT, result.start, exit);
+		regexp_link(parser, result.exit, op == '?' ? exit : split);
+		result = (struct regexp_fragment){ .start = op == '+' ? result.start : split, .exit = exit };
+	}
+	return result;
+}
+
+/* reversed, each piece goes in front of the ones before it */
+static struct regexp_fragment regexp_parse_concatenation(struct regexp_parser* parser)
+{
+	int empty = regexp_add_state(parser, STATE_EMPTY, -1, -1);
+	struct regexp_fragment result = { .start = empty, .exit = empty };
+	while (!parser->failed && parser->pattern < parser->end && *parser->pattern != '|' && *parser->pattern != ')')
+	{
+		struct regexp_fragment piece = regexp_parse_repetition(parser);
+		if (parser->reverse)
+		{
+			regexp_link(parser, piece.exit, result.start);
+			result.start = piece.start;
+		}
+		else
+		{
+			regexp_link(parser, result.exit, piece.start);
+			result.exit = piece.exit;
+		}
+	}
+	return result;
+}
+
+static struct regexp_fragment regexp_parse_alternation(struct regexp_parser* parser)
+{
+	struct regexp_fragment result = regexp_parse_concatenation(parser);
+	while (!parser->failed && regexp_is_next(parser, '|'))
+	{
+		parser->pattern++;
+		struct regexp_fragment other = regexp_parse_concatenation(parser);
+		int exit = regexp_add_state(parser, STATE_EMPTY, -1, -1);
+		int split = regexp_add_state(parser, STATE_SPLIT, result.start, other.start);
+		regexp_link(parser, result.exit, exit);
+		regexp_link(parser, other.exit, exit);
+		result = (struct regexp_fragment){ .start = split, .exit = exit };
+	}
+	return result;
+}
+
+/* compiles pattern into automaton's NFA, reversed if reverse is set */
+static bool regexp_build(struct regexp_automaton* automaton, const char* pattern, int size, bool ignore_case, bool reverse)
+{
+	struct regexp_parser parser = { .pattern = pattern, .end = pattern + size, .ignore_case = ignore_case, .reverse = reverse };
+	parser.nfa = list_create(sizeof(struct regexp_state));
+	struct regexp_fragment whole = regexp_parse_alternation(&parser);
+	regexp_link(&parser, whole.exit, regexp_add_state(&parser, STATE_MATCH, -1, -1));
+
+	*automaton = (struct regexp_automaton){ .nfa = parser.nfa, .start = whole.start, .unanchored = reverse };
+	automaton->states = list_create(sizeof(struct regexp_dfa_state));
+	automaton->sets = list_create(sizeof(int));
+	automaton->initial[0] = automaton->initial[1] = -1;
+	automaton->next_set = list_create(sizeof(int));
+	automaton->marks = list_create(sizeof(char));
+	automaton->stack = list_create(sizeof(int));
+	list_resize(automaton->marks, list_count(parser.nfa));
+	return !parser.failed && parser.pattern == parser.end;
+}
+
+static void regexp_destroy_automaton(struct regexp_automaton* automaton)
+{
+	list_destroy(automaton->nfa);
+	list_destroy(automaton->states);
+	list_destroy(automaton->sets);
+	list_destroy(automaton->next_set);
+	list_destroy(automaton->marks);
+	list_destroy(automaton->stack);
+}
+
+/*
+	DFA
+*/
+
+/* starts building the set of a new DFA state */
+static void regexp_begin_set(struct regexp_automaton* automaton)
+{
+	list_clear(automaton->next_set);
+	memset(list_element_array(automaton->marks), 0, list_count(automaton->marks));
+}
+
+/*	adds every NFA state reachable from from without reading a character to the set being built.
+	Only those that read one, matches, and edges ahead are kept, they're all that tells DFA states apart */
+static void regexp_add_closure(struct regexp_automaton* automaton, int from, bool edge_behind, bool edge_ahead)
+{
+	char* marks = list_element_array(automaton->marks);
+	list_clear(automaton->stack);
+	LIST_PUSH(automaton->stack, from);
+	while (list_count(automaton->stack) > 0)
+	{
+		int index;
+		list_pop(automaton->stack, &index);
+		if (marks[index])
+			continue;
+		marks[index] = 1;
+		const struct regexp_state* state = regexp_get_state(automaton->nfa, index);
+		if (state->type == STATE_EMPTY
+			|| (state->type == STATE_EDGE_BEHIND && edge_behind)
+			|| (state->type == STATE_EDGE_AHEAD && edge_ahead))
+			LIST_PUSH(automaton->stack, state->out);
+		else if (state->type == STATE_SPLIT)
+		{
+			LIST_PUSH(automaton->stack, state->alternate);
+			LIST_PUSH(automaton->stack, state->out);
+		}
+		else if (state->type != STATE_EDGE_BEHIND)
+			LIST_PUSH(automaton->next_set, index);
+	}
+}
+
+static int regexp_compare_ints(const void* a, const void* b)
+{
+	return *(const int*)a - *(const int*)b;
+}
+
+/* whether the set being built reaches a match, following the edges ahead in it if edge_ahead is set */
+static bool regexp_set_is_accepting(struct regexp_automaton* automaton, bool edge_ahead)
+{
+	int count = list_count(automaton->next_set);
+	for (int i = 0; i < count; i++)
+	{
+		const struct regexp_state* state = regexp_get_state(automaton->nfa, *LIST_GET(automaton->next_set, i, int));
+		if (state->type == STATE_MATCH)
+			return true;
+	}
+	if (!edge_ahead)
+		return false;
+
+	/* closures are added past the end of the set and taken off again */
+	bool result = false;
+	for (int i = 0; i < count && !result; i++)
+	{
+		int index = *LIST_GET(automaton->next_set, i, int);
+		if (regexp_get_state(automaton->nfa, index)->type != STATE_EDGE_AHEAD)
+			continue;
+		regexp_add_closure(automaton, regexp_get_state(automaton->nfa, index)->out, false, true);
+		for (int j = count; j < list_count(automaton->next_set) && !result; j++)
+			result = regexp_get_state(automaton->nfa, *LIST_GET(automaton->next_set, j, int))->type == STATE_MATCH;
+	}
+	list_resize(automaton->next_set, count);
+	return result;
+}
+
+/* finds or adds the DFA state of the set being built. Every state is thrown out first if there are too many */
+static int regexp_add_dfa_state(struct regexp_automaton* automaton)
+{
+	int count = list_count(automaton->next_set);
+	int* set = list_element_array(automaton->next_set);
+	qsort(set, count, sizeof * set, regexp_compare_ints);
+	uint64_t hash = list_hash(automaton->next_set);
+
+	for (int i = 0; i < list_count(automaton->states); i++)
+	{
+		const struct regexp_dfa_state* state = LIST_GET(automaton->states, i, struct regexp_dfa_state);
+		if (state->hash == hash && state->set_count == count
+			&& memcmp((int*)list_element_array(automaton->sets) + state->set_offset, set, sizeof * set * count) == 0)
+			return i;
+	}
+
+	if (list_count(automaton->states) >= REGEXP_MAX_STATES)
+	{
+		list_clear(automaton->states);
+		list_clear(automaton->sets);
+		automaton->initial[0] = automaton->initial[1] = -1;
+		automaton->flushes++;
+	}
+
+	struct regexp_dfa_state state = { .set_offset = list_count(automaton->sets), .set_count = count, .hash = hash };
+	state.accepting = regexp_set_is_accepting(automaton, false);
+	state.accepting_at_edge = regexp_set_is_accepting(automaton, true);
+	memset(state.next, -1, sizeof state.next);
+	list_concat(automaton->sets, automaton->next_set, list_count(automaton->sets));
+	LIST_PUSH(automaton->states, state);
+	return list_count(automaton->states) - 1;
+}
+
+/* DFA state a scan begins in */
+static int regexp_initial(struct regexp_automaton* automaton, bool edge_behind)
+{
+	if (automaton->initial[edge_behind] < 0)
+	{
+		regexp_begin_set(automaton);
+		regexp_add_closure(automaton, automaton->start, edge_behind, false);
+		int result = regexp_add_dfa_state(automaton);
+		automaton->initial[edge_behind] = result;
+	}
+	return automaton->initial[edge_behind];
+}
+
+/* DFA state after reading ch in state index, built the first time it's needed */
+static int regexp_step(struct regexp_automaton* automaton, int index, unsigned char ch)
+{
+	const struct regexp_dfa_state* state = LIST_GET(automaton->states, index, struct regexp_dfa_state);
+	if (state->next[ch] >= 0)
+		return state->next[ch];
+
+	regexp_begin_set(automaton);
+	const int* set = (const int*)list_element_array(automaton->sets) + state->set_offset;
+	for (int i = 0; i < state->set_count; i++)
+	{
+		const struct regexp_state* nfa_state = regexp_get_state(automaton->nfa, set[i]);
+		if (nfa_state->type == STATE_SET && (nfa_state->set[ch >> 5] >> (ch & 31) & 1))
+			regexp_add_closure(automaton, nfa_state->out, false, false);
+	}
+	if (automaton->unanchored)
+		regexp_add_closure(automaton, automaton->start, false, false);
+
+	int flushes = automaton->flushes;
+	int result = regexp_add_dfa_state(automaton);
+	if (flushes == automaton->flushes) /* otherwise index is gone */
+		LIST_GET(automaton->states, index, struct regexp_dfa_state)->next[ch] = result;
+	return result;
+}
+
+/*
+	SEARCHING
+*/
+
+/* column after the longest match that starts at column, -1 if none does */
+static int regexp_match_end(regexp_t regexp, const char* str, int count, int column)
+{
+	struct regexp_automaton* automaton = &regexp->forward;
+	int state = regexp_initial(automaton, column == 0), result = -1;
+	for (int i = column;; i++)
+	{
+		const struct regexp_dfa_state* dfa_state = LIST_GET(automaton->states, state, struct regexp_dfa_state);
+		if (i == count ? dfa_state->accepting_at_edge : dfa_state->accepting)
+			result = i;
+		if (i == count || dfa_state->set_count == 0)
+			return result;
+		state = regexp_step(automaton, state, (unsigned char)str[i]);
+	}
+}
+
+/* marks every column of str a match starts at in regexp's starts, reading it from the end */
+static void regexp_mark_starts(regexp_t regexp, const char* str, int count)
+{
+	struct regexp_automaton* automaton = &regexp->backward;
+	list_resize(regexp->starts, count + 1);
+	char* starts = list_element_array(regexp->starts);
+	int state = regexp_initial(automaton, true);
+	for (int i = count;; i--)
+	{
+		const struct regexp_dfa_state* dfa_state = LIST_GET(automaton->states, state, struct regexp_dfa_state);
+		starts[i] = i == 0 ? dfa_state->accepting_at_edge : dfa_state->accepting;
+		if (i == 0)
+			return;
+		state = regexp_step(automaton, state, (unsigned char)str[i - 1]);
+	}
+}
+
+/* compiles size bytes of pattern, returns NULL if the pattern isn't valid */
+regexp_t regexp_compile(const char* pattern, int size, bool ignore_case)
+{
+	assert(pattern && size >= 0);
+	regexp_t result = journal_malloc(sizeof * result);
+	bool valid = regexp_build(&result->forward, pattern, size, ignore_case, false);
+	valid = regexp_build(&result->backward, pattern, size, ignore_case, true) && valid;
+	result->starts = list_create(sizeof(char));
+	if (!valid)
+	{
+		debug_format("Pattern \"%.*s\" isn't valid.\n", size, pattern);
+		regexp_destroy(result);
+		return NULL;
+	}
+	return result;
+}
+
+/* frees regexp and every DFA state built for it */
+void regexp_destroy(regexp_t regexp)
+{
+	if (!regexp)
+		return;
+	regexp_destroy_automaton(&regexp->forward);
+	regexp_destroy_automaton(&regexp->backward);
+	list_destroy(regexp->starts);
+	free(regexp);
+}
+
+/*	finds the leftmost match in string at or after column, preferring the longest one that starts there.
+	Sets begin to the column it starts at and end to the column after it. Takes time linear in the string's length */
+bool regexp_find(regexp_t regexp, const char* str, int count, int column, int* begin, int* end)
+{
+	assert(regexp && (str || count == 0) && column >= 0 && begin && end);
+	if (column > count)
+		return false;
+	regexp_mark_starts(regexp, str, count);
+	const char* starts = list_element_array(regexp->starts);
+	for (int i = column; i <= count; i++)
+	{
+		if (starts[i])
+		{
+			*begin = i;
+			*end = regexp_match_end(regexp, str, count, i);
+			assert(*end >= i);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* finds the first match at or after from, searching a line at a time */
+bool regexp_find_in_lines(regexp_t regexp, rope_t lines, coords_t from, regexp_match_t* match)
+{
+	assert(regexp && lines && match && from.row >= 0);
+	for (int row = from.row; row < rope_line_count(lines); row++)
+	{
+		int begin, end, count;
+		const char* str = rope_line(lines, row, &count);
+		if (regexp_find(regexp, str, count, row == from.row ? from.column : 0, &begin, &end))
+		{
+			*match = (regexp_match_t){ .begin = { .column = begin, .row = row }, .end = { .column = end, .row = row } };
+			return true;
+		}
+	}
+	return false;
+}
+
+/* adds every match in lines to matches in order. Matches don't overlap, and searching goes on a column past an empty one */
+void regexp_find_all(regexp_t regexp, rope_t lines, list_t matches)
+{
+	assert(regexp && lines && matches && list_element_size(matches) == sizeof(regexp_match_t));
+	for (int row = 0; row < rope_line_count(lines); row++)
+	{
+		int count;
+		const char* str = rope_line(lines, row, &count);
+		regexp_mark_starts(regexp, str, count);
+		const char* starts = list_element_array(regexp->starts);
+		for (int i = 0; i <= count; i++)
+		{
+			if (!starts[i])
+				continue;
+			int end = regexp_match_end(regexp, str, count, i);
+			regexp_match_t match = { .begin = { .column = i, .row = row }, .end = { .column = end, .row = row } };
+			LIST_PUSH(matches, match);
+			i = max(i, end - 1);
+		}
+	}
+}
+
+#ifdef TEST
+#ifdef REGEXP_TEST
+#include <stdio.h>
+#include <time.h>
+
+#define TEST_LINE_LENGTH		100000
+
+struct regexp_test_case
+{
+	const char* pattern, *text;
+	int begin, end; /* -1 if nothing matches */
+};
+
+int main()
+{
+	static const struct regexp_test_case cases[] =
+	{
+		{ "abc", "xxabcxx", 2, 5 },
+		{ "a|ab|abc", "xabcx", 1, 4 },
+		{ "a*", "baaa", 0, 0 },
+		{ "a+", "baaa", 1, 4 },
+		{ "colou?r", "the color red", 4, 9 },
+		{ "^TODO", "a TODO", -1, -1 },
+		{ "^TODO", "TODO: write", 0, 4 },
+		{ "done$", "done or not done", 12, 16 },
+		{ "^$", "", 0, 0 },
+		{ "\\d\\d\\d\\d-\\d\\d-\\d\\d", "on 2024-05-17, rain", 3, 13 },
+		{ "#[a-z_]+", "notes #work_log here", 6, 15 },
+		{ "[^ ]+", "   word  ", 3, 7 },
+		{ "(ab)+c", "ababab abababc", 7, 14 },
+		{ "a.*c|b", "abc", 0, 3 },
+		{ "\\w+\\s\\W", "hi there !", 3, 10 },
+		{ "[]x]", "a]", 1, 2 },
+		{ "x\\.y", "xay x.y", 4, 7 },
+		{ "(a|b)*abb", "babaabbx", 0, 7 },
+	};
+
+	int wrong_count = 0;
+	for (int i = 0; i < sizeof cases / sizeof * cases; i++)
+	{
+		regexp_t regexp = regexp_compile(cases[i].pattern, (int)strlen(cases[i].pattern), false);
+		list_t string = list_create_with_array(cases[i].text, sizeof(char), (int)strlen(cases[i].text));
+		int begin = -1, end = -1;
+		if (!regexp || !regexp_find(regexp, list_element_array(string), list_count(string), 0, &begin, &end))
+			begin = end = -1;
+		if (begin != cases[i].begin || end != cases[i].end)
+		{
+			printf("\"%s\" in \"%s\" matched (%i, %i), expected (%i, %i).\n", cases[i].pattern, cases[i].text, begin, end, cases[i].begin, cases[i].end);
+			wrong_count++;
+		}
+		list_destroy(string);
+		regexp_destroy(regexp);
+	}
+
+	/* patterns that don't parse, and case being ignored */
+	static const char* invalid[] = { "(ab", "ab)", "*a", "[abc", "a\\", "[z-a]" };
+	for (int i = 0; i < sizeof invalid / sizeof * invalid; i++)
+		wrong_count += regexp_compile(invalid[i], (int)strlen(invalid[i]), false) != NULL;
+	regexp_t regexp = regexp_compile("todo", 4, true);
+	rope_t lines = rope_create();
+	coords_t position = { 0 };
+	editor_add_raw(lines, "a ToDo\nnone\nTODO todo", &position);
+	list_t matches = list_create(sizeof(regexp_match_t));
+	regexp_find_all(regexp, lines, matches);
+	wrong_count += list_count(matches) != 3 || LIST_GET(matches, 2, regexp_match_t)->begin.column != 5 || LIST_GET(matches, 2, regexp_match_t)->begin.row != 2;
+	regexp_destroy(regexp);
+	printf("Regexp test resulted in %i mismatches.\n", wrong_count);
+
+	/*	benchmark, a pattern whose DFA has 2^n states and one that backtracking takes exponential time on.
+		Neither takes more than linear time, and the states kept never go past the cap */
+	static const char* slow[] = { "(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)c", "(a*)*(a*)*(a*)*d" };
+	list_t string = list_create(sizeof(char));
+	list_resize(string, TEST_LINE_LENGTH);
+	srand(20);
+	for (int i = 0; i < TEST_LINE_LENGTH; i++)
+		*LIST_GET(string, i, char) = i == TEST_LINE_LENGTH - 1 ? 'c' : 'a' + rand() % 2;
+	for (int i = 0; i < sizeof slow / sizeof * slow; i++)
+	{
+		regexp = regexp_compile(slow[i], (int)strlen(slow[i]), false);
+		int begin, end;
+		clock_t start = clock();
+		bool found = regexp_find(regexp, list_element_array(string), list_count(string), 0, &begin, &end);
+		double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+		int states = list_count(regexp->backward.states) + list_count(regexp->forward.states);
+		printf("\"%s\" over %i characters: %s in %.3fs, %i DFA states kept, flushed %i times.\n",
+			slow[i], TEST_LINE_LENGTH, found ? "found" : "not found", seconds, states, regexp->backward.flushes + regexp->forward.flushes);
+		wrong_count += states > REGEXP_MAX_STATES * 2;
+		regexp_destroy(regexp);
+	}
+
+	list_destroy(string);
+	list_destroy(matches);
+	rope_destroy(lines);
+	return wrong_count;
+}
+
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+/*
+	regexp.h ~ RL
+
+	Regular expressions over the editor's lines, run with a lazily built DFA so a search never backtracks.
+	Supports literals, ., [classes], \d \w \s and their negations, ^ $, groups, | and the * + ? quantifiers
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include "editor.h"
+#include "util.h"
+
+#define REGEXP_MAX_STATES		256 /* DFA states kept before they are all thrown out and built again as needed */
+
+typedef struct regexp* regexp_t;
+
+/* where a match is. End is the position after its last character, so an empty match has end equal to begin */
+typedef struct regexp_match
+{
+	coords_t begin, end;
+} regexp_match_t;
+
+/* compiles size bytes of pattern, returns NULL if the pattern isn't valid */
+regexp_t regexp_compile(const char* pattern, int size, bool ignore_case);
+/* frees regexp and every DFA state built for it */
+void regexp_destroy(regexp_t regexp);
+
+/*	finds the leftmost match in count characters of str at or after column, preferring the longest one that starts there.
+	Sets begin to the column it starts at and end to the column after it. Takes time linear in the string's length */
+bool regexp_find(regexp_t regexp, const char* str, int count, int column, int* begin, int* end);
+/* finds the first match at or after from, searching a line at a time */
+bool regexp_find_in_lines(regexp_t regexp, rope_t lines, coords_t from, regexp_match_t* match);
+/* adds every match in lines to matches in order. Matches don't overlap, and searching goes on a column past an empty one */
+void regexp_find_all(regexp_t regexp, rope_t lines, list_t matches);
\ No newline at end of file
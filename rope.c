@@ -0,0 +1,880 @@
+/*
+	rope.c ~ RL
+
+	Piece table text buffer, balanced with a persistent treap
+	Holds the editor's lines, editor.h formats text on its way in
+*/
+
+#include "rope.h"
+#include <assert.h>
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* pieces point into one of these. The original buffer never changes and the added buffer is append-only */
+struct rope_buffer
+{
+	list_t text;		/* char */
+	list_t newlines;	/* int, offset of every newline in text in ascending order */
+};
+
+/*	pieces are shared between versions of the rope. A piece with more than one reference is never
+	changed, an edit copies the path down to it instead */
+struct piece
+{
+	struct piece* left, *right;
+	int references;
+	uint32_t priority;
+	bool added;			/* which buffer the piece points into */
+	int start, length;
+	int newlines;
+	int total_length;	/* totals of the subtree, including this piece */
+	int total_newlines;
+};
+
+/* node of the undo tree, index-linked through rope's list of versions */
+struct rope_version
+{
+	struct piece* root;
+	int parent;			/* -1 for the first version */
+	int last_child;		/* child that redo goes to, -1 if there is none */
+	int first_child;	/* newest child, -1 if there is none */
+	int next_sibling;	/* next older child of the same parent, -1 for the oldest */
+};
+
+/* hash of a row's text, edits mark their row out of date and rows added or removed after it shift the ones after with them */
+struct line_hash
+{
+	bool hashed;
+	uint64_t hash;
+};
+
+struct rope
+{
+	struct piece* root;
+	list_t versions;	/* struct rope_version */
+	int version;		/* version the current text was edited from */
+	struct rope_buffer original, added;
+	uint32_t seed;
+	/* line index cache. Bounds of the last row looked up, row is -1 if invalid and end is -1 until it's found */
+	int cached_row, cached_start, cached_end;
+	list_t line_hashes;	/* struct line_hash, one for each row up to the last one hashed */
+	list_t line_copy;	/* char, text of the last line rope_line had to copy */
+};
+
+static inline int piece_total_length(const struct piece* p)
+{
+	return p ? p->total_length : 0;
+}
+
+static inline int piece_total_newlines(const struct piece* p)
+{
+	return p ? p->total_newlines : 0;
+}
+
+static inline void piece_update(struct piece* p)
+{
+	p->total_length = p->length + piece_total_length(p->left) + piece_total_length(p->right);
+	p->total_newlines = p->newlines + piece_total_newlines(p->left) + piece_total_newlines(p->right);
+}
+
+/* adds every newline in the buffer's text from start on to its newlines */
+static void rope_buffer_index(struct rope_buffer* buf, int start)
+{
+	const char* text = list_element_array(buf->text), *end = text + list_count(buf->text);
+	for (const char* pos = text + start; pos < end && (pos = memchr(pos, '\n', end - pos)); pos++)
+	{
+		int offset = (int)(pos - text);
+		LIST_PUSH(buf->newlines, offset);
+	}
+}
+
+/* buffer over a copy of text, or over text itself if backing owns it */
+static void rope_buffer_create(struct rope_buffer* buf, const char* text, int size, list_backing_t* backing)
+{
+	buf->text = backing ? list_create_borrowed(text, sizeof(char), size, backing) : list_create_with_array(text, sizeof(char), size);
+	buf->newlines = list_create(sizeof(int));
+	rope_buffer_index(buf, 0);
+}
+
+static void rope_buffer_destroy(struct rope_buffer* buf)
+{
+	list_destroy(buf->text);
+	list_destroy(buf->newlines);
+}
+
+/* returns offset where text begins in the buffer */
+static int rope_buffer_append(struct rope_buffer* buf, const char* text, int size)
+{
+	int start = list_count(buf->text);
+	list_resize(buf->text, start + size);
+	memcpy((char*)list_element_array(buf->text) + start, text, size);
+	rope_buffer_index(buf, start);
+	return start;
+}
+
+/* index of first newline at or after offset */
+static int rope_buffer_lower_bound(const struct rope_buffer* buf, int offset)
+{
+	const int* newlines = LIST_GET_ARRAY(buf->newlines, int);
+	int low = 0, high = list_count(buf->newlines);
+	while (low < high)
+	{
+		int mid = low + (high - low) / 2;
+		if (newlines[mid] < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+static inline struct rope_buffer* rope_piece_buffer(const rope_t rope, const struct piece* p)
+{
+	return p->added ? &rope->added : &rope->original;
+}
+
+static int rope_count_piece_newlines(const rope_t rope, bool added, int start, int length)
+{
+	const struct rope_buffer* buf = added ? &rope->added : &rope->original;
+	return rope_buffer_lower_bound(buf, start + length) - rope_buffer_lower_bound(buf, start);
+}
+
+static struct piece* rope_create_piece(rope_t rope, bool added, int start, int length)
+{
+	/* xorshift32, the priorities only have to be scattered */
+	rope->seed ^= rope->seed << 13;
+	rope->seed ^= rope->seed >> 17;
+	rope->seed ^= rope->seed << 5;
+
+	struct piece* result = journal_malloc(sizeof * result);
+	*result = (struct piece)
+	{
+		.references = 1,
+		.priority = rope->seed,
+		.added = added,
+		.start = start,
+		.length = length,
+		.newlines = rope_count_piece_newlines(rope, added, start, length)
+	};
+	piece_update(result);
+	return result;
+}
+
+static inline struct piece* rope_retain_pieces(struct piece* p)
+{
+	if (p)
+		p->references++;
+	return p;
+}
+
+/* drops a reference to p, freeing every piece under it that isn't shared */
+static void rope_release_pieces(struct piece* p)
+{
+	while (p && --p->references == 0)
+	{
+		rope_release_pieces(p->left);
+		struct piece* right = p->right;
+		free(p);
+		p = right;
+	}
+}
+
+/* returns a piece equal to p that can be changed. Takes p's reference and gives one back */
+static struct piece* rope_own_piece(struct piece* p)
+{
+	if (p->references == 1)
+		return p;
+	struct piece* result = journal_malloc(sizeof * result);
+	*result = *p;
+	result->references = 1;
+	rope_retain_pieces(result->left);
+	rope_retain_pieces(result->right);
+	p->references--;
+	return result;
+}
+
+/* takes the references to l and r */
+static struct piece* rope_merge(struct piece* l, struct piece* r)
+{
+	if (!l)
+		return r;
+	if (!r)
+		return l;
+	if (l->priority > r->priority)
+	{
+		l = rope_own_piece(l);
+		l->right = rope_merge(l->right, r);
+		piece_update(l);
+		return l;
+	}
+	r = rope_own_piece(r);
+	r->left = rope_merge(l, r->left);
+	piece_update(r);
+	return r;
+}
+
+/*	the first offset characters of p go to l, the rest go to r. Cuts a piece in two if needed.
+	Takes the reference to p */
+static void rope_split(rope_t rope, struct piece* p, int offset, struct piece** l, struct piece** r)
+{
+	if (!p)
+	{
+		*l = *r = NULL;
+		return;
+	}
+	p = rope_own_piece(p);
+	int left_length = piece_total_length(p->left);
+	if (offset <= left_length)
+	{
+		rope_split(rope, p->left, offset, l, &p->left);
+		piece_update(p);
+		*r = p;
+	}
+	else if (offset >= left_length + p->length)
+	{
+		rope_split(rope, p->right, offset - left_length - p->length, &p->right, r);
+		piece_update(p);
+		*l = p;
+	}
+	else
+	{
+		int cut = offset - left_length;
+		struct piece* tail = rope_create_piece(rope, p->added, p->start + cut, p->length - cut);
+		struct piece* right = p->right;
+		p->right = NULL;
+		p->length = cut;
+		p->newlines -= tail->newlines;
+		piece_update(p);
+		*l = p;
+		*r = rope_merge(tail, right); /* tail's priority is random, so merge rather than attach it */
+	}
+}
+
+/* offset of the kth newline in the rope, -1 if there is none */
+static int rope_find_newline(const rope_t rope, int k)
+{
+	const struct piece* p = rope->root;
+	int base = 0;
+	while (p)
+	{
+		int left_newlines = piece_total_newlines(p->left);
+		if (k < left_newlines)
+		{
+			p = p->left;
+			continue;
+		}
+		k -= left_newlines;
+		base += piece_total_length(p->left);
+		if (k < p->newlines)
+		{
+			const struct rope_buffer* buf = rope_piece_buffer(rope, p);
+			int i = rope_buffer_lower_bound(buf, p->start) + k;
+			return base + *LIST_GET(buf->newlines, i, int) - p->start;
+		}
+		k -= p->newlines;
+		base += p->length;
+		p = p->right;
+	}
+	return -1;
+}
+
+/* count of newlines before offset */
+static int rope_count_newlines(const rope_t rope, int offset)
+{
+	const struct piece* p = rope->root;
+	int result = 0;
+	while (p)
+	{
+		int left_length = piece_total_length(p->left);
+		if (offset <= left_length)
+		{
+			p = p->left;
+			continue;
+		}
+		result += piece_total_newlines(p->left);
+		offset -= left_length;
+		if (offset <= p->length)
+			return result + rope_count_piece_newlines(rope, p->added, p->start, offset);
+		result += p->newlines;
+		offset -= p->length;
+		p = p->right;
+	}
+	return result;
+}
+
+/* offset row begins at. The row after the last one looked up begins right after its end, so reading rows in order is cheap */
+static int rope_line_start(const rope_t rope, int row)
+{
+	assert(row >= 0 && row < rope_line_count(rope));
+	if (rope->cached_row == row)
+		return rope->cached_start;
+	int start;
+	if (row == 0)
+		start = 0;
+	else if (rope->cached_row == row - 1 && rope->cached_end >= 0)
+		start = rope->cached_end + 1;
+	else
+		start = rope_find_newline(rope, row - 1) + 1;
+	rope->cached_row = row;
+	rope->cached_start = start;
+	rope->cached_end = -1;
+	return start;
+}
+
+/* offset of the newline that ends row, or the rope's length for the last row */
+static int rope_line_end(const rope_t rope, int row)
+{
+	rope_line_start(rope, row);
+	if (rope->cached_end < 0)
+		rope->cached_end = row + 1 < rope_line_count(rope) ? rope_find_newline(rope, row) : rope_length(rope);
+	return rope->cached_end;
+}
+
+/*	marks row's hash out of date, with the hashes of removed rows after it taken out and added rows put in their place.
+	Called before the edit so row can still be found */
+static void rope_rows_edited(rope_t rope, int row, int removed, int added)
+{
+	int count = list_count(rope->line_hashes);
+	if (row >= count)
+		return;
+	LIST_GET(rope->line_hashes, row, struct line_hash)->hashed = false;
+	int last = min(row + removed, count - 1);
+	if (last > row)
+		list_splice(rope->line_hashes, row + 1, last);
+	if (added > 0 && row + 1 < list_count(rope->line_hashes))
+	{
+		list_t dirty = list_create(sizeof(struct line_hash));
+		list_resize(dirty, added);
+		memset(list_element_array(dirty), 0, sizeof(struct line_hash) * added);
+		list_concat(rope->line_hashes, dirty, row + 1);
+		list_destroy(dirty);
+	}
+}
+
+static void rope_copy_pieces(const rope_t rope, const struct piece* p, int offset, int size, char* out)
+{
+	while (p && size > 0)
+	{
+		int left_length = piece_total_length(p->left);
+		if (offset < left_length)
+		{
+			int copied = min(size, left_length - offset);
+			rope_copy_pieces(rope, p->left, offset, copied, out);
+			out += copied;
+			size -= copied;
+			offset += copied;
+			if (size <= 0)
+				return;
+		}
+		offset -= left_length;
+		if (offset < p->length)
+		{
+			int copied = min(size, p->length - offset);
+			memcpy(out, (char*)list_element_array(rope_piece_buffer(rope, p)->text) + p->start + offset, copied);
+			out += copied;
+			size -= copied;
+			offset += copied;
+		}
+		offset -= p->length;
+		p = p->right;
+	}
+}
+
+static rope_t rope_create_buffers(const char* text, int size, list_backing_t* backing)
+{
+	assert(size >= 0 && (text || size == 0));
+	rope_t result = journal_malloc(sizeof * result);
+	*result = (struct rope)
+	{
+		.seed = 0x9E3779B9,
+		.cached_row = -1,
+		.versions = list_create(sizeof(struct rope_version)),
+		.line_hashes = list_create(sizeof(struct line_hash)),
+		.line_copy = list_create(sizeof(char))
+	};
+	rope_buffer_create(&result->original, text, size, backing);
+	rope_buffer_create(&result->added, NULL, 0, NULL);
+	if (size > 0)
+		result->root = rope_create_piece(result, false, 0, size);
+	rope_clear_versions(result);
+	return result;
+}
+
+/* creates empty rope, which has a single empty line */
+rope_t rope_create(void)
+{
+	return rope_create_buffers(NULL, 0, NULL);
+}
+
+/* creates rope that uses a copy of text as its original buffer. Text is expected to be formatted */
+rope_t rope_create_with_text(const char* text, int size)
+{
+	return rope_create_buffers(text, size, NULL);
+}
+
+/* creates rope over text owned by backing without copying it, like a mapped file. Text is expected to be formatted */
+rope_t rope_create_borrowed(const char* text, int size, list_backing_t* backing)
+{
+	assert(backing);
+	return rope_create_buffers(text, size, backing);
+}
+
+/* copies text the rope borrows into storage of its own */
+void rope_own(rope_t rope)
+{
+	assert(rope);
+	list_own(rope->original.text);
+}
+
+/* frees rope and its buffers */
+void rope_destroy(rope_t rope)
+{
+	if (!rope)
+		return;
+	rope_release_pieces(rope->root);
+	for (int i = 0; i < list_count(rope->versions); i++)
+		rope_release_pieces(LIST_GET(rope->versions, i, struct rope_version)->root);
+	list_destroy(rope->versions);
+	list_destroy(rope->line_hashes);
+	list_destroy(rope->line_copy);
+	rope_buffer_destroy(&rope->original);
+	rope_buffer_destroy(&rope->added);
+	free(rope);
+}
+
+/* character count, including newlines */
+int rope_length(const rope_t rope)
+{
+	assert(rope);
+	return piece_total_length(rope->root);
+}
+
+/* line count, always >= 1 */
+int rope_line_count(const rope_t rope)
+{
+	assert(rope);
+	return piece_total_newlines(rope->root) + 1;
+}
+
+/* character count of line at row, excluding newline */
+int rope_line_length(const rope_t rope, int row)
+{
+	assert(rope && row >= 0 && row < rope_line_count(rope));
+	return rope_line_end(rope, row) - rope_line_start(rope, row);
+}
+
+/*	text of line at row, excluding newline, and its length in length. Points into the rope's buffers if the line is in
+	one piece, a copy otherwise. Only valid until the rope is used again */
+const char* rope_line(const rope_t rope, int row, int* length)
+{
+	assert(rope && row >= 0 && row < rope_line_count(rope) && length);
+	int start = rope_line_start(rope, row), size;
+	*length = rope_line_end(rope, row) - start;
+	const char* text = rope_text(rope, start, &size);
+	if (*length == 0)
+		return "";
+	if (size >= *length)
+		return text;
+	list_resize(rope->line_copy, *length);
+	rope_copy(rope, start, *length, list_element_array(rope->line_copy));
+	return list_element_array(rope->line_copy);
+}
+
+/* hash of a row's text, cached so only the rows edited since it was last asked for are hashed again */
+uint64_t rope_line_hash(const rope_t rope, int row)
+{
+	assert(rope && row >= 0 && row < rope_line_count(rope));
+	int count = list_count(rope->line_hashes);
+	if (count <= row)
+	{
+		list_resize(rope->line_hashes, row + 1);
+		memset(LIST_GET(rope->line_hashes, count, struct line_hash), 0, sizeof(struct line_hash) * (row + 1 - count));
+	}
+	struct line_hash* cached = LIST_GET(rope->line_hashes, row, struct line_hash);
+	if (!cached->hashed)
+	{
+		int length;
+		const char* text = rope_line(rope, row, &length);
+		cached->hash = hash_bytes(text, length, 0);
+		cached->hashed = true;
+	}
+	return cached->hash;
+}
+
+/* returns absolute offset of a valid cursor */
+int rope_coords_to_offset(const rope_t rope, coords_t coords)
+{
+	assert(rope && coords.column >= 0 && coords.column <= rope_line_length(rope, coords.row));
+	return rope_line_start(rope, coords.row) + coords.column;
+}
+
+/* returns cursor at absolute offset. Offset is clamped to [0, length] */
+coords_t rope_offset_to_coords(const rope_t rope, int offset)
+{
+	assert(rope);
+	offset = min(max(0, offset), rope_length(rope));
+	int row = rope_count_newlines(rope, offset);
+	return (coords_t) { .column = offset - rope_line_start(rope, row), .row = row };
+}
+
+/*	text from offset to the end of the piece holding it, with its length in size. NULL at the end of the rope.
+	Valid until the rope is changed, and safe to call from any thread while it isn't */
+const char* rope_text(const rope_t rope, int offset, int* size)
+{
+	assert(rope && offset >= 0 && offset <= rope_length(rope) && size);
+	const struct piece* p = rope->root;
+	while (p)
+	{
+		int left_length = piece_total_length(p->left);
+		if (offset < left_length)
+			p = p->left;
+		else if (offset < left_length + p->length)
+		{
+			offset -= left_length;
+			*size = p->length - offset;
+			return (const char*)list_element_array(rope_piece_buffer(rope, p)->text) + p->start + offset;
+		}
+		else
+		{
+			offset -= left_length + p->length;
+			p = p->right;
+		}
+	}
+	*size = 0;
+	return NULL;
+}
+
+/* copies size characters at offset into out, which must have space for size characters. Safe to call from any thread */
+void rope_copy(const rope_t rope, int offset, int size, char* out)
+{
+	assert(rope && offset >= 0 && size >= 0 && offset + size <= rope_length(rope) && (out || size == 0));
+	rope_copy_pieces(rope, rope->root, offset, size, out);
+}
+
+/* walks the right spine of p, growing the last piece by length characters. Takes the reference to p */
+static struct piece* rope_extend_last_piece(struct piece* p, int length, int newlines)
+{
+	p = rope_own_piece(p);
+	p->total_length += length;
+	p->total_newlines += newlines;
+	if (p->right)
+		p->right = rope_extend_last_piece(p->right, length, newlines);
+	else
+	{
+		p->length += length;
+		p->newlines += newlines;
+	}
+	return p;
+}
+
+/* inserts unformatted text at offset */
+void rope_insert(rope_t rope, int offset, const char* text, int size)
+{
+	assert(rope && offset >= 0 && offset <= rope_length(rope) && size >= 0 && (text || size == 0));
+	if (size == 0)
+		return;
+
+	int newlines_before = list_count(rope->added.newlines);
+	int start = rope_buffer_append(&rope->added, text, size);
+	int newlines = list_count(rope->added.newlines) - newlines_before;
+	if (list_count(rope->line_hashes) > 0)
+		rope_rows_edited(rope, rope_count_newlines(rope, offset), 0, newlines);
+
+	struct piece* l, *r;
+	rope_split(rope, rope->root, offset, &l, &r);
+
+	/* typing appends to the added buffer, so usually the piece before the cursor can just grow */
+	const struct piece* last = l;
+	while (last && last->right)
+		last = last->right;
+	if (last && last->added && last->start + last->length == start)
+		l = rope_extend_last_piece(l, size, newlines);
+	else
+		l = rope_merge(l, rope_create_piece(rope, true, start, size));
+
+	rope->root = rope_merge(l, r);
+	rope->cached_row = -1;
+}
+
+/* removes size characters at offset */
+void rope_delete(rope_t rope, int offset, int size)
+{
+	assert(rope && offset >= 0 && size >= 0 && offset + size <= rope_length(rope));
+	if (size == 0)
+		return;
+	if (list_count(rope->line_hashes) > 0)
+	{
+		int row = rope_count_newlines(rope, offset);
+		rope_rows_edited(rope, row, rope_count_newlines(rope, offset + size) - row, 0);
+	}
+
+	struct piece* l, *m, *r;
+	rope_split(rope, rope->root, offset, &l, &m);
+	rope_split(rope, m, size, &m, &r);
+	rope_release_pieces(m);
+	rope->root = rope_merge(l, r);
+	rope->cached_row = -1;
+}
+
+/* swaps in root, which is shared with a version. Any row might have changed */
+static void rope_set_root(rope_t rope, struct piece* root)
+{
+	rope_retain_pieces(root);
+	rope_release_pieces(rope->root);
+	rope->root = root;
+	rope->cached_row = -1;
+	list_clear(rope->line_hashes);
+}
+
+/* records the current text as a child of the version it was edited from. Returns the current version if nothing changed */
+int rope_commit(rope_t rope)
+{
+	assert(rope);
+	struct rope_version* current = LIST_GET(rope->versions, rope->version, struct rope_version);
+	if (current->root == rope->root)
+		return rope->version;
+	struct rope_version version =
+	{
+		.root = rope_retain_pieces(rope->root),
+		.parent = rope->version,
+		.last_child = -1,
+		.first_child = -1,
+		.next_sibling = current->first_child
+	};
+	LIST_PUSH(rope->versions, version);
+	rope->version = list_count(rope->versions) - 1;
+	current = LIST_GET(rope->versions, version.parent, struct rope_version);
+	current->last_child = current->first_child = rope->version;
+	return rope->version;
+}
+
+/* records the current text as the current version instead of a new one. The version can't have been committed from yet */
+void rope_amend(rope_t rope)
+{
+	assert(rope);
+	struct rope_version* current = LIST_GET(rope->versions, rope->version, struct rope_version);
+	assert(current->first_child < 0);
+	rope_retain_pieces(rope->root);
+	rope_release_pieces(current->root);
+	current->root = rope->root;
+}
+
+/* goes back to the version the current one was committed from, dropping uncommitted edits. Returns false at the first version */
+bool rope_undo(rope_t rope)
+{
+	assert(rope);
+	int parent = LIST_GET(rope->versions, rope->version, struct rope_version)->parent;
+	if (parent < 0)
+		return false;
+	/* redo comes back down the branch it left from */
+	LIST_GET(rope->versions, parent, struct rope_version)->last_child = rope->version;
+	rope_checkout(rope, parent);
+	return true;
+}
+
+/* goes to the child last committed or undone from, dropping uncommitted edits. Returns false if there is none */
+bool rope_redo(rope_t rope)
+{
+	assert(rope);
+	int child = LIST_GET(rope->versions, rope->version, struct rope_version)->last_child;
+	if (child < 0)
+		return false;
+	rope_checkout(rope, child);
+	return true;
+}
+
+/* points redo at the next older branch off of the current version, or the newest after the oldest. Returns false if there is none */
+bool rope_next_branch(rope_t rope)
+{
+	assert(rope);
+	struct rope_version* current = LIST_GET(rope->versions, rope->version, struct rope_version);
+	if (current->last_child < 0)
+		return false;
+	int next = LIST_GET(rope->versions, current->last_child, struct rope_version)->next_sibling;
+	current->last_child = next >= 0 ? next : current->first_child;
+	return true;
+}
+
+/* goes to any version on any branch, dropping uncommitted edits */
+void rope_checkout(rope_t rope, int version)
+{
+	assert(rope && version >= 0 && version < list_count(rope->versions));
+	rope_set_root(rope, LIST_GET(rope->versions, version, struct rope_version)->root);
+	rope->version = version;
+}
+
+/* version the current text was edited from */
+int rope_version(const rope_t rope)
+{
+	assert(rope);
+	return rope->version;
+}
+
+/* version that version was committed from, -1 for the first version */
+int rope_parent_version(const rope_t rope, int version)
+{
+	assert(rope && version >= 0 && version < list_count(rope->versions));
+	return LIST_GET(rope->versions, version, struct rope_version)->parent;
+}
+
+/* forgets every version, the current text becomes the first */
+void rope_clear_versions(rope_t rope)
+{
+	assert(rope);
+	for (int i = 0; i < list_count(rope->versions); i++)
+		rope_release_pieces(LIST_GET(rope->versions, i, struct rope_version)->root);
+	list_clear(rope->versions);
+	struct rope_version first = { .root = rope_retain_pieces(rope->root), .parent = -1, .last_child = -1, .first_child = -1, .next_sibling = -1 };
+	LIST_PUSH(rope->versions, first);
+	rope->version = 0;
+}
+
+#ifdef TEST
+#ifdef ROPE_TEST
+#include <stdio.h>
+
+#define TEST_COUNT 20000
+#define TEST_VERSION_INTERVAL 500
+
+/* compares rope against text, line by line and in pieces */
+static bool rope_test_equal(rope_t rope, list_t text)
+{
+	const char* str = list_element_array(text);
+	int size = list_count(text), row = 0, start = 0;
+	if (rope_length(rope) != size)
+		return false;
+	for (int i = 0; i <= size; i++)
+	{
+		if (i < size && str[i] != '\n')
+			continue;
+		int length;
+		const char* line = rope_line(rope, row, &length);
+		if (length != i - start || memcmp(line, str + start, length) != 0 || rope_line_hash(rope, row) != hash_bytes(str + start, length, 0))
+			return false;
+		row++;
+		start = i + 1;
+	}
+	for (int offset = 0, piece; offset < size; offset += piece)
+	{
+		const char* text_at = rope_text(rope, offset, &piece);
+		if (!text_at || piece <= 0 || memcmp(text_at, str + offset, min(piece, size - offset)) != 0)
+			return false;
+	}
+	return rope_line_count(rope) == row;
+}
+
+/* coordinates of offset in text, counted the slow way */
+static coords_t rope_test_coords(list_t text, int offset)
+{
+	coords_t result = { 0 };
+	for (int i = 0; i < offset; i++)
+		result = *LIST_GET(text, i, char) == '\n' ? (coords_t) { 0, result.row + 1 } : (coords_t) { result.column + 1, result.row };
+	return result;
+}
+
+static int test_backing_released;
+
+static void rope_test_release(list_backing_t* backing)
+{
+	test_backing_released++;
+}
+
+int main()
+{
+	static const char* samples[] = { "a", "hello", "\n", "ab\ncd", "  x", "line\n\nline", "z\n" };
+	rope_t rope = rope_create();
+	list_t text = list_create(sizeof(char)); /* the same text, edited the slow way */
+	list_t versions = list_create(sizeof(list_t)); /* text at every committed version */
+	list_t version = list_create(sizeof(char));
+	LIST_PUSH(versions, version);
+	srand(17);
+
+	int wrong_count = 0;
+	for (int i = 0; i < TEST_COUNT; i++)
+	{
+		if (i % TEST_VERSION_INTERVAL == TEST_VERSION_INTERVAL - 1)
+		{
+			wrong_count += rope_commit(rope) != list_count(versions);
+			version = list_create_with_array(list_element_array(text), sizeof(char), list_count(text));
+			LIST_PUSH(versions, version);
+		}
+
+		int offset = rand() % (list_count(text) + 1);
+		if (rand() % 3 || list_count(text) < 16)
+		{
+			const char* sample = samples[rand() % (sizeof samples / sizeof * samples)];
+			list_t inserted = list_create_with_array(sample, sizeof(char), (int)strlen(sample));
+			list_concat(text, inserted, offset);
+			list_destroy(inserted);
+			rope_insert(rope, offset, sample, (int)strlen(sample));
+		}
+		else
+		{
+			int size = rand() % 12;
+			size = min(size, list_count(text) - offset);
+			list_splice_count(text, offset, size);
+			rope_delete(rope, offset, size);
+		}
+
+		/* hashes are only checked now and then, so the ones cached have to follow the edits between */
+		offset = rand() % (list_count(text) + 1);
+		coords_t expected = rope_test_coords(text, offset), found = rope_offset_to_coords(rope, offset);
+		wrong_count += expected.row != found.row || expected.column != found.column || rope_coords_to_offset(rope, found) != offset;
+		if (i % 50 == 0)
+			wrong_count += !rope_test_equal(rope, text);
+	}
+	printf("Rope test resulted in %i mismatches over %i edits (%i lines).\n", wrong_count, TEST_COUNT, rope_line_count(rope));
+
+	/* every version is intact after going back and forth through them, and after branching off of one */
+	int version_wrong_count = 0, last = list_count(versions) - 1;
+	rope_checkout(rope, last);
+	while (rope_undo(rope))
+		version_wrong_count += !rope_test_equal(rope, *LIST_GET(versions, rope_version(rope), list_t));
+	version_wrong_count += rope_version(rope) != 0;
+	while (rope_redo(rope))
+		version_wrong_count += !rope_test_equal(rope, *LIST_GET(versions, rope_version(rope), list_t));
+	version_wrong_count += rope_version(rope) != last;
+
+	int fork = last / 2;
+	rope_checkout(rope, fork);
+	rope_insert(rope, 0, "branch\n", 7);
+	int branch = rope_commit(rope);
+	version_wrong_count += rope_parent_version(rope, branch) != fork || rope_line_length(rope, 0) != 6;
+	rope_undo(rope);
+	rope_redo(rope);
+	version_wrong_count += rope_version(rope) != branch;
+	rope_checkout(rope, fork + 1);
+	version_wrong_count += !rope_test_equal(rope, *LIST_GET(versions, fork + 1, list_t));
+
+	/* redo cycles through the branches off of a version from the newest, and amending keeps a version's place in the tree */
+	rope_checkout(rope, fork);
+	version_wrong_count += !rope_next_branch(rope) || !rope_redo(rope) || rope_version(rope) != fork + 1;
+	version_wrong_count += !rope_undo(rope) || !rope_next_branch(rope) || !rope_redo(rope) || rope_version(rope) != branch;
+	rope_insert(rope, 0, "amended ", 8);
+	rope_amend(rope);
+	version_wrong_count += !rope_undo(rope) || !rope_redo(rope) || rope_version(rope) != branch || rope_line_length(rope, 0) != 14;
+	rope_clear_versions(rope);
+	version_wrong_count += rope_version(rope) != 0 || rope_undo(rope) || rope_line_length(rope, 0) != 14;
+	printf("Rope version test resulted in %i mismatches over %i versions.\n", version_wrong_count, list_count(versions));
+
+	/* borrowed text is read in place until the rope owns it, and let go of once */
+	static const char borrowed[] = "mapped\ntext";
+	list_backing_t backing = { .release = rope_test_release };
+	rope_t mapped = rope_create_borrowed(borrowed, sizeof borrowed - 1, &backing);
+	int length;
+	wrong_count += rope_line(mapped, 1, &length) != borrowed + 7 || length != 4;
+	rope_own(mapped);
+	wrong_count += test_backing_released != 1 || rope_line(mapped, 1, &length) == borrowed + 7 || memcmp(rope_line(mapped, 0, &length), "mapped", 6) != 0;
+	rope_destroy(mapped);
+	wrong_count += test_backing_released != 1;
+
+	for (int i = 0; i < list_count(versions); i++)
+		list_destroy(*LIST_GET(versions, i, list_t));
+	list_destroy(versions);
+	list_destroy(text);
+	rope_destroy(rope);
+	return wrong_count != 0 || version_wrong_count != 0;
+}
+#endif
+#endif
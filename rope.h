@@ -0,0 +1,80 @@
+/*
+	rope.h ~ RL
+
+	Piece table text buffer, balanced with a persistent treap
+	Holds the editor's lines, editor.h formats text on its way in
+*/
+
+#pragma once
+
+#include "util.h"
+
+typedef struct coords
+{
+	int column;
+	int row;
+} coords_t;
+
+typedef struct rope* rope_t;
+
+/* creates empty rope, which has a single empty line */
+rope_t rope_create(void);
+/* creates rope that uses a copy of text as its original buffer. Text is expected to be formatted */
+rope_t rope_create_with_text(const char* text, int size);
+/* creates rope over text owned by backing without copying it, like a mapped file. Text is expected to be formatted */
+rope_t rope_create_borrowed(const char* text, int size, list_backing_t* backing);
+/* copies text the rope borrows into storage of its own */
+void rope_own(rope_t rope);
+/* frees rope and its buffers */
+void rope_destroy(rope_t rope);
+
+/* character count, including newlines */
+int rope_length(const rope_t rope);
+/* line count, always >= 1 */
+int rope_line_count(const rope_t rope);
+/* character count of line at row, excluding newline */
+int rope_line_length(const rope_t rope, int row);
+/*	text of line at row, excluding newline, and its length in length. Points into the rope's buffers if the line is in
+	one piece, a copy otherwise. Only valid until the rope is used again */
+const char* rope_line(const rope_t rope, int row, int* length);
+/* hash of a row's text, cached so only the rows edited since it was last asked for are hashed again */
+uint64_t rope_line_hash(const rope_t rope, int row);
+
+/* returns absolute offset of a valid cursor */
+int rope_coords_to_offset(const rope_t rope, coords_t coords);
+/* returns cursor at absolute offset. Offset is clamped to [0, length] */
+coords_t rope_offset_to_coords(const rope_t rope, int offset);
+
+/*	text from offset to the end of the piece holding it, with its length in size. NULL at the end of the rope.
+	Valid until the rope is changed, and safe to call from any thread while it isn't */
+const char* rope_text(const rope_t rope, int offset, int* size);
+/* copies size characters at offset into out, which must have space for size characters. Safe to call from any thread */
+void rope_copy(const rope_t rope, int offset, int size, char* out);
+/* inserts unformatted text at offset */
+void rope_insert(rope_t rope, int offset, const char* text, int size);
+/* removes size characters at offset */
+void rope_delete(rope_t rope, int offset, int size);
+
+/*
+	VERSIONS FORM AN UNDO TREE. EVERY VERSION SHARES UNCHANGED PIECES WITH THE OTHERS,
+	SO GOING BETWEEN THEM ONLY SWAPS THE ROOT
+*/
+
+/* records the current text as a child of the version it was edited from. Returns the current version if nothing changed */
+int rope_commit(rope_t rope);
+/* records the current text as the current version instead of a new one. The version can't have been committed from yet */
+void rope_amend(rope_t rope);
+/* goes back to the version the current one was committed from, dropping uncommitted edits. Returns false at the first version */
+bool rope_undo(rope_t rope);
+/* goes to the child last committed or undone from, dropping uncommitted edits. Returns false if there is none */
+bool rope_redo(rope_t rope);
+/* points redo at the next older branch off of the current version, or the newest after the oldest. Returns false if there is none */
+bool rope_next_branch(rope_t rope);
+/* goes to any version on any branch, dropping uncommitted edits */
+void rope_checkout(rope_t rope, int version);
+/* version the current text was edited from */
+int rope_version(const rope_t rope);
+/* version that version was committed from, -1 for the first version */
+int rope_parent_version(const rope_t rope, int version);
+/* forgets every version, the current text becomes the first */
+void rope_clear_versions(rope_t rope);
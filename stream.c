@@ -0,0 +1,239 @@
+/*
+	stream.c ~ RL
+
+	Chains of readers and writers that pass fixed-size buffers from stage to stage
+*/
+
+#include "stream.h"
+#include <assert.h>
+#include <string.h>
+
+struct reader
+{
+	reader_read_t read;
+	stream_free_t free_state;
+	void* state;
+	reader_t source;
+	bool failed, ended;
+	char peeked[STREAM_PEEK_SIZE];
+	int peeked_count;
+};
+
+struct writer
+{
+	writer_write_t write;
+	writer_close_t close;
+	stream_free_t free_state;
+	void* state;
+	writer_t sink;
+	bool failed, closed;
+};
+
+/* creates stage that pulls from source. The source is destroyed along with it */
+reader_t reader_create(reader_read_t read, stream_free_t free_state, void* state, reader_t source)
+{
+	assert(read);
+	reader_t result = journal_malloc(sizeof * result);
+	*result = (struct reader){ .read = read, .free_state = free_state, .state = state, .source = source };
+	return result;
+}
+
+static int reader_file_read(void* state, reader_t source, char* buf, int size)
+{
+	(void)source;
+	FILE* file = state;
+	int count = (int)fread(buf, 1, size, file);
+	return count == 0 && ferror(file) ? -1 : count;
+}
+
+/* creates first stage, reading from an open file. The file is not closed */
+reader_t reader_create_file(FILE* file)
+{
+	assert(file);
+	return reader_create(reader_file_read, NULL, file, NULL);
+}
+
+struct memory_source
+{
+	const char* buf;
+	int size, pos;
+};
+
+static int reader_memory_read(void* state, reader_t source, char* buf, int size)
+{
+	(void)source;
+	struct memory_source* memory = state;
+	int count = min(size, memory->size - memory->pos);
+	memcpy(buf, memory->buf + memory->pos, count);
+	memory->pos += count;
+	return count;
+}
+
+/* creates first stage, reading from a buffer that must outlive the reader */
+reader_t reader_create_memory(const void* buf, int size)
+{
+	assert((buf || size == 0) && size >= 0);
+	struct memory_source* memory = journal_malloc(sizeof * memory);
+	*memory = (struct memory_source){ .buf = buf, .size = size };
+	return reader_create(reader_memory_read, free, memory, NULL);
+}
+
+/* destroys reader and every stage it pulls from */
+void reader_destroy(reader_t reader)
+{
+	while (reader)
+	{
+		reader_t source = reader->source;
+		if (reader->free_state)
+			reader->free_state(reader->state);
+		free(reader);
+		reader = source;
+	}
+}
+
+/* reads up to size bytes. Returns count, 0 at the end of the stream, or -1 on failure */
+int reader_read(reader_t reader, void* buf, int size)
+{
+	assert(reader && buf && size >= 0);
+	if (reader->peeked_count > 0)
+	{
+		int count = min(size, reader->peeked_count);
+		memcpy(buf, reader->peeked, count);
+		memmove(reader->peeked, reader->peeked + count, reader->peeked_count - count);
+		reader->peeked_count -= count;
+		return count;
+	}
+	if (reader->failed)
+		return -1;
+	if (reader->ended || size == 0)
+		return 0;
+
+	int count = reader->read(reader->state, reader->source, buf, size);
+	if (count < 0)
+		reader->failed = true;
+	else if (count == 0)
+		reader->ended = true;
+	return count;
+}
+
+/* reads until size bytes are read or the stream ends. Returns count or -1 on failure */
+int reader_read_full(reader_t reader, void* buf, int size)
+{
+	int total = 0;
+	while (total < size)
+	{
+		int count = reader_read(reader, (char*)buf + total, size - total);
+		if (count < 0)
+			return -1;
+		if (count == 0)
+			break;
+		total += count;
+	}
+	return total;
+}
+
+/* reads up to size bytes, at most STREAM_PEEK_SIZE, without consuming them */
+int reader_peek(reader_t reader, void* buf, int size)
+{
+	assert(reader && buf && size >= 0 && size <= STREAM_PEEK_SIZE);
+	while (reader->peeked_count < size && !reader->failed && !reader->ended)
+	{
+		int count = reader->read(reader->state, reader->source, reader->peeked + reader->peeked_count, size - reader->peeked_count);
+		if (count < 0)
+			reader->failed = true;
+		else if (count == 0)
+			reader->ended = true;
+		else
+			reader->peeked_count += count;
+	}
+	if (reader->failed && reader->peeked_count == 0)
+		return -1;
+	int count = min(size, reader->peeked_count);
+	memcpy(buf, reader->peeked, count);
+	return count;
+}
+
+/* creates stage that writes to sink. The sink is destroyed along with it */
+writer_t writer_create(writer_write_t write, writer_close_t close, stream_free_t free_state, void* state, writer_t sink)
+{
+	assert(write);
+	writer_t result = journal_malloc(sizeof * result);
+	*result = (struct writer){ .write = write, .close = close, .free_state = free_state, .state = state, .sink = sink };
+	return result;
+}
+
+static bool writer_file_write(void* state, writer_t sink, const char* buf, int size)
+{
+	(void)sink;
+	return fwrite(buf, 1, size, state) == (size_t)size;
+}
+
+static bool writer_file_close(void* state, writer_t sink)
+{
+	(void)sink;
+	return fflush(state) == 0;
+}
+
+/* creates last stage, writing to an open file. The file is not closed */
+writer_t writer_create_file(FILE* file)
+{
+	assert(file);
+	return writer_create(writer_file_write, writer_file_close, NULL, file, NULL);
+}
+
+static bool writer_list_write(void* state, writer_t sink, const char* buf, int size)
+{
+	(void)sink;
+	list_t out = state;
+	int start = list_count(out);
+	list_resize(out, start + size);
+	memcpy((char*)list_element_array(out) + start, buf, size);
+	return true;
+}
+
+/* creates last stage, appending to a list of chars */
+writer_t writer_create_list(list_t out)
+{
+	assert(out && list_element_size(out) == sizeof(char));
+	return writer_create(writer_list_write, NULL, NULL, out, NULL);
+}
+
+/* destroys writer and every stage after it */
+void writer_destroy(writer_t writer)
+{
+	while (writer)
+	{
+		writer_t sink = writer->sink;
+		if (writer->free_state)
+			writer->free_state(writer->state);
+		free(writer);
+		writer = sink;
+	}
+}
+
+/* writes size bytes to the first stage */
+bool writer_write(writer_t writer, const void* buf, int size)
+{
+	assert(writer && (buf || size == 0) && size >= 0 && !writer->closed);
+	if (writer->failed)
+		return false;
+	if (size > 0 && !writer->write(writer->state, writer->sink, buf, size))
+		writer->failed = true;
+	return !writer->failed;
+}
+
+/* closes every stage in order, returns false if any write failed */
+bool writer_close(writer_t writer)
+{
+	bool result = true;
+	for (; writer; writer = writer->sink)
+	{
+		if (writer->closed)
+			continue;
+		writer->closed = true;
+		if (!writer->failed && writer->close && !writer->close(writer->state, writer->sink))
+			writer->failed = true;
+		result &= !writer->failed;
+	}
+	return result;
+}
\ No newline at end of file
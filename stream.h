@@ -0,0 +1,56 @@
+/*
+	stream.h ~ RL
+
+	Chains of readers and writers that pass fixed-size buffers from stage to stage
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "util.h"
+
+#define STREAM_BUFFER_SIZE		0x10000 /* bytes stages move at a time */
+#define STREAM_PEEK_SIZE		16
+
+typedef struct reader* reader_t;
+typedef struct writer* writer_t;
+
+/* fills buf with up to size bytes pulled from source. Returns count, 0 at the end of the stream, or -1 on failure */
+typedef int (*reader_read_t)(void* state, reader_t source, char* buf, int size);
+/* processes size bytes, passing output on to sink */
+typedef bool (*writer_write_t)(void* state, writer_t sink, const char* buf, int size);
+/* passes on anything still buffered once the last byte has been written */
+typedef bool (*writer_close_t)(void* state, writer_t sink);
+/* frees state of a stage */
+typedef void (*stream_free_t)(void* state);
+
+/* creates stage that pulls from source. The source is destroyed along with it */
+reader_t reader_create(reader_read_t read, stream_free_t free_state, void* state, reader_t source);
+/* creates first stage, reading from an open file. The file is not closed */
+reader_t reader_create_file(FILE* file);
+/* creates first stage, reading from a buffer that must outlive the reader */
+reader_t reader_create_memory(const void* buf, int size);
+/* destroys reader and every stage it pulls from */
+void reader_destroy(reader_t reader);
+
+/* reads up to size bytes. Returns count, 0 at the end of the stream, or -1 on failure */
+int reader_read(reader_t reader, void* buf, int size);
+/* reads until size bytes are read or the stream ends. Returns count or -1 on failure */
+int reader_read_full(reader_t reader, void* buf, int size);
+/* reads up to size bytes, at most STREAM_PEEK_SIZE, without consuming them */
+int reader_peek(reader_t reader, void* buf, int size);
+
+/* creates stage that writes to sink. The sink is destroyed along with it */
+writer_t writer_create(writer_write_t write, writer_close_t close, stream_free_t free_state, void* state, writer_t sink);
+/* creates last stage, writing to an open file. The file is not closed */
+writer_t writer_create_file(FILE* file);
+/* creates last stage, appending to a list of chars */
+writer_t writer_create_list(list_t out);
+/* destroys writer and every stage after it */
+void writer_destroy(writer_t writer);
+
+/* writes size bytes to the first stage */
+bool writer_write(writer_t writer, const void* buf, int size);
+/* closes every stage in order, returns false if any write failed */
+bool writer_close(writer_t writer);
\ No newline at end of file
@@ -0,0 +1,339 @@
+/*
+	thread.c ~ RL
+
+	Worker thread pool for running independent jobs in parallel
+*/
+
+#include "thread.h"
+#include <assert.h>
+#include <stdint.h>
+#include "util.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+
+typedef HANDLE thread_handle_t;
+typedef CRITICAL_SECTION thread_mutex_t;
+typedef CONDITION_VARIABLE thread_cond_t;
+
+#define THREAD_MUTEX_INIT(m)		InitializeCriticalSection(m)
+#define THREAD_MUTEX_DESTROY(m)		DeleteCriticalSection(m)
+#define THREAD_LOCK(m)				EnterCriticalSection(m)
+#define THREAD_UNLOCK(m)			LeaveCriticalSection(m)
+#define THREAD_COND_INIT(c)			InitializeConditionVariable(c)
+#define THREAD_COND_DESTROY(c)		((void)(c))
+#define THREAD_WAIT(c, m)			SleepConditionVariableCS(c, m, INFINITE)
+#define THREAD_BROADCAST(c)			WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t thread_handle_t;
+typedef pthread_mutex_t thread_mutex_t;
+typedef pthread_cond_t thread_cond_t;
+
+#define THREAD_MUTEX_INIT(m)		pthread_mutex_init(m, NULL)
+#define THREAD_MUTEX_DESTROY(m)		pthread_mutex_destroy(m)
+#define THREAD_LOCK(m)				pthread_mutex_lock(m)
+#define THREAD_UNLOCK(m)			pthread_mutex_unlock(m)
+#define THREAD_COND_INIT(c)			pthread_cond_init(c, NULL)
+#define THREAD_COND_DESTROY(c)		pthread_cond_destroy(c)
+#define THREAD_WAIT(c, m)			pthread_cond_wait(c, m)
+#define THREAD_BROADCAST(c)			pthread_cond_broadcast(c)
+#endif
+
+static struct
+{
+	int requested;				/* worker count knob, 0 = one per core */
+	bool created, stopping, busy;
+	int thread_count;			/* spawned threads, excluding the calling thread */
+	thread_handle_t threads[THREAD_MAX_WORKERS];
+	thread_mutex_t lock;
+	thread_cond_t wake, done;
+
+	/* current batch */
+	uint64_t generation;
+	uint64_t created_generation;	/* the one before the threads were created, so they don't miss the batch that created them */
+	thread_job_t job;
+	void* ctx;
+	int job_count, next_job, finished_jobs;
+} pool;
+
+static int thread_core_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+/* takes jobs from the current batch until there are none left. Lock must be held */
+static void thread_work(void)
+{
+	while (pool.next_job < pool.job_count)
+	{
+		int index = pool.next_job++;
+		THREAD_UNLOCK(&pool.lock);
+		pool.job(pool.ctx, index);
+		THREAD_LOCK(&pool.lock);
+		if (++pool.finished_jobs == pool.job_count)
+			THREAD_BROADCAST(&pool.done);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(void* unused)
+#else
+static void* thread_main(void* unused)
+#endif
+{
+	(void)unused;
+	THREAD_LOCK(&pool.lock);
+	uint64_t seen = pool.created_generation;
+	for (;;)
+	{
+		while (!pool.stopping && pool.generation == seen)
+			THREAD_WAIT(&pool.wake, &pool.lock);
+		if (pool.stopping)
+			break;
+		seen = pool.generation;
+		thread_work();
+	}
+	THREAD_UNLOCK(&pool.lock);
+	/* jobs may have left blocks in this thread's cache, which the next workers can use */
+	list_pool_flush_thread_cache();
+	return 0;
+}
+
+static void thread_create_pool(void)
+{
+	THREAD_MUTEX_INIT(&pool.lock);
+	THREAD_COND_INIT(&pool.wake);
+	THREAD_COND_INIT(&pool.done);
+	pool.stopping = false;
+	pool.created = true;
+	pool.created_generation = pool.generation;
+
+	int count = thread_worker_count() - 1;
+	for (pool.thread_count = 0; pool.thread_count < count; pool.thread_count++)
+	{
+#ifdef _WIN32
+		thread_handle_t handle = CreateThread(NULL, 0, thread_main, NULL, 0, NULL);
+		if (!handle)
+			break;
+#else
+		thread_handle_t handle;
+		if (pthread_create(&handle, NULL, thread_main, NULL) != 0)
+			break;
+#endif
+		pool.threads[pool.thread_count] = handle;
+	}
+	if (pool.thread_count < count)
+		debug_format("Created %i of %i worker threads.\n", pool.thread_count, count);
+}
+
+/* whether a batch is running, which only ends on the thread that started it */
+static bool thread_is_busy(void)
+{
+	if (!pool.created)
+		return false;
+	THREAD_LOCK(&pool.lock);
+	bool busy = pool.busy;
+	THREAD_UNLOCK(&pool.lock);
+	return busy;
+}
+
+/* sets how many threads run jobs, including the calling thread. 0 uses one per core, 1 runs everything on the calling thread */
+void thread_set_worker_count(int count)
+{
+	assert(count >= 0);
+	if (count == pool.requested)
+		return;
+	/* the threads can't be joined under a batch, so the count only changes between them */
+	if (thread_is_busy())
+	{
+		debug_format("Worker count can't change while jobs are running.\n");
+		return;
+	}
+	thread_destroy_pool();
+	pool.requested = count;
+}
+
+/* how many threads jobs are spread across, including the calling thread */
+int thread_worker_count(void)
+{
+	int count = pool.requested ? pool.requested : thread_core_count();
+	return min(max(1, count), THREAD_MAX_WORKERS + 1);
+}
+
+/* hands a batch to the workers and helps with it until it's done. Lock must be held */
+static void thread_run_batch(thread_job_t job, void* ctx, int count)
+{
+	pool.busy = true;
+	pool.job = job;
+	pool.ctx = ctx;
+	pool.job_count = count;
+	pool.next_job = 0;
+	pool.finished_jobs = 0;
+	pool.generation++;
+	THREAD_BROADCAST(&pool.wake);
+
+	thread_work();
+	while (pool.finished_jobs < pool.job_count)
+		THREAD_WAIT(&pool.done, &pool.lock);
+	pool.busy = false;
+}
+
+/* runs job for every index in [0, count) and returns once all of them are done */
+void thread_run_jobs(thread_job_t job, void* ctx, int count)
+{
+	assert(job && count >= 0);
+	if (count > 1 && thread_worker_count() > 1)
+	{
+		if (!pool.created)
+			thread_create_pool();
+		THREAD_LOCK(&pool.lock);
+		/* the pool runs one batch at a time, so a batch started from inside a job runs on the calling thread */
+		if (!pool.busy)
+		{
+			thread_run_batch(job, ctx, count);
+			THREAD_UNLOCK(&pool.lock);
+			return;
+		}
+		THREAD_UNLOCK(&pool.lock);
+	}
+	for (int i = 0; i < count; i++)
+		job(ctx, i);
+}
+
+/* stops and joins the worker threads, they are recreated by the next call to thread_run_jobs */
+void thread_destroy_pool(void)
+{
+	if (!pool.created)
+		return;
+	THREAD_LOCK(&pool.lock);
+	pool.stopping = true;
+	THREAD_BROADCAST(&pool.wake);
+	THREAD_UNLOCK(&pool.lock);
+
+	for (int i = 0; i < pool.thread_count; i++)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(pool.threads[i], INFINITE);
+		CloseHandle(pool.threads[i]);
+#else
+		pthread_join(pool.threads[i], NULL);
+#endif
+	}
+	pool.thread_count = 0;
+	THREAD_COND_DESTROY(&pool.wake);
+	THREAD_COND_DESTROY(&pool.done);
+	THREAD_MUTEX_DESTROY(&pool.lock);
+	pool.created = false;
+}
+#ifdef TEST
+#ifdef THREAD_TEST
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_JOB_COUNT		1000
+#define TEST_RESPAWNS		16
+
+static int test_runs[TEST_JOB_COUNT];
+static int test_nested_runs[TEST_JOB_COUNT][4];
+
+static void thread_test_nested_job(void* ctx, int index)
+{
+	test_nested_runs[*(int*)ctx][index]++;
+}
+
+static void thread_test_job(void* ctx, int index)
+{
+	(void)ctx;
+	test_runs[index]++;
+	/* batches started by a job run on its thread, and the pool can't be resized under them */
+	if (index % 100 == 0)
+	{
+		thread_run_jobs(thread_test_nested_job, &index, 4);
+		if (pool.created)
+			thread_set_worker_count(3);
+	}
+}
+
+static thread_mutex_t test_lock;
+static thread_cond_t test_arrived;
+static int test_arrivals;
+
+/* waits for a job on every thread, so each of them makes lists */
+static void thread_test_list_job(void* ctx, int index)
+{
+	(void)index;
+	THREAD_LOCK(&test_lock);
+	test_arrivals++;
+	THREAD_BROADCAST(&test_arrived);
+	while (test_arrivals < *(int*)ctx)
+		THREAD_WAIT(&test_arrived, &test_lock);
+	THREAD_UNLOCK(&test_lock);
+	for (int i = 0; i < TEST_JOB_COUNT; i++)
+	{
+		list_t list = list_create(sizeof(char));
+		for (int j = 0; j < i % 200; j++)
+			LIST_PUSH_PRIMITIVE(list, (char)j);
+		list_destroy(list);
+	}
+}
+
+int main()
+{
+	int wrong_count = 0;
+	/* the calling thread takes a slab of the default pool, and exiting workers give theirs back for the next ones */
+	THREAD_MUTEX_INIT(&test_lock);
+	THREAD_COND_INIT(&test_arrived);
+	int workers = 1;
+	test_arrivals = 0;
+	thread_run_jobs(thread_test_list_job, &workers, workers);
+	size_t slab_bytes = list_pool_stats(NULL).slab_bytes;
+	for (int i = 0; i < TEST_RESPAWNS; i++)
+	{
+		workers = 3 + i % 2;
+		thread_set_worker_count(workers);
+		test_arrivals = 0;
+		thread_run_jobs(thread_test_list_job, &workers, workers);
+	}
+	thread_destroy_pool();
+	THREAD_COND_DESTROY(&test_arrived);
+	THREAD_MUTEX_DESTROY(&test_lock);
+	size_t respawned_slab_bytes = list_pool_stats(NULL).slab_bytes;
+	wrong_count += respawned_slab_bytes > slab_bytes * 4;
+
+	int counts[] = { 1, 2, 4, 0, 1 };
+	for (int i = 0; i < sizeof counts / sizeof * counts; i++)
+	{
+		thread_set_worker_count(counts[i]);
+		int expected = counts[i] ? counts[i] : thread_core_count();
+		wrong_count += thread_worker_count() != min(expected, THREAD_MAX_WORKERS + 1);
+
+		memset(test_runs, 0, sizeof test_runs);
+		memset(test_nested_runs, 0, sizeof test_nested_runs);
+		thread_run_jobs(thread_test_job, NULL, TEST_JOB_COUNT);
+		for (int j = 0; j < TEST_JOB_COUNT; j++)
+		{
+			wrong_count += test_runs[j] != 1;
+			for (int k = 0; k < 4; k++)
+				wrong_count += test_nested_runs[j][k] != (j % 100 == 0);
+		}
+		/* only 1 runs on the calling thread alone, the others start the pool */
+		wrong_count += pool.created != (thread_worker_count() > 1);
+		wrong_count += thread_worker_count() != min(expected, THREAD_MAX_WORKERS + 1);
+	}
+	thread_destroy_pool();
+	printf("Thread test resulted in %i mismatches, %i cores.\n", wrong_count, thread_core_count());
+	printf("Respawned the workers %i times, the default pool grew from %zu to %zu bytes of slabs.\n", TEST_RESPAWNS, slab_bytes, respawned_slab_bytes);
+	return 0;
+}
+#endif
+#endif
@@ -0,0 +1,24 @@
+/*
+	thread.h ~ RL
+
+	Worker thread pool for running independent jobs in parallel
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#define THREAD_MAX_WORKERS		64
+
+/* called once for every index passed to thread_run_jobs, possibly from several threads at once */
+typedef void (*thread_job_t)(void* ctx, int index);
+
+/* sets how many threads run jobs, including the calling thread. 0 uses one per core, 1 runs everything on the calling thread */
+void thread_set_worker_count(int count);
+/* how many threads jobs are spread across, including the calling thread */
+int thread_worker_count(void);
+
+/* runs job for every index in [0, count) and returns once all of them are done */
+void thread_run_jobs(thread_job_t job, void* ctx, int count);
+/* stops and joins the worker threads, they are recreated by the next call to thread_run_jobs */
+void thread_destroy_pool(void);
\ No newline at end of file
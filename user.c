@@ -7,15 +7,20 @@
 #include "user.h"
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #if _WIN32
 #include <Windows.h>
 #include <ShlObj.h>
 #define MAX_PATH_LEN MAX_PATH
 #else
-#error "Invalid platform."
+#include <stdlib.h>
+#include <sys/stat.h>
+#define MAX_PATH_LEN 260 /* same as MAX_PATH, callers' buffers are this size */
 #endif
 
 #define DIRECTORY_NAME "Journal"
+/* first int of states saved since the worker count was added, older ones start with the foreground color */
+#define STATE_TAG 0x4A4E5331
 
 static char* user_directory;
 static bool has_cache;
@@ -24,10 +29,10 @@ static user_t cache;
 static bool user_find_directory(void)
 {
 #if _WIN32
-	char app_data[MAX_PATH];
+	char app_data[MAX_PATH_LEN];
 	if (FAILED(SHGetFolderPathA(NULL, CSIDL_APPDATA, NULL, SHGFP_TYPE_CURRENT, app_data)))
 		return false;
-	user_directory = journal_malloc(MAX_PATH);
+	user_directory = journal_malloc(MAX_PATH_LEN);
 	snprintf(user_directory, MAX_PATH, "%s\\" DIRECTORY_NAME, app_data);
 	DWORD attribs = GetFileAttributesA(user_directory);
 	if (attribs == INVALID_FILE_ATTRIBUTES || attribs ^ FILE_ATTRIBUTE_DIRECTORY)
@@ -37,7 +42,15 @@ static bool user_find_directory(void)
 	}
 	return true;
 #else
-#error "Unsupported platform."
+	const char* home = getenv("HOME");
+	if (!home)
+		return false;
+	user_directory = journal_malloc(MAX_PATH_LEN);
+	snprintf(user_directory, MAX_PATH_LEN, "%s/." DIRECTORY_NAME, home);
+	struct stat info;
+	if (stat(user_directory, &info) != 0 && mkdir(user_directory, 0700) != 0)
+		return false;
+	return true;
 #endif
 }
 
@@ -47,8 +60,8 @@ int user_get_user_directory(char* directory)
 	if (!user_directory && !user_find_directory())
 		return 0;
 	if (directory)
-		strncpy(directory, user_directory, MAX_PATH);
-	return (int)strnlen(user_directory, MAX_PATH);
+		strncpy(directory, user_directory, MAX_PATH_LEN);
+	return (int)strnlen(user_directory, MAX_PATH_LEN);
 }
 
 static list_t blank_saves;
@@ -124,7 +137,7 @@ bool user_load(user_t* user)
 		return false;
 
 	char state_dir[MAX_PATH_LEN];
-	snprintf(state_dir, MAX_PATH_LEN, "%s\\state", user_directory);
+	snprintf(state_dir, MAX_PATH_LEN, "%s" PATH_SEPARATOR "state", user_directory);
 	FILE* state_file = fopen(state_dir, "rb");
 	if (!state_file)
 	{
@@ -143,12 +156,15 @@ bool user_load(user_t* user)
 	if (!state)
 		return false;
 
+	int tag = 0;
+	long pos = read_int(state, 0, size, &tag) && tag == STATE_TAG ? INT_SIZE * 2 : 0;
 	bool success = size > 0
-		&& read_int(state, 0, size, (int*)&user->foreground)
-		&& read_int(state, INT_SIZE, size, (int*)&user->background)
-		&& read_int(state, INT_SIZE * 2, size, (int*)&user->desired_save_type);
+		&& (pos == 0 || (read_int(state, INT_SIZE, size, &user->worker_count) && user->worker_count >= 0))
+		&& read_int(state, pos, size, (int*)&user->foreground)
+		&& read_int(state, pos + INT_SIZE, size, (int*)&user->background)
+		&& read_int(state, pos + INT_SIZE * 2, size, (int*)&user->desired_save_type);
 
-	char* read = state + INT_SIZE * 3, *write = user->font;
+	char* read = state + pos + INT_SIZE * 3, *write = user->font;
 	while (*write++ = *read++);
 	user->file_saves = user_load_saves(state, read - state, size);
 	success &= !!user->file_saves;
@@ -176,14 +192,16 @@ bool user_load(user_t* user)
 bool user_save(user_t user)
 {
 	assert(user.file_saves && list_element_size(user.file_saves) == sizeof(file_save_t));
-	char state_dir[MAX_PATH];
-	snprintf(state_dir, MAX_PATH, "%s\\state", user_directory);
+	char state_dir[MAX_PATH_LEN];
+	snprintf(state_dir, MAX_PATH_LEN, "%s" PATH_SEPARATOR "state", user_directory);
 	FILE* state_file = fopen(state_dir, "wb");
 	if (!state_file)
 		return false;
 
 	size_t len = strnlen(user.font, sizeof user.font);
-	bool success = write_int(state_file, user.foreground)
+	bool success = write_int(state_file, STATE_TAG)
+		&& write_int(state_file, user.worker_count)
+		&& write_int(state_file, user.foreground)
 		&& write_int(state_file, user.background)
 		&& write_int(state_file, user.desired_save_type)
 		&& fwrite(user.font, 1, len, state_file) == len
@@ -192,7 +210,7 @@ bool user_save(user_t user)
 	for (int i = 0; success && i < list_count(user.file_saves); i++)
 	{
 		file_save_t* iter = LIST_GET(user.file_saves, i, file_save_t);
-		size_t expected = strnlen(iter->directory, MAX_PATH) + 1; /* +1 for NUL character */
+		size_t expected = strnlen(iter->directory, MAX_PATH_LEN) + 1; /* +1 for NUL character */
 		success &= fwrite(iter->directory, 1, expected, state_file) == expected
 			&& write_int(state_file, iter->cursor.column)
 			&& write_int(state_file, iter->cursor.row);
@@ -226,7 +244,7 @@ bool user_save_file(file_save_t save)
 
 	/* first, search if a config with the given directory exists */
 	user_t user = user_get_latest();
-	size_t size = strnlen(save.directory, MAX_PATH);
+	size_t size = strnlen(save.directory, MAX_PATH_LEN);
 	bool was_added = false;
 	for (int i = 0; i < list_count(user.file_saves); i++)
 	{
@@ -21,6 +21,7 @@ typedef struct user
 	char font[32];
 	color_t foreground, background;
 	file_type_t desired_save_type;
+	int worker_count;		/* passed to thread_set_worker_count, 0 = one per core */
 	list_t file_saves;
 } user_t;
 
@@ -6,17 +6,417 @@
 
 #include "util.h"
 #include <assert.h>
+#include "hash.h"
 #include <stdlib.h>
 #include <string.h>
 
-struct list
+panic_callback_t panic_callback = NULL;
+
+/*
+	LIST ALLOCATORS. POOLS CARVE BLOCKS OF EACH SIZE CLASS OUT OF SLABS AND KEEP RELEASED ONES ON A FREE LIST PER CLASS,
+	SO LISTS NEED NO HEAP CALL ONCE THE POOL HAS WARMED UP. BLOCKS ARE RELEASED WITH THEIR SIZE, SO THEY HAVE NO HEADER.
+	EVERY THREAD USES THE DEFAULT POOL THROUGH A CACHE OF ITS OWN, AND ONLY LOCKS THE POOL TO TRADE BLOCKS AND SLABS WITH IT
+*/
+
+#ifdef _WIN32
+#include <Windows.h>
+
+typedef SRWLOCK pool_lock_t;
+
+#define POOL_LOCK_INITIALIZER		SRWLOCK_INIT
+#define POOL_LOCK_INIT(l)			InitializeSRWLock(l)
+#define POOL_LOCK_DESTROY(l)		((void)(l))
+#define POOL_LOCK(l)				AcquireSRWLockExclusive(l)
+#define POOL_UNLOCK(l)				ReleaseSRWLockExclusive(l)
+#define POOL_THREAD_LOCAL			__declspec(thread)
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t pool_lock_t;
+
+#define POOL_LOCK_INITIALIZER		PTHREAD_MUTEX_INITIALIZER
+#define POOL_LOCK_INIT(l)			pthread_mutex_init(l, NULL)
+#define POOL_LOCK_DESTROY(l)		pthread_mutex_destroy(l)
+#define POOL_LOCK(l)				pthread_mutex_lock(l)
+#define POOL_UNLOCK(l)				pthread_mutex_unlock(l)
+#define POOL_THREAD_LOCAL			_Thread_local
+#endif
+
+#define POOL_GRANULARITY			16
+#define POOL_CLASS_COUNT			(POOL_MAX_BLOCK / POOL_GRANULARITY)
+#define POOL_SLAB_SIZE				(64 * 1024)
+#define POOL_CACHE_BLOCKS			64 /* released blocks of a class a thread keeps before giving half of them to the pool */
+#define POOL_CLASS(size)			((int)(((size) - 1) / POOL_GRANULARITY))
+#define POOL_CLASS_SIZE(class)		((size_t)((class) + 1) * POOL_GRANULARITY)
+
+/* slabs are linked through their first block so the pool can free them */
+struct pool_slab
 {
-	int reserved, count;
-	int element_size;
-	char* element_array;
+	struct pool_slab* next;
 };
 
-panic_callback_t panic_callback = NULL;
+/* the rest of a slab an exited thread was carving, linked through its first bytes */
+struct pool_spare
+{
+	struct pool_spare* next;
+	char* end;
+};
+
+/* what a thread hands blocks out of without locking the pool */
+struct pool_cache
+{
+	void* free_blocks[POOL_CLASS_COUNT];	/* released blocks of each class, linked through their first bytes */
+	int free_counts[POOL_CLASS_COUNT];
+	char* carved;		/* rest of the thread's newest slab, blocks of every class are carved from it in turn */
+	char* carved_end;
+	list_pool_stats_t stats;
+};
+
+struct list_pool
+{
+	list_allocator_t allocator; /* first, so the allocator is also the pool */
+	bool shared;				/* used from every thread through their own caches, otherwise from one thread at a time */
+	struct pool_cache cache;	/* of a pool that isn't shared */
+	pool_lock_t lock;			/* held for the rest */
+	void* free_blocks[POOL_CLASS_COUNT];	/* given back by thread caches with too many, or exiting */
+	struct pool_spare* spares;	/* carved from before new slabs, never smaller than POOL_MAX_BLOCK */
+	struct pool_slab* slabs;
+	size_t slab_bytes;
+};
+
+static void* pool_allocate(list_allocator_t* allocator, size_t size);
+static void* pool_reallocate(list_allocator_t* allocator, void* block, size_t size, size_t new_size);
+static void pool_release(list_allocator_t* allocator, void* block, size_t size);
+
+static struct list_pool list_default_pool =
+{
+	.allocator = { pool_allocate, pool_reallocate, pool_release },
+	.shared = true,
+	.lock = POOL_LOCK_INITIALIZER
+};
+static list_allocator_t* list_current_allocator = &list_default_pool.allocator;
+/* a thread's cache of the default pool. Threads give it back with list_pool_flush_thread_cache before exiting */
+static POOL_THREAD_LOCAL struct pool_cache pool_thread_cache;
+
+/* realloc that exits like journal_malloc when out of memory */
+static void* journal_realloc(void* block, size_t size)
+{
+	void* res = realloc(block, size);
+	if (!res)
+	{
+		if (panic_callback)
+			panic_callback();
+		exit(1);
+	}
+	return res;
+}
+
+static void* heap_allocate(list_allocator_t* allocator, size_t size)
+{
+	(void)allocator;
+	return journal_malloc(size);
+}
+
+static void* heap_reallocate(list_allocator_t* allocator, void* block, size_t size, size_t new_size)
+{
+	(void)allocator;
+	(void)size;
+	return journal_realloc(block, new_size);
+}
+
+static void heap_release(list_allocator_t* allocator, void* block, size_t size)
+{
+	(void)allocator;
+	(void)size;
+	free(block);
+}
+
+/* allocator that goes straight to the heap */
+list_allocator_t list_heap_allocator = { heap_allocate, heap_reallocate, heap_release };
+
+static struct pool_cache* pool_cache_of(struct list_pool* pool)
+{
+	return pool->shared ? &pool_thread_cache : &pool->cache;
+}
+
+/* moves up to half a cache's worth of the pool's released blocks of class to cache, false if it had none */
+static bool pool_take_blocks(struct list_pool* pool, struct pool_cache* cache, int class)
+{
+	POOL_LOCK(&pool->lock);
+	void* first = pool->free_blocks[class], *last = first;
+	int count = 0;
+	if (first)
+	{
+		for (count = 1; count < POOL_CACHE_BLOCKS / 2 && *(void**)last; count++)
+			last = *(void**)last;
+		pool->free_blocks[class] = *(void**)last;
+		*(void**)last = cache->free_blocks[class];
+		cache->free_blocks[class] = first;
+		cache->free_counts[class] += count;
+	}
+	POOL_UNLOCK(&pool->lock);
+	return count > 0;
+}
+
+/* gives half of cache's released blocks of class to the pool, for the other threads */
+static void pool_give_blocks(struct list_pool* pool, struct pool_cache* cache, int class)
+{
+	void* first = cache->free_blocks[class], *last = first;
+	for (int i = 1; i < cache->free_counts[class] / 2; i++)
+		last = *(void**)last;
+	cache->free_blocks[class] = *(void**)last;
+	cache->free_counts[class] -= cache->free_counts[class] / 2;
+	POOL_LOCK(&pool->lock);
+	*(void**)last = pool->free_blocks[class];
+	pool->free_blocks[class] = first;
+	POOL_UNLOCK(&pool->lock);
+}
+
+/* gives cache a new slab to carve blocks out of, or what an exited thread left of one. What's left of the last one is too small for the block wanted */
+static void pool_add_slab(struct list_pool* pool, struct pool_cache* cache)
+{
+	POOL_LOCK(&pool->lock);
+	struct pool_spare* spare = pool->spares;
+	if (spare)
+		pool->spares = spare->next;
+	POOL_UNLOCK(&pool->lock);
+	if (spare)
+	{
+		cache->carved = (char*)spare;
+		cache->carved_end = spare->end;
+		return;
+	}
+
+	/* not under the lock, panic_callback may need lists */
+	struct pool_slab* slab = journal_malloc(POOL_SLAB_SIZE);
+	POOL_LOCK(&pool->lock);
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->slab_bytes += POOL_SLAB_SIZE;
+	POOL_UNLOCK(&pool->lock);
+	/* the first granule holds the link, so blocks stay aligned the same as malloc's */
+	cache->carved = (char*)slab + POOL_GRANULARITY;
+	cache->carved_end = (char*)slab + POOL_SLAB_SIZE;
+}
+
+static void* pool_allocate(list_allocator_t* allocator, size_t size)
+{
+	struct list_pool* pool = (struct list_pool*)allocator;
+	struct pool_cache* cache = pool_cache_of(pool);
+	size = max(size, 1);
+	cache->stats.allocations++;
+	if (size > POOL_MAX_BLOCK)
+	{
+		cache->stats.bytes_in_use += size;
+		return journal_malloc(size);
+	}
+	int class = POOL_CLASS(size);
+	size_t class_size = POOL_CLASS_SIZE(class);
+	cache->stats.bytes_in_use += class_size;
+	if (!cache->free_blocks[class] && (size_t)(cache->carved_end - cache->carved) < class_size
+		&& !(pool->shared && pool_take_blocks(pool, cache, class)))
+		pool_add_slab(pool, cache);
+
+	void* block = cache->free_blocks[class];
+	if (block)
+	{
+		cache->free_blocks[class] = *(void**)block;
+		cache->free_counts[class]--;
+		return block;
+	}
+	block = cache->carved;
+	cache->carved += class_size;
+	return block;
+}
+
+static void pool_release(list_allocator_t* allocator, void* block, size_t size)
+{
+	struct list_pool* pool = (struct list_pool*)allocator;
+	struct pool_cache* cache = pool_cache_of(pool);
+	if (!block)
+		return;
+	size = max(size, 1);
+	cache->stats.releases++;
+	if (size > POOL_MAX_BLOCK)
+	{
+		cache->stats.bytes_in_use -= size;
+		free(block);
+		return;
+	}
+	int class = POOL_CLASS(size);
+	size_t class_size = POOL_CLASS_SIZE(class);
+	cache->stats.bytes_in_use -= class_size;
+	/* the newest block carved goes back to the slab, so a list that's only briefly alive leaves nothing behind */
+	if ((char*)block + class_size == cache->carved)
+	{
+		cache->carved = block;
+		return;
+	}
+	*(void**)block = cache->free_blocks[class];
+	cache->free_blocks[class] = block;
+	if (++cache->free_counts[class] > POOL_CACHE_BLOCKS && pool->shared)
+		pool_give_blocks(pool, cache, class);
+}
+
+static void* pool_reallocate(list_allocator_t* allocator, void* block, size_t size, size_t new_size)
+{
+	struct list_pool* pool = (struct list_pool*)allocator;
+	struct pool_cache* cache = pool_cache_of(pool);
+	size = max(size, 1);
+	new_size = max(new_size, 1);
+	bool large = size > POOL_MAX_BLOCK, new_large = new_size > POOL_MAX_BLOCK;
+	if (large && new_large)
+	{
+		/* the heap can often extend the block, or remap it without copying */
+		void* result = journal_realloc(block, new_size);
+		cache->stats.bytes_in_use += new_size - size;
+		if (result == block)
+			cache->stats.grown_in_place++;
+		else
+			cache->stats.moved++;
+		return result;
+	}
+	if (!large && !new_large)
+	{
+		size_t class_size = POOL_CLASS_SIZE(POOL_CLASS(size)), new_class_size = POOL_CLASS_SIZE(POOL_CLASS(new_size));
+		/* the newest block carved grows into the rest of its slab, the way a list being filled usually is */
+		bool newest = (char*)block + class_size == cache->carved && new_class_size - class_size <= (size_t)(cache->carved_end - cache->carved);
+		if (class_size == new_class_size || newest)
+		{
+			if (newest)
+				cache->carved = (char*)block + new_class_size;
+			cache->stats.bytes_in_use += new_class_size - class_size;
+			cache->stats.grown_in_place++;
+			return block;
+		}
+		/* a block that grew once likely grows again, so it moves to the end of the slab where it can do that in place */
+		if (new_class_size > class_size && new_class_size <= (size_t)(cache->carved_end - cache->carved))
+		{
+			void* result = cache->carved;
+			cache->carved += new_class_size;
+			memcpy(result, block, size);
+			pool_release(allocator, block, size);
+			cache->stats.allocations++;
+			cache->stats.bytes_in_use += new_class_size;
+			cache->stats.moved++;
+			return result;
+		}
+	}
+	void* result = pool_allocate(allocator, new_size);
+	memcpy(result, block, min(size, new_size));
+	pool_release(allocator, block, size);
+	cache->stats.moved++;
+	return result;
+}
+
+/* creates a pool handing out blocks of up to POOL_MAX_BLOCK bytes from slabs by size class, larger ones come from the heap.
+	It takes no lock, so it must only be used from one thread at a time */
+list_pool_t* list_pool_create(void)
+{
+	struct list_pool* pool = journal_malloc(sizeof * pool);
+	*pool = (struct list_pool){ .allocator = { pool_allocate, pool_reallocate, pool_release } };
+	POOL_LOCK_INIT(&pool->lock);
+	return pool;
+}
+
+/* frees pool's slabs. Every list created with it must be destroyed first */
+void list_pool_destroy(list_pool_t* pool)
+{
+	if (!pool)
+		return;
+	assert(pool != &list_default_pool);
+	while (pool->slabs)
+	{
+		struct pool_slab* next = pool->slabs->next;
+		free(pool->slabs);
+		pool->slabs = next;
+	}
+	POOL_LOCK_DESTROY(&pool->lock);
+	free(pool);
+}
+
+/* allocator handing out pool's blocks for list_set_allocator, NULL for the default pool */
+list_allocator_t* list_pool_allocator(list_pool_t* pool)
+{
+	return pool ? &pool->allocator : &list_default_pool.allocator;
+}
+
+/* gives the calling thread's blocks of the default pool back to it, so they aren't lost when the thread exits */
+void list_pool_flush_thread_cache(void)
+{
+	struct list_pool* pool = &list_default_pool;
+	struct pool_cache* cache = &pool_thread_cache;
+	struct pool_spare* spare = NULL;
+	size_t rest = (size_t)(cache->carved_end - cache->carved);
+	if (rest >= POOL_MAX_BLOCK)
+	{
+		spare = (struct pool_spare*)cache->carved;
+		spare->end = cache->carved_end;
+	}
+	else if (rest > 0)
+	{
+		/* slabs are carved in whole granules, so the rest is a block of its own class */
+		*(void**)cache->carved = cache->free_blocks[POOL_CLASS(rest)];
+		cache->free_blocks[POOL_CLASS(rest)] = cache->carved;
+	}
+
+	POOL_LOCK(&pool->lock);
+	if (spare)
+	{
+		spare->next = pool->spares;
+		pool->spares = spare;
+	}
+	for (int class = 0; class < POOL_CLASS_COUNT; class++)
+	{
+		void* last = cache->free_blocks[class];
+		if (!last)
+			continue;
+		while (*(void**)last)
+			last = *(void**)last;
+		*(void**)last = pool->free_blocks[class];
+		pool->free_blocks[class] = cache->free_blocks[class];
+	}
+	POOL_UNLOCK(&pool->lock);
+	*cache = (struct pool_cache){ 0 };
+}
+
+/* statistics of pool, NULL for the pool lists use by default. The default pool's only count the calling thread's calls */
+list_pool_stats_t list_pool_stats(list_pool_t* pool)
+{
+	if (!pool)
+		pool = &list_default_pool;
+	list_pool_stats_t result = pool_cache_of(pool)->stats;
+	POOL_LOCK(&pool->lock);
+	result.slab_bytes = pool->slab_bytes;
+	POOL_UNLOCK(&pool->lock);
+	return result;
+}
+
+/* sets the allocator lists created from now on get their memory from, NULL for the default pool. Returns the previous one */
+list_allocator_t* list_set_allocator(list_allocator_t* allocator)
+{
+	list_allocator_t* previous = list_current_allocator;
+	list_current_allocator = allocator ? allocator : &list_default_pool.allocator;
+	return previous;
+}
+
+/* allocates a list from the current allocator */
+static list_t list_allocate(int element_size)
+{
+	list_t result = list_current_allocator->allocate(list_current_allocator, sizeof * result);
+	*result = (struct list){ .element_size = element_size, .allocator = list_current_allocator };
+	return result;
+}
+
+/* allocates room for count of list's elements from its allocator */
+static char* list_allocate_array(list_t list, int count)
+{
+	return list->allocator->allocate(list->allocator, (size_t)count * list->element_size);
+}
+
+/*
+	LISTS
+*/
 
 int list_reserved(const list_t list)
 {
@@ -56,38 +456,26 @@ list_t list_get_range(const list_t list, int start, int end)
 	list_t result = list_create(list->element_size);
 	int space = end - start + 1;
 	if (space >= result->reserved)
-		list_reserve(result, round_to_power_of_two(space) - result->reserved);
+		list_reserve(result, round_to_power_of_two(space + 1) - result->reserved);
 
-	memcpy(result->element_array, list->element_array + start, space);
+	memcpy(result->element_array, list->element_array + start * list->element_size, (size_t)space * list->element_size);
 	result->count = space;
 	return result;
 }
 
+/* hashes every byte of the list's elements */
 uint64_t list_hash(const list_t list)
 {
 	assert(list != NULL);
-
-	char* element_array = list->element_array;
-	uint64_t hash = 5381;
-	int c;
-
-	while (c = *element_array++)
-		hash = ((hash << 5) + hash) ^ c;
-
-	return hash;
+	return hash_bytes(list->element_array, (size_t)list->count * list->element_size, 0);
 }
 
 list_t list_create(int element_size)
 {
 	assert(element_size != 0);
-	list_t result = journal_malloc(sizeof * result);
-	*result = (struct list)
-	{
-		.count = 0,
-		.reserved = STARTING_RESERVE,
-		.element_size = element_size,
-		.element_array = journal_malloc((size_t)element_size * STARTING_RESERVE)
-	};
+	list_t result = list_allocate(element_size);
+	result->reserved = STARTING_RESERVE;
+	result->element_array = list_allocate_array(result, STARTING_RESERVE);
 	return result;
 }
 
@@ -96,45 +484,115 @@ list_t list_create_with_array(const void* element_array, int element_size, int c
 	assert(element_size != 0);
 	if (!element_array)
 		return list_create(element_size);
-	list_t result = journal_malloc(sizeof * result);
-	int reserve_count = round_to_power_of_two(count + 1);
-	*result = (struct list)
-	{
-		.count = count,
-		.reserved = reserve_count,
-		.element_size = element_size,
-		.element_array = journal_malloc((size_t)element_size * reserve_count)
-	};
+	list_t result = list_allocate(element_size);
+	result->count = count;
+	result->reserved = round_to_power_of_two(count + 1);
+	result->element_array = list_allocate_array(result, result->reserved);
 	memcpy(result->element_array, element_array, count * element_size);
 	return result;
 }
 
+/* creates list with room for just count elements, plus the spare one every list keeps */
+list_t list_create_fitted(const void* element_array, int element_size, int count)
+{
+	assert(element_size != 0 && (element_array || count == 0) && count >= 0);
+	list_t result = list_allocate(element_size);
+	result->count = count;
+	result->reserved = count + 1;
+	result->element_array = list_allocate_array(result, count + 1);
+	if (count > 0)
+		memcpy(result->element_array, element_array, (size_t)count * element_size);
+	return result;
+}
+
+/* creates list over elements owned by backing without copying them. They are copied on the first change */
+list_t list_create_borrowed(const void* element_array, int element_size, int count, list_backing_t* backing)
+{
+	assert(element_size != 0 && (element_array || count == 0) && count >= 0 && backing);
+	list_t result = list_allocate(element_size);
+	result->count = count;
+	result->reserved = count;
+	result->element_array = (char*)element_array;
+	result->backing = backing;
+	backing->references++;
+	return result;
+}
+
+/* releases element array */
+static void list_free_array(list_t list)
+{
+	if (list->element_array)
+		list->allocator->release(list->allocator, list->element_array, (size_t)list->reserved * list->element_size);
+}
+
+static void list_release_backing(list_t list)
+{
+	list_backing_t* backing = list->backing;
+	list->backing = NULL;
+	list->element_array = NULL;
+	if (--backing->references == 0 && backing->release)
+		backing->release(backing);
+}
+
+/* whether the list still points into a backing's storage */
+bool list_is_borrowed(const list_t list)
+{
+	assert(list != NULL);
+	return list->backing != NULL;
+}
+
+/* copies a borrowed list's elements into storage of its own */
+void list_own(list_t list)
+{
+	assert(list != NULL);
+	if (!list->backing)
+		return;
+	/* owned lists always keep a spare element past count */
+	int reserve_count = round_to_power_of_two(list->count + 1);
+	char* owned = list_allocate_array(list, reserve_count);
+	memcpy(owned, list->element_array, (size_t)list->count * list->element_size);
+	list_release_backing(list);
+	list->element_array = owned;
+	list->reserved = reserve_count;
+}
+
 void list_destroy(list_t list)
 {
 	if (list)
 	{
-		free(list->element_array);
+		if (list->backing)
+			list_release_backing(list);
+		list_free_array(list);
 		list->element_array = NULL;
+		list->allocator->release(list->allocator, list, sizeof * list);
 	}
-	free(list);
 }
 
 void list_reserve(list_t list, int count)
 {
 	assert(list != NULL && count >= 0);
+	list_own(list);
 	if (count == 0)
 		return;
 
-	char* reallocated = journal_malloc((size_t)(list->reserved + count) * list->element_size);
-	memcpy(reallocated, list->element_array, list->reserved * list->element_size);
-	free(list->element_array);
-	list->element_array = reallocated;
+	size_t size = (size_t)list->reserved * list->element_size, new_size = (size_t)(list->reserved + count) * list->element_size;
+	list->element_array = list->allocator->reallocate(list->allocator, list->element_array, size, new_size);
 	list->reserved += count;
 }
 
+void list_resize(list_t list, int count)
+{
+	assert(list != NULL && count >= 0);
+	list_own(list);
+	if (count >= list->reserved)
+		list_reserve(list, round_to_power_of_two(count + 1) - list->reserved);
+	list->count = count;
+}
+
 void list_push(list_t list, const void* element)
 {
 	assert(list != NULL && element);
+	list_own(list);
 	memcpy(&list->element_array[list->element_size * list->count], element, list->element_size);
 	if (++list->count >= list->reserved)
 		list_reserve(list, list->reserved);
@@ -157,11 +615,12 @@ void list_pop(list_t list, void* out)
 void list_concat(list_t list, const list_t other, int pos)
 {
 	assert(list != NULL && other != NULL && pos >= 0 && pos <= list->count && other->element_size == list->element_size);
+	list_own(list);
 	int bound = max(list->count + other->count, pos + other->count * 2);
 	if (list->reserved <= bound)
 		list_reserve(list, round_to_power_of_two(bound + 1) - list->reserved);
 
-	memmove(&list->element_array[(pos + other->count) * list->element_size], &list->element_array[pos * list->element_size], (size_t)other->count * list->element_size);
+	memmove(&list->element_array[(pos + other->count) * list->element_size], &list->element_array[pos * list->element_size], (size_t)(list->count - pos) * list->element_size);
 	memcpy(&list->element_array[pos * list->element_size], other->element_array, (size_t)other->count * list->element_size);
 	list->count += other->count;
 }
@@ -169,6 +628,7 @@ void list_concat(list_t list, const list_t other, int pos)
 void list_add(list_t list, const void* element, int pos)
 {
 	assert(list != NULL && pos >= 0 && pos <= list->count);
+	list_own(list);
 	int offset = list->element_size * pos;
 	memmove(&list->element_array[list->element_size + offset], &list->element_array[offset], (size_t)list->count * list->element_size - offset);
 	memcpy(&list->element_array[offset], element, list->element_size);
@@ -179,14 +639,22 @@ void list_add(list_t list, const void* element, int pos)
 void list_remove(list_t list, int pos)
 {
 	assert(list != NULL && pos >= 0 && pos < list->count);
-	memmove(&list->element_array[pos * list->element_size], &list->element_array[pos * list->element_size + list->element_size], (size_t)(list->count - pos + 1) * list->element_size);
+	list_own(list);
+	memmove(&list->element_array[pos * list->element_size], &list->element_array[pos * list->element_size + list->element_size], (size_t)(list->count - pos) * list->element_size);
 	list->count--;
 }
 
 void list_splice(list_t list, int start, int end)
 {
 	assert(list != NULL && start >= 0 && end >= start && end < list->count);
-	memmove(&list->element_array[start * list->element_size], &list->element_array[end * list->element_size + list->element_size], (size_t)(list->count - end + 1) * list->element_size);
+	/* cutting the end off a borrowed list doesn't need a copy */
+	if (list->backing && end == list->count - 1)
+	{
+		list->count = start;
+		return;
+	}
+	list_own(list);
+	memmove(&list->element_array[start * list->element_size], &list->element_array[end * list->element_size + list->element_size], (size_t)(list->count - end) * list->element_size);
 	list->count -= end - start + 1;
 }
 
@@ -198,8 +666,12 @@ void list_clear(list_t list)
 
 #ifdef _WIN32
 #include <Windows.h>
+#include <bcrypt.h>
+#include <limits.h>
 #include <strsafe.h>
 
+#pragma comment(lib, "bcrypt.lib")
+
 bool debug_format(const char* fmt, ...)
 {
 	static char* current_buffer = NULL;
@@ -228,6 +700,41 @@ bool debug_format(const char* fmt, ...)
 	OutputDebugStringA(current_buffer);
 	return false;
 }
+
+/* fills buf with random bytes from the operating system's secure generator */
+bool random_bytes(void* buf, size_t size)
+{
+	assert(buf && size <= ULONG_MAX);
+	return BCRYPT_SUCCESS(BCryptGenRandom(NULL, buf, (ULONG)size, BCRYPT_USE_SYSTEM_PREFERRED_RNG));
+}
+#else
+#include <stdarg.h>
+
+/* stderr is the terminal the editor draws on, so this is only written in debug and test builds */
+bool debug_format(const char* fmt, ...)
+{
+#if defined(_DEBUG) || defined(TEST)
+	va_list list;
+	va_start(list, fmt);
+	vfprintf(stderr, fmt, list);
+	va_end(list);
+#else
+	(void)fmt;
+#endif
+	return false;
+}
+
+/* fills buf with random bytes from the operating system's secure generator */
+bool random_bytes(void* buf, size_t size)
+{
+	assert(buf);
+	FILE* file = fopen("/dev/urandom", "rb");
+	if (!file)
+		return false;
+	bool result = fread(buf, 1, size, file) == size;
+	fclose(file);
+	return result;
+}
 #endif
 
 /* you must free the pointer returned by this function */
@@ -254,7 +761,8 @@ bool read_int(const char* buf, long pos, long size, int* out)
 		debug_format("Read int outside bounds! (%i + INT_SIZE > %i)\n", pos, size);
 		return false;
 	}
-	*out = (int)buf[pos] | ((int)buf[pos + 1] << 8) | ((int)buf[pos + 2] << 16) | ((int)buf[pos + 3] << 24);
+	const uint8_t* bytes = (const uint8_t*)buf + pos; /* char may be signed */
+	*out = (int)((uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24));
 	return true;
 }
 
@@ -271,6 +779,19 @@ bool read_char(const char* buf, long pos, long size, char* out)
 	return true;
 }
 
+bool store_int(char* buf, long pos, long size, int in)
+{
+	assert(buf && pos >= 0 && size > 0);
+	if (size < pos + INT_SIZE)
+	{
+		debug_format("Stored int outside bounds! (%i + INT_SIZE > %i)\n", pos, size);
+		return false;
+	}
+	for (int i = 0; i < INT_SIZE; i++)
+		buf[pos + i] = (char)((in >> (8 * i)) & 0xFF);
+	return true;
+}
+
 bool write_int(FILE* file, int in)
 {
 	assert(file);
@@ -12,6 +12,12 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+/* MSVC's stdlib.h defines these, other compilers leave them out */
+#ifndef min
+#define min(a, b)	(((a) < (b)) ? (a) : (b))
+#define max(a, b)	(((a) > (b)) ? (a) : (b))
+#endif
+
 typedef void (*panic_callback_t)(void);
 extern panic_callback_t panic_callback;
 
@@ -43,18 +49,85 @@ extern inline void* journal_malloc(size_t sz)
 
 typedef struct list* list_t;
 
+/* storage lists can be created over without copying it, like a mapped file. release is called once no list refers to it */
+typedef struct list_backing
+{
+	int references;
+	void (*release)(struct list_backing* backing);
+} list_backing_t;
+
+/* where lists get their own memory and their elements'. Blocks are released and reallocated with the size they last had */
+typedef struct list_allocator
+{
+	void* (*allocate)(struct list_allocator* allocator, size_t size);
+	void* (*reallocate)(struct list_allocator* allocator, void* block, size_t size, size_t new_size);
+	void (*release)(struct list_allocator* allocator, void* block, size_t size);
+} list_allocator_t;
+
+/* only in the header so typed vectors can inline their accessors, use the functions below otherwise */
+struct list
+{
+	int reserved, count;
+	int element_size;
+	char* element_array;
+	list_backing_t* backing; /* NULL unless element_array is borrowed */
+	list_allocator_t* allocator;	/* where the list and its element array came from */
+};
+
+/* largest block pools carve out of their slabs, larger ones come from the heap */
+#define POOL_MAX_BLOCK			256
+
+typedef struct list_pool list_pool_t;
+
+typedef struct list_pool_stats
+{
+	long long allocations, releases;
+	long long grown_in_place;	/* reallocations that kept their block */
+	long long moved;			/* reallocations that copied to a new block */
+	size_t bytes_in_use;		/* bytes of blocks handed out, rounded up to their size class */
+	size_t slab_bytes;			/* bytes of slabs, only given back when the pool is destroyed */
+} list_pool_stats_t;
+
+/* allocator that goes straight to the heap */
+extern list_allocator_t list_heap_allocator;
+
+/*	creates a pool handing out blocks of up to POOL_MAX_BLOCK bytes from slabs by size class, larger ones come from the heap.
+	It takes no lock, so it must only be used from one thread at a time. The default pool can be used from any */
+list_pool_t* list_pool_create(void);
+/* frees pool's slabs. Every list created with it must be destroyed first */
+void list_pool_destroy(list_pool_t* pool);
+/* allocator handing out pool's blocks for list_set_allocator, NULL for the default pool */
+list_allocator_t* list_pool_allocator(list_pool_t* pool);
+/* gives the calling thread's blocks of the default pool back to it. Threads using lists call it before exiting */
+void list_pool_flush_thread_cache(void);
+/* statistics of pool, NULL for the pool lists use by default. The default pool's only count the calling thread's calls */
+list_pool_stats_t list_pool_stats(list_pool_t* pool);
+/* sets the allocator lists created from now on get their memory from, NULL for the default pool. Returns the previous one */
+list_allocator_t* list_set_allocator(list_allocator_t* allocator);
+
 int list_reserved(const list_t list);
 int list_count(const list_t list);
 int list_element_size(const list_t list);
 void* list_element_array(const list_t list);
 void* list_get(const list_t list, int i);
 list_t list_get_range(const list_t list, int start, int end);
+/* hashes every byte of the list's elements */
 uint64_t list_hash(const list_t list);
 
 list_t list_create(int element_size);
 list_t list_create_with_array(const void* element_array, int element_size, int count);
+/* creates list with room for just count elements, plus the spare one every list keeps */
+list_t list_create_fitted(const void* element_array, int element_size, int count);
+/* creates list over elements owned by backing without copying them. They are copied on the first change */
+list_t list_create_borrowed(const void* element_array, int element_size, int count, list_backing_t* backing);
+/* whether the list still points into a backing's storage */
+bool list_is_borrowed(const list_t list);
+/* copies a borrowed list's elements into storage of its own */
+void list_own(list_t list);
 void list_destroy(list_t list);
 void list_reserve(list_t list, int count);
+/* sets count, reserving space if needed. New elements are uninitialized */
+void list_resize(list_t list, int count);
 void list_push(list_t list, const void* element);
 void list_pop(list_t list, void* out);
 void list_concat(list_t list, const list_t other, int pos);
@@ -80,12 +153,50 @@ extern inline void list_splice_count(list_t list, int start, int count)
 		list_splice(list, start, end >= list_count(list) ? (list_count(list) - 1) : end);
 }
 
+/*	defines name_t, a list of type with the element size fixed at compile time. Its accessors inline to plain array
+	indexing instead of calling list_get or list_push. It shares the list's storage: name_of views a list_t as one and
+	.list goes back, so every list_* function still works on it */
+#define LIST_DEFINE_VEC(name, type)																\
+	typedef struct name { list_t list; } name##_t;												\
+	extern inline name##_t name##_of(list_t list)												\
+	{																							\
+		LIST_ASSERT_TYPEOF(list, type);															\
+		return (name##_t) { list };																\
+	}																							\
+	extern inline name##_t name##_create(void)													\
+	{																							\
+		return (name##_t) { list_create(sizeof(type)) };										\
+	}																							\
+	extern inline int name##_count(name##_t vec)												\
+	{																							\
+		return vec.list->count;																	\
+	}																							\
+	extern inline type* name##_array(name##_t vec)												\
+	{																							\
+		return (type*)vec.list->element_array;													\
+	}																							\
+	extern inline type* name##_at(name##_t vec, int i)											\
+	{																							\
+		assert(i >= 0 && i < vec.list->count);													\
+		return (type*)vec.list->element_array + i;												\
+	}																							\
+	extern inline void name##_push(name##_t vec, type element)									\
+	{																							\
+		/* the spare element every owned list keeps is only filled by list_push, which grows it */	\
+		if (vec.list->backing || vec.list->count + 1 >= vec.list->reserved)					\
+			list_push(vec.list, &element);														\
+		else																					\
+			((type*)vec.list->element_array)[vec.list->count++] = element;					\
+	}
+
 #define __STR2(s) __STR(s)
 #define __STR(s) #s
 #define DEBUG_ON_FAILURE(func)			((func) || debug_format(#func " failed at line " __STR2(__LINE__) ".\n"))
 
 /* ALWAYS returns false. Look at macro above */
 bool debug_format(const char* fmt, ...);
+/* fills buf with random bytes from the operating system's secure generator */
+bool random_bytes(void* buf, size_t size);
 
 extern inline int round_to_power_of_two(int i)
 {
@@ -98,6 +209,12 @@ extern inline int round_to_power_of_two(int i)
 	return ++i;
 }
 
+#ifdef _WIN32
+#define PATH_SEPARATOR "\\"
+#else
+#define PATH_SEPARATOR "/"
+#endif
+
 /* ints are saved to disk with 4 bytes, not sizeof(int) on this platform */
 #define INT_SIZE 4
 #define CHAR_SIZE 1
@@ -106,6 +223,7 @@ extern inline int round_to_power_of_two(int i)
 char* read_all_file(FILE* file, long* size);
 bool read_int(const char* buf, long pos, long size, int* out);
 bool read_char(const char* buf, long pos, long size, char* out);
+bool store_int(char* buf, long pos, long size, int in);
 bool write_int(FILE* file, int in);
 bool write_char(FILE* file, char ch);
 bool clear_file(const char* dir);
\ No newline at end of file
@@ -46,4 +46,212 @@ int main()
 	return 0;
 }
 #endif
+#endif
+#ifdef TEST
+#ifdef POOL_TEST
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_LIST_COUNT 4096
+#define TEST_ROUNDS 256
+#define TEST_LINE_COUNT (1024 * 1024)
+#define TEST_GROWN_COUNT (64 * 1024)
+#define TEST_GROWN_SIZE 250
+#define TEST_BLOCK_CALLS (32 * 1024 * 1024)
+#define TEST_BLOCK_SLOTS 256
+
+LIST_DEFINE_VEC(char_vec, char)
+
+/* churns lists of text the way edits do, returns how many lists ended with the wrong contents */
+static int pool_test_churn(list_allocator_t* allocator, double* seconds)
+{
+	list_allocator_t* previous = list_set_allocator(allocator);
+	list_t* lists = calloc(TEST_LIST_COUNT, sizeof * lists);
+	int wrong_count = 0;
+	srand(1);
+	clock_t start = clock();
+	for (int round = 0; round < TEST_ROUNDS; round++)
+	{
+		for (int i = 0; i < TEST_LIST_COUNT; i++)
+		{
+			if (!lists[i] || rand() % 4 == 0)
+			{
+				list_destroy(lists[i]);
+				lists[i] = rand() % 2 ? list_create(sizeof(char)) : list_create_with_array("line", sizeof(char), 4);
+				list_clear(lists[i]);
+			}
+			int pushes = rand() % 16;
+			for (int j = 0; j < pushes; j++)
+				LIST_PUSH_PRIMITIVE(lists[i], 'a' + list_count(lists[i]) % 26);
+		}
+	}
+	*seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	for (int i = 0; i < TEST_LIST_COUNT; i++)
+	{
+		for (int j = 0; j < list_count(lists[i]); j++)
+			wrong_count += *(char*)list_get(lists[i], j) != 'a' + j % 26;
+		list_destroy(lists[i]);
+	}
+	free(lists);
+	list_set_allocator(previous);
+	return wrong_count;
+}
+
+/* seconds taken allocating and releasing blocks straight from allocator, with a working set of TEST_BLOCK_SLOTS of them */
+static double pool_test_blocks(list_allocator_t* allocator)
+{
+	void* blocks[TEST_BLOCK_SLOTS] = { 0 };
+	size_t sizes[TEST_BLOCK_SLOTS];
+	srand(3);
+	for (int i = 0; i < TEST_BLOCK_SLOTS; i++)
+		sizes[i] = 1 + rand() % POOL_MAX_BLOCK;
+	clock_t start = clock();
+	for (int i = 0; i < TEST_BLOCK_CALLS; i++)
+	{
+		int slot = (int)((i * 2654435761u) % TEST_BLOCK_SLOTS);
+		if (blocks[slot])
+		{
+			allocator->release(allocator, blocks[slot], sizes[slot]);
+			blocks[slot] = NULL;
+		}
+		else
+			*(char*)(blocks[slot] = allocator->allocate(allocator, sizes[slot])) = 0;
+	}
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	for (int i = 0; i < TEST_BLOCK_SLOTS; i++)
+		allocator->release(allocator, blocks[i], sizes[i]);
+	return seconds;
+}
+
+/* seconds taken making a list per line of a file and destroying them again, odd ones first */
+static double pool_test_lines(list_allocator_t* allocator)
+{
+	list_allocator_t* previous = list_set_allocator(allocator);
+	list_t* lists = malloc(TEST_LINE_COUNT * sizeof * lists);
+	const char line[80] = "a line of text that is as long as the longest line in a file of lines of text";
+	srand(2);
+	clock_t start = clock();
+	for (int i = 0; i < TEST_LINE_COUNT; i++)
+		lists[i] = list_create_with_array(line, sizeof(char), rand() % sizeof line);
+	for (int i = 1; i < TEST_LINE_COUNT; i += 2)
+		list_destroy(lists[i]);
+	for (int i = 0; i < TEST_LINE_COUNT; i += 2)
+		list_destroy(lists[i]);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	free(lists);
+	list_set_allocator(previous);
+	return seconds;
+}
+
+/* seconds taken filling lists a character at a time, each growing twice before it outgrows the pool */
+static double pool_test_growth(list_allocator_t* allocator)
+{
+	list_allocator_t* previous = list_set_allocator(allocator);
+	list_t* lists = malloc(TEST_GROWN_COUNT * sizeof * lists);
+	clock_t start = clock();
+	for (int i = 0; i < TEST_GROWN_COUNT; i++)
+	{
+		lists[i] = list_create(sizeof(char));
+		for (int j = 0; j < TEST_GROWN_SIZE; j++)
+			char_vec_push(char_vec_of(lists[i]), (char)j);
+	}
+	for (int i = 0; i < TEST_GROWN_COUNT; i++)
+		list_destroy(lists[i]);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	free(lists);
+	list_set_allocator(previous);
+	return seconds;
+}
+
+int main()
+{
+	double heap_seconds, pool_seconds;
+	int wrong_count = pool_test_churn(&list_heap_allocator, &heap_seconds);
+	list_pool_t* pool = list_pool_create();
+	wrong_count += pool_test_churn(list_pool_allocator(pool), &pool_seconds);
+	list_pool_stats_t stats = list_pool_stats(pool);
+	wrong_count += stats.allocations != stats.releases || stats.bytes_in_use != 0;
+	list_pool_destroy(pool);
+
+	/* the default pool balances out on one thread too, even though what it was given back is in that thread's cache */
+	list_pool_stats_t default_before = list_pool_stats(NULL);
+	double default_seconds;
+	wrong_count += pool_test_churn(NULL, &default_seconds);
+	list_pool_stats_t default_after = list_pool_stats(NULL);
+	wrong_count += default_after.allocations - default_before.allocations != default_after.releases - default_before.releases
+		|| default_after.bytes_in_use != default_before.bytes_in_use;
+
+	printf("Pool test resulted in %i mismatches.\n", wrong_count);
+	printf("Churned %i lists for %i rounds in %.3fs from the heap, %.3fs from a pool, %.3fs from the default pool.\n",
+		TEST_LIST_COUNT, TEST_ROUNDS, heap_seconds, pool_seconds, default_seconds);
+	printf("Pool made %lli allocations, grew %lli blocks in place and moved %lli, using %zu bytes of slabs.\n",
+		stats.allocations, stats.grown_in_place, stats.moved, stats.slab_bytes);
+
+	/* benchmarks, heap against the default pool */
+	printf("Made %i allocator calls in %.3fs to the heap, %.3fs to the default pool.\n",
+		TEST_BLOCK_CALLS, pool_test_blocks(&list_heap_allocator), pool_test_blocks(list_pool_allocator(NULL)));
+	printf("Made and destroyed %i lines in %.3fs from the heap, %.3fs from the default pool.\n",
+		TEST_LINE_COUNT, pool_test_lines(&list_heap_allocator), pool_test_lines(NULL));
+	default_before = list_pool_stats(NULL);
+	double growth_heap = pool_test_growth(&list_heap_allocator), growth_pool = pool_test_growth(NULL);
+	default_after = list_pool_stats(NULL);
+	printf("Filled %i lists of %i chars in %.3fs from the heap, %.3fs from the default pool, which grew %lli blocks in place and moved %lli.\n",
+		TEST_GROWN_COUNT, TEST_GROWN_SIZE, growth_heap, growth_pool,
+		default_after.grown_in_place - default_before.grown_in_place, default_after.moved - default_before.moved);
+	return 0;
+}
+#endif
+#endif
+#ifdef TEST
+#ifdef VEC_TEST
+#include <stdio.h>
+#include <time.h>
+
+#define TEST_COUNT (16 * 1024 * 1024)
+
+LIST_DEFINE_VEC(char_vec, char)
+
+static double vec_test_seconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main()
+{
+	int wrong_count = 0;
+	long long list_sum = 0, vec_sum = 0;
+
+	/* pushing through list_push, then through the inlined fast path */
+	clock_t start = clock();
+	list_t list = list_create(sizeof(char));
+	for (int i = 0; i < TEST_COUNT; i++)
+		LIST_PUSH_PRIMITIVE(list, i % 128);
+	double list_push_seconds = vec_test_seconds(start);
+	start = clock();
+	char_vec_t vec = char_vec_create();
+	for (int i = 0; i < TEST_COUNT; i++)
+		char_vec_push(vec, i % 128);
+	double vec_push_seconds = vec_test_seconds(start);
+
+	/* reading every element, the way console_draw_line reads cells */
+	start = clock();
+	for (int i = 0; i < list_count(list); i++)
+		list_sum += *LIST_GET(list, i, char);
+	double list_get_seconds = vec_test_seconds(start);
+	start = clock();
+	for (int i = 0; i < char_vec_count(vec); i++)
+		vec_sum += *char_vec_at(vec, i);
+	double vec_get_seconds = vec_test_seconds(start);
+
+	wrong_count += list_count(list) != char_vec_count(vec) || list_sum != vec_sum || list_sum != (long long)TEST_COUNT / 128 * (127 * 128 / 2);
+	list_destroy(list);
+	list_destroy(vec.list);
+
+	printf("Vector test resulted in %i mismatches.\n", wrong_count);
+	printf("Pushed %i chars in %.3fs through list_push, %.3fs through char_vec_push.\n", TEST_COUNT, list_push_seconds, vec_push_seconds);
+	printf("Read them back in %.3fs through list_get, %.3fs through char_vec_at.\n", list_get_seconds, vec_get_seconds);
+	return 0;
+}
+#endif
 #endif
\ No newline at end of file
@@ -0,0 +1,455 @@
+/*
+	wal.c ~ RL
+
+	Append-only log of edits made since the last save, replayed over the saved file after a crash
+*/
+
+#include "wal.h"
+#include <assert.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define WAL_EXTENSION		".wal"
+#define WAL_MAX_PATH		264
+#define WAL_VERSION			1
+#define WAL_STAMP_COUNT		4 /* ints identifying the saved file the log applies to */
+#define WAL_HEADER_SIZE		(sizeof wal_magic + CHAR_SIZE + WAL_STAMP_COUNT * INT_SIZE)
+#define WAL_RECORD_SIZE		(2 * INT_SIZE) /* size and checksum in front of each edit */
+#define WAL_EDIT_SIZE		(CHAR_SIZE + 4 * INT_SIZE) /* kind, start, and end in front of the text */
+
+enum wal_kind
+{
+	WAL_INSERT,
+	WAL_REMOVE
+};
+
+static const char wal_magic[3] = { 'J', 'W', 'L' };
+
+static FILE* wal_file;
+static char wal_directory[WAL_MAX_PATH];
+static list_t wal_group;			/* edits not written yet, laid out as they are on disk */
+static uint64_t wal_group_time;	/* when the oldest edit in the group was appended */
+
+/* size and last write time of the file at directory */
+static bool wal_stamp(const char* directory, int stamp[WAL_STAMP_COUNT])
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(directory, GetFileExInfoStandard, &data))
+		return false;
+	stamp[0] = (int)data.nFileSizeLow;
+	stamp[1] = (int)data.nFileSizeHigh;
+	stamp[2] = (int)data.ftLastWriteTime.dwLowDateTime;
+	stamp[3] = (int)data.ftLastWriteTime.dwHighDateTime;
+#else
+	struct stat info;
+	if (stat(directory, &info) != 0)
+		return false;
+	uint64_t size = (uint64_t)info.st_size, time = (uint64_t)info.st_mtime;
+	stamp[0] = (int)size;
+	stamp[1] = (int)(size >> 32);
+	stamp[2] = (int)time;
+	stamp[3] = (int)(time >> 32);
+#endif
+	return true;
+}
+
+static uint64_t wal_milliseconds(void)
+{
+#ifdef _WIN32
+	return GetTickCount64();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+/* FNV-1a, only has to catch an edit torn by a crash */
+static int wal_checksum(const char* buf, int size)
+{
+	uint32_t hash = 0x811C9DC5;
+	for (int i = 0; i < size; i++)
+		hash = (hash ^ (uint8_t)buf[i]) * 0x01000193;
+	return (int)hash;
+}
+
+/* waits for everything written to reach the disk */
+static bool wal_sync(FILE* file)
+{
+	if (fflush(file) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+static bool wal_truncate(FILE* file, long size)
+{
+#ifdef _WIN32
+	return _chsize_s(_fileno(file), size) == 0;
+#else
+	return ftruncate(fileno(file), size) == 0;
+#endif
+}
+
+/* applies one edit to lines, returns false if it doesn't fit them */
+static bool wal_apply(rope_t lines, const char* edit, int size)
+{
+	char kind;
+	coords_t start, end;
+	read_char(edit, 0, size, &kind);
+	read_int(edit, CHAR_SIZE, size, &start.column);
+	read_int(edit, CHAR_SIZE + INT_SIZE, size, &start.row);
+	read_int(edit, CHAR_SIZE + 2 * INT_SIZE, size, &end.column);
+	read_int(edit, CHAR_SIZE + 3 * INT_SIZE, size, &end.row);
+	if (!editor_is_valid_cursor(lines, start))
+		return false;
+
+	if (kind == WAL_INSERT)
+	{
+		editor_add_text(lines, edit + WAL_EDIT_SIZE, size - WAL_EDIT_SIZE, &start);
+		return true;
+	}
+	/* a region can only end on a newline that has a row after it */
+	if (kind != WAL_REMOVE || !editor_is_valid_cursor(lines, end) || editor_compare_cursors(start, end) > 0
+		|| (end.row + 1 == rope_line_count(lines) && end.column == rope_line_length(lines, end.row)))
+		return false;
+	editor_delete_region(lines, start, end);
+	return true;
+}
+
+/* replays log into lines if it was written against stamp. Returns count of edits replayed or -1, and size of the log up to the last whole edit */
+static int wal_replay(FILE* file, const int stamp[WAL_STAMP_COUNT], rope_t lines, long* valid_size)
+{
+	long size;
+	char* buf = read_all_file(file, &size);
+	if (!buf)
+		return -1;
+
+	int result = -1;
+	if (size >= (long)WAL_HEADER_SIZE && memcmp(buf, wal_magic, sizeof wal_magic) == 0 && buf[sizeof wal_magic] == WAL_VERSION)
+	{
+		result = 0;
+		for (int i = 0; i < WAL_STAMP_COUNT; i++)
+		{
+			int value;
+			read_int(buf, sizeof wal_magic + CHAR_SIZE + i * INT_SIZE, size, &value);
+			if (value != stamp[i])
+				result = -1; /* the file was saved since, or changed by something else */
+		}
+	}
+
+	long pos = WAL_HEADER_SIZE;
+	while (result >= 0 && size - pos >= WAL_RECORD_SIZE)
+	{
+		int edit_size, checksum;
+		read_int(buf, pos, size, &edit_size);
+		read_int(buf, pos + INT_SIZE, size, &checksum);
+		const char* edit = buf + pos + WAL_RECORD_SIZE;
+		if (edit_size < WAL_EDIT_SIZE || edit_size > size - pos - WAL_RECORD_SIZE || wal_checksum(edit, edit_size) != checksum)
+			break; /* torn by the crash */
+		if (!wal_apply(lines, edit, edit_size))
+		{
+			debug_format("Edit %i in the log doesn't fit the file, stopping replay.\n", result);
+			break;
+		}
+		result++;
+		pos += WAL_RECORD_SIZE + edit_size;
+	}
+	*valid_size = pos;
+	free(buf);
+	return result;
+}
+
+/* creates empty log, stamped with the file at directory */
+static FILE* wal_create(const char* directory)
+{
+	int stamp[WAL_STAMP_COUNT];
+	if (!wal_stamp(directory, stamp))
+		return NULL;
+	FILE* file = fopen(wal_directory, "wb");
+	if (!file)
+		return NULL;
+	setvbuf(file, NULL, _IONBF, 0); /* the group is the buffer, nothing should be left to allocate when flushing */
+
+	char header[WAL_HEADER_SIZE];
+	memcpy(header, wal_magic, sizeof wal_magic);
+	header[sizeof wal_magic] = WAL_VERSION;
+	for (int i = 0; i < WAL_STAMP_COUNT; i++)
+		store_int(header, sizeof wal_magic + CHAR_SIZE + i * INT_SIZE, sizeof header, stamp[i]);
+	if (fwrite(header, 1, sizeof header, file) != sizeof header || !wal_sync(file))
+	{
+		fclose(file);
+		remove(wal_directory);
+		return NULL;
+	}
+	return file;
+}
+
+/* reopens the log left by a crash to keep appending after its last whole edit */
+static FILE* wal_reopen(long valid_size)
+{
+	FILE* file = fopen(wal_directory, "r+b");
+	if (!file)
+		return NULL;
+	setvbuf(file, NULL, _IONBF, 0);
+	if (!wal_truncate(file, valid_size) || fseek(file, 0, SEEK_END) != 0)
+	{
+		fclose(file);
+		return NULL;
+	}
+	return file;
+}
+
+static bool wal_set_directory(const char* directory)
+{
+	int count = snprintf(wal_directory, sizeof wal_directory, "%s" WAL_EXTENSION, directory);
+	return count > 0 && count < (int)sizeof wal_directory;
+}
+
+static void wal_start(FILE* file)
+{
+	wal_file = file;
+	wal_group = list_create(sizeof(char));
+	list_reserve(wal_group, WAL_GROUP_SIZE);
+}
+
+/*	starts logging edits to the file at directory, first replaying into lines any edits a crash left in its log.
+	Returns count of edits replayed or -1 if the log couldn't be started */
+int wal_open(const char* directory, rope_t lines)
+{
+	assert(directory && lines);
+	wal_close();
+	int stamp[WAL_STAMP_COUNT];
+	if (!wal_set_directory(directory) || !wal_stamp(directory, stamp))
+		return -1;
+
+	int result = -1;
+	long valid_size = 0;
+	FILE* file = fopen(wal_directory, "rb");
+	if (file)
+	{
+		result = wal_replay(file, stamp, lines, &valid_size);
+		fclose(file);
+	}
+	file = result >= 0 ? wal_reopen(valid_size) : NULL;
+	if (!file)
+	{
+		file = wal_create(directory);
+		if (!file)
+			return -1;
+	}
+	wal_start(file);
+	return max(result, 0);
+}
+
+/* starts an empty log for the file at directory as it is on disk now. Called after the file is saved */
+bool wal_restart(const char* directory)
+{
+	assert(directory);
+	wal_close();
+	if (!wal_set_directory(directory))
+		return false;
+	FILE* file = wal_create(directory);
+	if (!file)
+		return false;
+	wal_start(file);
+	return true;
+}
+
+/* stops logging and deletes the log, its edits are either saved or discarded */
+void wal_close(void)
+{
+	if (!wal_file)
+		return;
+	fclose(wal_file);
+	wal_file = NULL;
+	remove(wal_directory);
+	list_destroy(wal_group);
+	wal_group = NULL;
+}
+
+/* whether edits are being logged */
+bool wal_is_open(void)
+{
+	return !!wal_file;
+}
+
+/* logs text inserted at start, or the inclusive region from start to end removed */
+void wal_append(bool did_remove, coords_t start, coords_t end, const char* text, int size)
+{
+	assert((text || size == 0) && size >= 0);
+	if (!wal_file)
+		return;
+	int edit_size = WAL_EDIT_SIZE + (did_remove ? 0 : size);
+	if (list_count(wal_group) > 0 && list_count(wal_group) + WAL_RECORD_SIZE + edit_size > WAL_GROUP_SIZE)
+		DEBUG_ON_FAILURE(wal_flush());
+	if (!wal_file)
+		return;
+
+	uint64_t now = wal_milliseconds();
+	if (list_count(wal_group) == 0)
+		wal_group_time = now;
+	int pos = list_count(wal_group), record_size = WAL_RECORD_SIZE + edit_size;
+	list_resize(wal_group, pos + record_size);
+	char* record = (char*)list_element_array(wal_group) + pos, *edit = record + WAL_RECORD_SIZE;
+	edit[0] = did_remove ? WAL_REMOVE : WAL_INSERT;
+	store_int(edit, CHAR_SIZE, edit_size, start.column);
+	store_int(edit, CHAR_SIZE + INT_SIZE, edit_size, start.row);
+	store_int(edit, CHAR_SIZE + 2 * INT_SIZE, edit_size, end.column);
+	store_int(edit, CHAR_SIZE + 3 * INT_SIZE, edit_size, end.row);
+	if (!did_remove)
+		memcpy(edit + WAL_EDIT_SIZE, text, size);
+	store_int(record, 0, record_size, edit_size);
+	store_int(record, INT_SIZE, record_size, wal_checksum(edit, edit_size));
+
+	if (list_count(wal_group) >= WAL_GROUP_SIZE || now - wal_group_time >= WAL_GROUP_DELAY)
+		DEBUG_ON_FAILURE(wal_flush());
+}
+
+/* whether there are edits that haven't been written yet */
+bool wal_has_pending(void)
+{
+	return wal_file && list_count(wal_group) > 0;
+}
+
+/* writes pending edits and waits for them to reach the disk. Allocates nothing, so it's safe when out of memory */
+bool wal_flush(void)
+{
+	if (!wal_file)
+		return false;
+	int count = list_count(wal_group);
+	if (count == 0)
+		return true;
+	if (fwrite(list_element_array(wal_group), 1, count, wal_file) == (size_t)count && wal_sync(wal_file))
+	{
+		list_clear(wal_group);
+		return true;
+	}
+
+	/* the edits before this group can still be replayed, so the log is kept but nothing more is added */
+	fclose(wal_file);
+	wal_file = NULL;
+	list_destroy(wal_group);
+	wal_group = NULL;
+	return false;
+}
+
+#ifdef TEST
+#ifdef WAL_TEST
+#include <stdio.h>
+
+#define TEST_BASE "wal_test.txt"
+#define TEST_COUNT 2000
+
+static bool wal_test_equal(rope_t a, rope_t b)
+{
+	list_t x = list_create(sizeof(char)), y = list_create(sizeof(char));
+	editor_copy_all_lines(a, x);
+	editor_copy_all_lines(b, y);
+	bool result = list_count(x) == list_count(y) && memcmp(list_element_array(x), list_element_array(y), list_count(x)) == 0;
+	list_destroy(x);
+	list_destroy(y);
+	return result;
+}
+
+static rope_t wal_test_base(void)
+{
+	static const char base[] = "first line\n\tsecond line\nthird\n";
+	rope_t lines = rope_create();
+	coords_t start = { 0 };
+	editor_add_text(lines, base, sizeof base - 1, &start);
+	return lines;
+}
+
+/* leaves the log on disk like a crash would */
+static void wal_test_crash(void)
+{
+	wal_flush();
+	fclose(wal_file);
+	wal_file = NULL;
+	list_destroy(wal_group);
+	wal_group = NULL;
+}
+
+int main()
+{
+	static const char* samples[] = { "a", "hello", "\n", "ab\ncd", "\tx" };
+	FILE* base = fopen(TEST_BASE, "wb");
+	fputs("first line\n\tsecond line\nthird\n", base);
+	fclose(base);
+	srand(29);
+
+	/* edits are applied as the console would and logged */
+	int wrong_count = 0;
+	rope_t lines = wal_test_base();
+	wrong_count += wal_open(TEST_BASE, lines) != 0;
+	for (int i = 0; i < TEST_COUNT; i++)
+	{
+		int row = rand() % rope_line_count(lines);
+		coords_t start = { rand() % (rope_line_length(lines, row) + 1), row };
+		if (rand() % 3 || rope_line_count(lines) < 4)
+		{
+			const char* sample = samples[rand() % (sizeof samples / sizeof * samples)];
+			coords_t end = start;
+			editor_add_text(lines, sample, (int)strlen(sample), &end);
+			wal_append(false, start, end, sample, (int)strlen(sample));
+		}
+		else if (start.column < rope_line_length(lines, row))
+		{
+			coords_t end = editor_overflow_cursor(lines, (coords_t) { start.column + rand() % 12, start.row });
+			if (editor_compare_cursors(start, end) > 0 || (end.row + 1 == rope_line_count(lines) && end.column == rope_line_length(lines, end.row)))
+				continue;
+			editor_delete_region(lines, start, end);
+			wal_append(true, start, end, NULL, 0);
+		}
+	}
+	wal_test_crash();
+
+	/* replaying over the saved file gets the same lines back, even with a torn edit at the end */
+	FILE* log = fopen(TEST_BASE WAL_EXTENSION, "ab");
+	fwrite("\x40\0\0\0garbage", 1, 11, log);
+	fclose(log);
+	rope_t recovered = wal_test_base();
+	int replayed = wal_open(TEST_BASE, recovered);
+	wrong_count += replayed <= 0 || !wal_test_equal(lines, recovered);
+
+	/* the log keeps going after a recovery */
+	coords_t start = { 0 }, end = start;
+	editor_add_text(lines, "new", 3, &end);
+	wal_append(false, start, end, "new", 3);
+	end = start;
+	editor_add_text(recovered, "new", 3, &end);
+	wal_test_crash();
+	rope_destroy(recovered);
+	recovered = wal_test_base();
+	wrong_count += wal_open(TEST_BASE, recovered) != replayed + 1 || !wal_test_equal(lines, recovered);
+
+	/* a restarted log, like after saving, has nothing to replay */
+	wrong_count += !wal_restart(TEST_BASE);
+	wal_test_crash();
+	rope_destroy(recovered);
+	recovered = wal_test_base();
+	wrong_count += wal_open(TEST_BASE, recovered) != 0;
+	wal_close();
+	wrong_count += fopen(TEST_BASE WAL_EXTENSION, "rb") != NULL;
+
+	printf("Log test resulted in %i mismatches after replaying %i edits.\n", wrong_count, replayed);
+	rope_destroy(lines);
+	rope_destroy(recovered);
+	remove(TEST_BASE);
+	return wrong_count != 0;
+}
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+/*
+	wal.h ~ RL
+
+	Append-only log of edits made since the last save, replayed over the saved file after a crash
+*/
+
+#pragma once
+
+#include "editor.h"
+#include <stdbool.h>
+#include "util.h"
+
+#define WAL_GROUP_SIZE		0x1000	/* pending edits are written together once they take this many bytes */
+#define WAL_GROUP_DELAY		250		/* or once the oldest has waited this many milliseconds */
+
+/*	starts logging edits to the file at directory, first replaying into lines any edits a crash left in its log.
+	Returns count of edits replayed or -1 if the log couldn't be started */
+int wal_open(const char* directory, rope_t lines);
+/* starts an empty log for the file at directory as it is on disk now. Called after the file is saved */
+bool wal_restart(const char* directory);
+/* stops logging and deletes the log, its edits are either saved or discarded */
+void wal_close(void);
+/* whether edits are being logged */
+bool wal_is_open(void);
+
+/* logs text inserted at start, or the inclusive region from start to end removed */
+void wal_append(bool did_remove, coords_t start, coords_t end, const char* text, int size);
+/* whether there are edits that haven't been written yet */
+bool wal_has_pending(void);
+/* writes pending edits and waits for them to reach the disk. Allocates nothing, so it's safe when out of memory */
+bool wal_flush(void);
\ No newline at end of file